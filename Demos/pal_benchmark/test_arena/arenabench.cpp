@@ -0,0 +1,123 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	PAL object arena benchmark.
+	Plays a number of matches, each creating a world of boxes, walking all the bodies a few times
+	and tearing the world down with palFactory::Cleanup, once with the objects allocated from the heap
+	one by one and once from the per-type arenas. Reports per match:
+	- create ms: creating the physics and the bodies
+	- walk ms: reading the location of every body, through pointers and through handles
+	- teardown ms: Cleanup, which deletes the objects one by one in both cases
+	Stale handles are checked to resolve to NULL after each match.
+
+	usage: ./test_arena engine [bodies] [matches] [walks]
+*/
+
+struct Times {
+	double create, walkPointers, walkHandles, teardown;
+};
+
+static bool Match(int bodies, int walks, Times& t) {
+	BenchTimer timer;
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return false;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+	std::vector<palBody *> list;
+	std::vector<palHandle> handles;
+	list.reserve(bodies);
+	handles.reserve(bodies);
+	for (int i = 0; i < bodies; i++) {
+		palGenericBody *pb = PF->CreateGenericBody();
+		if (pb == NULL)
+			return false;
+		palMatrix4x4 m;
+		mat_identity(&m);
+		mat_translate(&m, Float(i % 100) * 2.0f, 1.0f + Float(i / 10000), Float(i / 100 % 100) * 2.0f);
+		pb->Init(m);
+		pb->SetDynamicsType(PALBODY_DYNAMIC);
+		pb->SetMass(1);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, 1, 1, 1, 1);
+		pb->ConnectGeometry(pbg);
+		list.push_back(pb);
+		handles.push_back(PF->GetHandle(pb));
+	}
+	t.create += timer.ElapsedMs();
+
+	Float sum = 0;
+	timer.Start();
+	for (int w = 0; w < walks; w++)
+		for (size_t i = 0; i < list.size(); i++)
+			sum += list[i]->GetLocationMatrix()._mat[13];
+	t.walkPointers += timer.ElapsedMs();
+	timer.Start();
+	for (int w = 0; w < walks; w++) {
+		for (size_t i = 0; i < handles.size(); i++) {
+			palBody *pb = PF->Resolve<palBody>(handles[i]);
+			if (pb)
+				sum -= pb->GetLocationMatrix()._mat[13];
+		}
+	}
+	t.walkHandles += timer.ElapsedMs();
+
+	timer.Start();
+	PF->Cleanup();
+	t.teardown += timer.ElapsedMs();
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		if (PF->Resolve(handles[i]) != NULL) {
+			printf("Handle %u still resolves after Cleanup\n", handles[i]);
+			return false;
+		}
+	}
+	return sum == 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Object arena benchmark\n");
+		printf("usage: ./test_arena engine [bodies] [matches] [walks]\n");
+		printf("example: ./test_arena Bullet 20000 5 20\n");
+		return 0;
+	}
+	int bodies = 20000;
+	int matches = 5;
+	int walks = 20;
+	if (argc > 2) bodies = atoi(argv[2]);
+	if (argc > 3) matches = atoi(argv[3]);
+	if (argc > 4) walks = atoi(argv[4]);
+	if (bodies < 1 || matches < 1 || walks < 1) {
+		printf("usage: ./test_arena engine [bodies] [matches] [walks]\n");
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d bodies, %d matches, %d walks, per match:\n", argv[1], bodies, matches, walks);
+	printf("   objects    create ms    walk ms (pointers)    walk ms (handles)    teardown ms\n");
+	const char *names[2] = {"heap", "arenas"};
+	for (int a = 0; a < 2; a++) {
+		ObjectArena::SetEnabled(a == 1);
+		Times t = {0, 0, 0, 0};
+		for (int i = 0; i < matches; i++) {
+			if (!Match(bodies, walks, t)) {
+				printf("Could not play the match\n");
+				return 1;
+			}
+		}
+		printf("%10s   %10.2f   %19.3f   %18.3f   %12.2f\n", names[a],
+			t.create / matches, t.walkPointers / matches, t.walkHandles / matches, t.teardown / matches);
+	}
+	ObjectArena::SetEnabled(true);
+	PF->Cleanup();
+	return 0;
+}
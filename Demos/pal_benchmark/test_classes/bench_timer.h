@@ -0,0 +1,23 @@
+#ifndef BENCH_TIMER_H
+#define BENCH_TIMER_H
+
+#include <chrono>
+
+/*
+	Wall clock stopwatch used by the console micro benchmarks.
+*/
+class BenchTimer {
+public:
+	BenchTimer() { Start(); }
+	void Start() { m_start = std::chrono::high_resolution_clock::now(); }
+	/// @return seconds since the last Start()
+	double Elapsed() const {
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - m_start).count();
+	}
+	/// @return milliseconds since the last Start()
+	double ElapsedMs() const { return Elapsed() * 1000.0; }
+private:
+	std::chrono::high_resolution_clock::time_point m_start;
+};
+
+#endif
@@ -0,0 +1,95 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+	PAL compound body benchmark.
+	Rests generic bodies made of many small boxes on top of each other, and reports the step time
+	by number of boxes per body, with and without the compound AABB tree (Bullet_CompoundAabbTreeThreshold).
+
+	usage: ./test_compound engine [pairs] [steps]
+*/
+
+static palGenericBody *CreateSlab(Float x, Float y, Float z, int children, bool dynamic) {
+	palGenericBody *pb = PF->CreateGenericBody();
+	if (pb == NULL)
+		return NULL;
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	pb->Init(m);
+	pb->SetDynamicsType(dynamic ? PALBODY_DYNAMIC : PALBODY_STATIC);
+	if (dynamic)
+		pb->SetMass(Float(children));
+	// a square slab of 0.2 unit boxes, a couple of boxes thick
+	int side = (int)ceil(sqrt(children / 2.0));
+	for (int i = 0; i < children; i++) {
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		palMatrix4x4 g = m;
+		mat_translate(&g, Float(i % side) * 0.2f, Float(i / (side * side)) * 0.2f, Float((i / side) % side) * 0.2f);
+		pbg->Init(g, 0.2f, 0.2f, 0.2f, 1);
+		pb->ConnectGeometry(pbg);
+	}
+	return pb;
+}
+
+static double Run(int children, bool tree, int pairs, int steps) {
+	palPhysicsDesc desc;
+	desc.m_Properties["Bullet_CompoundAabbTreeThreshold"] = tree ? "1" : "0";
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return -1;
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 200.0f);
+
+	for (int i = 0; i < pairs; i++) {
+		Float x = Float(i % 10) * 10;
+		Float z = Float(i / 10) * 10;
+		if (CreateSlab(x, 0.1f, z, children, false) == NULL || CreateSlab(x + 0.3f, 1.0f, z + 0.3f, children, true) == NULL) {
+			printf("Could not create generic body\n");
+			return -1;
+		}
+	}
+	// let the upper slabs land, so every step has compound vs compound contacts
+	for (int i = 0; i < 100; i++)
+		pp->Update(0.01f);
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	double ms = t.ElapsedMs() / steps;
+	PF->Cleanup();
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Compound body benchmark\n");
+		printf("usage: ./test_compound engine [pairs] [steps]\n");
+		printf("example: ./test_compound Bullet 10 200\n");
+		return 0;
+	}
+	int pairs = 10;
+	int steps = 200;
+	if (argc > 2) pairs = atoi(argv[2]);
+	if (argc > 3) steps = atoi(argv[3]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d pairs of compound bodies, %d steps\n", argv[1], pairs, steps);
+	printf("children    linear ms/step   tree ms/step   speedup\n");
+	const int counts[] = { 8, 32, 128, 256, 512 };
+	for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		double linear = Run(counts[i], false, pairs, steps);
+		double tree = Run(counts[i], true, pairs, steps);
+		if (linear < 0 || tree < 0)
+			return 1;
+		printf("%8d   %14.3f   %12.3f   %6.2fx\n", counts[i], linear, tree, linear / tree);
+	}
+	return 0;
+}
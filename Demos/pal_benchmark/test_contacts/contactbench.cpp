@@ -0,0 +1,92 @@
+#include "pal/palFactory.h"
+#include "pal/palSensors.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+	PAL contact sensor benchmark.
+	Rests a grid of box stacks on a plane, so every step has many contacts, and reports the step time
+	as contact sensors are added to more of the boxes. Engines that only report the collisions of
+	bodies with sensors keep the step time flat until most of the boxes have one.
+
+	usage: ./test_contacts engine [stacks] [boxes per stack] [steps]
+*/
+
+static double Run(int sensors, int stacks, int height, int steps) {
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return -1;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 200.0f);
+
+	int side = 1;
+	while (side * side < stacks)
+		side++;
+	int count = 0;
+	for (int i = 0; i < stacks; i++) {
+		Float x = Float(i % side) * 2 - side;
+		Float z = Float(i / side) * 2 - side;
+		for (int j = 0; j < height; j++) {
+			palBox *pb = PF->CreateBox();
+			if (pb == NULL) {
+				printf("Could not create box\n");
+				return -1;
+			}
+			pb->Init(x, 0.5f + j, z, 1, 1, 1, 1);
+			if (count++ < sensors) {
+				palContactSensor *pcs = PF->CreateContactSensor();
+				if (pcs == NULL) {
+					printf("Could not create contact sensor\n");
+					return -1;
+				}
+				pcs->Init(pb);
+			}
+		}
+	}
+	// let the stacks settle
+	for (int i = 0; i < 50; i++)
+		pp->Update(0.01f);
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	double ms = t.ElapsedMs() / steps;
+	PF->Cleanup();
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Contact sensor benchmark\n");
+		printf("usage: ./test_contacts engine [stacks] [boxes per stack] [steps]\n");
+		printf("example: ./test_contacts Tokamak 100 4 200\n");
+		return 0;
+	}
+	int stacks = 100;
+	int height = 4;
+	int steps = 200;
+	if (argc > 2) stacks = atoi(argv[2]);
+	if (argc > 3) height = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	int boxes = stacks * height;
+	printf("%s: %d stacks of %d boxes, %d steps\n", argv[1], stacks, height, steps);
+	printf(" sensors    ms/step\n");
+	const int counts[] = { 0, 1, 10, 100, boxes };
+	for (unsigned i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		if (counts[i] > boxes)
+			continue;
+		double ms = Run(counts[i], stacks, height, steps);
+		if (ms < 0)
+			return 1;
+		printf("%8d   %8.3f\n", counts[i], ms);
+	}
+	return 0;
+}
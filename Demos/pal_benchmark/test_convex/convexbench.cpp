@@ -0,0 +1,110 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL convex hull benchmark.
+	Drops a pile of rocks, each a dense point cloud like a scanned mesh, and reports the step time
+	with the whole hull and with the hull reduced to a vertex budget (Bullet_ConvexHullMaxVertices).
+	Only a few distinct rocks are generated, so engines that share hull shapes can do so.
+
+	usage: ./test_convex engine [rocks] [points per rock] [max hull vertices] [steps]
+*/
+
+static Float frand() {
+	return rand() / (Float)RAND_MAX;
+}
+
+// a lumpy ellipsoid, sampled on and just below its surface
+static void MakeRock(std::vector<Float>& points, int count) {
+	Float sx = 0.6f + frand() * 0.4f, sy = 0.4f + frand() * 0.3f, sz = 0.5f + frand() * 0.5f;
+	points.resize(count * 3);
+	for (int i = 0; i < count; i++) {
+		Float z = frand() * 2 - 1;
+		Float a = frand() * Float(2 * M_PI);
+		Float r = sqrt(1 - z * z);
+		Float d = 0.9f + frand() * 0.1f;
+		points[i*3 + 0] = r * cos(a) * sx * d;
+		points[i*3 + 1] = r * sin(a) * sy * d;
+		points[i*3 + 2] = z * sz * d;
+	}
+}
+
+static double RunPile(const char *engine, int rocks, int pointsPerRock, int maxVertices, int steps) {
+	srand(1);
+	palPhysicsDesc desc;
+	char buf[32];
+	sprintf(buf, "%d", maxVertices);
+	desc.m_Properties["Bullet_ConvexHullMaxVertices"] = buf;
+	desc.m_Properties["Bullet_ConvexHullPolyhedralFeatures"] = "false";
+
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL) {
+		printf("Could not create physics for %s\n", engine);
+		return -1;
+	}
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 100.0f);
+
+	const int templates = 8;
+	std::vector<std::vector<Float> > shapes(templates);
+	for (int i = 0; i < templates; i++)
+		MakeRock(shapes[i], pointsPerRock);
+
+	int side = (int)ceil(pow((double)rocks, 1.0 / 3.0));
+	for (int i = 0; i < rocks; i++) {
+		palConvex *pc = PF->CreateConvex();
+		if (pc == NULL) {
+			printf("Could not create convex\n");
+			return -1;
+		}
+		const std::vector<Float>& s = shapes[i % templates];
+		Float x = Float(i % side) * 2.2f - side;
+		Float y = Float((i / side) / side) * 1.6f + 1.0f;
+		Float z = Float((i / side) % side) * 2.2f - side;
+		pc->Init(x, y, z, &s[0], pointsPerRock, 1);
+	}
+
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	double ms = t.ElapsedMs() / steps;
+	PF->Cleanup();
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Convex hull benchmark\n");
+		printf("usage: ./test_convex engine [rocks] [points per rock] [max hull vertices] [steps]\n");
+		printf("example: ./test_convex Bullet 500 3000 32 300\n");
+		return 0;
+	}
+	int rocks = 500;
+	int pointsPerRock = 3000;
+	int maxVertices = 32;
+	int steps = 300;
+	if (argc > 2) rocks = atoi(argv[2]);
+	if (argc > 3) pointsPerRock = atoi(argv[3]);
+	if (argc > 4) maxVertices = atoi(argv[4]);
+	if (argc > 5) steps = atoi(argv[5]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d rocks of %d points, %d steps\n", argv[1], rocks, pointsPerRock, steps);
+
+	double full = RunPile(argv[1], rocks, pointsPerRock, 0, steps);
+	double reduced = RunPile(argv[1], rocks, pointsPerRock, maxVertices, steps);
+	if (full < 0 || reduced < 0)
+		return 1;
+	printf("whole hull     %10.3f ms/step\n", full);
+	printf("%3d vertices   %10.3f ms/step   speedup %5.2fx\n", maxVertices, reduced, full / reduced);
+	return 0;
+}
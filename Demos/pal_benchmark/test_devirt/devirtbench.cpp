@@ -0,0 +1,140 @@
+#include "pal/palStaticEngine.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL static single engine benchmark.
+	Creates a grid of boxes on a plane, half of them with the PAL Create methods and half with palFactory::CreateEngineObject,
+	and reports how long each takes. Then times a per body loop like a sync and force pass: read the location and
+	the velocities of every body, and apply a spring force holding it at its resting height and a damping torque.
+	The loop is run through the PAL interfaces (palBody *, virtual calls) and through the engine types
+	(palEngineGenericBody *, direct calls), alternately on the same state between steps, and must read the same values.
+
+	Built once per engine (test_devirt_ode, test_devirt_bullet) with PAL_STATIC_ENGINE defined.
+	usage: ./test_devirt_<engine> [bodies] [passes]
+*/
+
+#ifndef PAL_STATIC_ENGINE
+#error test_devirt is built for one engine, with PAL_STATIC_ENGINE and PAL_STATIC_ENGINE_ODE or PAL_STATIC_ENGINE_BULLET defined
+#endif
+
+static const Float DT = 1.0f / 60.0f;
+static const Float SPRING = 2.0f;
+static const Float DAMPING = 0.5f;
+static const Float HEIGHT = 0.5f;
+
+template <typename Body> static double Pass(Body *const *bodies, size_t count) {
+	double sum = 0;
+	for (size_t i = 0; i < count; i++) {
+		Body *b = bodies[i];
+		const palMatrix4x4& m = b->GetLocationMatrix();
+		palVector3 v, w;
+		b->GetLinearVelocity(v);
+		b->GetAngularVelocity(w);
+		if (b->IsActive()) {
+			b->ApplyForce(-DAMPING * v.x, -SPRING * (m._mat[13] - HEIGHT) - DAMPING * v.y, -DAMPING * v.z);
+			b->ApplyTorque(-DAMPING * w.x, -DAMPING * w.y, -DAMPING * w.z);
+		}
+		sum += m._mat[12] + m._mat[13] + m._mat[14] + v.x + v.y + v.z + w.x + w.y + w.z;
+	}
+	return sum;
+}
+
+int main(int argc, char *argv[]) {
+	int count = 10000;
+	int passes = 200;
+	if (argc > 1) count = atoi(argv[1]);
+	if (argc > 2) passes = atoi(argv[2]);
+	if (count < 2 || passes < 1) {
+		printf("usage: %s [bodies] [passes]\n", argv[0]);
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(PAL_STATIC_ENGINE_NAME)) {
+		printf("Could not select engine %s\n", PAL_STATIC_ENGINE_NAME);
+		return 1;
+	}
+	palEnginePhysics *pp = PF->CreateEnginePhysics<palEnginePhysics>();
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	int side = (int)ceil(sqrt((double)count));
+	palEngineTerrainPlane *ground = PF->CreateEngineObject<palEngineTerrainPlane>();
+	ground->Init(0, 0, 0, side * 2.0f * 2 + 20);
+
+	std::vector<palBody *> bodies;
+	std::vector<palEngineGenericBody *> engineBodies;
+	BenchTimer t;
+	double createMs[2] = {0, 0};
+	for (int i = 0; i < count; i++) {
+		palMatrix4x4 m;
+		mat_identity(&m);
+		mat_translate(&m, (i % side) * 2.0f - side, HEIGHT + (i % 5) * 0.01f, (i / side) * 2.0f - side);
+		bool engine = i >= count / 2;
+		t.Start();
+		palEngineGenericBody *peb;
+		if (engine) {
+			peb = PF->CreateEngineObject<palEngineGenericBody>();
+			peb->Init(m);
+			peb->SetDynamicsType(PALBODY_DYNAMIC);
+			peb->SetMass(1);
+			palEngineBoxGeometry *pbg = PF->CreateEngineObject<palEngineBoxGeometry>();
+			pbg->Init(m, 1, 1, 1, 1);
+			peb->ConnectGeometry(pbg);
+		} else {
+			palGenericBody *pgb = PF->CreateGenericBody();
+			pgb->Init(m);
+			pgb->SetDynamicsType(PALBODY_DYNAMIC);
+			pgb->SetMass(1);
+			palBoxGeometry *pbg = PF->CreateBoxGeometry();
+			pbg->Init(m, 1, 1, 1, 1);
+			pgb->ConnectGeometry(pbg);
+			peb = dynamic_cast<palEngineGenericBody *>(pgb);
+		}
+		createMs[engine] += t.ElapsedMs();
+		if (peb == NULL) {
+			printf("Could not create a box\n");
+			return 1;
+		}
+		bodies.push_back(peb);
+		engineBodies.push_back(peb);
+	}
+	printf("%s: %d bodies, %d passes\n", PAL_STATIC_ENGINE_NAME, count, passes);
+	printf("create: %.3f us/body with the PAL Create methods, %.3f us/body with CreateEngineObject\n",
+		createMs[0] * 1000 / (count / 2), createMs[1] * 1000 / (count - count / 2));
+
+	for (int i = 0; i < 10; i++)
+		pp->Update(DT);
+
+	double ms[2] = {0, 0};
+	unsigned mismatches = 0;
+	for (int p = 0; p < passes; p++) {
+		//alternate which loop runs first, so neither always gets the warm cache
+		double sum[2];
+		for (int k = 0; k < 2; k++) {
+			int mode = (p + k) % 2;
+			t.Start();
+			if (mode == 0)
+				sum[mode] = Pass(&bodies[0], bodies.size());
+			else
+				sum[mode] = Pass(&engineBodies[0], engineBodies.size());
+			ms[mode] += t.ElapsedMs();
+		}
+		if (sum[0] != sum[1])
+			mismatches++;
+		pp->Update(DT);
+	}
+	double ns[2];
+	for (int mode = 0; mode < 2; mode++)
+		ns[mode] = ms[mode] * 1e6 / ((double)passes * count);
+	printf("virtual (palBody *):                %.2f ns/body\n", ns[0]);
+	printf("direct (palEngineGenericBody *):    %.2f ns/body\n", ns[1]);
+	printf("speedup %.2fx, %u passes read different values\n", ns[0] / ns[1], mismatches);
+
+	PF->Cleanup();
+	return mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,140 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+	PAL static instance set benchmark.
+	Scatters static props (crates and posts) over a field with a few dynamic boxes falling on them,
+	and reports the creation time, step time and resident memory with one static body per prop,
+	and with all the props in a single palStaticInstanceSet.
+
+	usage: ./test_instances engine [props] [dynamic bodies] [steps]
+*/
+
+// resident set size in kB, -1 if not known on this platform
+static long ResidentKB() {
+	long kb = -1;
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f == NULL)
+		return kb;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "VmRSS: %ld", &kb) == 1)
+			break;
+	}
+	fclose(f);
+	return kb;
+}
+
+static void PropLocation(int i, int side, palMatrix4x4& m) {
+	mat_identity(&m);
+	mat_translate(&m, Float(i % side) * 2.0f, 0.5f, Float(i / side) * 2.0f);
+	mat_rotate(&m, Float(i * 37 % 360), 0, 1, 0);
+}
+
+static bool Run(int props, int bodies, int steps, bool instanced) {
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return false;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 4000.0f);
+
+	long kb = ResidentKB();
+	BenchTimer t;
+	int side = (int)ceil(sqrt((double)props));
+	if (instanced) {
+		palStaticInstanceSet *set = PF->CreateStaticInstanceSet();
+		if (set == NULL) {
+			printf("Could not create static instance set\n");
+			return false;
+		}
+		for (int i = 0; i < props; i++) {
+			palMatrix4x4 m;
+			PropLocation(i, side, m);
+			if (i % 2)
+				set->AddBox(m, 1, 1, 1);
+			else
+				set->AddCapsule(m, 0.2f, 0.6f);
+		}
+		set->Finalize();
+	} else {
+		for (int i = 0; i < props; i++) {
+			palGenericBody *pb = PF->CreateGenericBody();
+			palMatrix4x4 m;
+			PropLocation(i, side, m);
+			pb->Init(m);
+			pb->SetDynamicsType(PALBODY_STATIC);
+			palGeometry *pg;
+			if (i % 2) {
+				palBoxGeometry *pbg = PF->CreateBoxGeometry();
+				pbg->Init(m, 1, 1, 1, 1);
+				pg = pbg;
+			} else {
+				palCapsuleGeometry *pcg = PF->CreateCapsuleGeometry();
+				pcg->Init(m, 0.2f, 0.6f, 1);
+				pg = pcg;
+			}
+			pb->ConnectGeometry(pg);
+		}
+	}
+	double create = t.ElapsedMs();
+	long createKb = ResidentKB();
+
+	for (int i = 0; i < bodies; i++) {
+		palGenericBody *pb = PF->CreateGenericBody();
+		palMatrix4x4 m;
+		mat_identity(&m);
+		mat_translate(&m, Float(rand() % (side * 2)), 3.0f + Float(i % 10), Float(rand() % (side * 2)));
+		pb->Init(m);
+		pb->SetDynamicsType(PALBODY_DYNAMIC);
+		pb->SetMass(1);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, 0.5f, 0.5f, 0.5f, 1);
+		pb->ConnectGeometry(pbg);
+	}
+	t.Start();
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	double step = t.ElapsedMs() / steps;
+	PF->Cleanup();
+
+	if (kb >= 0 && createKb >= 0)
+		printf("%-12s %10.1f ms   %8.3f ms/step   %8ld kB\n", instanced ? "instance set" : "bodies", create, step, createKb - kb);
+	else
+		printf("%-12s %10.1f ms   %8.3f ms/step   n/a\n", instanced ? "instance set" : "bodies", create, step);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Static instance set benchmark\n");
+		printf("usage: ./test_instances engine [props] [dynamic bodies] [steps]\n");
+		printf("example: ./test_instances Bullet 50000 200 200\n");
+		return 0;
+	}
+	int props = 50000;
+	int bodies = 200;
+	int steps = 200;
+	if (argc > 2) props = atoi(argv[2]);
+	if (argc > 3) bodies = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d static props, %d dynamic boxes, %d steps\n", argv[1], props, bodies, steps);
+	printf("             create            step             memory\n");
+	srand(1);
+	if (!Run(props, bodies, steps, false))
+		return 1;
+	srand(1);
+	if (!Run(props, bodies, steps, true))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,120 @@
+#include "pal/palMath.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	PAL math micro benchmark.
+	Times the compiled math backend (see pal_math_backend) against the scalar reference
+	implementation and reports the largest difference between the two.
+
+	usage: ./test_math [count] [repeats]
+*/
+
+static Float sfrand() {
+	return (rand()/(Float)RAND_MAX - Float(0.5)) * Float(2.0);
+}
+
+static void RandomPose(palMatrix4x4 *m, palQuaternion *q) {
+	palVector3 axis(sfrand(), sfrand(), sfrand());
+	q_set_axis_angle(q, &axis, sfrand() * Float(M_PI));
+	mat_identity(m);
+	mat_set_quaternion_scalar(m, q);
+	mat_set_translation(m, sfrand() * 100, sfrand() * 100, sfrand() * 100);
+}
+
+static Float MaxDiff(const Float *a, const Float *b, size_t count, size_t stride, size_t used) {
+	Float result = 0;
+	for (size_t i = 0; i < count; i++)
+		for (size_t j = 0; j < used; j++) {
+			Float d = std::abs(a[i*stride+j] - b[i*stride+j]);
+			if (d > result)
+				result = d;
+		}
+	return result;
+}
+
+static bool Report(const char *name, double scalarMs, double simdMs, Float err) {
+	// FMA contraction is the only allowed source of difference
+	const Float tolerance = PAL_FLOAT_EPSILON * 1000;
+	bool ok = err <= tolerance;
+	printf("%-22s scalar %9.3f ms   %-6s %9.3f ms   speedup %5.2fx   max err %g %s\n",
+		name, scalarMs, pal_math_backend(), simdMs, scalarMs / simdMs, (double)err, ok ? "" : "FAILED");
+	return ok;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned int n = 100000;
+	int repeats = 20;
+	if (argc > 1)
+		n = atoi(argv[1]);
+	if (argc > 2)
+		repeats = atoi(argv[2]);
+
+	printf("PAL math benchmark: %u elements, %d repeats, backend %s, %s precision\n",
+		n, repeats, pal_math_backend(), sizeof(Float) == sizeof(double) ? "double" : "single");
+
+	std::vector<palMatrix4x4> a(n), b(n), ref(n), res(n);
+	std::vector<palQuaternion> q(n);
+	std::vector<palVector3> v(n), vref(n), vres(n);
+	for (unsigned int i = 0; i < n; i++) {
+		RandomPose(&a[i], &q[i]);
+		palQuaternion tmp;
+		RandomPose(&b[i], &tmp);
+		v[i].Set(sfrand() * 10, sfrand() * 10, sfrand() * 10);
+	}
+
+	bool ok = true;
+	BenchTimer t;
+	double scalarMs, simdMs;
+
+	// mat_multiply over N poses
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		for (unsigned int i = 0; i < n; i++)
+			mat_multiply_scalar(&ref[i], &a[i], &b[i]);
+	scalarMs = t.ElapsedMs();
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		mat_multiply_n(&res[0], &a[0], &b[0], n);
+	simdMs = t.ElapsedMs();
+	ok &= Report("mat_multiply_n", scalarMs, simdMs, MaxDiff(ref[0]._mat, res[0]._mat, n, 16, 16) / 100);
+
+	// one matrix, N points
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		for (unsigned int i = 0; i < n; i++)
+			vec_mat_mul_scalar(&vref[i], &a[0], &v[i]);
+	scalarMs = t.ElapsedMs();
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		vec_mat_mul_n(&vres[0], &a[0], &v[0], n);
+	simdMs = t.ElapsedMs();
+	ok &= Report("vec_mat_mul_n", scalarMs, simdMs, MaxDiff(vref[0]._vec, vres[0]._vec, n, 3, 3) / 10);
+
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		for (unsigned int i = 0; i < n; i++)
+			vec_mat_transform_scalar(&vref[i], &a[0], &v[i]);
+	scalarMs = t.ElapsedMs();
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		vec_mat_transform_n(&vres[0], &a[0], &v[0], n);
+	simdMs = t.ElapsedMs();
+	ok &= Report("vec_mat_transform_n", scalarMs, simdMs, MaxDiff(vref[0]._vec, vres[0]._vec, n, 3, 3) / 100);
+
+	// quaternion to matrix over N poses
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		for (unsigned int i = 0; i < n; i++)
+			mat_set_quaternion_scalar(&ref[i], &q[i]);
+	scalarMs = t.ElapsedMs();
+	t.Start();
+	for (int r = 0; r < repeats; r++)
+		mat_set_quaternion_n(&res[0], &q[0], n);
+	simdMs = t.ElapsedMs();
+	ok &= Report("mat_set_quaternion_n", scalarMs, simdMs, MaxDiff(ref[0]._mat, res[0]._mat, n, 16, 11));
+
+	return ok ? 0 : 1;
+}
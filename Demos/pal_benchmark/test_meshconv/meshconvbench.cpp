@@ -0,0 +1,201 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL mesh and transform conversion benchmark.
+	Times the conversions between the PAL types and the engine types:
+	- creating concave and convex geometries and terrain meshes from a grid mesh, which hands the vertices and indices to the engine
+	- reading the location of every body of a grid of boxes, which converts the engine transform to a palMatrix4x4
+	Where Float matches the engine scalar (ODE_REAL_IS_PAL_FLOAT, BT_SCALAR_IS_PAL_FLOAT, TOKAMAK_T3_IS_PAL_MATRIX)
+	these are passed through or copied as a block, compare with a build using DOUBLE_PRECISION.
+
+	usage: ./test_meshconv engine [meshes] [mesh side] [bodies] [passes]
+*/
+
+static const Float DT = 1.0f / 60.0f;
+
+// a side x side grid of quads, bumped so it is not flat
+static void BuildGrid(int side, std::vector<Float>& vertices, std::vector<int>& indices) {
+	vertices.clear();
+	indices.clear();
+	for (int z = 0; z <= side; z++) {
+		for (int x = 0; x <= side; x++) {
+			vertices.push_back(Float(x) - side * 0.5f);
+			vertices.push_back(Float(0.2 * sin(x * 0.7) * cos(z * 0.3)));
+			vertices.push_back(Float(z) - side * 0.5f);
+		}
+	}
+	for (int z = 0; z < side; z++) {
+		for (int x = 0; x < side; x++) {
+			int i = z * (side + 1) + x;
+			indices.push_back(i);
+			indices.push_back(i + side + 1);
+			indices.push_back(i + 1);
+			indices.push_back(i + 1);
+			indices.push_back(i + side + 1);
+			indices.push_back(i + side + 2);
+		}
+	}
+}
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(1);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, 1, 1, 1, 1);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, 1, 1, 1, 1);
+	return pb;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Mesh and transform conversion benchmark\n");
+		printf("usage: ./test_meshconv engine [meshes] [mesh side] [bodies] [passes]\n");
+		printf("example: ./test_meshconv ODE 200 32 10000 200\n");
+		return 0;
+	}
+	int meshes = 200;
+	int side = 32;
+	int count = 10000;
+	int passes = 200;
+	if (argc > 2) meshes = atoi(argv[2]);
+	if (argc > 3) side = atoi(argv[3]);
+	if (argc > 4) count = atoi(argv[4]);
+	if (argc > 5) passes = atoi(argv[5]);
+	if (meshes < 1 || side < 1 || count < 1 || passes < 1) {
+		printf("usage: ./test_meshconv engine [meshes] [mesh side] [bodies] [passes]\n");
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return 1;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	std::vector<Float> vertices;
+	std::vector<int> indices;
+	BuildGrid(side, vertices, indices);
+	int nVertices = (int)vertices.size() / 3;
+	int nIndices = (int)indices.size();
+	printf("%s: %d meshes of %d vertices and %d triangles, %d bodies, %d passes\n",
+		argv[1], meshes, nVertices, nIndices / 3, count, passes);
+
+	//the meshes are spread out below the boxes, on static bodies
+	BenchTimer t;
+	double concaveMs = 0, convexMs = 0, terrainMs = 0;
+	int concave = 0, convex = 0, terrain = 0;
+	for (int i = 0; i < meshes; i++) {
+		palMatrix4x4 m;
+		mat_identity(&m);
+		mat_translate(&m, (i % 16) * (side + 2.0f), -10.0f - (i / 16) * 2.0f, 0);
+
+		palGenericBody *pgb = PF->CreateGenericBody();
+		if (pgb != NULL) {
+			pgb->Init(m);
+			pgb->SetDynamicsType(PALBODY_STATIC);
+			t.Start();
+			palConcaveGeometry *pcg = PF->CreateConcaveGeometry();
+			if (pcg != NULL) {
+				pcg->Init(m, &vertices[0], nVertices, &indices[0], nIndices, 1);
+				pgb->ConnectGeometry(pcg);
+				concaveMs += t.ElapsedMs();
+				concave++;
+			}
+		}
+
+		pgb = PF->CreateGenericBody();
+		if (pgb != NULL) {
+			pgb->Init(m);
+			pgb->SetDynamicsType(PALBODY_STATIC);
+			t.Start();
+			palConvexGeometry *pxg = PF->CreateConvexGeometry();
+			if (pxg != NULL) {
+				pxg->Init(m, &vertices[0], nVertices, &indices[0], nIndices, 1);
+				pgb->ConnectGeometry(pxg);
+				convexMs += t.ElapsedMs();
+				convex++;
+			}
+		}
+
+		t.Start();
+		palTerrainMesh *ptm = PF->CreateTerrainMesh();
+		if (ptm != NULL) {
+			ptm->Init(m._41, m._42 - 50.0f, m._43, &vertices[0], nVertices, &indices[0], nIndices);
+			terrainMs += t.ElapsedMs();
+			terrain++;
+		}
+	}
+	if (concave > 0)
+		printf("concave geometry: %.3f us/mesh\n", concaveMs * 1000 / concave);
+	if (convex > 0)
+		printf("convex geometry:  %.3f us/mesh\n", convexMs * 1000 / convex);
+	if (terrain > 0)
+		printf("terrain mesh:     %.3f us/mesh\n", terrainMs * 1000 / terrain);
+
+	int boxSide = (int)ceil(sqrt((double)count));
+	palTerrainPlane *ground = PF->CreateTerrainPlane();
+	if (ground != NULL)
+		ground->Init(0, 0, 0, boxSide * 2.0f * 2 + 20);
+	std::vector<palBody *> bodies;
+	for (int i = 0; i < count; i++) {
+		palBody *pb = CreateBox((i % boxSide) * 2.0f - boxSide, 0.5f + (i % 5) * 0.01f, (i / boxSide) * 2.0f - boxSide);
+		if (pb == NULL) {
+			printf("Could not create a box\n");
+			return 1;
+		}
+		bodies.push_back(pb);
+	}
+	for (int i = 0; i < 10; i++)
+		pp->Update(DT);
+
+	//the loop a renderer or a sync runs every frame
+	double ms = 0;
+	double sum = 0;
+	for (int p = 0; p < passes; p++) {
+		t.Start();
+		for (size_t i = 0; i < bodies.size(); i++) {
+			const palMatrix4x4& m = bodies[i]->GetLocationMatrix();
+			sum += m._11 + m._22 + m._33 + m._41 + m._42 + m._43 + m._44;
+		}
+		ms += t.ElapsedMs();
+		if (p % 20 == 19)
+			pp->Update(DT);
+	}
+	printf("GetLocationMatrix: %.2f ns/body\n", ms * 1e6 / ((double)passes * count));
+
+	//a body at rest on the plane has an orthonormal rotation and _44 of 1
+	unsigned bad = 0;
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const palMatrix4x4& m = bodies[i]->GetLocationMatrix();
+		Float det = m._11 * (m._22 * m._33 - m._23 * m._32) - m._12 * (m._21 * m._33 - m._23 * m._31)
+			+ m._13 * (m._21 * m._32 - m._22 * m._31);
+		if (fabs(det - 1) > 1e-3 || m._14 != 0 || m._24 != 0 || m._34 != 0 || m._44 != 1)
+			bad++;
+	}
+	printf("%u bodies with a malformed location matrix (checksum %g)\n", bad, sum);
+
+	PF->Cleanup();
+	return bad == 0 ? 0 : 2;
+}
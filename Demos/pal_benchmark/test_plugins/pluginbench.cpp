@@ -0,0 +1,86 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+	PAL plugin startup benchmark.
+	Reports the time and resident memory taken to find the engine plugins, select one engine and
+	create its physics, and the memory left after unloading the other engines.
+	With a plugin manifest (pal_plugins.txt, written by cmake next to the libraries) only the
+	selected engine is loaded; remove the manifest to measure loading every library.
+
+	usage: ./test_plugins engine [plugin directory] [unload]
+*/
+
+// resident set size in kB, -1 if not known on this platform
+static long ResidentKB() {
+	long kb = -1;
+	FILE *f = fopen("/proc/self/status", "r");
+	if (f == NULL)
+		return kb;
+	char line[256];
+	while (fgets(line, sizeof(line), f)) {
+		if (strncmp(line, "VmRSS:", 6) == 0) {
+			kb = atol(line + 6);
+			break;
+		}
+	}
+	fclose(f);
+	return kb;
+}
+
+static void Report(const char *stage, double ms, long kb) {
+	if (kb >= 0)
+		printf("%-18s %9.3f ms   RSS %8ld kB\n", stage, ms, kb);
+	else
+		printf("%-18s %9.3f ms   RSS n/a\n", stage, ms);
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Plugin startup benchmark\n");
+		printf("usage: ./test_plugins engine [plugin directory] [unload]\n");
+		printf("example: ./test_plugins ODE ../lib unload\n");
+		return 0;
+	}
+	const char *dir = NULL;
+	if (argc > 2 && strcmp(argv[2], "-") != 0)
+		dir = argv[2];
+	bool unload = (argc > 3) && (strcmp(argv[3], "unload") == 0);
+
+	Report("start", 0, ResidentKB());
+
+	BenchTimer total;
+	BenchTimer t;
+	PF->LoadPhysicsEngines(dir);
+	Report("LoadPhysicsEngines", t.ElapsedMs(), ResidentKB());
+
+	t.Start();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	Report("SelectEngine", t.ElapsedMs(), ResidentKB());
+
+	t.Start();
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL) {
+		printf("Could not create physics\n");
+		return 1;
+	}
+	palPhysicsDesc desc;
+	pp->Init(desc);
+	Report("CreatePhysics", t.ElapsedMs(), ResidentKB());
+	Report("total", total.ElapsedMs(), ResidentKB());
+
+	if (unload) {
+		t.Start();
+		PF->UnloadUnusedEngines();
+		Report("UnloadUnused", t.ElapsedMs(), ResidentKB());
+	}
+
+	PF->Cleanup();
+	return 0;
+}
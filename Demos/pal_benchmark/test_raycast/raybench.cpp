@@ -0,0 +1,123 @@
+#include "pal/palFactory.h"
+#include "pal/palCollision.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL raycast benchmark.
+	Scatters boxes, spheres and capsules over a terrain plane and reports the rays per second
+	for single raycasts and for batched raycasts (palCollisionDetection::RayCastBatch),
+	with rays from random points above the scene, aimed at random points on the ground.
+
+	usage: ./test_raycast engine [bodies] [rays]
+*/
+
+static Float frand() {
+	return rand() / (Float)RAND_MAX;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Raycast benchmark\n");
+		printf("usage: ./test_raycast engine [bodies] [rays]\n");
+		printf("example: ./test_raycast Tokamak 400 100000\n");
+		return 0;
+	}
+	int bodies = 400;
+	int rays = 100000;
+	if (argc > 2) bodies = atoi(argv[2]);
+	if (argc > 3) rays = atoi(argv[3]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL) {
+		printf("Could not create physics\n");
+		return 1;
+	}
+	palPhysicsDesc desc;
+	pp->Init(desc);
+	palCollisionDetection *pcd = pp->asCollisionDetection();
+	if (pcd == NULL) {
+		printf("%s does not support collision detection\n", argv[1]);
+		return 1;
+	}
+	const Float size = 100.0f;
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, size);
+
+	srand(1);
+	for (int i = 0; i < bodies; i++) {
+		Float x = (frand() - 0.5f) * size;
+		Float y = 0.5f + frand() * 4;
+		Float z = (frand() - 0.5f) * size;
+		palBodyBase *pb = NULL;
+		switch (i % 3) {
+		case 0: {
+				palBox *box = PF->CreateBox();
+				if (box) box->Init(x, y, z, 1, 1, 1, 1);
+				pb = box;
+			}
+			break;
+		case 1: {
+				palSphere *sphere = PF->CreateSphere();
+				if (sphere) sphere->Init(x, y, z, 0.5f, 1);
+				pb = sphere;
+			}
+			break;
+		default: {
+				palCapsule *capsule = PF->CreateCapsule();
+				if (capsule) capsule->Init(x, y, z, 0.3f, 1, 1);
+				pb = capsule;
+			}
+			break;
+		}
+		if (pb == NULL) {
+			printf("Could not create body\n");
+			return 1;
+		}
+	}
+	// settle the bodies, so the scene has been stepped before it is queried
+	for (int i = 0; i < 10; i++)
+		pp->Update(0.01f);
+
+	std::vector<palRay> batch(rays);
+	for (int i = 0; i < rays; i++) {
+		palRay &r = batch[i];
+		vec_set(&r.m_vOrigin, (frand() - 0.5f) * size, 10, (frand() - 0.5f) * size);
+		palVector3 target;
+		vec_set(&target, (frand() - 0.5f) * size, 0, (frand() - 0.5f) * size);
+		vec_sub(&r.m_vDirection, &target, &r.m_vOrigin);
+		r.m_fRange = vec_mag(&r.m_vDirection) * 1.5f;
+		vec_norm(&r.m_vDirection);
+	}
+	std::vector<palRayHit> hits(rays);
+
+	printf("%s: %d bodies, %d rays\n", argv[1], bodies, rays);
+	int hitCount = 0;
+	BenchTimer t;
+	for (int i = 0; i < rays; i++) {
+		const palRay &r = batch[i];
+		palRayHit hit;
+		pcd->RayCast(r.m_vOrigin.x, r.m_vOrigin.y, r.m_vOrigin.z,
+			r.m_vDirection.x, r.m_vDirection.y, r.m_vDirection.z, r.m_fRange, hit);
+		if (hit.m_bHit)
+			hitCount++;
+	}
+	double single = t.ElapsedMs();
+
+	t.Start();
+	pcd->RayCastBatch(&batch[0], &hits[0], rays);
+	double batched = t.ElapsedMs();
+
+	printf("single    %10.0f rays/s   %d hits\n", rays * 1000.0 / single, hitCount);
+	printf("batched   %10.0f rays/s\n", rays * 1000.0 / batched);
+	PF->Cleanup();
+	return 0;
+}
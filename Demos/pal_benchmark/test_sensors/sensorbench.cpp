@@ -0,0 +1,135 @@
+#include "pal/palFactory.h"
+#include "pal/palSensors.h"
+#include "pal/palSensorManager.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL sensor benchmark.
+	Attaches PSD, inclinometer and gyroscope sensors to a grid of boxes resting on a plane and
+	compares reading every sensor on demand each step against one palSensorManager::Update per step.
+
+	usage: ./test_sensors engine [boxes] [sensors per box] [steps] [threads]
+*/
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Sensor benchmark\n");
+		printf("usage: ./test_sensors engine [boxes] [sensors per box] [steps] [threads]\n");
+		printf("example: ./test_sensors Bullet 1000 16 100 4\n");
+		return 0;
+	}
+	int boxes = 1000;
+	int perBox = 16;
+	int steps = 100;
+	unsigned threads = 1;
+	if (argc > 2) boxes = atoi(argv[2]);
+	if (argc > 3) perBox = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+	if (argc > 5) threads = atoi(argv[5]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL) {
+		printf("Could not create physics\n");
+		return 1;
+	}
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 500.0f);
+
+	std::vector<palPSDSensor *> psds;
+	std::vector<palInclinometerSensor *> inclinometers;
+	std::vector<palGyroscopeSensor *> gyroscopes;
+	int side = (int)ceil(sqrt((double)boxes));
+	for (int i = 0; i < boxes; i++) {
+		palBox *pb = PF->CreateBox();
+		Float x = Float(i % side) * 3 - side;
+		Float z = Float(i / side) * 3 - side;
+		pb->Init(x, 0.5f, z, 1, 1, 1, 1);
+		for (int s = 0; s < perBox; s++) {
+			// mostly rangefinders, as on a robot, plus a couple of attitude sensors
+			if (s % 4 != 3) {
+				Float a = Float(s) / perBox * Float(2 * M_PI);
+				palPSDSensor *psd = PF->CreatePSDSensor();
+				if (psd == NULL)
+					continue;
+				psd->Init(pb, x, 0.5f, z, cos(a), 0, sin(a), 10);
+				psds.push_back(psd);
+			} else if (s % 8 == 3) {
+				palInclinometerSensor *inc = PF->CreateInclinometerSensor();
+				inc->Init(pb, 1, 0, 0, 0, 1, 0, 0, -1, 0);
+				inclinometers.push_back(inc);
+			} else {
+				palGyroscopeSensor *gyro = PF->CreateGyroscopeSensor();
+				gyro->Init(pb, 0, 1, 0);
+				gyroscopes.push_back(gyro);
+			}
+		}
+	}
+	size_t total = psds.size() + inclinometers.size() + gyroscopes.size();
+	printf("%s: %d boxes, %u sensors (%u PSD), %d steps, %u threads\n", argv[1], boxes,
+		(unsigned)total, (unsigned)psds.size(), steps, threads);
+
+	const Float dt = 0.01f;
+	for (int i = 0; i < 10; i++)
+		pp->Update(dt);
+
+	BenchTimer t;
+	double sum = 0;
+	double ondemandMs = 0;
+	for (int i = 0; i < steps; i++) {
+		pp->Update(dt);
+		t.Start();
+		for (size_t s = 0; s < psds.size(); s++)
+			sum += psds[s]->GetDistance();
+		for (size_t s = 0; s < inclinometers.size(); s++)
+			sum += inclinometers[s]->GetAngle();
+		for (size_t s = 0; s < gyroscopes.size(); s++)
+			sum += gyroscopes[s]->GetAngle();
+		ondemandMs += t.ElapsedMs();
+	}
+	double ondemandSum = sum;
+
+	palSensorManager manager;
+	manager.SetNumThreads(threads);
+	for (size_t s = 0; s < psds.size(); s++)
+		manager.Add(psds[s]);
+	for (size_t s = 0; s < inclinometers.size(); s++)
+		manager.Add(inclinometers[s]);
+	for (size_t s = 0; s < gyroscopes.size(); s++)
+		manager.Add(gyroscopes[s]);
+
+	sum = 0;
+	double managedMs = 0;
+	for (int i = 0; i < steps; i++) {
+		pp->Update(dt);
+		t.Start();
+		manager.Update();
+		for (size_t s = 0; s < psds.size(); s++)
+			sum += psds[s]->GetDistance();
+		for (size_t s = 0; s < inclinometers.size(); s++)
+			sum += inclinometers[s]->GetAngle();
+		for (size_t s = 0; s < gyroscopes.size(); s++)
+			sum += gyroscopes[s]->GetAngle();
+		managedMs += t.ElapsedMs();
+	}
+
+	printf("on demand %10.3f ms/step\n", ondemandMs / steps);
+	printf("managed   %10.3f ms/step   speedup %5.2fx\n", managedMs / steps, ondemandMs / managedMs);
+	// the boxes are at rest, so both passes should read (almost) the same values
+	printf("checksum  on demand %g, managed %g\n", ondemandSum, sum);
+
+	manager.Clear();
+	PF->Cleanup();
+	return 0;
+}
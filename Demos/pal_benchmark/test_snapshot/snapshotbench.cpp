@@ -0,0 +1,212 @@
+#include "pal/palFactory.h"
+#include "pal/palTransformSnapshots.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/*
+	PAL transform snapshot stress test.
+	Drops a grid of boxes onto a plane, with every box added to a palTransformSnapshots published by each step.
+	Steps a number of frames with no readers, then the same number again while reader threads acquire
+	the latest snapshot as fast as they can. Each reader checks:
+	- the snapshots it gets never go back in time
+	- a snapshot does not change while it is held
+	- a snapshot matches the bodies as the physics thread saw them at the end of that step
+	Reports the step time with and without readers, the reads per second, and the steps that were not published.
+
+	usage: ./test_snapshot engine [bodies] [frames] [readers]
+*/
+
+static const Float DT = 1.0f / 60.0f;
+static const int HISTORY = 64;
+
+// what the physics thread saw at the end of recent steps, written like a seqlock
+struct Expected {
+	std::atomic<unsigned> frame;
+	std::atomic<double> sum;
+};
+static Expected history[HISTORY];
+
+struct ReaderStats {
+	unsigned long reads, verified, errors;
+};
+
+static double Sum(const palBodySnapshot *bodies, unsigned count) {
+	double sum = 0;
+	for (unsigned i = 0; i < count; i++) {
+		const palBodySnapshot& b = bodies[i];
+		sum += b.m_mLocation._mat[12] + b.m_mLocation._mat[13] + b.m_mLocation._mat[14];
+		sum += b.m_vLinearVelocity.x + b.m_vLinearVelocity.y + b.m_vLinearVelocity.z;
+		sum += b.m_vAngularVelocity.x + b.m_vAngularVelocity.y + b.m_vAngularVelocity.z;
+	}
+	return sum;
+}
+
+static double Sum(const std::vector<palBody *>& bodies) {
+	double sum = 0;
+	for (size_t i = 0; i < bodies.size(); i++) {
+		const palMatrix4x4& m = bodies[i]->GetLocationMatrix();
+		palVector3 v, w;
+		bodies[i]->GetLinearVelocity(v);
+		bodies[i]->GetAngularVelocity(w);
+		sum += m._mat[12] + m._mat[13] + m._mat[14];
+		sum += v.x + v.y + v.z;
+		sum += w.x + w.y + w.z;
+	}
+	return sum;
+}
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(1);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, 1, 1, 1, 1);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, 1, 1, 1, 1);
+	return pb;
+}
+
+static void Reader(const palTransformSnapshots *snapshots, const std::atomic<bool> *stop, ReaderStats *stats) {
+	unsigned lastFrame = 0;
+	while (!*stop) {
+		const palTransformSnapshot *s = snapshots->Acquire();
+		if (s == NULL)
+			continue;
+		stats->reads++;
+		if (s->GetFrame() < lastFrame)
+			stats->errors++;
+		lastFrame = s->GetFrame();
+		double sum = Sum(s->GetBodies(), s->GetNumSlots());
+		Expected& e = history[s->GetFrame() % HISTORY];
+		unsigned before = e.frame;
+		double expected = e.sum;
+		if (before == s->GetFrame() && e.frame == before) {
+			stats->verified++;
+			if (sum != expected)
+				stats->errors++;
+		}
+		if (Sum(s->GetBodies(), s->GetNumSlots()) != sum)
+			stats->errors++;
+		snapshots->Release(s);
+	}
+}
+
+static double Step(palPhysics *pp, palTransformSnapshots& snapshots, const std::vector<palBody *>& bodies, int frames) {
+	BenchTimer t;
+	double ms = 0;
+	for (int f = 0; f < frames; f++) {
+		unsigned skipped = snapshots.GetNumSkipped();
+		t.Start();
+		pp->Update(DT);
+		ms += t.ElapsedMs();
+		if (snapshots.GetNumSkipped() != skipped)
+			continue;
+		//the latest snapshot is this step's
+		const palTransformSnapshot *s = snapshots.Acquire();
+		unsigned frame = s->GetFrame();
+		snapshots.Release(s);
+		Expected& e = history[frame % HISTORY];
+		e.frame = 0;
+		e.sum = Sum(bodies);
+		e.frame = frame;
+	}
+	return ms / frames;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Transform snapshot stress test\n");
+		printf("usage: ./test_snapshot engine [bodies] [frames] [readers]\n");
+		printf("example: ./test_snapshot Bullet 10000 300 4\n");
+		return 0;
+	}
+	int count = 10000;
+	int frames = 300;
+	int readers = 4;
+	if (argc > 2) count = atoi(argv[2]);
+	if (argc > 3) frames = atoi(argv[3]);
+	if (argc > 4) readers = atoi(argv[4]);
+	if (count < 1 || frames < 1 || readers < 1) {
+		printf("usage: ./test_snapshot engine [bodies] [frames] [readers]\n");
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return 1;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	int side = (int)ceil(sqrt((double)count));
+	palTerrainPlane *ground = PF->CreateTerrainPlane();
+	if (ground != NULL)
+		ground->Init(0, 0, 0, side * 2.0f * 2 + 20);
+
+	palTransformSnapshots snapshots;
+	std::vector<palBody *> bodies;
+	for (int i = 0; i < count; i++) {
+		palBody *pb = CreateBox((i % side) * 2.0f, 1.0f + (i % 7) * 0.3f, (i / side) * 2.0f);
+		if (pb == NULL) {
+			printf("Could not create a box\n");
+			return 1;
+		}
+		bodies.push_back(pb);
+		snapshots.Add(pb);
+	}
+	pp->SetTransformSnapshots(&snapshots);
+
+	printf("%s: %d bodies, %d frames, %d readers\n", argv[1], count, frames, readers);
+	double alone = Step(pp, snapshots, bodies, frames);
+	printf("step %.3f ms with no readers\n", alone);
+
+	std::atomic<bool> stop(false);
+	std::vector<ReaderStats> stats(readers);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < readers; i++) {
+		ReaderStats zero = {0, 0, 0};
+		stats[i] = zero;
+		threads.push_back(std::thread(Reader, &snapshots, &stop, &stats[i]));
+	}
+	BenchTimer t;
+	double shared = Step(pp, snapshots, bodies, frames);
+	double seconds = t.Elapsed();
+	stop = true;
+	for (int i = 0; i < readers; i++)
+		threads[i].join();
+
+	unsigned long reads = 0, verified = 0, errors = 0;
+	for (int i = 0; i < readers; i++) {
+		reads += stats[i].reads;
+		verified += stats[i].verified;
+		errors += stats[i].errors;
+	}
+	printf("step %.3f ms with %d readers\n", shared, readers);
+	printf("%.0f reads/s per reader, %lu checked against the step, %u steps not published\n",
+		reads / seconds / readers, verified, snapshots.GetNumSkipped());
+	printf("%lu errors\n", errors);
+
+	pp->SetTransformSnapshots(NULL);
+	snapshots.Clear();
+	PF->Cleanup();
+	return errors == 0 ? 0 : 2;
+}
@@ -0,0 +1,142 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+
+/*
+	PAL solver threading benchmark.
+	Packs boxes into a block of columns touching each other, so the whole block is one island,
+	and reports for each thread count (ODE_Threads):
+	- ms/iteration: the step time it takes for each extra QuickStep iteration, from the step times
+	  with a low and a high ODE_QuickStepIterations, so the time spent outside the solver drops out
+	- same: whether the boxes end where they did with one thread, with ODE_Deterministic set
+
+	usage: ./test_solver engine [columns] [column height] [steps] [threads ...]
+*/
+
+static const int LOW_ITERATIONS = 10;
+static const int HIGH_ITERATIONS = 40;
+
+static std::string ToString(int value) {
+	char buf[16];
+	sprintf(buf, "%d", value);
+	return buf;
+}
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(1);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, 1, 1, 1, 1);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, 1, 1, 1, 1);
+	return pb;
+}
+
+/// @return the ms per step, or a negative value if the scene could not be made
+static double Run(int threads, int iterations, bool deterministic, int columns, int height, int steps, std::vector<palVector3>& ends) {
+	palPhysicsDesc desc;
+	desc.m_Properties["ODE_Threads"] = ToString(threads);
+	desc.m_Properties["ODE_QuickStepIterations"] = ToString(iterations);
+	desc.m_Properties["ODE_Deterministic"] = deterministic ? "true" : "false";
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return -1;
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 200.0f);
+
+	int side = (int)ceil(sqrt((double)columns));
+	std::vector<palBody *> boxes;
+	for (int c = 0; c < columns; c++) {
+		// 0.99 apart, so neighbouring columns are in contact
+		Float x = Float(c % side) * 0.99f;
+		Float z = Float(c / side) * 0.99f;
+		for (int i = 0; i < height; i++) {
+			palBody *pb = CreateBox(x, 0.5f + i, z);
+			if (pb == NULL) {
+				PF->Cleanup();
+				return -1;
+			}
+			boxes.push_back(pb);
+		}
+	}
+	// let the block settle, so every step has the same contacts to solve
+	for (int i = 0; i < 20; i++)
+		pp->Update(0.01f);
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	double ms = t.ElapsedMs() / steps;
+	ends.resize(boxes.size());
+	for (unsigned i = 0; i < boxes.size(); i++)
+		boxes[i]->GetPosition(ends[i]);
+	PF->Cleanup();
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Solver threading benchmark\n");
+		printf("usage: ./test_solver engine [columns] [column height] [steps] [threads ...]\n");
+		printf("example: ./test_solver ODE 100 8 100 1 2 4 8\n");
+		return 0;
+	}
+	int columns = 100;
+	int height = 8;
+	int steps = 100;
+	if (argc > 2) columns = atoi(argv[2]);
+	if (argc > 3) height = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+	std::vector<int> threads;
+	for (int i = 5; i < argc; i++)
+		threads.push_back(atoi(argv[i]));
+	if (threads.empty()) {
+		threads.push_back(1);
+		threads.push_back(2);
+		threads.push_back(4);
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d columns of %d boxes, %d steps, %d and %d iterations\n", argv[1], columns, height, steps, LOW_ITERATIONS, HIGH_ITERATIONS);
+	printf(" threads   ms/iteration   det ms/iteration   same\n");
+	// the positions the deterministic run with one thread ends with
+	std::vector<palVector3> reference;
+	Run(1, HIGH_ITERATIONS, true, columns, height, steps, reference);
+	for (unsigned i = 0; i < threads.size(); i++) {
+		std::vector<palVector3> ends;
+		double low = Run(threads[i], LOW_ITERATIONS, false, columns, height, steps, ends);
+		double high = Run(threads[i], HIGH_ITERATIONS, false, columns, height, steps, ends);
+		double detLow = Run(threads[i], LOW_ITERATIONS, true, columns, height, steps, ends);
+		double detHigh = Run(threads[i], HIGH_ITERATIONS, true, columns, height, steps, ends);
+		// ends now holds where the boxes of the deterministic run with HIGH_ITERATIONS ended
+		if (low < 0 || high < 0 || detLow < 0 || detHigh < 0) {
+			printf("Could not create the scene\n");
+			return 1;
+		}
+		bool same = ends.size() == reference.size();
+		for (unsigned j = 0; same && j < ends.size(); j++)
+			same = ends[j].x == reference[j].x && ends[j].y == reference[j].y && ends[j].z == reference[j].z;
+		const double extra = HIGH_ITERATIONS - LOW_ITERATIONS;
+		printf("%8d   %12.4f   %16.4f   %4s\n", threads[i], (high - low) / extra, (detHigh - detLow) / extra, same ? "yes" : "no");
+	}
+	return 0;
+}
@@ -0,0 +1,204 @@
+#include "pal/palFactory.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <math.h>
+#include <string>
+#include <vector>
+
+/*
+	PAL stacking benchmark.
+	Runs two scenes with each configuration of init properties given on the command line, and with none:
+	- stack: a grid of box towers, slightly offset, which should stay standing
+	- pile:  boxes dropped at random into a heap, which should come to rest
+	and reports the step time with the stability of each scene:
+	- drift:    the furthest any tower box moved sideways from where it started
+	- toppled:  the number of tower boxes more than half a box below where they started
+	- residual: the fastest box speed at the end, large values are jitter
+
+	A configuration is one or more name=value pairs separated by commas, eg:
+	./test_stacking ODE 16 10 500 ODE_MaxContactsPerPair=8 ODE_MaxContactsPerPair=2
+
+	or, to compare the QuickStep iteration count against stability with and without warm starting:
+	./test_stacking ODE 16 10 500 ODE_QuickStepIterations=5 ODE_QuickStepIterations=5,ODE_WarmStart=true
+		ODE_QuickStepIterations=10 ODE_QuickStepIterations=10,ODE_WarmStart=true
+		ODE_QuickStepIterations=20 ODE_QuickStepIterations=20,ODE_WarmStart=true
+
+	usage: ./test_stacking engine [towers] [tower height] [steps] [configuration ...]
+*/
+
+struct Result {
+	double ms;
+	Float drift;
+	int toppled;
+	Float residual;
+};
+
+static Float frand() {
+	return rand() / (Float)RAND_MAX;
+}
+
+static void ParseConfiguration(const char *config, palPhysicsDesc& desc) {
+	std::string s(config);
+	size_t start = 0;
+	while (start < s.size()) {
+		size_t end = s.find(',', start);
+		if (end == std::string::npos)
+			end = s.size();
+		std::string pair = s.substr(start, end - start);
+		size_t eq = pair.find('=');
+		if (eq != std::string::npos)
+			desc.m_Properties[pair.substr(0, eq)] = pair.substr(eq + 1);
+		start = end + 1;
+	}
+}
+
+static palPhysics *CreateWorld(const palPhysicsDesc& desc) {
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return NULL;
+	pp->Init(desc);
+	palTerrainPlane *pt = PF->CreateTerrainPlane();
+	pt->Init(0, 0, 0, 200.0f);
+	return pp;
+}
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z, Float width, Float height, Float depth, Float mass) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(mass);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, width, height, depth, mass);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, width, height, depth, mass);
+	return pb;
+}
+
+static Float MaxSpeed(const std::vector<palBody *>& boxes) {
+	Float fastest = 0;
+	for (unsigned i = 0; i < boxes.size(); i++) {
+		palVector3 v;
+		boxes[i]->GetLinearVelocity(v);
+		fastest = std::max(fastest, vec_mag(&v));
+	}
+	return fastest;
+}
+
+static bool RunStacks(const palPhysicsDesc& desc, int towers, int height, int steps, Result& r) {
+	palPhysics *pp = CreateWorld(desc);
+	if (pp == NULL)
+		return false;
+	srand(1);
+	int side = (int)ceil(sqrt((double)towers));
+	std::vector<palBody *> boxes;
+	std::vector<palVector3> start;
+	for (int t = 0; t < towers; t++) {
+		Float x = Float(t % side) * 3;
+		Float z = Float(t / side) * 3;
+		for (int i = 0; i < height; i++) {
+			palBody *pb = CreateBox(x + (frand() - 0.5f) * 0.1f, 0.5f + i * 1.01f, z + (frand() - 0.5f) * 0.1f, 1, 1, 1, 1);
+			if (pb == NULL) {
+				PF->Cleanup();
+				return false;
+			}
+			boxes.push_back(pb);
+			palVector3 p;
+			pb->GetPosition(p);
+			start.push_back(p);
+		}
+	}
+	BenchTimer timer;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	r.ms = timer.ElapsedMs() / steps;
+	r.drift = 0;
+	r.toppled = 0;
+	for (unsigned i = 0; i < boxes.size(); i++) {
+		palVector3 p;
+		boxes[i]->GetPosition(p);
+		Float dx = p.x - start[i].x, dz = p.z - start[i].z;
+		r.drift = std::max(r.drift, Float(sqrt(dx * dx + dz * dz)));
+		if (p.y < start[i].y - 0.5f)
+			r.toppled++;
+	}
+	r.residual = MaxSpeed(boxes);
+	PF->Cleanup();
+	return true;
+}
+
+static bool RunPile(const palPhysicsDesc& desc, int count, int steps, Result& r) {
+	palPhysics *pp = CreateWorld(desc);
+	if (pp == NULL)
+		return false;
+	srand(2);
+	std::vector<palBody *> boxes;
+	for (int i = 0; i < count; i++) {
+		palBody *pb = CreateBox((frand() - 0.5f) * 6, 1 + i * 0.3f, (frand() - 0.5f) * 6, 0.5f + frand(), 0.5f + frand(), 0.5f + frand(), 1);
+		if (pb == NULL) {
+			PF->Cleanup();
+			return false;
+		}
+		boxes.push_back(pb);
+	}
+	BenchTimer timer;
+	for (int i = 0; i < steps; i++)
+		pp->Update(0.01f);
+	r.ms = timer.ElapsedMs() / steps;
+	r.drift = 0;
+	r.toppled = 0;
+	r.residual = MaxSpeed(boxes);
+	PF->Cleanup();
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Stacking benchmark\n");
+		printf("usage: ./test_stacking engine [towers] [tower height] [steps] [configuration ...]\n");
+		printf("example: ./test_stacking ODE 16 10 500 ODE_MaxContactsPerPair=8\n");
+		return 0;
+	}
+	int towers = 16;
+	int height = 10;
+	int steps = 500;
+	if (argc > 2) towers = atoi(argv[2]);
+	if (argc > 3) height = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	printf("%s: %d towers of %d boxes, a pile of %d boxes, %d steps\n", argv[1], towers, height, towers * height, steps);
+	printf("%-40s %-6s %9s %8s %8s %9s\n", "configuration", "scene", "ms/step", "drift", "toppled", "residual");
+	// the first run has no properties set, the others one configuration each
+	for (int c = 4; c < argc || c == 4; c++) {
+		palPhysicsDesc desc;
+		const char *name = "default";
+		if (c > 4) {
+			name = argv[c];
+			ParseConfiguration(argv[c], desc);
+		}
+		Result stack, pile;
+		if (!RunStacks(desc, towers, height, steps, stack) || !RunPile(desc, towers * height, steps, pile)) {
+			printf("Could not create the scene\n");
+			return 1;
+		}
+		printf("%-40s %-6s %9.3f %8.3f %8d %9.3f\n", name, "stack", stack.ms, stack.drift, stack.toppled, stack.residual);
+		printf("%-40s %-6s %9.3f %8s %8s %9.3f\n", name, "pile", pile.ms, "-", "-", pile.residual);
+	}
+	return 0;
+}
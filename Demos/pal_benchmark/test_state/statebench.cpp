@@ -0,0 +1,176 @@
+#include "pal/palFactory.h"
+#include "pal/palStateBuffer.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <vector>
+
+/*
+	PAL state save and restore benchmark.
+	Drops piles of boxes, and a chain of boxes held together by spherical links, onto a plane and lets them settle.
+	Then saves the state of the world a number of times and reports how long a save takes and its size.
+	Then checks the state reproduces the simulation: the world is stepped a number of frames from the saved state,
+	recording the position of every body, restored, and stepped again, twice. Reports the time a restore takes,
+	and whether the resimulated trajectories are identical, or their largest deviation.
+
+	usage: ./test_state engine [bodies] [frames] [saves]
+*/
+
+static const int CHAIN = 8;
+static const Float DT = 1.0f / 60.0f;
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z, Float size, Float mass) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(mass);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, size, size, size, mass);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, size, size, size, mass);
+	return pb;
+}
+
+static Float Jitter(unsigned int& seed) {
+	seed = seed * 1664525u + 1013904223u;
+	return Float((seed >> 8) % 1000) / 1000.0f - 0.5f;
+}
+
+static void Simulate(palPhysics *pp, const std::vector<palBody *>& bodies, int frames, std::vector<Float>& trajectory) {
+	trajectory.resize(bodies.size() * frames * 3);
+	Float *p = trajectory.empty() ? NULL : &trajectory[0];
+	for (int f = 0; f < frames; f++) {
+		pp->Update(DT);
+		for (size_t i = 0; i < bodies.size(); i++) {
+			palVector3 pos;
+			bodies[i]->GetPosition(pos);
+			*p++ = pos.x;
+			*p++ = pos.y;
+			*p++ = pos.z;
+		}
+	}
+}
+
+static Float Deviation(const std::vector<Float>& a, const std::vector<Float>& b) {
+	Float d = 0;
+	for (size_t i = 0; i < a.size(); i++)
+		if (fabs(a[i] - b[i]) > d)
+			d = (Float)fabs(a[i] - b[i]);
+	return d;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("State save and restore benchmark\n");
+		printf("usage: ./test_state engine [bodies] [frames] [saves]\n");
+		printf("example: ./test_state Bullet 10000 60 100\n");
+		return 0;
+	}
+	int count = 10000;
+	int frames = 60;
+	int saves = 100;
+	if (argc > 2) count = atoi(argv[2]);
+	if (argc > 3) frames = atoi(argv[3]);
+	if (argc > 4) saves = atoi(argv[4]);
+	if (count < CHAIN || frames < 1 || saves < 1) {
+		printf("usage: ./test_state engine [bodies] [frames] [saves]\n");
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return 1;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	int piles = (count - CHAIN + 3) / 4;
+	int side = (int)ceil(sqrt((double)piles));
+	palTerrainPlane *ground = PF->CreateTerrainPlane();
+	if (ground != NULL)
+		ground->Init(0, 0, 0, side * 1.5f * 2 + 20);
+
+	std::vector<palBody *> bodies;
+	unsigned int seed = 1;
+	for (int i = 0; i < count - CHAIN; i++) {
+		int pile = i / 4;
+		Float x = (pile % side) * 1.5f + Jitter(seed) * 0.2f;
+		Float z = (pile / side) * 1.5f + Jitter(seed) * 0.2f;
+		palBody *pb = CreateBox(x, 0.5f + (i % 4) * 1.1f, z, 1, 1);
+		if (pb == NULL) {
+			printf("Could not create a box\n");
+			return 1;
+		}
+		bodies.push_back(pb);
+	}
+	for (int i = 0; i < CHAIN; i++) {
+		palBody *pb = CreateBox(-5 - i * 1.2f, 3, -5, 1, 1);
+		if (pb == NULL)
+			return 1;
+		if (i > 0) {
+			palSphericalLink *link = PF->CreateSphericalLink();
+			if (link != NULL)
+				link->Init(bodies.back(), pb, palVector3(-5 - i * 1.2f + 0.6f, 3, -5), palVector3(0, 0, 1));
+		}
+		bodies.push_back(pb);
+	}
+
+	std::vector<Float> first, again;
+	Simulate(pp, bodies, 30, first);
+
+	palStateBuffer state;
+	BenchTimer t;
+	double saveMs = 0, maxSaveMs = 0;
+	for (int i = 0; i < saves; i++) {
+		t.Start();
+		bool saved = pp->SaveState(state);
+		double ms = t.ElapsedMs();
+		if (!saved) {
+			printf("%s cannot save its state\n", argv[1]);
+			PF->Cleanup();
+			return 1;
+		}
+		saveMs += ms;
+		if (ms > maxSaveMs)
+			maxSaveMs = ms;
+	}
+	printf("%s: %d bodies, state %u kB\n", argv[1], (int)bodies.size(), (unsigned int)(state.GetSize() / 1024));
+	printf("save %.3f ms (max %.3f)\n", saveMs / saves, maxSaveMs);
+
+	Float time = pp->GetTime();
+	Simulate(pp, bodies, frames, first);
+	bool identical = true;
+	for (int pass = 0; pass < 2; pass++) {
+		t.Start();
+		if (!pp->RestoreState(state)) {
+			printf("Could not restore the state\n");
+			PF->Cleanup();
+			return 1;
+		}
+		double restoreMs = t.ElapsedMs();
+		if (pp->GetTime() != time)
+			printf("time not restored\n");
+		Simulate(pp, bodies, frames, again);
+		Float d = Deviation(first, again);
+		if (d != 0)
+			identical = false;
+		printf("restore %.3f ms, %d frames resimulated, max deviation %g\n", restoreMs, frames, d);
+	}
+	printf("trajectories %s\n", identical ? "identical" : "differ");
+	PF->Cleanup();
+	return identical ? 0 : 2;
+}
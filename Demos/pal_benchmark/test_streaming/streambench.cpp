@@ -0,0 +1,132 @@
+#include "pal/palFactory.h"
+#include "pal/palTerrainStreamer.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+/*
+	PAL terrain streaming benchmark.
+	Streams a hilly heightmap terrain with a palTerrainStreamer around two focus points:
+	one flying over the terrain, and one fixed under a box resting on the ground.
+	Reports the time each step spends in the streamer on the physics thread against the background build
+	time of a tile, the latency from a tile being wanted to it being added, and whether the box is still resting.
+
+	usage: ./test_streaming engine [tile samples] [steps] [speed]
+	speed is in tiles per second, at 60 steps per second
+*/
+
+static const Float TILE_SIZE = 64.0f;
+
+static Float Height(Float x, Float z) {
+	return sinf(x * 0.05f) * cosf(z * 0.037f) * 4.0f + sinf(x * 0.011f + z * 0.013f) * 8.0f;
+}
+
+// a box body, generic where the engine has generic bodies
+static palBody *CreateBox(Float x, Float y, Float z, Float width, Float height, Float depth, Float mass) {
+	palMatrix4x4 m;
+	mat_identity(&m);
+	mat_translate(&m, x, y, z);
+	palGenericBody *pgb = PF->CreateGenericBody();
+	if (pgb != NULL) {
+		pgb->Init(m);
+		pgb->SetDynamicsType(PALBODY_DYNAMIC);
+		pgb->SetMass(mass);
+		palBoxGeometry *pbg = PF->CreateBoxGeometry();
+		pbg->Init(m, width, height, depth, mass);
+		pgb->ConnectGeometry(pbg);
+		return pgb;
+	}
+	palBox *pb = PF->CreateBox();
+	if (pb != NULL)
+		pb->Init(x, y, z, width, height, depth, mass);
+	return pb;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 2) {
+		printf("Terrain streaming benchmark\n");
+		printf("usage: ./test_streaming engine [tile samples] [steps] [speed]\n");
+		printf("example: ./test_streaming Bullet 129 2000 2\n");
+		return 0;
+	}
+	int samples = 129;
+	int steps = 2000;
+	Float speed = 2;
+	if (argc > 2) samples = atoi(argv[2]);
+	if (argc > 3) steps = atoi(argv[3]);
+	if (argc > 4) speed = (Float)atof(argv[4]);
+	if (samples < 2 || steps < 1) {
+		printf("usage: ./test_streaming engine [tile samples] [steps] [speed]\n");
+		return 1;
+	}
+
+	PF->LoadPhysicsEngines();
+	if (!PF->SelectEngine(argv[1])) {
+		printf("Could not select engine %s\n", argv[1]);
+		return 1;
+	}
+	palPhysics *pp = PF->CreatePhysics();
+	if (pp == NULL)
+		return 1;
+	palPhysicsDesc desc;
+	pp->Init(desc);
+
+	Float restY = 0;
+	{
+		palTerrainStreamer streamer;
+		streamer.Init(TILE_SIZE, samples, [](int tileX, int tileZ, int n, Float *heights) {
+			for (int j = 0; j < n; j++) {
+				for (int i = 0; i < n; i++) {
+					Float x = (tileX + i / (n - 1.0f)) * TILE_SIZE;
+					Float z = (tileZ + j / (n - 1.0f)) * TILE_SIZE;
+					heights[i + j * n] = Height(x, z);
+				}
+			}
+			return true;
+		});
+		streamer.AddFocus(0, 0);
+		int flyer = streamer.AddFocus(0, 0);
+		BenchTimer t;
+		streamer.Flush();
+		double flushMs = t.ElapsedMs();
+
+		palBody *pb = CreateBox(1, Height(1, 1) + 1.0f, 1, 1, 1, 1, 1);
+		if (pb == NULL) {
+			printf("Could not create a box\n");
+			return 1;
+		}
+
+		const Float dt = 1.0f / 60.0f;
+		double streamMs = 0, maxStreamMs = 0, stepMs = 0;
+		for (int i = 0; i < steps; i++) {
+			Float d = i * dt * speed * TILE_SIZE;
+			streamer.SetFocus(flyer, d, d * 0.5f);
+			t.Start();
+			streamer.Update();
+			double ms = t.ElapsedMs();
+			streamMs += ms;
+			if (ms > maxStreamMs)
+				maxStreamMs = ms;
+			t.Start();
+			pp->Update(dt);
+			stepMs += t.ElapsedMs();
+		}
+		palVector3 pos;
+		pb->GetPosition(pos);
+		restY = pos.y - Height(pos.x, pos.z);
+
+		palTerrainStreamer::Metrics m = streamer.GetMetrics();
+		printf("%s: tiles of %dx%d heights, %d steps at %.1f tiles/s\n", argv[1], samples, samples, steps, speed);
+		printf("first flush %.1f ms, %u tiles\n", flushMs, m.m_nLoaded);
+		printf("step %.3f ms, streamer update %.3f ms (max %.3f)\n", stepMs / steps, streamMs / steps, maxStreamMs);
+		printf("tile build %.2f ms (max %.2f) in the background, add %.3f ms (max %.3f)\n",
+			m.m_fMeanBuildMs, m.m_fMaxBuildMs, m.m_fMeanAddMs, m.m_fMaxAddMs);
+		printf("latency %.1f ms (max %.1f)\n", m.m_fMeanLatencyMs, m.m_fMaxLatencyMs);
+		printf("resident %u tiles, %u kB; loaded %u, unloaded %u, cancelled %u\n",
+			m.m_nResidentTiles, (unsigned int)(m.m_nResidentBytes / 1024), m.m_nLoaded, m.m_nUnloaded, m.m_nCancelled);
+	}
+	printf("box %s (%.2f over the ground)\n", (restY > 0) ? "resting" : "fell through", restY);
+	PF->Cleanup();
+	return 0;
+}
@@ -1,6 +1,10 @@
 
 #include "test_lib/test_lib.h"
 #include "framework/util.h"
+#include "../test_classes/bench_timer.h"
+#include <sstream>
+#include <thread>
+#include <vector>
 
 bool	g_quit = false;
 
@@ -97,7 +101,7 @@ void CreatePool(float height,float length_down,float length_up,float width_down,
 }
 
 palPhysics *pp = 0;
-int InitPhysics() {
+int InitPhysics(int threads = 1) {
 	pp = PF->CreatePhysics();
 	if (!pp) {
 #ifdef _WIN32
@@ -108,6 +112,11 @@ int InitPhysics() {
 	//initialize gravity
 	palPhysicsDesc desc;
 	desc.m_vGravity.y = -9.8;
+	if (threads != 1) {
+		std::ostringstream value;
+		value << threads;
+		desc.m_Properties["Bullet_Threads"] = value.str();
+	}
 	pp->Init(desc);
 		
 	CreatePool(5,5,10,5,10);		
@@ -189,6 +198,38 @@ int UpdatePhysics() {
 }
 
 
+// runs the test with 1, 2, 4... threads up to the number of cores (the Bullet_Threads property) and prints the times
+int ThreadScaling(const char *engine) {
+	int cores = std::thread::hardware_concurrency();
+	if (cores < 1)
+		cores = 1;
+	std::vector<int> counts;
+	for (int threads = 1; threads < cores; threads *= 2)
+		counts.push_back(threads);
+	counts.push_back(cores);
+
+	printf("%s stress test, %g s in steps of %g s\n", engine, g_max_time, step_size);
+	printf("threads    seconds    speedup\n");
+	double single = 0;
+	for (size_t i = 0; i < counts.size(); i++) {
+		if (InitPhysics(counts[i]) < 0)
+			return -1;
+		last_counter_y = -1;
+		BenchTimer t;
+		while (pp->GetTime() < g_max_time) {
+			UpdatePhysics();
+			pp->Update(step_size);
+			last_counter_y = counter_y;
+		}
+		double seconds = t.Elapsed();
+		if (i == 0)
+			single = seconds;
+		printf("%7d %10.3f %10.2f\n", counts[i], seconds, single / seconds);
+		PF->Cleanup();
+	}
+	return 0;
+}
+
 int main(int argc, char *argv[]) {
 	
 	if ( argc != 5 )
@@ -196,7 +237,7 @@ int main(int argc, char *argv[]) {
 		printf("Stress Test");
 		printf("\nYou did not supply 4 arguments. example: ./test_stress g Bullet 10 0.001\n");
 		printf("\toptions:\n");
-		printf("\t1st argument: 'g' = graphics ON. 'n' = graphics OFF.\n");
+		printf("\t1st argument: 'g' = graphics ON. 'n' = graphics OFF. 't' = thread scaling table, graphics OFF.\n");
 		printf("\t2nd argument: Name of physics engine to use: ie: Bullet, Newton, ODE, Tokamak, etc\n");
 		printf("\t3rd argument: Max Time\n");
 		printf("\t4th argument: Step Size\n");
@@ -219,6 +260,14 @@ int main(int argc, char *argv[]) {
 			printf("Graphics ON\n");
 			printf("No Results. Results only output to textfile in 'n' (no graphics) mode\n");
 		}
+		else if (argv[1][0]=='t'){
+			g_graphics=false;
+			printf("Graphics OFF\n");
+			PF->SelectEngine(argv[2]);
+			g_max_time=atof(argv[3]);
+			step_size = atof(argv[4]);
+			return ThreadScaling(argv[2]);
+		}
 		else if (argv[1][0]=='n'){
 			g_graphics=false;
 			printf("Graphics OFF\n");
@@ -0,0 +1,235 @@
+#include "tokamak.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	Tokamak math benchmark.
+	Times the vector, matrix and transform ops and the batch kernels, in whichever math
+	Tokamak was built with (build it and this with NE_USE_SSE2 defined for the SSE2 math),
+	then steps a scene of stacked boxes, spheres and cylinders as a regression check:
+	the checksum of where the bodies end should come out the same in both builds.
+
+	usage: ./test_tokamak_math [count] [repeats] [steps]
+*/
+
+static f32 Random() {
+	return (f32)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static neT3 RandomTransform() {
+	neT3 t;
+	neV3 r;
+	r.Set(Random() * 3.0f, Random() * 3.0f, Random() * 3.0f);
+	t.rot.RotateXYZ(r);
+	t.pos.Set(Random() * 10.0f, Random() * 10.0f, Random() * 10.0f);
+	return t;
+}
+
+static f32 Sum(const neV3 &v) {
+	return v.v[0] + v.v[1] + v.v[2];
+}
+
+static void Report(const char *name, double ms, int ops) {
+	printf("%-24s %10.3f ns/op\n", name, ms * 1.0e6 / ops);
+}
+
+/// @return the ms per step, the checksum and how many bodies are on the ground
+static double RunScene(int steps, double &checksum, int &onGround) {
+	const int side = 8, height = 6;
+	neSimulatorSizeInfo si;
+	si.rigidBodiesCount = side * side * height;
+	si.animatedBodiesCount = 1;
+	si.geometriesCount = side * side * height + 1;
+	si.overlappedPairsCount = si.rigidBodiesCount * 8;
+	neV3 gravity;
+	gravity.Set(0.0f, -9.8f, 0.0f);
+	neSimulator *sim = neSimulator::CreateSimulator(si, NULL, &gravity);
+
+	neAnimatedBody *ground = sim->CreateAnimatedBody();
+	ground->AddGeometry()->SetBoxSize(200.0f, 2.0f, 200.0f);
+	ground->UpdateBoundingInfo();
+	neV3 pos;
+	pos.Set(0.0f, -1.0f, 0.0f);
+	ground->SetPos(pos);
+
+	std::vector<neRigidBody *> bodies;
+	srand(1);
+	for (int i = 0; i < side * side; i++) {
+		for (int j = 0; j < height; j++) {
+			neRigidBody *rb = sim->CreateRigidBody();
+			neGeometry *geom = rb->AddGeometry();
+			switch ((i + j) % 3) {
+			case 0:
+				geom->SetBoxSize(1.0f, 1.0f, 1.0f);
+				rb->SetInertiaTensor(neBoxInertiaTensor(1.0f, 1.0f, 1.0f, 1.0f));
+				break;
+			case 1:
+				geom->SetSphereDiameter(1.0f);
+				rb->SetInertiaTensor(neSphereInertiaTensor(1.0f, 1.0f));
+				break;
+			default:
+				geom->SetCylinder(1.0f, 1.0f);
+				rb->SetInertiaTensor(neCylinderInertiaTensor(1.0f, 1.0f, 1.0f));
+				break;
+			}
+			rb->UpdateBoundingInfo();
+			rb->SetMass(1.0f);
+			// a little off centre, so the stacks topple
+			pos.Set((i % side) * 1.6f + (rand() % 100) * 0.002f, 0.5f + j * 1.05f, (i / side) * 1.6f);
+			rb->SetPos(pos);
+			bodies.push_back(rb);
+		}
+	}
+
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		sim->Advance(1.0f / 60.0f);
+	double ms = t.ElapsedMs() / steps;
+
+	checksum = 0;
+	onGround = 0;
+	for (unsigned i = 0; i < bodies.size(); i++) {
+		neV3 p = bodies[i]->GetPos();
+		checksum += p[0] + p[1] * 3.0f + p[2] * 7.0f;
+		if (p[1] < 0.6f)
+			onGround++;
+	}
+	neSimulator::DestroySimulator(sim);
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	int count = 1024;
+	int repeats = 2000;
+	int steps = 300;
+	if (argc > 1) count = atoi(argv[1]);
+	if (argc > 2) repeats = atoi(argv[2]);
+	if (argc > 3) steps = atoi(argv[3]);
+	if (count < 1 || repeats < 1 || steps < 1) {
+		printf("usage: ./test_tokamak_math [count] [repeats] [steps]\n");
+		return 1;
+	}
+#ifdef NE_USE_SSE2
+	printf("Tokamak math: SSE2, %d elements, %d repeats\n", count, repeats);
+#else
+	printf("Tokamak math: scalar, %d elements, %d repeats\n", count, repeats);
+#endif
+
+	// Tokamak's own allocator, which keeps neV3 aligned the way the SSE2 math wants it
+	neAllocatorDefault alloc;
+	neT3 *trans = (neT3 *)alloc.Alloc(sizeof(neT3) * count);
+	neT3 *transOut = (neT3 *)alloc.Alloc(sizeof(neT3) * count);
+	neV3 *points = (neV3 *)alloc.Alloc(sizeof(neV3) * count);
+	neV3 *pointsOut = (neV3 *)alloc.Alloc(sizeof(neV3) * count);
+	neV3 *minBound = (neV3 *)alloc.Alloc(sizeof(neV3) * count);
+	neV3 *maxBound = (neV3 *)alloc.Alloc(sizeof(neV3) * count);
+	srand(1);
+	for (int i = 0; i < count; i++) {
+		trans[i] = RandomTransform();
+		points[i].Set(Random(), Random(), Random());
+	}
+	neT3 t = RandomTransform();
+	const int ops = count * repeats;
+	// keeps the compiler from dropping the loops
+	f32 sink = 0;
+	BenchTimer timer;
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			pointsOut[i] = points[i] + points[(i + 1) % count] * 0.5f;
+		sink += Sum(pointsOut[r % count]);
+	}
+	Report("neV3 a + b * s", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			pointsOut[i] = points[i].Cross(points[(i + 1) % count]);
+		sink += Sum(pointsOut[r % count]);
+	}
+	Report("neV3 Cross", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			pointsOut[i] = trans[i].rot * points[i];
+		sink += Sum(pointsOut[r % count]);
+	}
+	Report("neM3 * neV3", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			transOut[i].rot = t.rot * trans[i].rot;
+		sink += Sum(transOut[r % count].rot.M[0]);
+	}
+	Report("neM3 * neM3", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			transOut[i] = t * trans[i];
+		sink += Sum(transOut[r % count].pos);
+	}
+	Report("neT3 * neT3", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		neT3MulBatch(transOut, t, trans, count);
+		sink += Sum(transOut[r % count].pos);
+	}
+	Report("neT3MulBatch", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++)
+			pointsOut[i] = t * points[i];
+		sink += Sum(pointsOut[r % count]);
+	}
+	Report("neT3 * neV3", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		neT3TransformBatch(pointsOut, t, points, count);
+		sink += Sum(pointsOut[r % count]);
+	}
+	Report("neT3TransformBatch", timer.ElapsedMs(), ops);
+
+	// the bounds the way UpdateAABB used to work them out, one axis at a time
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		for (int i = 0; i < count; i++) {
+			for (int j = 0; j < 3; j++) {
+				f32 a = neAbs(trans[i].rot[0][j]) + neAbs(trans[i].rot[1][j]) + neAbs(trans[i].rot[2][j]);
+				minBound[i][j] = trans[i].pos[j] - a;
+				maxBound[i][j] = trans[i].pos[j] + a;
+			}
+		}
+		sink += Sum(maxBound[r % count]);
+	}
+	Report("AABB per axis", timer.ElapsedMs(), ops);
+
+	timer.Start();
+	for (int r = 0; r < repeats; r++) {
+		neAABBBatch(minBound, maxBound, trans, count);
+		sink += Sum(maxBound[r % count]);
+	}
+	Report("neAABBBatch", timer.ElapsedMs(), ops);
+
+	double checksum;
+	int onGround;
+	double ms = RunScene(steps, checksum, onGround);
+	printf("scene: %d steps, %.3f ms/step, checksum %.4f, %d bodies on the ground\n", steps, ms, checksum, onGround);
+	printf("(%g)\n", sink);
+
+	alloc.Free((neByte *)trans);
+	alloc.Free((neByte *)transOut);
+	alloc.Free((neByte *)points);
+	alloc.Free((neByte *)pointsOut);
+	alloc.Free((neByte *)minBound);
+	alloc.Free((neByte *)maxBound);
+	return 0;
+}
@@ -0,0 +1,150 @@
+#include "tokamak.h"
+#include "../test_classes/bench_timer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	Tokamak threaded narrowphase benchmark.
+	Drops a debris field of boxes, spheres, cylinders and two box compounds into a pit and
+	reports for each collision thread count (neSimulator::SetCollisionThreadCount):
+	- ms/step: the time Advance takes, the body to body tests included
+	- checksum: where the bodies end; it should be the same for every thread count above one,
+	  one thread responds to each pair as it is tested so it can come out slightly different
+
+	usage: ./test_tokamak_narrowphase [bodies] [steps] [threads ...]
+*/
+
+/// @return the ms per step, or a negative value if the scene could not be made
+static double Run(int threads, int count, int steps, double &checksum) {
+	neSimulatorSizeInfo si;
+	si.rigidBodiesCount = count;
+	si.animatedBodiesCount = 5;
+	si.geometriesCount = count * 2 + 5;
+	si.overlappedPairsCount = count * 12;
+	neV3 gravity;
+	gravity.Set(0.0f, -9.8f, 0.0f);
+	neSimulator *sim = neSimulator::CreateSimulator(si, NULL, &gravity);
+	if (sim == NULL)
+		return -1;
+	sim->SetCollisionThreadCount(threads);
+
+	// the floor and four walls
+	const f32 half = 12.0f;
+	const f32 walls[5][6] = {
+		{0, -1, 0, half * 2, 2, half * 2},
+		{-half, 10, 0, 1, 20, half * 2},
+		{half, 10, 0, 1, 20, half * 2},
+		{0, 10, -half, half * 2, 20, 1},
+		{0, 10, half, half * 2, 20, 1},
+	};
+	neV3 pos;
+	for (int i = 0; i < 5; i++) {
+		neAnimatedBody *ab = sim->CreateAnimatedBody();
+		ab->AddGeometry()->SetBoxSize(walls[i][3], walls[i][4], walls[i][5]);
+		ab->UpdateBoundingInfo();
+		pos.Set(walls[i][0], walls[i][1], walls[i][2]);
+		ab->SetPos(pos);
+	}
+
+	std::vector<neRigidBody *> bodies;
+	srand(1);
+	const int side = 14;
+	for (int i = 0; i < count; i++) {
+		neRigidBody *rb = sim->CreateRigidBody();
+		if (rb == NULL)
+			return -1;
+		neGeometry *geom = rb->AddGeometry();
+		switch (i % 4) {
+		case 0:
+			geom->SetBoxSize(1.0f, 0.6f, 0.8f);
+			rb->SetInertiaTensor(neBoxInertiaTensor(1.0f, 0.6f, 0.8f, 1.0f));
+			break;
+		case 1:
+			geom->SetSphereDiameter(0.8f);
+			rb->SetInertiaTensor(neSphereInertiaTensor(0.8f, 1.0f));
+			break;
+		case 2:
+			geom->SetCylinder(0.7f, 1.0f);
+			rb->SetInertiaTensor(neCylinderInertiaTensor(0.7f, 1.0f, 1.0f));
+			break;
+		default: {
+			// an L of two boxes, so the compound tests get their share
+			geom->SetBoxSize(1.2f, 0.4f, 0.4f);
+			neGeometry *geom2 = rb->AddGeometry();
+			geom2->SetBoxSize(0.4f, 0.8f, 0.4f);
+			neT3 t;
+			t.SetIdentity();
+			t.pos.Set(0.4f, 0.6f, 0.0f);
+			geom2->SetTransform(t);
+			rb->SetInertiaTensor(neBoxInertiaTensor(1.2f, 1.2f, 0.4f, 1.0f));
+			break;
+		}
+		}
+		rb->UpdateBoundingInfo();
+		rb->SetMass(1.0f);
+		int layer = i / (side * side);
+		int cell = i % (side * side);
+		pos.Set((cell % side - side / 2) * 1.5f + (rand() % 100) * 0.003f, 1.0f + layer * 1.5f,
+				(cell / side - side / 2) * 1.5f + (rand() % 100) * 0.003f);
+		rb->SetPos(pos);
+		bodies.push_back(rb);
+	}
+
+	BenchTimer t;
+	for (int i = 0; i < steps; i++)
+		sim->Advance(1.0f / 60.0f);
+	double ms = t.ElapsedMs() / steps;
+
+	checksum = 0;
+	for (unsigned i = 0; i < bodies.size(); i++) {
+		neV3 p = bodies[i]->GetPos();
+		checksum += p[0] + p[1] * 3.0f + p[2] * 7.0f;
+	}
+	neSimulator::DestroySimulator(sim);
+	return ms;
+}
+
+int main(int argc, char *argv[]) {
+	int count = 2000;
+	int steps = 200;
+	if (argc > 1) count = atoi(argv[1]);
+	if (argc > 2) steps = atoi(argv[2]);
+	std::vector<int> threads;
+	for (int i = 3; i < argc; i++)
+		threads.push_back(atoi(argv[i]));
+	if (threads.empty()) {
+		threads.push_back(1);
+		threads.push_back(2);
+		threads.push_back(4);
+		threads.push_back(8);
+	}
+	if (count < 1 || steps < 1) {
+		printf("usage: ./test_tokamak_narrowphase [bodies] [steps] [threads ...]\n");
+		return 1;
+	}
+
+	printf("Tokamak narrowphase: %d bodies, %d steps\n", count, steps);
+	printf(" threads      ms/step       checksum   same\n");
+	// the checksum of the first run with more than one thread, the others should match it
+	double reference = 0;
+	bool haveReference = false;
+	for (unsigned i = 0; i < threads.size(); i++) {
+		double checksum;
+		double ms = Run(threads[i], count, steps, checksum);
+		if (ms < 0) {
+			printf("Could not create the scene\n");
+			return 1;
+		}
+		const char *same = "-";
+		if (threads[i] > 1) {
+			if (!haveReference) {
+				reference = checksum;
+				haveReference = true;
+			}
+			same = checksum == reference ? "yes" : "no";
+		}
+		printf("%8d   %10.3f   %12.4f   %4s\n", threads[i], ms, checksum, same);
+	}
+	return 0;
+}
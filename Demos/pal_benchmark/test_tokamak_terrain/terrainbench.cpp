@@ -0,0 +1,138 @@
+#include "tokamak.h"
+#include "../test_classes/bench_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	Tokamak terrain tree benchmark.
+	Makes a hilly grid terrain with each tree Tokamak can build over it (neSimulator::SetTerrainTreeType),
+	drops bodies on it and reports:
+	- build ms: the time SetTerrainMesh takes to build the tree
+	- ms/step: the time Advance takes with the bodies on the terrain, mostly finding the triangles
+	  under each body and testing them
+	- resting: the bodies still above the terrain at the end; fewer for one tree means bodies fell through
+
+	usage: ./test_tokamak_terrain [grid] [bodies] [steps]
+	grid is the number of cells along each side, two triangles each
+*/
+
+static const f32 CELL = 1.0f;
+
+static f32 Height(f32 x, f32 z) {
+	return sinf(x * 0.15f) * cosf(z * 0.11f) * 2.0f + sinf(x * 0.031f + z * 0.027f) * 4.0f;
+}
+
+/// @return false if the scene could not be made
+static bool Run(neSimulator::TERRAIN_TREE_TYPE type, int grid, int count, int steps,
+				double &buildMs, double &stepMs, int &resting) {
+	neSimulatorSizeInfo si;
+	si.rigidBodiesCount = count;
+	si.animatedBodiesCount = 1;
+	si.geometriesCount = count + 1;
+	si.overlappedPairsCount = count * 8;
+	si.terrainNodesStartCount = 1000;
+	si.terrainNodesGrowByCount = 1000;
+	neV3 gravity;
+	gravity.Set(0.0f, -9.8f, 0.0f);
+	neSimulator *sim = neSimulator::CreateSimulator(si, NULL, &gravity);
+	if (sim == NULL)
+		return false;
+	sim->SetTerrainTreeType(type);
+
+	const f32 half = grid * CELL * 0.5f;
+	std::vector<neV3> vertices((grid + 1) * (grid + 1));
+	for (int z = 0; z <= grid; z++) {
+		for (int x = 0; x <= grid; x++) {
+			f32 px = x * CELL - half, pz = z * CELL - half;
+			vertices[z * (grid + 1) + x].Set(px, Height(px, pz), pz);
+		}
+	}
+	std::vector<neTriangle> triangles(grid * grid * 2);
+	for (int z = 0; z < grid; z++) {
+		for (int x = 0; x < grid; x++) {
+			s32 v = z * (grid + 1) + x;
+			neTriangle *t = &triangles[(z * grid + x) * 2];
+			t[0].indices[0] = v; t[0].indices[1] = v + grid + 1; t[0].indices[2] = v + 1;
+			t[1].indices[0] = v + 1; t[1].indices[1] = v + grid + 1; t[1].indices[2] = v + grid + 2;
+		}
+	}
+	neTriangleMesh mesh;
+	mesh.vertices = &vertices[0];
+	mesh.vertexCount = (s32)vertices.size();
+	mesh.triangles = &triangles[0];
+	mesh.triangleCount = (s32)triangles.size();
+
+	BenchTimer t;
+	sim->SetTerrainMesh(&mesh);
+	buildMs = t.ElapsedMs();
+
+	std::vector<neRigidBody *> bodies;
+	srand(1);
+	// spread over most of the terrain, so the queries reach every part of the tree
+	const f32 spread = half * 0.9f;
+	for (int i = 0; i < count; i++) {
+		neRigidBody *rb = sim->CreateRigidBody();
+		if (rb == NULL)
+			return false;
+		neGeometry *geom = rb->AddGeometry();
+		if (i % 2) {
+			geom->SetBoxSize(0.8f, 0.8f, 0.8f);
+			rb->SetInertiaTensor(neBoxInertiaTensor(0.8f, 0.8f, 0.8f, 1.0f));
+		} else {
+			geom->SetSphereDiameter(0.8f);
+			rb->SetInertiaTensor(neSphereInertiaTensor(0.8f, 1.0f));
+		}
+		rb->UpdateBoundingInfo();
+		rb->SetMass(1.0f);
+		neV3 pos;
+		f32 x = ((rand() % 10000) / 5000.0f - 1.0f) * spread;
+		f32 z = ((rand() % 10000) / 5000.0f - 1.0f) * spread;
+		pos.Set(x, Height(x, z) + 1.0f + (i % 5) * 0.5f, z);
+		rb->SetPos(pos);
+		bodies.push_back(rb);
+	}
+
+	t.Start();
+	for (int i = 0; i < steps; i++)
+		sim->Advance(1.0f / 60.0f);
+	stepMs = t.ElapsedMs() / steps;
+
+	resting = 0;
+	for (unsigned i = 0; i < bodies.size(); i++) {
+		neV3 p = bodies[i]->GetPos();
+		if (p[1] > Height(p[0], p[2]) - 0.5f)
+			resting++;
+	}
+	neSimulator::DestroySimulator(sim);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	int grid = 256;
+	int count = 500;
+	int steps = 200;
+	if (argc > 1) grid = atoi(argv[1]);
+	if (argc > 2) count = atoi(argv[2]);
+	if (argc > 3) steps = atoi(argv[3]);
+	if (grid < 1 || count < 1 || steps < 1) {
+		printf("usage: ./test_tokamak_terrain [grid] [bodies] [steps]\n");
+		return 1;
+	}
+
+	printf("Tokamak terrain: %d triangles, %d bodies, %d steps\n", grid * grid * 2, count, steps);
+	printf("     tree     build ms      ms/step   resting\n");
+	const neSimulator::TERRAIN_TREE_TYPE types[2] = {neSimulator::TERRAIN_TREE_BVH, neSimulator::TERRAIN_TREE_QUADTREE};
+	const char *names[2] = {"bvh", "quadtree"};
+	for (int i = 0; i < 2; i++) {
+		double buildMs, stepMs;
+		int resting;
+		if (!Run(types[i], grid, count, steps, buildMs, stepMs, resting)) {
+			printf("Could not create the scene\n");
+			return 1;
+		}
+		printf("%9s   %10.2f   %10.3f   %7d\n", names[i], buildMs, stepMs, resting);
+	}
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include "tokamak.h"
+#include "../test_classes/bench_timer.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+/*
+	Tokamak terrain tile benchmark.
+	Makes a hilly grid terrain cut into tiles x tiles square tiles and gives it to Tokamak
+	either as one merged mesh (neSimulator::SetTerrainMesh) or as a tile each (neSimulator::AddTerrainMesh),
+	drops bodies on it and reports:
+	- setup ms: the time to hand over the terrain and build its trees
+	- change ms: the time to replace one tile, by rebuilding the whole merged mesh,
+	  or by removing and adding the one tile
+	- ms/step: the time Advance takes with the bodies on the terrain
+	- resting: the bodies still above the terrain at the end, it should be the same for both
+	- checksum: where the bodies end, it should be close for both
+
+	usage: ./test_tokamak_terrain_tiles [grid] [tiles] [bodies] [steps]
+	grid is the number of cells along each side, two triangles each
+*/
+
+static const f32 CELL = 1.0f;
+
+static f32 Height(f32 x, f32 z) {
+	return sinf(x * 0.15f) * cosf(z * 0.11f) * 2.0f + sinf(x * 0.031f + z * 0.027f) * 4.0f;
+}
+
+struct Mesh {
+	std::vector<neV3> vertices;
+	std::vector<neTriangle> triangles;
+
+	void Get(neTriangleMesh &mesh) {
+		mesh.vertices = &vertices[0];
+		mesh.vertexCount = (s32)vertices.size();
+		mesh.triangles = &triangles[0];
+		mesh.triangleCount = (s32)triangles.size();
+	}
+};
+
+//the cells [x0,x1) x [z0,z1) of the grid, appended to the mesh
+static void AddCells(Mesh &mesh, int grid, int x0, int z0, int x1, int z1) {
+	const f32 half = grid * CELL * 0.5f;
+	s32 first = (s32)mesh.vertices.size();
+	s32 width = x1 - x0 + 1;
+	for (int z = z0; z <= z1; z++) {
+		for (int x = x0; x <= x1; x++) {
+			neV3 v;
+			f32 px = x * CELL - half, pz = z * CELL - half;
+			v.Set(px, Height(px, pz), pz);
+			mesh.vertices.push_back(v);
+		}
+	}
+	for (int z = 0; z < z1 - z0; z++) {
+		for (int x = 0; x < x1 - x0; x++) {
+			s32 v = first + z * width + x;
+			neTriangle t;
+			t.indices[0] = v; t.indices[1] = v + width; t.indices[2] = v + 1;
+			mesh.triangles.push_back(t);
+			t.indices[0] = v + 1; t.indices[1] = v + width; t.indices[2] = v + width + 1;
+			mesh.triangles.push_back(t);
+		}
+	}
+}
+
+/// @return false if the scene could not be made
+static bool Run(bool useTiles, int grid, int tiles, int count, int steps,
+				double &setupMs, double &changeMs, double &stepMs, int &resting, double &checksum) {
+	neSimulatorSizeInfo si;
+	si.rigidBodiesCount = count;
+	si.animatedBodiesCount = 1;
+	si.geometriesCount = count + 1;
+	si.overlappedPairsCount = count * 8;
+	neV3 gravity;
+	gravity.Set(0.0f, -9.8f, 0.0f);
+	neSimulator *sim = neSimulator::CreateSimulator(si, NULL, &gravity);
+	if (sim == NULL)
+		return false;
+
+	// the tiles, and all of them as one mesh
+	std::vector<Mesh> tileMeshes(tiles * tiles);
+	Mesh merged;
+	for (int tz = 0; tz < tiles; tz++) {
+		for (int tx = 0; tx < tiles; tx++) {
+			int x0 = grid * tx / tiles, x1 = grid * (tx + 1) / tiles;
+			int z0 = grid * tz / tiles, z1 = grid * (tz + 1) / tiles;
+			AddCells(tileMeshes[tz * tiles + tx], grid, x0, z0, x1, z1);
+			AddCells(merged, grid, x0, z0, x1, z1);
+		}
+	}
+
+	neTriangleMesh mesh;
+	std::vector<s32> ids(tileMeshes.size());
+	BenchTimer t;
+	if (useTiles) {
+		for (unsigned i = 0; i < tileMeshes.size(); i++) {
+			tileMeshes[i].Get(mesh);
+			ids[i] = sim->AddTerrainMesh(&mesh);
+		}
+	} else {
+		merged.Get(mesh);
+		sim->SetTerrainMesh(&mesh);
+	}
+	setupMs = t.ElapsedMs();
+
+	// replace the middle tile with itself
+	unsigned middle = (tiles / 2) * tiles + tiles / 2;
+	t.Start();
+	if (useTiles) {
+		sim->RemoveTerrainMesh(ids[middle]);
+		tileMeshes[middle].Get(mesh);
+		ids[middle] = sim->AddTerrainMesh(&mesh);
+	} else {
+		merged.Get(mesh);
+		sim->SetTerrainMesh(&mesh);
+	}
+	changeMs = t.ElapsedMs();
+
+	std::vector<neRigidBody *> bodies;
+	srand(1);
+	const f32 spread = grid * CELL * 0.45f;
+	for (int i = 0; i < count; i++) {
+		neRigidBody *rb = sim->CreateRigidBody();
+		if (rb == NULL)
+			return false;
+		neGeometry *geom = rb->AddGeometry();
+		if (i % 2) {
+			geom->SetBoxSize(0.8f, 0.8f, 0.8f);
+			rb->SetInertiaTensor(neBoxInertiaTensor(0.8f, 0.8f, 0.8f, 1.0f));
+		} else {
+			geom->SetSphereDiameter(0.8f);
+			rb->SetInertiaTensor(neSphereInertiaTensor(0.8f, 1.0f));
+		}
+		rb->UpdateBoundingInfo();
+		rb->SetMass(1.0f);
+		neV3 pos;
+		f32 x = ((rand() % 10000) / 5000.0f - 1.0f) * spread;
+		f32 z = ((rand() % 10000) / 5000.0f - 1.0f) * spread;
+		pos.Set(x, Height(x, z) + 1.0f + (i % 5) * 0.5f, z);
+		rb->SetPos(pos);
+		bodies.push_back(rb);
+	}
+
+	t.Start();
+	for (int i = 0; i < steps; i++)
+		sim->Advance(1.0f / 60.0f);
+	stepMs = t.ElapsedMs() / steps;
+
+	resting = 0;
+	checksum = 0;
+	for (unsigned i = 0; i < bodies.size(); i++) {
+		neV3 p = bodies[i]->GetPos();
+		if (p[1] > Height(p[0], p[2]) - 0.5f)
+			resting++;
+		checksum += p[0] + p[1] * 3.0f + p[2] * 7.0f;
+	}
+	neSimulator::DestroySimulator(sim);
+	return true;
+}
+
+int main(int argc, char *argv[]) {
+	int grid = 256;
+	int tiles = 8;
+	int count = 500;
+	int steps = 200;
+	if (argc > 1) grid = atoi(argv[1]);
+	if (argc > 2) tiles = atoi(argv[2]);
+	if (argc > 3) count = atoi(argv[3]);
+	if (argc > 4) steps = atoi(argv[4]);
+	if (grid < 1 || tiles < 1 || tiles > grid || count < 1 || steps < 1) {
+		printf("usage: ./test_tokamak_terrain_tiles [grid] [tiles] [bodies] [steps]\n");
+		return 1;
+	}
+
+	printf("Tokamak terrain tiles: %d triangles in %d tiles, %d bodies, %d steps\n", grid * grid * 2, tiles * tiles, count, steps);
+	printf("   terrain     setup ms    change ms      ms/step   resting       checksum\n");
+	const char *names[2] = {"merged", "tiles"};
+	for (int i = 0; i < 2; i++) {
+		double setupMs, changeMs, stepMs, checksum;
+		int resting;
+		if (!Run(i == 1, grid, tiles, count, steps, setupMs, changeMs, stepMs, resting, checksum)) {
+			printf("Could not create the scene\n");
+			return 1;
+		}
+		printf("%10s   %10.2f   %10.2f   %10.3f   %7d   %12.4f\n", names[i], setupMs, changeMs, stepMs, resting, checksum);
+	}
+	return 0;
+}
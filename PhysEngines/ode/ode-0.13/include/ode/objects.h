@@ -464,6 +464,86 @@ ODE_API void dWorldSetQuickStepW (dWorldID, dReal over_relaxation);
  */
 ODE_API dReal dWorldGetQuickStepW (dWorldID);
 
+/**
+ * @brief Set whether QuickStep starts from the lambda the joints were left with
+ * @ingroup world
+ * @remarks
+ * Each joint keeps the lambda (constraint force) QuickStep found for it on
+ * the last step. With warm starting on, the solver starts from those values
+ * instead of zero, so fewer iterations are needed for the same accuracy.
+ * Contact joints are made anew each step, so their lambda has to be seeded
+ * with dJointSetLambda by whoever matches the contacts across steps.
+ * @param enabled The default is 0 (off).
+ */
+ODE_API void dWorldSetQuickStepWarmStarting (dWorldID, int enabled);
+
+/* defined so code can tell this ODE has the warm starting functions */
+#define dQUICKSTEP_WARM_STARTING 1
+
+/**
+ * @brief Get whether QuickStep starts from the lambda the joints were left with
+ * @ingroup world
+ */
+ODE_API int dWorldGetQuickStepWarmStarting (dWorldID);
+
+/**
+ * @brief Set whether QuickStep gives the same result whatever the number of threads
+ * @ingroup world
+ * @remarks
+ * Big islands are solved with their joints coloured, so that joints of one
+ * colour share no bodies and can be solved by several threads at once, see
+ * dWorldSetStepThreadingImplementation. That changes the order the joints
+ * are solved in, and with it the result. In deterministic mode every island
+ * is solved that way, even with one thread, the random reordering of the
+ * joints does not depend on the other islands, and the islands are stepped
+ * one after the other, each with all the threads, so a simulation gives the
+ * same result with any number of threads.
+ * @param enabled The default is 0 (off).
+ */
+ODE_API void dWorldSetQuickStepDeterministic (dWorldID, int enabled);
+
+/**
+ * @brief Get whether QuickStep gives the same result whatever the number of threads
+ * @ingroup world
+ */
+ODE_API int dWorldGetQuickStepDeterministic (dWorldID);
+
+/* defined so code can tell this ODE has the deterministic mode functions */
+#define dQUICKSTEP_DETERMINISTIC 1
+
+/**
+ * @brief Get the number of bytes dWorldSaveState needs for the world as it is now
+ * @ingroup world
+ */
+ODE_API size_t dWorldGetStateSize (dWorldID);
+
+/**
+ * @brief Copy the state of the bodies and joints of a world
+ * @ingroup world
+ * @remarks
+ * The state is the position, orientation, velocities, force and torque
+ * accumulators, enabled flag and auto-disable counters of every body, and
+ * the lambda of every joint (which QuickStep warm starts from), in the order
+ * the world holds them. None of the parameters of the world, bodies or joints
+ * are kept: the state is meant to be given back to dWorldRestoreState of the
+ * same world, while it has the same bodies and joints, to go back in time.
+ * @param buffer dWorldGetStateSize bytes
+ */
+ODE_API void dWorldSaveState (dWorldID, void *buffer);
+
+/**
+ * @brief Set the bodies and joints of a world back to the state dWorldSaveState copied
+ * @ingroup world
+ * @remarks
+ * The geoms of the bodies are marked as moved.
+ * @returns 1, or 0 (changing nothing) if the world no longer has the same
+ * number of bodies and joints, or the size does not match
+ */
+ODE_API int dWorldRestoreState (dWorldID, const void *buffer, size_t size);
+
+/* defined so code can tell this ODE has the state functions */
+#define dWORLD_SAVE_STATE 1
+
 /* World contact parameter functions */
 
 /**
@@ -1857,6 +1937,24 @@ ODE_API void dJointSetFeedback (dJointID, dJointFeedback *);
  */
 ODE_API dJointFeedback *dJointGetFeedback (dJointID);
 
+/**
+ * @brief Set the lambda the joint starts from on the next QuickStep.
+ * @ingroup joints
+ * @remarks
+ * Only used when warm starting is on, see dWorldSetQuickStepWarmStarting.
+ * There is one value per constraint row, for a contact joint the normal
+ * row is first and the friction rows follow.
+ * @param lambda 6 values, rows the joint does not have are ignored.
+ */
+ODE_API void dJointSetLambda (dJointID, const dReal *lambda);
+
+/**
+ * @brief Get the lambda the joint was left with by the last QuickStep.
+ * @ingroup joints
+ * @param lambda receives 6 values.
+ */
+ODE_API void dJointGetLambda (dJointID, dReal *lambda);
+
 /**
  * @brief Set the joint anchor point.
  * @ingroup joints
@@ -106,6 +106,8 @@ struct dxDampingParameters {
 struct dxQuickStepParameters {
     int num_iterations;		// number of SOR iterations to perform
     dReal w;			// the SOR over-relaxation parameter
+    int warm_starting;		// start from the lambda the joints were left with
+    int deterministic;		// solve every island the same way, whatever the number of threads
 
     dxQuickStepParameters() {}
     explicit dxQuickStepParameters(void *);
@@ -1491,6 +1491,20 @@ dJointFeedback *dJointGetFeedback (dxJoint *joint)
 }
 
 
+void dJointSetLambda (dxJoint *joint, const dReal *lambda)
+{
+    dAASSERT (joint && lambda);
+    for (int i=0; i<6; i++) joint->lambda[i] = lambda[i];
+}
+
+
+void dJointGetLambda (dxJoint *joint, dReal *lambda)
+{
+    dAASSERT (joint && lambda);
+    for (int i=0; i<6; i++) lambda[i] = joint->lambda[i];
+}
+
+
 
 dJointID dConnectingJoint (dBodyID in_b1, dBodyID in_b2)
 {
@@ -2051,6 +2065,160 @@ dReal dWorldGetQuickStepW (dWorldID w)
 }
 
 
+void dWorldSetQuickStepWarmStarting (dWorldID w, int enabled)
+{
+    dAASSERT(w);
+    w->qs.warm_starting = enabled ? 1 : 0;
+}
+
+
+int dWorldGetQuickStepWarmStarting (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.warm_starting;
+}
+
+
+void dWorldSetQuickStepDeterministic (dWorldID w, int enabled)
+{
+    dAASSERT(w);
+    w->qs.deterministic = enabled ? 1 : 0;
+}
+
+
+int dWorldGetQuickStepDeterministic (dWorldID w)
+{
+    dAASSERT(w);
+    return w->qs.deterministic;
+}
+
+
+// the saved state of a body, followed by its average velocity buffers
+struct dxBodyState {
+    dxPosR posr;
+    dQuaternion q;
+    dVector3 lvel,avel;
+    dVector3 facc,tacc;
+    dReal adis_timeleft;
+    int adis_stepsleft;
+    unsigned int average_counter;
+    int average_ready;
+    int disabled;
+    int average_samples;      // the length of the buffers that follow
+};
+
+struct dxWorldStateHeader {
+    int nb,nj;
+};
+
+static size_t BodyAverageBytes (const dxBody *b)
+{
+    return b->average_lvel_buffer ? 2 * (size_t)b->adis.average_samples * sizeof(dVector3) : 0;
+}
+
+size_t dWorldGetStateSize (dWorldID w)
+{
+    dAASSERT(w);
+    size_t size = sizeof(dxWorldStateHeader) + (size_t)w->nb * sizeof(dxBodyState)
+        + (size_t)w->nj * 6 * sizeof(dReal);
+    for (dxBody *b = w->firstbody; b; b = (dxBody*)b->next)
+        size += BodyAverageBytes(b);
+    return size;
+}
+
+void dWorldSaveState (dWorldID w, void *buffer)
+{
+    dAASSERT(w && buffer);
+    char *p = (char *)buffer;
+    dxWorldStateHeader header;
+    header.nb = w->nb;
+    header.nj = w->nj;
+    memcpy (p, &header, sizeof(header));
+    p += sizeof(header);
+
+    for (dxBody *b = w->firstbody; b; b = (dxBody*)b->next) {
+        dxBodyState s;
+        s.posr = b->posr;
+        memcpy (s.q, b->q, sizeof(dQuaternion));
+        memcpy (s.lvel, b->lvel, sizeof(dVector3));
+        memcpy (s.avel, b->avel, sizeof(dVector3));
+        memcpy (s.facc, b->facc, sizeof(dVector3));
+        memcpy (s.tacc, b->tacc, sizeof(dVector3));
+        s.adis_timeleft = b->adis_timeleft;
+        s.adis_stepsleft = b->adis_stepsleft;
+        s.average_counter = b->average_counter;
+        s.average_ready = b->average_ready;
+        s.disabled = (b->flags & dxBodyDisabled) ? 1 : 0;
+        s.average_samples = b->average_lvel_buffer ? (int)b->adis.average_samples : 0;
+        memcpy (p, &s, sizeof(s));
+        p += sizeof(s);
+        if (s.average_samples) {
+            size_t bytes = (size_t)s.average_samples * sizeof(dVector3);
+            memcpy (p, b->average_lvel_buffer, bytes);
+            memcpy (p + bytes, b->average_avel_buffer, bytes);
+            p += 2 * bytes;
+        }
+    }
+
+    for (dxJoint *j = w->firstjoint; j; j = (dxJoint*)j->next) {
+        memcpy (p, j->lambda, 6 * sizeof(dReal));
+        p += 6 * sizeof(dReal);
+    }
+}
+
+int dWorldRestoreState (dWorldID w, const void *buffer, size_t size)
+{
+    dAASSERT(w && buffer);
+    const char *p = (const char *)buffer;
+    dxWorldStateHeader header;
+    if (size < sizeof(header)) return 0;
+    memcpy (&header, p, sizeof(header));
+    if (header.nb != w->nb || header.nj != w->nj || size != dWorldGetStateSize(w)) return 0;
+    // the sizes match, check the buffers of each body before changing anything
+    const char *check = p + sizeof(header);
+    for (dxBody *b = w->firstbody; b; b = (dxBody*)b->next) {
+        dxBodyState s;
+        memcpy (&s, check, sizeof(s));
+        int samples = b->average_lvel_buffer ? (int)b->adis.average_samples : 0;
+        if (s.average_samples != samples) return 0;
+        check += sizeof(s) + BodyAverageBytes(b);
+    }
+    p += sizeof(header);
+
+    for (dxBody *b = w->firstbody; b; b = (dxBody*)b->next) {
+        dxBodyState s;
+        memcpy (&s, p, sizeof(s));
+        p += sizeof(s);
+        b->posr = s.posr;
+        memcpy (b->q, s.q, sizeof(dQuaternion));
+        memcpy (b->lvel, s.lvel, sizeof(dVector3));
+        memcpy (b->avel, s.avel, sizeof(dVector3));
+        memcpy (b->facc, s.facc, sizeof(dVector3));
+        memcpy (b->tacc, s.tacc, sizeof(dVector3));
+        b->adis_timeleft = s.adis_timeleft;
+        b->adis_stepsleft = s.adis_stepsleft;
+        b->average_counter = s.average_counter;
+        b->average_ready = s.average_ready;
+        if (s.disabled) b->flags |= dxBodyDisabled;
+        else b->flags &= ~dxBodyDisabled;
+        if (s.average_samples) {
+            size_t bytes = (size_t)s.average_samples * sizeof(dVector3);
+            memcpy (b->average_lvel_buffer, p, bytes);
+            memcpy (b->average_avel_buffer, p + bytes, bytes);
+            p += 2 * bytes;
+        }
+        for (dxGeom *geom = b->geom; geom; geom = dGeomGetBodyNext (geom))
+            dGeomMoved (geom);
+    }
+
+    for (dxJoint *j = w->firstjoint; j; j = (dxJoint*)j->next) {
+        memcpy (j->lambda, p, 6 * sizeof(dReal));
+        p += 6 * sizeof(dReal);
+    }
+    return 1;
+}
+
+
 void dWorldSetContactMaxCorrectingVel (dWorldID w, dReal vel)
 {
     dAASSERT(w);
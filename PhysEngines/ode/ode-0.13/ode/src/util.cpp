@@ -898,11 +898,16 @@ bool dxProcessIslands (dxWorld *world, const dxWorldProcessIslandsInfo &islandsI
         int summaryFault = 0;
 
         unsigned activeThreadCount;
-        const unsigned islandsAllowedThreadCount = world->GetThreadingIslandsMaxThreadsCount(&activeThreadCount);
-        dIASSERT(islandsAllowedThreadCount != 0);
-        dIASSERT(activeThreadCount >= islandsAllowedThreadCount);
+        const unsigned islandsMaxThreadCount = world->GetThreadingIslandsMaxThreadsCount(&activeThreadCount);
+        dIASSERT(islandsMaxThreadCount != 0);
+        dIASSERT(activeThreadCount >= islandsMaxThreadCount);
 
-        unsigned stepperAllowedThreadCount = islandsAllowedThreadCount; // For now, set stepper allowed threads equal to island stepping threads
+        unsigned stepperAllowedThreadCount = islandsMaxThreadCount; // For now, set stepper allowed threads equal to island stepping threads
+
+        // Islands stepped in parallel move their geoms in the order they happen to finish in,
+        // which reorders the space and with it the contacts of the next step. In deterministic
+        // mode the islands are stepped one at a time and the stepper gets all the threads instead.
+        const unsigned islandsAllowedThreadCount = world->qs.deterministic ? 1 : islandsMaxThreadCount;
 
         unsigned simultaneousCallsCount = EstimateIslandProcessingSimultaneousCallsMaximumCount(activeThreadCount, islandsAllowedThreadCount, stepperAllowedThreadCount, maxCallCountEstimator);
         if (!world->PreallocateResourcesForThreadedCalls(simultaneousCallsCount)) {
@@ -72,7 +72,9 @@ dxDampingParameters::dxDampingParameters(void *):
 
 dxQuickStepParameters::dxQuickStepParameters(void *):
     num_iterations(20),
-    w(REAL(1.3))
+    w(REAL(1.3)),
+    warm_starting(0),
+    deterministic(0)
 {
 }
 
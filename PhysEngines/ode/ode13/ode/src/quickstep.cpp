@@ -68,6 +68,25 @@
 
 #define RANDOMLY_REORDER_CONSTRAINTS 1
 
+
+// for the SOR method:
+// islands with at least this many joints are solved with the constraint graph
+// coloured when the stepper has more than one thread, so that the joints of one
+// colour share no bodies and can be solved by all the threads at once. the
+// coloured solve is also used for every island in deterministic mode, see
+// dWorldSetQuickStepDeterministic.
+
+#define SOR_COLORED_MIN_JOINTS 64
+
+// the coloured solve takes the joints of a colour SOR_LANES at a time, with
+// the rows of those joints stored lane by lane so the inner loop vectorizes.
+// joints that would need more than SOR_MAX_COLORS colours are solved one
+// after another by a single thread, after the other colours.
+
+#define SOR_LANES 4
+#define SOR_MAX_COLORS 32
+#define SOR_BLOCKS_PER_WORK 4
+
 //****************************************************************************
 // special matrix multipliers
 
@@ -272,7 +291,36 @@ static int dxQuickStepIsland_Stage3_Callback(void *callContext, dcallindex_t cal
 static void dxQuickStepIsland_Stage2a(dxQuickStepperStage2CallContext *callContext);
 static void dxQuickStepIsland_Stage2b(dxQuickStepperStage2CallContext *callContext);
 static void dxQuickStepIsland_Stage2c(dxQuickStepperStage2CallContext *callContext);
-static void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *callContext);
+static void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *callContext, dCallReleaseeID callThisReleasee);
+
+struct dxQuickStepperColoredSOR;
+
+struct dxQuickStepperStage4CallContext
+{
+    void Initialize(const dxStepperProcessingCallContext *callContext, const dxQuickStepperLocalContext *localContext, 
+        dReal *lambda, dReal *cforce, void *lcpMemArenaState, dxQuickStepperColoredSOR *coloredSOR)
+    {
+        m_stepperCallContext = callContext;
+        m_localContext = localContext;
+        m_lambda = lambda;
+        m_cforce = cforce;
+        m_lcpMemArenaState = lcpMemArenaState;
+        m_coloredSOR = coloredSOR;
+    }
+
+    const dxStepperProcessingCallContext *m_stepperCallContext;
+    const dxQuickStepperLocalContext   *m_localContext;
+    dReal                           *m_lambda;
+    dReal                           *m_cforce;
+    void                            *m_lcpMemArenaState;
+    dxQuickStepperColoredSOR        *m_coloredSOR;
+};
+
+static int dxQuickStepIsland_Stage4_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static int dxQuickStepIsland_SORSweep_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+static int dxQuickStepIsland_SORWork_Callback(void *callContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee);
+
+static void dxQuickStepIsland_Stage4(dxQuickStepperStage4CallContext *callContext);
 
 
 //***************************************************************************
@@ -302,7 +350,6 @@ static void compute_invM_JT (unsigned int m, const dReal *J, dReal *iMJ, int *jb
 }
 
 // compute out = inv(M)*J'*in.
-#ifdef WARM_STARTING
 static void multiply_invM_JT (unsigned int m, unsigned int nb, dReal *iMJ, int *jb,
                               const dReal *in, dReal *out)
 {
@@ -322,7 +369,6 @@ static void multiply_invM_JT (unsigned int m, unsigned int nb, dReal *iMJ, int *
         iMJ_ptr += 6;
     }
 }
-#endif
 
 // compute out = J*in.
 static void multiplyAdd_J (volatile unsigned *mi_storage, 
@@ -524,21 +570,27 @@ static int compare_index_error (const void *a, const void *b)
 
 #endif
 
-static void SOR_LCP (dxWorldProcessMemArena *memarena,
+// the part of SOR_LCP before the iterations, it returns iMJ and Ad for them
+// and leaves J and b scaled by Ad.
+static void SOR_LCP_Prepare (dxWorldProcessMemArena *memarena,
                      const unsigned int m, const unsigned int nb, dReal *J, int *jb, dxBody * const *body,
                      const dReal *invI, dReal *lambda, dReal *fc, dReal *b,
-                     const dReal *lo, const dReal *hi, const dReal *cfm, const int *findex,
-                     const dxQuickStepParameters *qs)
+                     const dReal *cfm, const dxQuickStepParameters *qs,
+                     dReal **out_iMJ, dReal **out_Ad)
 {
 #ifdef WARM_STARTING
-    {
+    const int warm_starting = 1;
+#else
+    const int warm_starting = qs->warm_starting;
+#endif
+    if (warm_starting) {
         // for warm starting, this seems to be necessary to prevent
         // jerkiness in motor-driven joints. i have no idea why this works.
         for (unsigned int i=0; i<m; i++) lambda[i] *= 0.9;
     }
-#else
-    dSetZero (lambda,m);
-#endif
+    else {
+        dSetZero (lambda,m);
+    }
 
     // precompute iMJ = inv(M)*J'
     dReal *iMJ = memarena->AllocateArray<dReal>((size_t)m*12);
@@ -546,11 +598,12 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
 
     // compute fc=(inv(M)*J')*lambda. we will incrementally maintain fc
     // as we change lambda.
-#ifdef WARM_STARTING
-    multiply_invM_JT (m,nb,iMJ,jb,lambda,fc);
-#else
-    dSetZero (fc,(size_t)nb*6);
-#endif
+    if (warm_starting) {
+        multiply_invM_JT (m,nb,iMJ,jb,lambda,fc);
+    }
+    else {
+        dSetZero (fc,(size_t)nb*6);
+    }
 
     dReal *Ad = memarena->AllocateArray<dReal>(m);
 
@@ -586,6 +639,19 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
         }
     }
 
+    *out_iMJ = iMJ;
+    *out_Ad = Ad;
+}
+
+static void SOR_LCP (dxWorldProcessMemArena *memarena,
+                     const unsigned int m, const unsigned int nb, dReal *J, int *jb, dxBody * const *body,
+                     const dReal *invI, dReal *lambda, dReal *fc, dReal *b,
+                     const dReal *lo, const dReal *hi, const dReal *cfm, const int *findex,
+                     const dxQuickStepParameters *qs)
+{
+    dReal *iMJ, *Ad;
+    SOR_LCP_Prepare (memarena,m,nb,J,jb,body,invI,lambda,fc,b,cfm,qs,&iMJ,&Ad);
+
 
     // order to solve constraint rows in
     IndexError *order = memarena->AllocateArray<IndexError>(m);
@@ -782,6 +848,323 @@ static void SOR_LCP (dxWorldProcessMemArena *memarena,
     }
 }
 
+//***************************************************************************
+// SOR with the constraint graph coloured
+
+// one row of each of the SOR_LANES joints of a block, stored lane by lane
+struct dxSORRowBlock {
+    dReal J[12][SOR_LANES];     // J, scaled by Ad
+    dReal iMJ[12][SOR_LANES];
+    dReal b[SOR_LANES];         // b, scaled by Ad
+    dReal Ad[SOR_LANES];        // Ad, scaled by cfm
+    dReal lo[SOR_LANES];
+    dReal hi[SOR_LANES];
+    dReal lambda[SOR_LANES];
+    int fslot[SOR_LANES];       // the row of the same joint that limits this one (findex), or -1
+    int row[SOR_LANES];         // the row in the island, -1 for padding
+};
+
+// SOR_LANES joints of one colour. their rows are in rows[firstRow..firstRow+rowCount),
+// rows that do not limit others first.
+struct dxSORJointBlock {
+    int body1[SOR_LANES];       // -1 for none or padding
+    int body2[SOR_LANES];
+    unsigned int firstRow;
+    unsigned int rowCount;
+};
+
+struct dxQuickStepperColoredSOR
+{
+    dxWorld                         *m_world;
+    unsigned                        m_allowedThreads;
+    dReal                           *m_fc;
+    dxSORJointBlock                 *m_blocks;
+    dxSORRowBlock                   *m_rows;
+    unsigned int                    m_rowCount;
+    unsigned int                    *m_order;           // blocks in solving order, colour by colour
+    unsigned int                    m_colorStart[SOR_MAX_COLORS + 2];
+    unsigned int                    m_colorCount;
+    int                             m_sequentialColor;  // the colour of the joints that ran out of colours, or -1
+    unsigned long                   m_randomSeed;
+    unsigned int                    m_sweep;            // sweep = iteration * m_colorCount + colour
+    unsigned int                    m_sweepCount;
+    unsigned int                    m_sweepColor;
+    volatile unsigned int           m_workIndex;
+    unsigned int                    m_workCount;
+    dCallReleaseeID                 m_stage4Releasee;
+};
+
+// the coloured solve has its own random numbers, so the order the islands are
+// stepped in does not change the result
+static unsigned int SORRandInt (unsigned long *seed, unsigned int n)
+{
+    *seed = (1664525UL * *seed + 1013904223UL) & 0xffffffffUL;
+    return (unsigned int)((*seed >> 8) % n);
+}
+
+static dxQuickStepperColoredSOR *BuildColoredSOR (dxWorldProcessMemArena *memarena, dxWorld *world, unsigned allowedThreads,
+                     const unsigned int nj, const unsigned int *mindex, const unsigned int nb,
+                     const dReal *J, const dReal *iMJ, const int *jb, const dReal *b, const dReal *Ad,
+                     const dReal *lo, const dReal *hi, const int *findex, const dReal *lambda, dReal *fc,
+                     const dxQuickStepParameters *qs)
+{
+    dxQuickStepperColoredSOR *sor = (dxQuickStepperColoredSOR *)memarena->AllocateBlock(sizeof(dxQuickStepperColoredSOR));
+    sor->m_world = world;
+    sor->m_allowedThreads = allowedThreads;
+    sor->m_fc = fc;
+
+    // greedy colouring: each joint takes the lowest colour neither of its bodies has yet
+    unsigned int *jointColor = memarena->AllocateArray<unsigned int>(nj);
+    unsigned int *bodyColors = memarena->AllocateArray<unsigned int>(nb);
+    memset (bodyColors, 0, (size_t)nb * sizeof(unsigned int));
+    unsigned int colorJoints[SOR_MAX_COLORS + 1];
+    memset (colorJoints, 0, sizeof(colorJoints));
+    for (unsigned int ji = 0; ji < nj; ji++) {
+        const unsigned int ofsi = mindex[ji * 2 + 0];
+        int b1 = jb[(size_t)ofsi*2];
+        int b2 = jb[(size_t)ofsi*2+1];
+        unsigned int used = (b1 != -1 ? bodyColors[b1] : 0) | (b2 != -1 ? bodyColors[b2] : 0);
+        unsigned int color = 0;
+        while (color < SOR_MAX_COLORS && (used & (1U << color)) != 0) color++;
+        if (color < SOR_MAX_COLORS) {
+            if (b1 != -1) bodyColors[b1] |= 1U << color;
+            if (b2 != -1) bodyColors[b2] |= 1U << color;
+        }
+        jointColor[ji] = color;
+        colorJoints[color]++;
+    }
+
+    // lay the blocks out colour by colour, skipping unused colours.
+    // joints that ran out of colours get a block each.
+    unsigned int nextBlock[SOR_MAX_COLORS + 1];
+    unsigned int nextLane[SOR_MAX_COLORS + 1];
+    unsigned int blockCount = 0;
+    sor->m_colorCount = 0;
+    sor->m_sequentialColor = -1;
+    for (unsigned int c = 0; c <= SOR_MAX_COLORS; c++) {
+        if (colorJoints[c] == 0) continue;
+        if (c == SOR_MAX_COLORS) sor->m_sequentialColor = (int)sor->m_colorCount;
+        sor->m_colorStart[sor->m_colorCount++] = blockCount;
+        nextBlock[c] = blockCount;
+        nextLane[c] = 0;
+        blockCount += (c == SOR_MAX_COLORS) ? colorJoints[c] : (colorJoints[c] + SOR_LANES - 1) / SOR_LANES;
+    }
+    sor->m_colorStart[sor->m_colorCount] = blockCount;
+
+    dxSORJointBlock *blocks = memarena->AllocateArray<dxSORJointBlock>(blockCount);
+    for (unsigned int k = 0; k < blockCount; k++) {
+        for (unsigned int l = 0; l < SOR_LANES; l++) {
+            blocks[k].body1[l] = -1;
+            blocks[k].body2[l] = -1;
+        }
+        blocks[k].rowCount = 0;
+    }
+    // jointColor becomes the block and lane of each joint
+    for (unsigned int ji = 0; ji < nj; ji++) {
+        const unsigned int ofsi = mindex[ji * 2 + 0];
+        const unsigned int infom = mindex[ji * 2 + 2] - ofsi;
+        unsigned int c = jointColor[ji];
+        unsigned int k = nextBlock[c], l = nextLane[c];
+        dxSORJointBlock *block = blocks + k;
+        block->body1[l] = jb[(size_t)ofsi*2];
+        block->body2[l] = jb[(size_t)ofsi*2+1];
+        if (infom > block->rowCount) block->rowCount = infom;
+        jointColor[ji] = k * SOR_LANES + l;
+        if (++nextLane[c] == SOR_LANES || c == SOR_MAX_COLORS) {
+            nextLane[c] = 0;
+            nextBlock[c]++;
+        }
+    }
+    unsigned int rowCount = 0;
+    for (unsigned int k = 0; k < blockCount; k++) {
+        blocks[k].firstRow = rowCount;
+        rowCount += blocks[k].rowCount;
+    }
+
+    dxSORRowBlock *rows = memarena->AllocateArray<dxSORRowBlock>(rowCount);
+    memset (rows, 0, (size_t)rowCount * sizeof(dxSORRowBlock));
+    for (unsigned int r = 0; r < rowCount; r++) {
+        for (unsigned int l = 0; l < SOR_LANES; l++) {
+            rows[r].fslot[l] = -1;
+            rows[r].row[l] = -1;
+        }
+    }
+    for (unsigned int ji = 0; ji < nj; ji++) {
+        const unsigned int ofsi = mindex[ji * 2 + 0];
+        const unsigned int infom = mindex[ji * 2 + 2] - ofsi;
+        dIASSERT (infom <= 6);
+        const dxSORJointBlock *block = blocks + jointColor[ji] / SOR_LANES;
+        const unsigned int l = jointColor[ji] % SOR_LANES;
+        // the rows that limit others are solved first, as in the sequential solve
+        int slot[6];
+        unsigned int nextslot = 0;
+        for (unsigned int i = 0; i < infom; i++) if (findex[ofsi + i] == -1) slot[i] = nextslot++;
+        for (unsigned int i = 0; i < infom; i++) if (findex[ofsi + i] != -1) slot[i] = nextslot++;
+        for (unsigned int i = 0; i < infom; i++) {
+            const unsigned int index = ofsi + i;
+            dxSORRowBlock *rb = rows + block->firstRow + slot[i];
+            const dReal *J_ptr = J + (size_t)index*12;
+            const dReal *iMJ_ptr = iMJ + (size_t)index*12;
+            // iMJ is only computed for the bodies that are there
+            for (unsigned int j = 0; j < 6; j++) {
+                rb->J[j][l] = J_ptr[j];
+                rb->iMJ[j][l] = iMJ_ptr[j];
+            }
+            if (block->body2[l] != -1) {
+                for (unsigned int j = 6; j < 12; j++) {
+                    rb->J[j][l] = J_ptr[j];
+                    rb->iMJ[j][l] = iMJ_ptr[j];
+                }
+            }
+            rb->b[l] = b[index];
+            rb->Ad[l] = Ad[index];
+            rb->lo[l] = lo[index];
+            rb->hi[l] = hi[index];
+            rb->lambda[l] = lambda[index];
+            rb->fslot[l] = (findex[index] != -1) ? slot[findex[index] - (int)ofsi] : -1;
+            rb->row[l] = (int)index;
+        }
+    }
+
+    unsigned int *order = memarena->AllocateArray<unsigned int>(blockCount);
+    for (unsigned int k = 0; k < blockCount; k++) order[k] = k;
+
+    sor->m_blocks = blocks;
+    sor->m_rows = rows;
+    sor->m_rowCount = rowCount;
+    sor->m_order = order;
+    sor->m_randomSeed = (unsigned long)nj * 2654435761UL + nb;
+    sor->m_sweep = 0;
+    sor->m_sweepCount = (unsigned int)qs->num_iterations * sor->m_colorCount;
+    sor->m_sweepColor = 0;
+    sor->m_workIndex = 0;
+    sor->m_workCount = 0;
+    sor->m_stage4Releasee = NULL;
+    return sor;
+}
+
+static void SolveSORBlock (const dxSORJointBlock *block, dxSORRowBlock *rows, dReal *fc)
+{
+    // the bodies of a block are not in any other block of its colour, so their
+    // fc can be kept here while its rows are solved
+    dReal fc1[6][SOR_LANES], fc2[6][SOR_LANES];
+    for (unsigned int l = 0; l < SOR_LANES; l++) {
+        int b1 = block->body1[l], b2 = block->body2[l];
+        for (unsigned int j = 0; j < 6; j++) {
+            fc1[j][l] = (b1 != -1) ? fc[6*(size_t)(unsigned)b1 + j] : REAL(0.0);
+            fc2[j][l] = (b2 != -1) ? fc[6*(size_t)(unsigned)b2 + j] : REAL(0.0);
+        }
+    }
+
+    dxSORRowBlock *const firstrb = rows + block->firstRow;
+    dxSORRowBlock *const endrb = firstrb + block->rowCount;
+    for (dxSORRowBlock *rb = firstrb; rb != endrb; rb++) {
+        dReal delta[SOR_LANES];
+        for (unsigned int l = 0; l < SOR_LANES; l++) delta[l] = rb->b[l] - rb->lambda[l]*rb->Ad[l];
+        for (unsigned int j = 0; j < 6; j++) {
+            for (unsigned int l = 0; l < SOR_LANES; l++) {
+                delta[l] -= fc1[j][l] * rb->J[j][l] + fc2[j][l] * rb->J[j+6][l];
+            }
+        }
+
+        for (unsigned int l = 0; l < SOR_LANES; l++) {
+            // set the limits for this constraint and clamp lambda to them,
+            // as in SOR_LCP
+            dReal hi_act, lo_act;
+            int fslot = rb->fslot[l];
+            if (fslot != -1) {
+                hi_act = dFabs (rb->hi[l] * firstrb[fslot].lambda[l]);
+                lo_act = -hi_act;
+            } else {
+                hi_act = rb->hi[l];
+                lo_act = rb->lo[l];
+            }
+            dReal old_lambda = rb->lambda[l];
+            dReal new_lambda = old_lambda + delta[l];
+            if (new_lambda < lo_act) new_lambda = lo_act;
+            else if (new_lambda > hi_act) new_lambda = hi_act;
+            delta[l] = new_lambda - old_lambda;
+            rb->lambda[l] = new_lambda;
+        }
+
+        for (unsigned int j = 0; j < 6; j++) {
+            for (unsigned int l = 0; l < SOR_LANES; l++) {
+                fc1[j][l] += delta[l] * rb->iMJ[j][l];
+                fc2[j][l] += delta[l] * rb->iMJ[j+6][l];
+            }
+        }
+    }
+
+    for (unsigned int l = 0; l < SOR_LANES; l++) {
+        int b1 = block->body1[l], b2 = block->body2[l];
+        if (b1 != -1) for (unsigned int j = 0; j < 6; j++) fc[6*(size_t)(unsigned)b1 + j] = fc1[j][l];
+        if (b2 != -1) for (unsigned int j = 0; j < 6; j++) fc[6*(size_t)(unsigned)b2 + j] = fc2[j][l];
+    }
+}
+
+// sets up the next colour to be solved, and returns the number of work items for it
+static unsigned int BeginColoredSORSweep (dxQuickStepperColoredSOR *sor)
+{
+    const unsigned int color = sor->m_sweep % sor->m_colorCount;
+    const unsigned int iteration = sor->m_sweep / sor->m_colorCount;
+    sor->m_sweep++;
+
+#ifdef RANDOMLY_REORDER_CONSTRAINTS
+    if (color == 0 && (iteration & 7) == 0) {
+        for (unsigned int c = 0; c < sor->m_colorCount; c++) {
+            unsigned int *order = sor->m_order + sor->m_colorStart[c];
+            unsigned int size = sor->m_colorStart[c + 1] - sor->m_colorStart[c];
+            for (unsigned int i = 1; i < size; i++) {
+                unsigned int swapi = SORRandInt(&sor->m_randomSeed, i + 1);
+                unsigned int tmp = order[i];
+                order[i] = order[swapi];
+                order[swapi] = tmp;
+            }
+        }
+    }
+#else
+    (void)iteration;
+#endif
+
+    const unsigned int blockCount = sor->m_colorStart[color + 1] - sor->m_colorStart[color];
+    sor->m_sweepColor = color;
+    sor->m_workIndex = 0;
+    sor->m_workCount = ((int)color == sor->m_sequentialColor) ? 1 : (blockCount + SOR_BLOCKS_PER_WORK - 1) / SOR_BLOCKS_PER_WORK;
+    return sor->m_workCount;
+}
+
+// solves blocks of the current colour until there are none left.
+// blocks of one colour share no bodies, so any number of threads can do this at once.
+static void DoColoredSORWork (dxQuickStepperColoredSOR *sor)
+{
+    const unsigned int color = sor->m_sweepColor;
+    const unsigned int colorBegin = sor->m_colorStart[color];
+    const unsigned int colorEnd = sor->m_colorStart[color + 1];
+    const bool sequential = ((int)color == sor->m_sequentialColor);
+
+    unsigned int work;
+    while ((work = ThrsafeIncrementIntUpToLimit(&sor->m_workIndex, sor->m_workCount)) != sor->m_workCount) {
+        unsigned int begin = colorBegin + work * SOR_BLOCKS_PER_WORK;
+        unsigned int end = sequential ? colorEnd : dMIN(begin + SOR_BLOCKS_PER_WORK, colorEnd);
+        if (sequential) begin = colorBegin;
+        for (unsigned int i = begin; i != end; i++) {
+            SolveSORBlock (sor->m_blocks + sor->m_order[i], sor->m_rows, sor->m_fc);
+        }
+    }
+}
+
+// copies lambda back from the blocks
+static void EndColoredSOR (const dxQuickStepperColoredSOR *sor, dReal *lambda)
+{
+    const dxSORRowBlock *rb = sor->m_rows;
+    const dxSORRowBlock *const endrb = rb + sor->m_rowCount;
+    for (; rb != endrb; rb++) {
+        for (unsigned int l = 0; l < SOR_LANES; l++) {
+            if (rb->row[l] != -1) lambda[rb->row[l]] = rb->lambda[l];
+        }
+    }
+}
+
 /*extern */
 void dxQuickStepIsland(const dxStepperProcessingCallContext *callContext)
 {
@@ -1112,7 +1495,7 @@ void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext
             dxQuickStepIsland_Stage2a(stage2CallContext);
             dxQuickStepIsland_Stage2b(stage2CallContext);
             dxQuickStepIsland_Stage2c(stage2CallContext);
-            dxQuickStepIsland_Stage3(stage3CallContext);
+            dxQuickStepIsland_Stage3(stage3CallContext, NULL);
         }
         else
         {
@@ -1132,7 +1515,7 @@ void dxQuickStepIsland_Stage1(dxQuickStepperStage1CallContext *stage1CallContext
         }
     }
     else {
-        dxQuickStepIsland_Stage3(stage3CallContext);
+        dxQuickStepIsland_Stage3(stage3CallContext, NULL);
     }
 }
 
@@ -1367,12 +1750,12 @@ static
 int dxQuickStepIsland_Stage3_Callback(void *_stage3CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
 {
     dxQuickStepperStage3CallContext *stage3CallContext = (dxQuickStepperStage3CallContext *)_stage3CallContext;
-    dxQuickStepIsland_Stage3(stage3CallContext);
+    dxQuickStepIsland_Stage3(stage3CallContext, callThisReleasee);
     return 1;
 }
 
 static 
-void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext)
+void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext, dCallReleaseeID callThisReleasee)
 {
     const dxStepperProcessingCallContext *callContext = stage3CallContext->m_stepperCallContext;
     const dxQuickStepperLocalContext *localContext = stage3CallContext->m_localContext;
@@ -1386,7 +1769,6 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
     dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
     unsigned int nj = localContext->m_nj;
     unsigned int m = localContext->m_m;
-    unsigned int mfb = localContext->m_mfb;
     const unsigned int *mindex = localContext->m_mindex;
     const int *findex = localContext->m_findex;
     dReal *J = localContext->m_J;
@@ -1395,7 +1777,6 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
     dReal *hi = localContext->m_hi;
     int *jb = localContext->m_jb;
     dReal *rhs = localContext->m_rhs;
-    dReal *Jcopy = localContext->m_Jcopy;
 
     dxWorld *world = callContext->m_world;
     dxBody * const *body = callContext->m_islandBodiesStart;
@@ -1406,7 +1787,11 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
         dReal *lambda = memarena->AllocateArray<dReal>(m);
 
 #ifdef WARM_STARTING
-        {
+        const int warm_starting = 1;
+#else
+        const int warm_starting = world->qs.warm_starting;
+#endif
+        if (warm_starting) {
             dReal *lambdscurr = lambda;
             const dJointWithInfo1 *jicurr = jointinfos;
             const dJointWithInfo1 *const jiend = jicurr + nj;
@@ -1416,22 +1801,131 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
                 lambdscurr += infom;
             }
         }
-#endif
 
         dReal *cforce = memarena->AllocateArray<dReal>((size_t)nb*6);
 
-        BEGIN_STATE_SAVE(memarena, lcpstate) {
-            IFTIMING (dTimerNow ("solving LCP problem"));
+        // Stage4 releases the memory of the LCP solution, so its context goes before that
+        dxQuickStepperStage4CallContext *stage4CallContext = (dxQuickStepperStage4CallContext *)memarena->AllocateBlock(sizeof(dxQuickStepperStage4CallContext));
+        void *lcpstate = memarena->SaveState();
+
+        const unsigned allowedThreads = callContext->m_stepperAllowedThreads;
+        dxQuickStepperColoredSOR *coloredSOR = NULL;
+
+        IFTIMING (dTimerNow ("solving LCP problem"));
+        if (world->qs.deterministic || (allowedThreads > 1 && nj >= SOR_COLORED_MIN_JOINTS)) {
+            dReal *iMJ, *Ad;
+            SOR_LCP_Prepare (memarena,m,nb,J,jb,body,invI,lambda,cforce,rhs,cfm,&world->qs,&iMJ,&Ad);
+            coloredSOR = BuildColoredSOR (memarena,world,allowedThreads,nj,mindex,nb,J,iMJ,jb,rhs,Ad,lo,hi,findex,lambda,cforce,&world->qs);
+        }
+        else {
             // solve the LCP problem and get lambda and invM*constraint_force
             SOR_LCP (memarena,m,nb,J,jb,body,invI,lambda,cforce,rhs,lo,hi,cfm,findex,&world->qs);
+        }
+
+        stage4CallContext->Initialize(callContext, localContext, lambda, cforce, lcpstate, coloredSOR);
+
+        if (coloredSOR != NULL) {
+            if (allowedThreads > 1 && callThisReleasee != NULL && nj >= SOR_COLORED_MIN_JOINTS) {
+                // every colour of every iteration is a sweep of its own, each posted
+                // by the one before it. Stage4 runs after the last one.
+                world->AlterThreadedCallDependenciesCount(callThisReleasee, 1);
+                world->PostThreadedCall(NULL, &coloredSOR->m_stage4Releasee, 1, callThisReleasee, 
+                    NULL, &dxQuickStepIsland_Stage4_Callback, stage4CallContext, 0, "QuickStepIsland Stage4");
+                world->PostThreadedCall(NULL, NULL, 0, coloredSOR->m_stage4Releasee, 
+                    NULL, &dxQuickStepIsland_SORSweep_Callback, coloredSOR, 0, "QuickStepIsland SOR Sweep");
+                return;
+            }
+
+            while (coloredSOR->m_sweep != coloredSOR->m_sweepCount) {
+                BeginColoredSORSweep(coloredSOR);
+                DoColoredSORWork(coloredSOR);
+            }
+        }
 
-        } END_STATE_SAVE(memarena, lcpstate);
+        dxQuickStepIsland_Stage4(stage4CallContext);
+    }
+    else {
+        dxQuickStepperStage4CallContext stage4CallContext;
+        stage4CallContext.Initialize(callContext, localContext, NULL, NULL, NULL, NULL);
+        dxQuickStepIsland_Stage4(&stage4CallContext);
+    }
+}
+
+static 
+int dxQuickStepIsland_SORSweep_Callback(void *_coloredSOR, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    dxQuickStepperColoredSOR *coloredSOR = (dxQuickStepperColoredSOR *)_coloredSOR;
+
+    if (coloredSOR->m_sweep != coloredSOR->m_sweepCount) {
+        dxWorld *world = coloredSOR->m_world;
+        const unsigned workCount = BeginColoredSORSweep(coloredSOR);
+        const unsigned sweepThreads = dMIN(coloredSOR->m_allowedThreads, workCount);
+
+        // the next sweep takes the place of this one among the dependencies of Stage4
+        world->AlterThreadedCallDependenciesCount(coloredSOR->m_stage4Releasee, 1);
+        dCallReleaseeID nextSweepReleasee;
+        world->PostThreadedCall(NULL, &nextSweepReleasee, sweepThreads, coloredSOR->m_stage4Releasee, 
+            NULL, &dxQuickStepIsland_SORSweep_Callback, coloredSOR, 0, "QuickStepIsland SOR Sweep");
+
+        world->PostThreadedCallsGroup(NULL, sweepThreads, nextSweepReleasee, &dxQuickStepIsland_SORWork_Callback, coloredSOR, "QuickStepIsland SOR Work");
+    }
+
+    return 1;
+}
+
+static 
+int dxQuickStepIsland_SORWork_Callback(void *_coloredSOR, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    dxQuickStepperColoredSOR *coloredSOR = (dxQuickStepperColoredSOR *)_coloredSOR;
+    DoColoredSORWork(coloredSOR);
+    return 1;
+}
+
+static 
+int dxQuickStepIsland_Stage4_Callback(void *_stage4CallContext, dcallindex_t callInstanceIndex, dCallReleaseeID callThisReleasee)
+{
+    dxQuickStepperStage4CallContext *stage4CallContext = (dxQuickStepperStage4CallContext *)_stage4CallContext;
+    dxQuickStepIsland_Stage4(stage4CallContext);
+    return 1;
+}
+
+static 
+void dxQuickStepIsland_Stage4(dxQuickStepperStage4CallContext *stage4CallContext)
+{
+    const dxStepperProcessingCallContext *callContext = stage4CallContext->m_stepperCallContext;
+    const dxQuickStepperLocalContext *localContext = stage4CallContext->m_localContext;
+
+    dxWorldProcessMemArena *memarena = callContext->m_stepperArena;
+
+    dReal *invI = localContext->m_invI;
+    dJointWithInfo1 *jointinfos = localContext->m_jointinfos;
+    unsigned int nj = localContext->m_nj;
+    unsigned int m = localContext->m_m;
+    unsigned int mfb = localContext->m_mfb;
+    dReal *Jcopy = localContext->m_Jcopy;
+
+    dxWorld *world = callContext->m_world;
+    dxBody * const *body = callContext->m_islandBodiesStart;
+    unsigned int nb = callContext->m_islandBodiesCount;
+
+    if (m > 0) {
+        dReal *lambda = stage4CallContext->m_lambda;
+        dReal *cforce = stage4CallContext->m_cforce;
+
+        if (stage4CallContext->m_coloredSOR != NULL) {
+            EndColoredSOR (stage4CallContext->m_coloredSOR, lambda);
+        }
+        memarena->RestoreState(stage4CallContext->m_lcpMemArenaState);
 
 #ifdef WARM_STARTING
-        {
+        const int warm_starting = 1;
+#else
+        const int warm_starting = world->qs.warm_starting;
+#endif
+        if (warm_starting) {
             // save lambda for the next iteration
-            //@@@ note that this doesn't work for contact joints yet, as they are
-            // recreated every iteration
+            // contact joints are recreated every iteration, so their lambda
+            // has to be carried over by the caller with dJointGetLambda/dJointSetLambda
             const dReal *lambdacurr = lambda;
             const dJointWithInfo1 *jicurr = jointinfos;
             const dJointWithInfo1 *const jiend = jicurr + nj;
@@ -1441,7 +1935,6 @@ void dxQuickStepIsland_Stage3(dxQuickStepperStage3CallContext *stage3CallContext
                 lambdacurr += infom;
             }
         }
-#endif
 
         // note that the SOR method overwrites rhs and J at this point, so
         // they should not be used again.
@@ -1591,6 +2084,22 @@ static size_t EstimateSOR_LCPMemoryRequirements(unsigned int m)
     return res;
 }
 
+static size_t EstimateColoredSOR_LCPMemoryRequirements(unsigned int m, unsigned int nj, unsigned int nb)
+{
+    // there are at most as many row blocks as rows, and at most one block
+    // more than a full one per colour
+    unsigned int maxBlocks = nj + SOR_MAX_COLORS + 1;
+    size_t res = dEFFICIENT_SIZE(sizeof(dReal) * 12 * (size_t)m); // for iMJ
+    res += dEFFICIENT_SIZE(sizeof(dReal) * (size_t)m); // for Ad
+    res += dEFFICIENT_SIZE(sizeof(dxQuickStepperColoredSOR)); // for dxQuickStepperColoredSOR
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * (size_t)nj); // for jointColor
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * (size_t)nb); // for bodyColors
+    res += dEFFICIENT_SIZE(sizeof(dxSORJointBlock) * (size_t)maxBlocks); // for blocks
+    res += dEFFICIENT_SIZE(sizeof(dxSORRowBlock) * (size_t)m); // for rows
+    res += dEFFICIENT_SIZE(sizeof(unsigned int) * (size_t)maxBlocks); // for order
+    return res;
+}
+
 /*extern */
 size_t dxEstimateQuickStepMemoryRequirements (
     dxBody * const *body, unsigned int nb, dxJoint * const *_joint, unsigned int _nj)
@@ -1640,8 +2149,10 @@ size_t dxEstimateQuickStepMemoryRequirements (
 
                 size_t sub2_res2 = dEFFICIENT_SIZE(sizeof(dReal) * m); // for lambda
                 sub2_res2 += dEFFICIENT_SIZE(sizeof(dReal) * 6 * nb); // for cforce
+                sub2_res2 += dEFFICIENT_SIZE(sizeof(dxQuickStepperStage4CallContext)); // for dxQuickStepperStage4CallContext
                 {
-                    size_t sub3_res1 = EstimateSOR_LCPMemoryRequirements(m); // for SOR_LCP
+                    size_t sub3_res1 = dMAX(EstimateSOR_LCPMemoryRequirements(m), // for SOR_LCP
+                        EstimateColoredSOR_LCPMemoryRequirements(m, nj, nb)); // or for the coloured SOR
 
                     size_t sub3_res2 = 0;
 #ifdef CHECK_VELOCITY_OBEYS_CONSTRAINT
@@ -1679,7 +2190,8 @@ unsigned dxEstimateQuickStepMaxCallCount(
     unsigned activeThreadCount, unsigned allowedThreadCount)
 {
     unsigned result = 1 // dxQuickStepIsland itself
-        + (2 * allowedThreadCount + 2) // (dxQuickStepIsland_Stage2a + dxQuickStepIsland_Stage2b) * allowedThreadCount + 2 * dxStepIsland_Stage2?_Sync
+        + dMAX(2 * allowedThreadCount + 2, // (dxQuickStepIsland_Stage2a + dxQuickStepIsland_Stage2b) * allowedThreadCount + 2 * dxStepIsland_Stage2?_Sync
+            allowedThreadCount + 3) // or dxQuickStepIsland_SORWork * allowedThreadCount + 2 * dxQuickStepIsland_SORSweep + dxQuickStepIsland_Stage4
         + 1; // dxStepIsland_Stage3
     return result;
 }
@@ -18,9 +18,13 @@ subject to the following restrictions:
 
 
 // choose threading providers:
-//#if BT_USE_TBB
+#if BT_USE_TBB
 #define USE_TBB 1     // use Intel Threading Building Blocks for thread management
-//#endif
+#endif
+
+#ifndef USE_STD_THREAD
+#define USE_STD_THREAD 1     // use the built in pool of std::threads, when none of the others is compiled in
+#endif
 
 #if BT_USE_PPL
 #define USE_PPL 1     // use Microsoft Parallel Patterns Library (installed with Visual Studio 2010 and later)
@@ -58,16 +62,231 @@ tbb::task_scheduler_init* gTaskSchedulerInit;
 
 #endif // #if USE_TBB
 
+
+#if USE_STD_THREAD
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <vector>
+
+///
+/// StdThreadPool -- a work stealing pool of std::threads, for builds without TBB, PPL or OpenMP.
+///
+///  parallelFor splits the loop into grains and deals them out evenly to one queue per thread, the calling
+///  thread included. Each thread takes grains from the front of its own queue, and once that is empty
+///  steals them from the back of the others, so a thread that drew expensive grains (eg: a big island)
+///  is helped by the rest. The call returns when every thread has run out of grains.
+///
+///  Only one loop runs on the pool at a time: a loop started while another one runs (from another world
+///  stepping on another thread, or from inside a grain) is run by its caller alone.
+///
+class StdThreadPool
+{
+public:
+    typedef void (*RangeFunc)( const void* body, int iBegin, int iEnd );
+
+    StdThreadPool() : mNumThreads( 1 ), mBusy( false ), mQuit( false ), mGeneration( 0 ), mActive( 0 )
+    {
+        mQueues = new Queue[ 1 ];
+    }
+
+    ~StdThreadPool()
+    {
+        stop();
+        delete [] mQueues;
+    }
+
+    int getNumThreads() const { return mNumThreads; }
+
+    /// counts the calling thread, 1 stops the workers
+    void setNumThreads( int numThreads )
+    {
+        numThreads = (std::max)( 1, numThreads );
+        acquire();
+        if ( numThreads != mNumThreads )
+        {
+            stop();
+            delete [] mQueues;
+            mQueues = new Queue[ numThreads ];
+            mNumThreads = numThreads;
+            mQuit = false;
+            for ( int i = 1; i < numThreads; ++i )
+            {
+                mWorkers.push_back( std::thread( &StdThreadPool::workerMain, this, i, unsigned( mGeneration ) ) );
+            }
+        }
+        mBusy = false;
+    }
+
+    /// returns false, having run nothing, if the pool has no workers, the loop is a single grain, or another loop is running
+    bool run( int iBegin, int iEnd, int grainSize, RangeFunc func, const void* body )
+    {
+        grainSize = (std::max)( 1, grainSize );
+        int numGrains = ( iEnd - iBegin + grainSize - 1 ) / grainSize;
+        if ( mNumThreads < 2 || numGrains < 2 )
+        {
+            return false;
+        }
+        bool expected = false;
+        if ( !mBusy.compare_exchange_strong( expected, true ) )
+        {
+            return false;
+        }
+        mFunc = func;
+        mBody = body;
+        mBegin = iBegin;
+        mEnd = iEnd;
+        mGrainSize = grainSize;
+        for ( int i = 0; i < mNumThreads; ++i )
+        {
+            mQueues[ i ].next = int( (long long)numGrains * i / mNumThreads );
+            mQueues[ i ].end = int( (long long)numGrains * ( i + 1 ) / mNumThreads );
+        }
+        mActive = mNumThreads - 1;
+        {
+            std::lock_guard<std::mutex> lock( mWakeMutex );
+            mGeneration++;
+        }
+        mWake.notify_all();
+        work( 0 );
+        // the job lives on the caller's stack, wait until no worker can touch it
+        while ( mActive > 0 )
+        {
+            std::this_thread::yield();
+        }
+        mBusy = false;
+        return true;
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        int next, end;    // the grains left, taken from the front by the owner and from the back by thieves
+    };
+
+    // spins until no loop runs, so the pool can be changed
+    void acquire()
+    {
+        bool expected = false;
+        while ( !mBusy.compare_exchange_weak( expected, true ) )
+        {
+            expected = false;
+            std::this_thread::yield();
+        }
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mWakeMutex );
+            mQuit = true;
+        }
+        mWake.notify_all();
+        for ( size_t i = 0; i < mWorkers.size(); ++i )
+        {
+            mWorkers[ i ].join();
+        }
+        mWorkers.clear();
+    }
+
+    bool take( int queue, bool front, int& grain )
+    {
+        Queue& q = mQueues[ queue ];
+        std::lock_guard<std::mutex> lock( q.mutex );
+        if ( q.next >= q.end )
+        {
+            return false;
+        }
+        grain = front ? q.next++ : --q.end;
+        return true;
+    }
+
+    void work( int self )
+    {
+        for ( ;; )
+        {
+            int grain;
+            bool found = take( self, true, grain );
+            for ( int i = 1; !found && i < mNumThreads; ++i )
+            {
+                found = take( ( self + i ) % mNumThreads, false, grain );
+            }
+            if ( !found )
+            {
+                return;
+            }
+            int iBegin = mBegin + grain * mGrainSize;
+            mFunc( mBody, iBegin, (std::min)( iBegin + mGrainSize, mEnd ) );
+        }
+    }
+
+    // seen is the loop the pool was at when the worker was started, it waits for the next one
+    void workerMain( int self, unsigned seen )
+    {
+        for ( ;; )
+        {
+            // steps run loops back to back, so spin a little before sleeping
+            for ( int spin = 0; spin < 1000 && mGeneration == seen && !mQuit; ++spin )
+            {
+                std::this_thread::yield();
+            }
+            {
+                std::unique_lock<std::mutex> lock( mWakeMutex );
+                while ( mGeneration == seen && !mQuit )
+                {
+                    mWake.wait( lock );
+                }
+                if ( mQuit )
+                {
+                    return;
+                }
+                seen = mGeneration;
+            }
+            work( self );
+            mActive--;
+        }
+    }
+
+    int mNumThreads;
+    Queue* mQueues;
+    std::vector<std::thread> mWorkers;
+    std::atomic<bool> mBusy;
+    std::atomic<bool> mQuit;    // set under mWakeMutex
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    std::atomic<unsigned> mGeneration;
+    std::atomic<int> mActive;    // workers that have not finished the current loop
+
+    RangeFunc mFunc;
+    const void* mBody;
+    int mBegin, mEnd, mGrainSize;
+};
+
+// stopped when the program exits or the plugin is unloaded
+static StdThreadPool gStdThreadPool;
+
+#endif // #if USE_STD_THREAD
+
 enum TaskApi
 {
     apiNone,
     apiOpenMP,
     apiTbb,
     apiPpl,
+    apiStdThread,
 };
 
 
+#if USE_TBB
 static TaskApi gTaskApi = apiTbb;
+#elif USE_STD_THREAD
+static TaskApi gTaskApi = apiStdThread;
+#else
+static TaskApi gTaskApi = apiNone;
+#endif
 
 static void setTaskApi( TaskApi api )
 {
@@ -91,6 +310,13 @@ static void setTaskApi( TaskApi api )
         gTaskApi = api;
         return;
     }
+#endif
+#if USE_STD_THREAD
+    if ( api == apiStdThread )
+    {
+        gTaskApi = api;
+        return;
+    }
 #endif
     // no compile time support for selected API, fallback to "none"
     gTaskApi = apiNone;
@@ -104,6 +330,7 @@ static const char* getTaskApiName( TaskApi api )
     case apiOpenMP: return "OpenMP";
     case apiTbb: return "TBB";
     case apiPpl: return "PPL";
+    case apiStdThread: return "std::thread";
     default: return "unknown";
     }
 }
@@ -116,6 +343,8 @@ static int getMaxNumThreads()
     return concurrency::GetProcessorCount();
 #elif USE_TBB
     return tbb::task_scheduler_init::default_num_threads();
+#elif USE_STD_THREAD
+    return (std::max)( 1u, std::thread::hardware_concurrency() );
 #endif
     return 1;
 }
@@ -149,11 +378,18 @@ static int setNumThreads( int numThreads )
     }
     gTaskSchedulerInit = new tbb::task_scheduler_init( numThreads );
 #endif
+
+#if USE_STD_THREAD
+    gStdThreadPool.setNumThreads( numThreads );
+#endif
     return numThreads;
 }
 
 static void initTaskScheduler()
 {
+#if USE_STD_THREAD
+    setTaskApi( apiStdThread );
+#endif
 #if USE_PPL
     setTaskApi( apiPpl );
 #endif
@@ -215,6 +451,21 @@ struct PplBodyAdapter
 };
 #endif // #if USE_PPL
 
+#if USE_STD_THREAD
+///
+/// StdThreadBodyAdapter -- Calls the "forLoop(int iBegin, int iEnd) const" function
+///  of a body object through the untyped function pointer the std::thread pool takes.
+///
+template <class TBody>
+struct StdThreadBodyAdapter
+{
+    static void forLoop( const void* body, int iBegin, int iEnd )
+    {
+        static_cast<const TBody*>( body )->forLoop( iBegin, iEnd );
+    }
+};
+#endif // #if USE_STD_THREAD
+
 
 ///
 /// parallelFor -- interface for submitting work expressed as a for loop to the worker threads
@@ -266,6 +517,16 @@ void parallelFor( int iBegin, int iEnd, int grainSize, const TBody& body )
     }
 #endif // #if USE_TBB
 
+#if USE_STD_THREAD
+    if ( gTaskApi == apiStdThread )
+    {
+        if ( gStdThreadPool.run( iBegin, iEnd, grainSize, &StdThreadBodyAdapter<TBody>::forLoop, &body ) )
+        {
+            return;
+        }
+    }
+#endif // #if USE_STD_THREAD
+
     {
         // run on main thread
         body.forLoop( iBegin, iEnd );
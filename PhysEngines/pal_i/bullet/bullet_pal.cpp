@@ -2,6 +2,8 @@
 
 #include <limits>
 #include <cfloat>
+#include <cstddef>
+#include <algorithm>
 #include "bullet_pal.h"
 #include "bullet_palVehicle.h"
 #include "bullet_palCharacter.h"
@@ -11,8 +13,10 @@
 //#include <iostream>
 
 #include <pal/pal.inl>
+#include <pal/palStateBuffer.h>
 
 #include <BulletCollision/CollisionShapes/btShapeHull.h>
+#include <LinearMath/btConvexHullComputer.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
 #include <BulletCollision/CollisionDispatch/btInternalEdgeUtility.h>
 #include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
@@ -55,6 +59,7 @@ FACTORY_CLASS_IMPLEMENTATION(palBulletOrientatedTerrainPlane);
 FACTORY_CLASS_IMPLEMENTATION(palBulletTerrainPlane);
 FACTORY_CLASS_IMPLEMENTATION(palBulletTerrainMesh);
 FACTORY_CLASS_IMPLEMENTATION(palBulletTerrainHeightmap);
+FACTORY_CLASS_IMPLEMENTATION(palBulletStaticInstanceSet);
 
 FACTORY_CLASS_IMPLEMENTATION(palBulletSphericalLink);
 FACTORY_CLASS_IMPLEMENTATION(palBulletRevoluteLink);
@@ -185,6 +190,13 @@ private:
 
 static bool g_bEnableCustomMaterials = false;
 
+/// the material at a contact, for a static instance set this is the material of the instance that was hit
+static palMaterial* GetContactMaterial(palBodyBase* body, int index) {
+	if (body->m_Type == PAL_STATIC_INSTANCE_SET)
+		return dynamic_cast<palStaticInstanceSet*>(body)->GetInstanceMaterial(index);
+	return body->GetMaterial();
+}
+
 #if BT_BULLET_VERSION < 280
 static bool CustomMaterialCombinerCallback(btManifoldPoint& mp, const btCollisionObject* colObj0,int partId0,int index0,const btCollisionObject* colObj1,int partId1,int index1)
 #else
@@ -207,8 +219,22 @@ static bool CustomMaterialCombinerCallback(btManifoldPoint& mp, const btCollisio
 #endif
 	if (body0 != NULL && body1 != NULL)
 	{
-		palMaterial* mat0 = body0->GetMaterial();
-		palMaterial* mat1 = body1->GetMaterial();
+		palMaterial* mat0 = GetContactMaterial(body0, index0);
+		palMaterial* mat1 = GetContactMaterial(body1, index1);
+		palMaterials* materials = static_cast<palPhysics*>(body0->GetParent())->GetMaterials();
+		if (mat0 == NULL || mat1 == NULL || materials == NULL)
+			return true;
+		const palMaterialPair* matPair = materials->GetInteraction(mat0->GetId(), mat1->GetId());
+		if (matPair != NULL && !matPair->HasCallback())
+		{
+			mp.m_combinedFriction = matPair->m_fStatic;
+			mp.m_combinedRestitution = matPair->m_fRestitution;
+#if BT_BULLET_VERSION >= 280
+			mp.m_combinedRollingFriction = matPair->m_fKinetic;
+#endif
+			return true;
+		}
+
 		palMaterialDesc matResult;
 		matResult.m_fStatic = mp.m_combinedFriction;
 #if BT_BULLET_VERSION >= 280
@@ -219,7 +245,11 @@ static bool CustomMaterialCombinerCallback(btManifoldPoint& mp, const btCollisio
 		convertManifoldPtToContactPoint(mp, contactResult);
 		contactResult.m_pBody1 = body0;
 		contactResult.m_pBody2 = body1;
-		if (static_cast<palPhysics*>(body0->GetParent())->GetMaterials()->HandleCustomInteraction(mat0, mat1, matResult, contactResult, true))
+		if (body0->m_Type == PAL_STATIC_INSTANCE_SET)
+			contactResult.m_nInstance1 = index0;
+		if (body1->m_Type == PAL_STATIC_INSTANCE_SET)
+			contactResult.m_nInstance2 = index1;
+		if (materials->HandleCustomInteraction(mat0, mat1, matResult, contactResult, true))
 		{
 			convertContactPointToManifoldPt(contactResult, mp);
 			mp.m_combinedFriction = matResult.m_fStatic;
@@ -292,24 +322,25 @@ static void AddMeshToTrimesh(btTriangleIndexVertexArray *trimesh, const Float *p
 }
 
 ////////////////////////////////////////////////////
-class palBulletAction : public btActionInterface {
+// The one bullet action, it runs all the pal actions in each substep through palPhysics::CallActions
+class palBulletActionCaller : public btActionInterface {
 public:
-	palBulletAction(palAction& action)
-	: mAction(action)
+	palBulletActionCaller(palBulletPhysics& physics)
+	: mPhysics(physics)
 	{
 	}
 
-	virtual ~palBulletAction() {}
+	virtual ~palBulletActionCaller() {}
 
 	// Need to call and pass the pal debug drawer to the action.
 	virtual void debugDraw(btIDebugDraw *debugDrawer) {}
 private:
 	virtual void updateAction(btCollisionWorld *collisionWorld, btScalar deltaTimeStep)
 	{
-		mAction(deltaTimeStep);
+		mPhysics.CallActions(deltaTimeStep);
 	}
 
-	palAction& mAction;
+	palBulletPhysics& mPhysics;
 };
 
 ////////////////////////////////////////////////////
@@ -463,6 +494,10 @@ void palBulletPhysics::RayCast(Float x, Float y, Float z,
 }
 
 void palBulletPhysics::AddRigidBody(palBulletBodyBase* body) {
+	if (m_bBatching && body != nullptr && body->m_pbtBody != nullptr) {
+		m_BatchBodies.push_back(body);
+		return;
+	}
 	if (body != nullptr && body->m_pbtBody != nullptr) {
 		//reset the group to get rid of the default groups.
 		palGroup group = body->GetGroup();
@@ -471,11 +506,43 @@ void palBulletPhysics::AddRigidBody(palBulletBodyBase* body) {
 }
 
 void palBulletPhysics::RemoveRigidBody(palBulletBodyBase* body) {
+	if (m_bBatching) {
+		PAL_VECTOR<palBulletBodyBase*>::iterator it = std::find(m_BatchBodies.begin(), m_BatchBodies.end(), body);
+		if (it != m_BatchBodies.end()) {
+			// never made it into the world
+			m_BatchBodies.erase(it);
+			return;
+		}
+	}
 	if (body != nullptr && body->m_pbtBody != nullptr) {
 		m_dynamicsWorld->removeRigidBody(body->m_pbtBody);
 	}
 }
 
+void palBulletPhysics::BeginBatch() {
+	m_bBatching = true;
+}
+
+void palBulletPhysics::EndBatch() {
+	m_bBatching = false;
+	if (m_BatchBodies.empty())
+		return;
+	for (size_t i = 0; i < m_BatchBodies.size(); ++i) {
+		AddRigidBody(m_BatchBodies[i]);
+	}
+	// Each insertion only adjusts the dbvt locally, so after a large batch rebuild the trees once.
+	btDbvtBroadphase* dbvt = dynamic_cast<btDbvtBroadphase*>(m_dynamicsWorld->getBroadphase());
+	if (dbvt != NULL) {
+		for (int i = 0; i < 2; ++i) {
+			btDbvt& tree = dbvt->m_sets[i];
+			if (tree.m_leaves > 1 && m_BatchBodies.size() * 4 >= size_t(tree.m_leaves)) {
+				tree.optimizeTopDown();
+			}
+		}
+	}
+	m_BatchBodies.clear();
+}
+
 void palBulletPhysics::ClearBroadPhaseCachePairs(palBulletBodyBase *body) {
 	btBroadphaseProxy *proxy = body->BulletGetRigidBody()->getBroadphaseProxy();
 	if (proxy != nullptr) {
@@ -485,46 +552,158 @@ void palBulletPhysics::ClearBroadPhaseCachePairs(palBulletBodyBase *body) {
 	}
 }
 
-void palBulletPhysics::AddBulletConstraint(btTypedConstraint* constraint, bool disableCollisionsBetweenLinkedBodies)
-{
-	if (constraint != NULL) {
-		m_dynamicsWorld->addConstraint(constraint, disableCollisionsBetweenLinkedBodies);
-	}
+static void AddHullPoint(btConvexHullShape* shape, const btVector3& point) {
+#if BT_BULLET_VERSION < 282
+	shape->addPoint(point);
+#else
+	shape->addPoint(point, false);
+#endif
 }
 
-void palBulletPhysics::RemoveBulletConstraint(btTypedConstraint* constraint)
-{
-	if (constraint != NULL && constraint->getUserConstraintId() != INT_MIN) {
-		m_dynamicsWorld->removeConstraint(constraint);
-		constraint->setUserConstraintId(INT_MIN);
+static btConvexHullShape* BuildConvexHull(const Float *pVertices, unsigned int nVertices, unsigned int maxVertices, bool polyhedralFeatures) {
+	// The exact hull drops the interior points (scanned meshes have plenty) without changing the shape.
+	// The computer reads the PAL points in place (it takes float or double coordinates with a stride).
+	btConvexHullComputer computer;
+	btAlignedObjectArray<btVector3> points;
+	const btAlignedObjectArray<btVector3>* hull = &computer.vertices;
+	if (nVertices > 4) {
+		computer.compute(pVertices, int(3 * sizeof(Float)), int(nVertices), btScalar(0.0), btScalar(0.0));
+	}
+	if (computer.vertices.size() < 4) {
+		points.resize(nVertices);
+		for (unsigned int i = 0; i < nVertices; ++i) {
+			points[i].setValue(btScalar(pVertices[3*i + 0]), btScalar(pVertices[3*i + 1]), btScalar(pVertices[3*i + 2]));
+		}
+		hull = &points;
+	}
+
+	btConvexHullShape* shape = new btConvexHullShape();
+	int count = hull->size();
+	if (maxVertices > 0 && count > int(maxVertices)) {
+		// Keep the extreme point in each of maxVertices directions spread evenly over the sphere (golden spiral).
+		// This is the same idea as btShapeHull, but with a vertex budget.
+		PAL_VECTOR<bool> used(count, false);
+		for (unsigned int k = 0; k < maxVertices; ++k) {
+			btScalar z = btScalar(1.0) - (btScalar(2.0) * k + btScalar(1.0)) / btScalar(maxVertices);
+			btScalar r = btSqrt(btMax(btScalar(0.0), btScalar(1.0) - z * z));
+			btScalar phi = btScalar(2.39996322972865332) * k;
+			btVector3 dir(r * btCos(phi), r * btSin(phi), z);
+			int best = 0;
+			btScalar bestDot = dir.dot((*hull)[0]);
+			for (int i = 1; i < count; ++i) {
+				btScalar d = dir.dot((*hull)[i]);
+				if (d > bestDot) {
+					bestDot = d;
+					best = i;
+				}
+			}
+			if (!used[best]) {
+				used[best] = true;
+				AddHullPoint(shape, (*hull)[best]);
+			}
+		}
+	} else {
+		for (int i = 0; i < count; ++i) {
+			AddHullPoint(shape, (*hull)[i]);
+		}
 	}
+#if BT_BULLET_VERSION > 281
+	shape->recalcLocalAabb();
+#endif
+#if BT_BULLET_VERSION >= 280
+	if (polyhedralFeatures) {
+		shape->initializePolyhedralFeatures();
+	}
+#endif
+	return shape;
 }
 
-void palBulletPhysics::AddAction(palAction *action) {
-	if (action != NULL) {
-		palBulletAction* bulletAction = new palBulletAction(*action);
-		m_BulletActions[action] = bulletAction;
-		m_dynamicsWorld->addAction(bulletAction);
+btConvexHullShape* palBulletPhysics::AcquireConvexHull(const Float *pVertices, unsigned int nVertices) {
+	// FNV-1a of the raw points
+	unsigned long key = 2166136261UL;
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(pVertices);
+	for (size_t i = 0; i < nVertices * 3 * sizeof(Float); ++i) {
+		key = (key ^ bytes[i]) * 16777619UL;
 	}
+
+	PAL_VECTOR<SharedHull>& hulls = m_SharedHulls[key];
+	for (size_t i = 0; i < hulls.size(); ++i) {
+		if (hulls[i].m_Vertices.size() == nVertices * 3
+				&& std::equal(hulls[i].m_Vertices.begin(), hulls[i].m_Vertices.end(), pVertices)) {
+			hulls[i].m_nRefs++;
+			return hulls[i].m_pShape;
+		}
+	}
+
+	SharedHull hull;
+	hull.m_pShape = BuildConvexHull(pVertices, nVertices, m_nHullMaxVertices, m_bHullPolyhedralFeatures);
+	hull.m_Vertices.assign(pVertices, pVertices + nVertices * 3);
+	hull.m_nRefs = 1;
+	hulls.push_back(hull);
+	m_SharedHullKeys[hull.m_pShape] = key;
+	return hull.m_pShape;
 }
 
-void palBulletPhysics::RemoveAction(palAction *action) {
-	if (action != NULL) {
-		PAL_MAP<palAction*, btActionInterface*>::iterator item = m_BulletActions.find(action);
-		if (item != m_BulletActions.end()) {
-			btActionInterface* bulletAction = item->second;
-			if (bulletAction != NULL) {
-				m_dynamicsWorld->removeAction(bulletAction);
-				delete bulletAction;
-				bulletAction = NULL;
+void palBulletPhysics::ReleaseConvexHull(btConvexHullShape* shape) {
+	PAL_MAP<btConvexHullShape*, unsigned long>::iterator k = m_SharedHullKeys.find(shape);
+	if (k == m_SharedHullKeys.end()) {
+		return;
+	}
+	PAL_MAP<unsigned long, PAL_VECTOR<SharedHull> >::iterator h = m_SharedHulls.find(k->second);
+	PAL_VECTOR<SharedHull>& hulls = h->second;
+	for (size_t i = 0; i < hulls.size(); ++i) {
+		if (hulls[i].m_pShape == shape) {
+			if (--hulls[i].m_nRefs == 0) {
+				delete shape;
+				hulls.erase(hulls.begin() + i);
+				m_SharedHullKeys.erase(k);
+				if (hulls.empty()) {
+					m_SharedHulls.erase(h);
+				}
 			}
-			m_BulletActions.erase(item);
+			return;
+		}
+	}
+}
+
+void palBulletPhysics::QueueCompoundTree(btCompoundShape* compound) {
+	if (std::find(m_CompoundTreeQueue.begin(), m_CompoundTreeQueue.end(), compound) == m_CompoundTreeQueue.end()) {
+		m_CompoundTreeQueue.push_back(compound);
+	}
+}
+
+void palBulletPhysics::DequeueCompoundTree(btCompoundShape* compound) {
+	PAL_VECTOR<btCompoundShape*>::iterator it = std::find(m_CompoundTreeQueue.begin(), m_CompoundTreeQueue.end(), compound);
+	if (it != m_CompoundTreeQueue.end()) {
+		m_CompoundTreeQueue.erase(it);
+	}
+}
+
+void palBulletPhysics::BuildCompoundTrees() {
+	for (size_t i = 0; i < m_CompoundTreeQueue.size(); ++i) {
+#if BT_BULLET_VERSION >= 282
+		btCompoundShape* compound = m_CompoundTreeQueue[i];
+		if (compound->getDynamicAabbTree() == NULL) {
+			compound->createAabbTreeFromChildren();
 		}
+#endif
+	}
+	m_CompoundTreeQueue.clear();
+}
+
+void palBulletPhysics::AddBulletConstraint(btTypedConstraint* constraint, bool disableCollisionsBetweenLinkedBodies)
+{
+	if (constraint != NULL) {
+		m_dynamicsWorld->addConstraint(constraint, disableCollisionsBetweenLinkedBodies);
 	}
 }
 
-void palBulletPhysics::CallActions(Float timestep) {
-	// Do nothing here.  The dynamics world does this stuff.
+void palBulletPhysics::RemoveBulletConstraint(btTypedConstraint* constraint)
+{
+	if (constraint != NULL && constraint->getUserConstraintId() != INT_MIN) {
+		m_dynamicsWorld->removeConstraint(constraint);
+		constraint->setUserConstraintId(INT_MIN);
+	}
 }
 
 
@@ -620,6 +799,11 @@ palBulletPhysics::palBulletPhysics()
 , m_overlapCallback(NULL)
 , m_ghostPairCallback(NULL)
 , m_pbtDebugDraw(NULL)
+, m_pActionCaller(NULL)
+, m_nHullMaxVertices(0)
+, m_bHullPolyhedralFeatures(false)
+, m_nCompoundTreeThreshold(32)
+, m_bBatching(false)
 {}
 
 const char* palBulletPhysics::GetPALVersion() const {
@@ -663,6 +847,10 @@ void palBulletPhysics::GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>&
 {
 	palPhysics::GetPropertyDocumentation(descriptions);
 	//descriptions["Bullet_UseMultithreadedDispatcher"] = "Enables the multithreaded physics solver.  See palSolver::SetPE.  This defaults to false.";
+	descriptions["Bullet_Threads"] = "The number of threads, the calling one included, that find contacts, solve islands and integrate bodies. "
+			"More than 1 enables the multithreaded dispatcher and world, 0 uses one thread per core. "
+			"The threads come from TBB if PAL was built with BT_USE_TBB, otherwise from a built in pool of std::threads. "
+			"Only has an effect when built with BULLET_MULTITHREADING, against Bullet 2.83 or later built with BT_THREADSAFE. This defaults to 1.";
 	descriptions["Bullet_UseInternalEdgeUtility"] = "Enables the callback for the internal edge checked on the collision detection. Defaults false"
 			"This is extra overhead, but it prevents issues related to colliding with the back side and internal edges of triangle meshes."
 			"This defaults to false";
@@ -670,6 +858,11 @@ void palBulletPhysics::GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>&
 	descriptions["Bullet_AxisSweepBroadphase_RangeX"] = "If Bullet_UseAxisSweepBroadphase is true, this is the X range -X to +X. It defaults to 1000.";
 	descriptions["Bullet_AxisSweepBroadphase_RangeY"] = "If Bullet_UseAxisSweepBroadphase is true, this is the Y range -Y to +Y. It defaults to 1000";
 	descriptions["Bullet_AxisSweepBroadphase_RangeZ"] = "If Bullet_UseAxisSweepBroadphase is true, this is the Z range -Z to +Z. It defaults to 1000";
+	descriptions["Bullet_ConvexHullMaxVertices"] = "Convex geometries are reduced to their convex hull, and then to at most this many vertices by keeping the extreme points in evenly spread directions. "
+			"Fewer vertices make every collision test against the hull cheaper. 0, the default, keeps the whole hull.";
+	descriptions["Bullet_ConvexHullPolyhedralFeatures"] = "Computes the faces of convex hulls so contacts are found by SAT and clipping instead of GJK, which is more stable for resting contact. This defaults to false.";
+	descriptions["Bullet_CompoundAabbTreeThreshold"] = "Generic bodies with at least this many convex geometries get a dynamic AABB tree over them, "
+			"so collisions only test the geometries that overlap instead of all of them. 0 disables the tree. This defaults to 32.";
 	descriptions["Bullet_Solver"] = "Which solver to use.  btSequentialImpulseConstraintSolver (or fast) is the default and only option before 2.8.2.  Others are btNNCGConstraintSolver, btMLCPSolver - btSolveProjectedGaussSeidel(or accurate), btMLCPSolver - btDantzigSolver, btMLCPSolver - btLemkeSolver";
 
 	descriptions["WorldERP"] = "The Global value of the Error Reduction Parameter. Used as Baumgarte factor. Default is 0.2. See http://www.ode.org/ode-latest-userguide.html#sec_3_8_2";
@@ -686,7 +879,19 @@ void palBulletPhysics::Init(const palPhysicsDesc& desc) {
 
 
 #if BT_BULLET_VERSION >= 283 && defined(BULLET_MULTITHREADING)
-	bool parallel_solver = GetInitProperty("Bullet_UseMultithreadedDispatcher") == "true";
+	int threads = GetInitProperty<int>("Bullet_Threads", 1, 0, 1024);
+	if (threads == 0) {
+		threads = getMaxNumThreads();
+	} else if (threads == 1 && GetInitProperty("Bullet_UseMultithreadedDispatcher") == "true") {
+		threads = set_pe > 1 ? set_pe : getMaxNumThreads();
+	}
+	bool parallel_solver = threads > 1;
+	if (parallel_solver) {
+		initTaskScheduler();
+		setNumThreads(threads);
+	}
+	// a solver per thread, so islands never wait for one
+	int numSolvers = std::max(set_pe, threads);
 #else
 	bool parallel_solver = false;
 #endif
@@ -767,33 +972,33 @@ void palBulletPhysics::Init(const palPhysicsDesc& desc) {
 		m_dispatcher->setDispatcherFlags( btCollisionDispatcher::CD_DISABLE_CONTACTPOOL_DYNAMIC_ALLOCATION );
 
 		btAlignedObjectArray<btConstraintSolver*> solvers;
-		solvers.reserve( set_pe );
+		solvers.reserve( numSolvers );
 
 		std::string solverName = GetInitProperty("Bullet_Solver", "btSequentialImpulseConstraintSolver");
 		if (solverName == "btNNCGConstraintSolver")
 		{
-			for ( int i = 0; i < set_pe; ++i )
+			for ( int i = 0; i < numSolvers; ++i )
 			{
 				solvers.push_back( new btNNCGConstraintSolver);
 			}
 		}
 		else if (solverName == "btMLCPSolver - btSolveProjectedGaussSeidel" || solverName == "accurate")
 		{
-			for ( int i = 0; i < set_pe; ++i )
+			for ( int i = 0; i < numSolvers; ++i )
 			{
 				solvers.push_back( new btMLCPSolver(new btSolveProjectedGaussSeidel()));
 			}
 		}
 		else if (solverName == "btMLCPSolver - btDantzigSolver")
 		{
-			for ( int i = 0; i < set_pe; ++i )
+			for ( int i = 0; i < numSolvers; ++i )
 			{
 				solvers.push_back( new btMLCPSolver(new btDantzigSolver()));
 			}
 		}
 		else if (solverName == "btMLCPSolver - btLemkeSolver")
 		{
-			for ( int i = 0; i < set_pe; ++i )
+			for ( int i = 0; i < numSolvers; ++i )
 			{
 				solvers.push_back( new btMLCPSolver(new btLemkeSolver()));
 			}
@@ -805,7 +1010,7 @@ void palBulletPhysics::Init(const palPhysicsDesc& desc) {
 				printf("Pal-bullet: bullet solver named \"%s\" is not one of the options. Pal provides palPhysics::GetPropertyDocumentation(...) to get a listing of available options.", solverName.c_str());
 			}
 
-			for ( int i = 0; i < set_pe; ++i )
+			for ( int i = 0; i < numSolvers; ++i )
 			{
 				solvers.push_back( new btSequentialImpulseConstraintSolver );
 			}
@@ -824,6 +1029,14 @@ void palBulletPhysics::Init(const palPhysicsDesc& desc) {
 	}
 #endif
 
+	m_nHullMaxVertices = GetInitProperty<unsigned int>("Bullet_ConvexHullMaxVertices", 0, 0, 65536);
+	// values below 4 can not describe a solid
+	if (m_nHullMaxVertices > 0 && m_nHullMaxVertices < 4) {
+		m_nHullMaxVertices = 4;
+	}
+	m_bHullPolyhedralFeatures = GetInitProperty("Bullet_ConvexHullPolyhedralFeatures") == "true";
+	m_nCompoundTreeThreshold = GetInitProperty<unsigned int>("Bullet_CompoundAabbTreeThreshold", 32, 0, std::numeric_limits<unsigned int>::max());
+
 	if (GetInitProperty("Bullet_UseInternalEdgeUtility") == "true") {
 		g_bEnableCustomMaterials = true;
 	} else {
@@ -842,6 +1055,13 @@ void palBulletPhysics::Init(const palPhysicsDesc& desc) {
 	m_softBodyWorldInfo.m_dispatcher = m_dispatcher;
 	m_softBodyWorldInfo.m_broadphase = broadphase;
 
+	// bullet calls the actions for each substep, palPhysics::Update must not call them as well
+	if (m_pActionCaller == NULL) {
+		m_pActionCaller = new palBulletActionCaller(*this);
+		m_dynamicsWorld->addAction(m_pActionCaller);
+	}
+	m_bSubstepActions = true;
+
 	btVector3 gravity(m_fGravityX, m_fGravityY, m_fGravityZ);
 	m_dynamicsWorld->setGravity(gravity);
 	m_softBodyWorldInfo.m_gravity = gravity;
@@ -898,19 +1118,164 @@ void palBulletPhysics::Cleanup() {
 	m_overlapCallback = NULL;
 	m_ghostPairCallback = NULL;
 
-	PAL_MAP<palAction*, btActionInterface*>::iterator i, iend;
-	i = m_BulletActions.begin();
-	iend = m_BulletActions.end();
-	for (; i != iend; ++i) {
-		btActionInterface* bulletAction = i->second;
-		delete bulletAction;
+	delete m_pActionCaller;
+	m_pActionCaller = NULL;
+
+	// only left over if geometries outlive the physics
+	PAL_MAP<unsigned long, PAL_VECTOR<SharedHull> >::iterator h;
+	for (h = m_SharedHulls.begin(); h != m_SharedHulls.end(); ++h) {
+		for (size_t j = 0; j < h->second.size(); ++j) {
+			delete h->second[j].m_pShape;
+		}
+	}
+	m_SharedHulls.clear();
+	m_SharedHullKeys.clear();
+	m_CompoundTreeQueue.clear();
+}
+
+// the state of a collision object, and of its rigid body if it is one
+struct palBulletObjectState {
+	const btCollisionObject* m_pObject; //!< checked when restoring
+	btTransform m_WorldTransform;
+	btTransform m_InterpolationWorldTransform;
+	btTransform m_MotionStateTransform;
+	btVector3 m_InterpolationLinearVelocity;
+	btVector3 m_InterpolationAngularVelocity;
+	btVector3 m_LinearVelocity;
+	btVector3 m_AngularVelocity;
+	btVector3 m_TotalForce;
+	btVector3 m_TotalTorque;
+	btScalar m_fDeactivationTime;
+	btScalar m_fHitFraction;
+	int m_nActivationState;
+};
+
+// the time stepSimulation has left over from the last fixed substep is protected
+struct palBulletWorldAccess : public btDiscreteDynamicsWorld {
+	static btScalar btDiscreteDynamicsWorld::* LocalTime() { return &palBulletWorldAccess::m_localTime; }
+};
+
+bool palBulletPhysics::SaveEngineState(palStateBuffer& state) const {
+	if (m_dynamicsWorld == NULL)
+		return false;
+	const btCollisionObjectArray& objects = m_dynamicsWorld->getCollisionObjectArray();
+	int count = objects.size();
+	state.Write(count);
+	state.Write(m_dynamicsWorld->*palBulletWorldAccess::LocalTime());
+	for (int i = 0; i < count; i++) {
+		const btCollisionObject* obj = objects[i];
+		palBulletObjectState os;
+		memset(&os, 0, sizeof(os));
+		os.m_pObject = obj;
+		os.m_WorldTransform = obj->getWorldTransform();
+		os.m_InterpolationWorldTransform = obj->getInterpolationWorldTransform();
+		os.m_MotionStateTransform = obj->getWorldTransform();
+		os.m_InterpolationLinearVelocity = obj->getInterpolationLinearVelocity();
+		os.m_InterpolationAngularVelocity = obj->getInterpolationAngularVelocity();
+		os.m_fDeactivationTime = obj->getDeactivationTime();
+		os.m_fHitFraction = obj->getHitFraction();
+		os.m_nActivationState = obj->getActivationState();
+		const btRigidBody* body = btRigidBody::upcast(obj);
+		if (body != NULL) {
+			os.m_LinearVelocity = body->getLinearVelocity();
+			os.m_AngularVelocity = body->getAngularVelocity();
+			os.m_TotalForce = body->getTotalForce();
+			os.m_TotalTorque = body->getTotalTorque();
+			if (body->getMotionState() != NULL)
+				body->getMotionState()->getWorldTransform(os.m_MotionStateTransform);
+		}
+		state.Write(os);
 	}
-	// This isn't really necessary, I just don't like bad pointers hanging around.
-	m_BulletActions.clear();
+
+	int numManifolds = m_dispatcher->getNumManifolds();
+	state.Write(numManifolds);
+	for (int i = 0; i < numManifolds; i++) {
+		btPersistentManifold* manifold = m_dispatcher->getManifoldByIndexInternal(i);
+		const void* bodies[2] = { manifold->getBody0(), manifold->getBody1() };
+		int numContacts = manifold->getNumContacts();
+		state.Write(bodies);
+		state.Write(numContacts);
+		for (int j = 0; j < numContacts; j++)
+			state.Write(manifold->getContactPoint(j));
+	}
+	return true;
+}
+
+bool palBulletPhysics::RestoreEngineState(const palStateBuffer& state) {
+	if (m_dynamicsWorld == NULL)
+		return false;
+	btCollisionObjectArray& objects = m_dynamicsWorld->getCollisionObjectArray();
+	int count;
+	btScalar localTime;
+	if (!state.Read(count) || count != objects.size() || !state.Read(localTime))
+		return false;
+	const unsigned char* saved = static_cast<const unsigned char*>(state.Take(count * sizeof(palBulletObjectState)));
+	if (saved == NULL && count > 0)
+		return false;
+	// the objects have to be the same ones, in the same order, before anything is changed
+	for (int i = 0; i < count; i++) {
+		const btCollisionObject* obj;
+		memcpy(&obj, saved + i * sizeof(palBulletObjectState) + offsetof(palBulletObjectState, m_pObject), sizeof(obj));
+		if (obj != objects[i])
+			return false;
+	}
+
+	for (int i = 0; i < count; i++) {
+		btCollisionObject* obj = objects[i];
+		palBulletObjectState os;
+		memcpy(&os, saved + i * sizeof(palBulletObjectState), sizeof(os));
+		obj->setWorldTransform(os.m_WorldTransform);
+		obj->setInterpolationWorldTransform(os.m_InterpolationWorldTransform);
+		obj->setInterpolationLinearVelocity(os.m_InterpolationLinearVelocity);
+		obj->setInterpolationAngularVelocity(os.m_InterpolationAngularVelocity);
+		obj->forceActivationState(os.m_nActivationState);
+		obj->setDeactivationTime(os.m_fDeactivationTime);
+		obj->setHitFraction(os.m_fHitFraction);
+		btRigidBody* body = btRigidBody::upcast(obj);
+		if (body != NULL) {
+			body->setLinearVelocity(os.m_LinearVelocity);
+			body->setAngularVelocity(os.m_AngularVelocity);
+			body->clearForces();
+			body->applyCentralForce(os.m_TotalForce);
+			body->applyTorque(os.m_TotalTorque);
+			if (body->getMotionState() != NULL)
+				body->getMotionState()->setWorldTransform(os.m_MotionStateTransform);
+		}
+	}
+	m_dynamicsWorld->*palBulletWorldAccess::LocalTime() = localTime;
+
+	// the contacts go back into the manifolds of the same pairs, which are found by their bodies
+	typedef std::pair<const void*, const void*> BodyPair;
+	PAL_MAP<BodyPair, btPersistentManifold*> manifolds;
+	int numManifolds = m_dispatcher->getNumManifolds();
+	for (int i = 0; i < numManifolds; i++) {
+		btPersistentManifold* manifold = m_dispatcher->getManifoldByIndexInternal(i);
+		manifold->clearManifold();
+		manifolds[BodyPair(manifold->getBody0(), manifold->getBody1())] = manifold;
+	}
+	int savedManifolds = 0;
+	state.Read(savedManifolds);
+	for (int i = 0; i < savedManifolds; i++) {
+		const void* bodies[2];
+		int numContacts = 0;
+		if (!state.Read(bodies) || !state.Read(numContacts))
+			break;
+		PAL_MAP<BodyPair, btPersistentManifold*>::iterator it = manifolds.find(BodyPair(bodies[0], bodies[1]));
+		for (int j = 0; j < numContacts; j++) {
+			btManifoldPoint pt;
+			if (!state.Read(pt))
+				break;
+			pt.m_userPersistentData = 0;
+			if (it != manifolds.end())
+				it->second->addManifoldPoint(pt);
+		}
+	}
+	return true;
 }
 
 void palBulletPhysics::StartIterate(Float timestep) {
 	ClearContacts();
+	BuildCompoundTrees();
 
 	if (m_dynamicsWorld && m_dynamicsWorld->getCollisionObjectArray().size() > 0) {
 
@@ -958,6 +1323,11 @@ void palBulletPhysics::StartIterate(Float timestep) {
 					cp.m_pBody1=body1;
 					cp.m_pBody2=body2;
 					convertManifoldPtToContactPoint(pt, cp);
+					// the child of the compound, ie: the instance
+					if (body1 != NULL && body1->m_Type == PAL_STATIC_INSTANCE_SET)
+						cp.m_nInstance1 = pt.m_index0;
+					if (body2 != NULL && body2->m_Type == PAL_STATIC_INSTANCE_SET)
+						cp.m_nInstance2 = pt.m_index1;
 
 					EmitContact(cp);
 				}
@@ -1291,6 +1661,38 @@ static void DeleteBvhTriangleShape(btBvhTriangleMeshShape*& shapeToDelete) {
 }
 //////////////////////
 
+/** A compound shape that recalculates its local AABB once after its children change,
+ * instead of after every child that is removed or moved.
+ * The body refreshes it on the main thread before the shape is used (the body is built or added back to the world),
+ * so getAabb stays a plain read for the parallel broadphase and dispatch.
+ */
+class palBulletCompoundShape : public btCompoundShape {
+public:
+	palBulletCompoundShape()
+	// the AABB tree is built by palBulletPhysics::BuildCompoundTrees if there are enough children
+	: btCompoundShape(false)
+	, m_bLocalAabbDirty(false) {}
+
+	virtual void recalculateLocalAabb() {
+		m_bLocalAabbDirty = true;
+	}
+
+	/// Recalculates the local AABB if children were removed or moved since the last call
+	void RefreshLocalAabb() {
+		if (m_bLocalAabbDirty) {
+			m_bLocalAabbDirty = false;
+			btCompoundShape::recalculateLocalAabb();
+		}
+	}
+private:
+	bool m_bLocalAabbDirty;
+};
+
+static void RefreshCompoundAabb(btCompoundShape* compound) {
+	if (compound != NULL)
+		static_cast<palBulletCompoundShape*>(compound)->RefreshLocalAabb();
+}
+
 ///////////////
 palBulletGenericBody::palBulletGenericBody()
 : m_bGravityEnabled(true)
@@ -1301,8 +1703,7 @@ palBulletGenericBody::palBulletGenericBody()
 }
 
 palBulletGenericBody::~palBulletGenericBody() {
-	delete m_pCompound;
-	m_pCompound = NULL;
+	DeleteCompound();
 	DeleteBvhTriangleShape(m_pConcave);
 }
 
@@ -1325,6 +1726,7 @@ void palBulletGenericBody::Init(const palMatrix4x4 &pos) {
 		BuildBody(pos, m_fMass, GetDynamicsType(), m_pConcave, pvInertia);
 	} else {
 		InitCompoundIfNull();
+		RefreshCompoundAabb(m_pCompound);
 		BuildBody(pos, m_fMass, GetDynamicsType(), m_pCompound, pvInertia);
 	}
 
@@ -1475,12 +1877,34 @@ Float palBulletGenericBody::GetMaxAngularVelocity() const
 
 void palBulletGenericBody::InitCompoundIfNull() {
 	if (m_pCompound == NULL) {
-		m_pCompound = new btCompoundShape(false);
+		m_pCompound = new palBulletCompoundShape();
 		for (unsigned i = 0; i < m_Geometries.size(); ++i)
 			AddShapeToCompound(m_Geometries[i]);
 	}
 }
 
+void palBulletGenericBody::DeleteCompound() {
+	if (m_pCompound != NULL) {
+		palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+		if (physics) {
+			physics->DequeueCompoundTree(m_pCompound);
+		}
+		delete m_pCompound;
+		m_pCompound = NULL;
+	}
+}
+
+void palBulletGenericBody::QueueCompoundTreeIfLarge() {
+	// once the tree exists, addChildShape inserts into it
+	if (m_pCompound->getDynamicAabbTree() != NULL)
+		return;
+	palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+	if (physics && physics->GetCompoundTreeThreshold() > 0
+			&& unsigned(m_pCompound->getNumChildShapes()) >= physics->GetCompoundTreeThreshold()) {
+		physics->QueueCompoundTree(m_pCompound);
+	}
+}
+
 void palBulletGenericBody::AddShapeToCompound(palGeometry* pGeom) {
 	if (m_pCompound == NULL)
 		return;
@@ -1492,6 +1916,7 @@ void palBulletGenericBody::AddShapeToCompound(palGeometry* pGeom) {
 	if (pbtg->BulletGetCollisionShape()->isCompound() || pbtg->BulletGetCollisionShape()->isConvex()) {
 		// Ugh, Can't add a concave shape to a compound shape.
 		m_pCompound->addChildShape(localTrans, pbtg->BulletGetCollisionShape());
+		QueueCompoundTreeIfLarge();
 	}
 }
 
@@ -1554,15 +1979,13 @@ void palBulletGenericBody::ConnectGeometry(palGeometry* pGeom) {
 		physics->RemoveRigidBody(this);
 
 		if (IsUsingOneCenteredGeometry()) {
-			delete m_pCompound;
-			m_pCompound = NULL;
+			DeleteCompound();
 			DeleteBvhTriangleShape(m_pConcave);
 			palBulletGeometry *pbtg=dynamic_cast<palBulletGeometry *> (pGeom);
 			btCollisionShape* shape = pbtg->BulletGetCollisionShape();
 			m_pbtBody->setCollisionShape(shape);
 		} else if (IsUsingConcaveShape()) {
-			delete m_pCompound;
-			m_pCompound = NULL;
+			DeleteCompound();
 			RebuildConcaveShapeFromGeometry();
 			m_pbtBody->setCollisionShape(m_pConcave);
 		} else {
@@ -1570,6 +1993,7 @@ void palBulletGenericBody::ConnectGeometry(palGeometry* pGeom) {
 			AddShapeToCompound(pGeom);
 			// This is done after the above on purpose
 			InitCompoundIfNull();
+			RefreshCompoundAabb(m_pCompound);
 			m_pbtBody->setCollisionShape(m_pCompound);
 		}
 
@@ -1585,15 +2009,13 @@ void palBulletGenericBody::RemoveGeometry(palGeometry* pGeom)
 		physics->RemoveRigidBody(this);
 
 		if (IsUsingOneCenteredGeometry()) {
-			delete m_pCompound;
-			m_pCompound = NULL;
+			DeleteCompound();
 			DeleteBvhTriangleShape(m_pConcave);
 			palBulletGeometry *pbtg=dynamic_cast<palBulletGeometry *> (pGeom);
 			btCollisionShape* shape = pbtg->BulletGetCollisionShape();
 			m_pbtBody->setCollisionShape(shape);
 		} else if (IsUsingConcaveShape()) {
-			delete m_pCompound;
-			m_pCompound = NULL;
+			DeleteCompound();
 			RebuildConcaveShapeFromGeometry();
 			m_pbtBody->setCollisionShape(m_pConcave);
 		} else {
@@ -1601,6 +2023,7 @@ void palBulletGenericBody::RemoveGeometry(palGeometry* pGeom)
 			RemoveShapeFromCompound(pGeom);
 			// This is done after the above on purpose
 			InitCompoundIfNull();
+			RefreshCompoundAabb(m_pCompound);
 			m_pbtBody->setCollisionShape(m_pCompound);
 		}
 		// what about just clearing the broadphase cache?
@@ -1841,20 +2264,14 @@ palBulletTerrainMesh::~palBulletTerrainMesh() {
 }
 
 void palBulletTerrainMesh::Init(Float x, Float y, Float z, const Float *pVertices, int nVertices, const int *pIndices, int nIndices) {
-	m_Indices.reserve(nIndices);
-	for (int i = 0; i < nIndices; ++i)
-	{
-		m_Indices.push_back(pIndices[i]);
-	}
-
-	int nVertFloats = nVertices * 3;
-	m_Vertices.reserve(nVertFloats);
-	for (int i = 0; i < nVertFloats; ++i)
-	{
-		m_Vertices.push_back(pVertices[i]);
-	}
+	BuildShape(pVertices,nVertices,pIndices,nIndices);
+	BuildMeshBody(x,y,z);
+}
 
-	palTerrainMesh::Init(x,y,z,&m_Vertices.front(),nVertices,&m_Indices.front(),nIndices);
+void palBulletTerrainMesh::BuildShape(const Float *pVertices, int nVertices, const int *pIndices, int nIndices) {
+	// Bullet reads the mesh in place, so it keeps its own copy. The trimesh takes Float vertices whatever btScalar is.
+	m_Indices.assign(pIndices, pIndices + nIndices);
+	m_Vertices.assign(pVertices, pVertices + nVertices * 3);
 
 	btTriangleIndexVertexArray *trimesh = new btTriangleIndexVertexArray();
 	AddMeshToTrimesh(trimesh, &m_Vertices.front(), nVertices, &m_Indices.front(), nIndices);
@@ -1877,6 +2294,10 @@ void palBulletTerrainMesh::Init(Float x, Float y, Float z, const Float *pVertice
 	//	}
 
 	m_pbtTriMeshShape = new btBvhTriangleMeshShape(trimesh,true);
+}
+
+void palBulletTerrainMesh::BuildMeshBody(Float x, Float y, Float z) {
+	palTerrainMesh::Init(x,y,z,&m_Vertices.front(),(int)m_Vertices.size()/3,&m_Indices.front(),(int)m_Indices.size());
 	palMatrix4x4 mat;
 	mat_identity(&mat);
 	mat_set_translation(&mat,x,y,z);
@@ -1900,37 +2321,38 @@ void palBulletTerrainMesh::SetMaterial(palMaterial *material) {
 palBulletTerrainHeightmap::palBulletTerrainHeightmap() {
 }
 
-void palBulletTerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
-	palTerrainHeightmap::Init(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
+bool palBulletTerrainHeightmap::Prepare(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
+	if (m_pbtTriMeshShape)
+		return true;
 	int iTriIndex;
 	float fTerrainX, fTerrainZ;
 	int x,z;
 
-	int nv=m_iDataWidth*m_iDataDepth;
-	int ni=(m_iDataWidth-1)*(m_iDataDepth-1)*2*3;
+	int nv=terrain_data_width*terrain_data_depth;
+	int ni=(terrain_data_width-1)*(terrain_data_depth-1)*2*3;
 
 	Float *v = new Float[nv*3];
 	int *ind = new int[ni];
 
 	// Set the vertex values
-	fTerrainZ = -m_fDepth/2;
-	for (z=0; z<m_iDataDepth; z++)
+	fTerrainZ = -depth/2;
+	for (z=0; z<terrain_data_depth; z++)
 	{
-		fTerrainX = -m_fWidth/2;
-		for (x=0; x<m_iDataWidth; x++)
+		fTerrainX = -width/2;
+		for (x=0; x<terrain_data_width; x++)
 		{
-			v[(x + z*m_iDataWidth)*3+0]=fTerrainX;
-			v[(x + z*m_iDataWidth)*3+1]=pHeightmap[x+z*m_iDataWidth];
-			v[(x + z*m_iDataWidth)*3+2]=fTerrainZ;
+			v[(x + z*terrain_data_width)*3+0]=fTerrainX;
+			v[(x + z*terrain_data_width)*3+1]=pHeightmap[x+z*terrain_data_width];
+			v[(x + z*terrain_data_width)*3+2]=fTerrainZ;
 
-			fTerrainX += (m_fWidth / (m_iDataWidth-1));
+			fTerrainX += (width / (terrain_data_width-1));
 		}
-		fTerrainZ += (m_fDepth / (m_iDataDepth-1));
+		fTerrainZ += (depth / (terrain_data_depth-1));
 	}
 
 	iTriIndex = 0;
-	int xDim=m_iDataWidth;
-	int yDim=m_iDataDepth;
+	int xDim=terrain_data_width;
+	int yDim=terrain_data_depth;
 	int y;
 	for (y=0;y < yDim-1;y++)
 		for (x=0;x < xDim-1;x++) {
@@ -1946,14 +2368,153 @@ void palBulletTerrainHeightmap::Init(Float px, Float py, Float pz, Float width,
 			// Move to the next triangle in the array
 			iTriIndex += 1;
 		}
-	palBulletTerrainMesh::Init(px,py,pz,v,nv,ind,ni);
+	BuildShape(v,nv,ind,ni);
 
 	delete [] v;
 	delete [] ind;
+	return true;
+}
+
+void palBulletTerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
+	palTerrainHeightmap::Init(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
+	Prepare(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
+	BuildMeshBody(px,py,pz);
+}
+
+palBulletStaticInstanceSet::palBulletStaticInstanceSet()
+: m_pCompound(NULL) {}
+
+palBulletStaticInstanceSet::~palBulletStaticInstanceSet() {
+	palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+	if (physics) {
+		for (size_t i = 0; i < m_Hulls.size(); ++i) {
+			physics->ReleaseConvexHull(m_Hulls[i]);
+		}
+	}
+	m_Hulls.clear();
+	for (size_t i = 0; i < m_Shapes.size(); ++i) {
+		delete m_Shapes[i];
+	}
+	m_Shapes.clear();
+	delete m_pCompound;
+	m_pCompound = NULL;
+}
+
+const palMatrix4x4& palBulletStaticInstanceSet::GetLocationMatrix() const {
+	return palBulletBodyBase::GetLocationMatrix();
+}
+
+namespace {
+	/// instances with the same type and dimensions share their shape
+	struct InstanceShapeKey {
+		int m_nType;
+		Float m_fDimensions[3];
+		bool operator<(const InstanceShapeKey& other) const {
+			if (m_nType != other.m_nType)
+				return m_nType < other.m_nType;
+			for (int i = 0; i < 3; ++i) {
+				if (m_fDimensions[i] != other.m_fDimensions[i])
+					return m_fDimensions[i] < other.m_fDimensions[i];
+			}
+			return false;
+		}
+	};
+}
+
+btCollisionShape *palBulletStaticInstanceSet::CreateShape(unsigned int instance) const {
+	const palStaticInstance& inst = m_Instances[instance];
+	switch (inst.m_Type) {
+	case PAL_GEOM_BOX:
+	{
+		palVector3 dim = GetBoxXYZDimensions(instance);
+		return new btBoxShape(btVector3(dim.x*(Float)0.5,dim.y*(Float)0.5,dim.z*(Float)0.5));
+	}
+	case PAL_GEOM_SPHERE:
+		return new btSphereShape(inst.m_fDimensions[0]);
+	case PAL_GEOM_CAPSULE:
+		switch (GetUpAxis()) {
+		case PAL_Z_AXIS:
+			return new btCapsuleShapeZ(inst.m_fDimensions[0], inst.m_fDimensions[1]);
+		case PAL_X_AXIS:
+			return new btCapsuleShapeX(inst.m_fDimensions[0], inst.m_fDimensions[1]);
+		default:
+			return new btCapsuleShape(inst.m_fDimensions[0], inst.m_fDimensions[1]);
+		}
+	default:
+		return NULL;
+	}
+}
+
+void palBulletStaticInstanceSet::Finalize() {
+	palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+	if (m_bFinalized || physics == NULL)
+		return;
+	palStaticInstanceSet::Finalize();
+
+	for (unsigned int i = 0; i < GetNumConvexShapes(); ++i) {
+		const PAL_VECTOR<Float> *vertices;
+		const PAL_VECTOR<int> *indices;
+		GetConvexShape(i, vertices, indices);
+		m_Hulls.push_back(physics->AcquireConvexHull(&vertices->front(), unsigned(vertices->size() / 3)));
+	}
+
+	// the tree is built once, from all the children, rather than one insert per child
+#if BT_BULLET_VERSION >= 282
+	m_pCompound = new btCompoundShape(false);
+#else
+	m_pCompound = new btCompoundShape(true);
+#endif
+	// most props are copies of a few objects
+	PAL_MAP<InstanceShapeKey, btCollisionShape*> shapes;
+	for (unsigned int i = 0; i < m_Instances.size(); ++i) {
+		const palStaticInstance& inst = m_Instances[i];
+		btCollisionShape *shape;
+		if (inst.m_Type == PAL_GEOM_CONVEX) {
+			shape = m_Hulls[inst.m_nShape];
+		} else {
+			InstanceShapeKey key;
+			key.m_nType = inst.m_Type;
+			for (int j = 0; j < 3; ++j)
+				key.m_fDimensions[j] = inst.m_fDimensions[j];
+			btCollisionShape *&shared = shapes[key];
+			if (shared == NULL) {
+				shared = CreateShape(i);
+				m_Shapes.push_back(shared);
+			}
+			shape = shared;
+		}
+		btTransform localTrans;
+		convertPalMatToBtTransform(localTrans, inst.m_mLoc);
+		// the child index is the instance index, Bullet reports it in the contacts
+		m_pCompound->addChildShape(localTrans, shape);
+	}
+#if BT_BULLET_VERSION >= 282
+	m_pCompound->createAabbTreeFromChildren();
+#endif
+
+	palMatrix4x4 mat;
+	mat_identity(&mat);
+	BuildBody(mat, 0, PALBODY_STATIC, m_pCompound);
+	if (m_pMaterial != NULL) {
+		palBulletBodyBase::SetMaterial(m_pMaterial);
+	}
 }
 
 palBulletConvexGeometry::palBulletConvexGeometry()
-: m_pbtConvexShape(0) {}
+: m_pbtConvexShape(0)
+, m_bSharedHull(false) {}
+
+palBulletConvexGeometry::~palBulletConvexGeometry() {
+	if (m_bSharedHull) {
+		palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+		if (physics) {
+			physics->ReleaseConvexHull(m_pbtConvexShape);
+		}
+		// not ours, so keep ~palBulletGeometry from deleting it
+		m_pbtShape = NULL;
+		m_pbtConvexShape = NULL;
+	}
+}
 
 void palBulletConvexGeometry::Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, Float mass) {
 	palConvexGeometry::Init(pos,pVertices,nVertices,mass);
@@ -1965,85 +2526,17 @@ void palBulletConvexGeometry::Init(const palMatrix4x4 &pos, const Float *pVertic
 	InternalInit(pVertices, nVertices, pIndices, nIndices);
 }
 
-struct btVecLess
-{
-	bool operator()( const btVector3& lhs, const btVector3& rhs ) const
-	{
-		if (lhs.getX() < rhs.getX())
-			return true;
-		else if (lhs.getX() == rhs.getX() && lhs.getY() < rhs.getY())
-			return true;
-		else if (lhs.getX() == rhs.getX() && lhs.getY() == rhs.getY() && lhs.getZ() < rhs.getZ())
-			return true;
-		return false;
-	}
-};
-
 void palBulletConvexGeometry::InternalInit(const Float *pVertices, unsigned int nVertices, const int *pIndices, int nIndices)
 {
-//	btVector3* supportPoints = new btVector3[nVertices];
-//
-//	for (unsigned i = 0; i < nVertices; ++i)
-//	{
-//		supportPoints[i] = btVector3(pVertices[3*i + 0], pVertices[3*i + 1], pVertices[3*i + 2]);
-//		printf("InVec: %lf, %lf, %lf\n", supportPoints[i].getX(), supportPoints[i].getY(), supportPoints[i].getZ());
-//	}
-//
-//	HullDesc hd;
-//	hd.mFlags = QF_TRIANGLES;
-//	hd.mVcount = nVertices;
-//
-//	hd.mVertices = supportPoints;
-//	hd.mVertexStride = sizeof(btVector3);
-//	hd.mMaxVertices = nVertices;
-//
-//	HullLibrary hl;
-//	HullResult hr;
-//	if (hl.CreateConvexHull (hd, hr) == QE_FAIL)
-//	{
-//		printf("Hull creation failed\n");
-//		return;
-//	}
-
-#if BT_FLOAT_IS_PAL_FLOAT
-	m_pbtConvexShape = new btConvexHullShape(pVertices,nVertices,sizeof(btScalar)*3);
-#else
-	m_pbtConvexShape = new btConvexHullShape();
-
-	//for (unsigned i = 0; i < hr.mNumOutputVertices; ++i)
-	//{
-	//std::set<btVector3, btVecLess> theSet;
-	for (unsigned i = 0; i < nVertices/*unsigned(nIndices)*/; ++i)
-	{
-		//btVector3& nextv = hr.m_OutputVertices[i];
-		int idx = i;//pIndices[i];
-		btVector3 nextv(pVertices[3*idx + 0], pVertices[3*idx + 1], pVertices[3*idx + 2]);
-//		if (theSet.find(nextv) == theSet.end())
-//		{
-//			theSet.insert(nextv);
-				//printf("OutVec: %lf, %lf, %lf\n", nextv.getX(), nextv.getY(), nextv.getZ());
-#if BT_BULLET_VERSION < 282
-		m_pbtConvexShape->addPoint(nextv);
-#else
-		m_pbtConvexShape->addPoint(nextv, false);
-#endif
-//		}
+	palBulletPhysics* physics = dynamic_cast<palBulletPhysics*>(GetParent());
+	if (physics) {
+		m_pbtConvexShape = physics->AcquireConvexHull(pVertices, nVertices);
+		m_bSharedHull = true;
+	} else {
+		m_pbtConvexShape = BuildConvexHull(pVertices, nVertices, 0, false);
 	}
-
-	//printf("nVerts %d vs AddedVerts %d\n", nVertices, m_pbtConvexShape->getNumPoints());
-
-#if BT_BULLET_VERSION > 281
-	m_pbtConvexShape->recalcLocalAabb();
-#endif
-#endif
-	//	}
 	// default margin is 0.04
-	//	m_pbtConvexShape = convexShape;
 	m_pbtShape = m_pbtConvexShape;
-	//m_pbtShape->setMargin(0.0f);
-	// free temporary hull result that we just copied
-//	hl.ReleaseResult (hr);
-//	delete[] supportPoints;
 }
 
 palBulletConcaveGeometry::palBulletConcaveGeometry()
@@ -2191,34 +2684,26 @@ void palBulletPSDSensor::Init(palBody *body, Float x, Float y, Float z, Float dx
 #include <GL/gl.h>
 #pragma comment (lib, "opengl32.lib")
 #endif
+bool palBulletPSDSensor::GetWorldRay(const palMatrix4x4& bodypos, palRay& ray) const {
+	palVector3 relative(m_fRelativePosX, m_fRelativePosY, m_fRelativePosZ);
+	palVector3 axis(m_fAxisX, m_fAxisY, m_fAxisZ);
+	vec_mat_transform(&ray.m_vOrigin, &bodypos, &relative);
+	vec_mat_mul(&ray.m_vDirection, &bodypos, &axis);
+	vec_norm(&ray.m_vDirection);
+	ray.m_fRange = m_fRange;
+	return true;
+}
+
 Float palBulletPSDSensor::GetDistance() const {
-	// TODO simplify this by using vec_mat_mul instead of mat_multiply
-	btVector3 from;
-	palMatrix4x4 m;
-	palMatrix4x4 bodypos = m_pBody->GetLocationMatrix();
-	palMatrix4x4 out;
-
-	mat_identity(&m);
-	mat_translate(&m,m_fRelativePosX,m_fRelativePosY,m_fRelativePosZ);
-	mat_multiply(&out,&bodypos,&m);
-	from.setX(out._41);
-	from.setY(out._42);
-	from.setZ(out._43);
-
-	mat_identity(&m);
-	mat_translate(&m,m_fAxisX,m_fAxisY,m_fAxisZ);
-	mat_multiply(&out,&bodypos,&m);
-
-	palVector3 newaxis;
-	newaxis.x=out._41-bodypos._41;
-	newaxis.y=out._42-bodypos._42;
-	newaxis.z=out._43-bodypos._43;
-	vec_norm(&newaxis);
+	if (m_pManager != NULL)
+		return m_fReading;
 
+	palRay ray;
+	GetWorldRay(m_pBody->GetLocationMatrix(), ray);
 
 	palRayHit hit;
-	static_cast<const palBulletPhysics*>(GetParent())->RayCast(from.x(), from.y(), from.z(),
-			newaxis.x, newaxis.y, newaxis.z,
+	static_cast<const palBulletPhysics*>(GetParent())->RayCast(ray.m_vOrigin.x, ray.m_vOrigin.y, ray.m_vOrigin.z,
+			ray.m_vDirection.x, ray.m_vDirection.y, ray.m_vDirection.z,
 			m_fRange, hit);
 	/*
 	 * Checking hit position and not just hit since if the hit
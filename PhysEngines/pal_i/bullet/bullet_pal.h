@@ -13,6 +13,7 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+	Version 0.2.02: 19/10/26 - Final leaf classes and body overrides in the static single engine build
 	Version 0.2.01: 16/04/09 - Soft body tetrahedron
 	Version 0.2.00: 15/04/09 - Soft body cloth
 	Version 0.1.06: 18/02/09 - Public set/get for Bullet functionality & documentation
@@ -73,6 +74,10 @@
 #pragma warning(disable : 4250)
 #endif
 
+/* BT_SCALAR_IS_PAL_FLOAT is 1 when btScalar and Float are the same type. Then a palMatrix4x4 is passed to and from
+   btTransform as the OpenGL matrix it already is (16 column major scalars, translation in 12-14), without a copy.
+   btVector3 holds 4 scalars, so palVector3 arrays are never reinterpreted as btVector3 arrays: meshes are handed
+   to Bullet as Float arrays with a 3 Float stride (PHY_FLOAT or PHY_DOUBLE), which it reads in place. */
 #ifdef DOUBLE_PRECISION
 #ifdef BT_USE_DOUBLE_PRECISION
 #define BT_SCALAR_IS_PAL_FLOAT 1
@@ -89,13 +94,14 @@
 
 class palBulletBodyBase;
 class palBulletDebugDraw;
+class palBulletActionCaller;
 
 /** Bullet Physics Class
 	Additionally Supports:
 		- Collision Detection
 		- Solver System
  */
-class palBulletPhysics: public palPhysics, public palCollisionDetectionExtended, public palSolver {
+class palBulletPhysics PAL_FINAL : public palPhysics, public palCollisionDetectionExtended, public palSolver {
 	friend class palBulletSoftBody;
 public:
 	palBulletPhysics();
@@ -144,20 +150,39 @@ public:
 	void RemoveRigidBody(palBulletBodyBase* body);
 	void ClearBroadPhaseCachePairs(palBulletBodyBase* body);
 
+	/** Returns the hull shape for a set of points, simplified according to the Bullet_ConvexHull* init properties.
+	 * Geometries built from identical points share one shape, so call ReleaseConvexHull instead of deleting it.
+	 * Because of the sharing, setting the margin of one convex geometry sets it for all the geometries with the same points.
+	 */
+	btConvexHullShape* AcquireConvexHull(const Float *pVertices, unsigned int nVertices);
+	void ReleaseConvexHull(btConvexHullShape* shape);
+
+	/// Compound shapes with at least this many children use a dynamic AABB tree, 0 if they never do.
+	unsigned int GetCompoundTreeThreshold() const { return m_nCompoundTreeThreshold; }
+	/** Builds the AABB tree of a compound shape, with all its children at once, before the next step.
+	 * Call DequeueCompoundTree before deleting the shape.
+	 */
+	void QueueCompoundTree(btCompoundShape* compound);
+	void DequeueCompoundTree(btCompoundShape* compound);
+
 	// This is a helper function to keep track of constraints being removed
 	void AddBulletConstraint(btTypedConstraint* constraint, bool disableCollisionsBetweenLinkedBodies);
 	// This is a helper function to keep track of constraints being removed
 	void RemoveBulletConstraint(btTypedConstraint* constraint);
 
-	virtual void AddAction(palAction *action);
-	virtual void RemoveAction(palAction *action);
-
 	PAL_VECTOR<short> m_CollisionMasks;
 
 protected:
 
 	virtual void Iterate(Float timestep);
-	virtual void CallActions(Float timestep);
+	virtual void BeginBatch();
+	virtual void EndBatch();
+	/** Saves the bodies, the time left over from the last fixed substep, and the contact points of the overlapping pairs.
+	 * Only the contacts of the pairs still overlapping are restored, and the constraints and soft bodies are not saved,
+	 * so results after a restore may differ slightly if pairs started or stopped overlapping in between.
+	 */
+	virtual bool SaveEngineState(palStateBuffer& state) const;
+	virtual bool RestoreEngineState(const palStateBuffer& state);
 
 	Float m_fFixedTimeStep;
 	int set_substeps;
@@ -172,8 +197,28 @@ protected:
 	btOverlappingPairCallback* m_ghostPairCallback;
 	palBulletDebugDraw*	m_pbtDebugDraw;
 
-	// map of pal actions to bullet actions so they can be cleaned up.
-	PAL_MAP<palAction*, btActionInterface*> m_BulletActions;
+	// calls the pal actions before the constraints are solved in each substep
+	friend class palBulletActionCaller;
+	palBulletActionCaller* m_pActionCaller;
+
+	struct SharedHull {
+		btConvexHullShape* m_pShape;
+		PAL_VECTOR<Float> m_Vertices; //!< the input points, to tell apart inputs with the same hash
+		unsigned int m_nRefs;
+	};
+	// shared hull shapes by the hash of their input points
+	PAL_MAP<unsigned long, PAL_VECTOR<SharedHull> > m_SharedHulls;
+	PAL_MAP<btConvexHullShape*, unsigned long> m_SharedHullKeys;
+	unsigned int m_nHullMaxVertices;
+	bool m_bHullPolyhedralFeatures;
+
+	unsigned int m_nCompoundTreeThreshold;
+	PAL_VECTOR<btCompoundShape*> m_CompoundTreeQueue;
+	void BuildCompoundTrees();
+
+	// bodies added during a batch, they are added to the world together in EndBatch
+	bool m_bBatching;
+	PAL_VECTOR<palBulletBodyBase*> m_BatchBodies;
 
 	FACTORY_CLASS(palBulletPhysics,palPhysics,Bullet,1)
 };
@@ -235,20 +280,20 @@ public:
 	//	virtual void SetTorque(Float tx, Float ty, Float tz);
 	//	virtual void GetTorque(palVector3& torque);
 
-	virtual void ApplyForce(Float fx, Float fy, Float fz);
-	virtual void ApplyTorque(Float tx, Float ty, Float tz);
+	virtual void ApplyForce(Float fx, Float fy, Float fz) PAL_FINAL;
+	virtual void ApplyTorque(Float tx, Float ty, Float tz) PAL_FINAL;
 
-	virtual void ApplyImpulse(Float fx, Float fy, Float fz);
-	virtual void ApplyAngularImpulse(Float fx, Float fy, Float fz);
+	virtual void ApplyImpulse(Float fx, Float fy, Float fz) PAL_FINAL;
+	virtual void ApplyAngularImpulse(Float fx, Float fy, Float fz) PAL_FINAL;
 
-	virtual void GetLinearVelocity(palVector3& velocity) const;
-	virtual void GetAngularVelocity(palVector3& velocity_rad) const;
+	virtual void GetLinearVelocity(palVector3& velocity) const PAL_FINAL;
+	virtual void GetAngularVelocity(palVector3& velocity_rad) const PAL_FINAL;
 
-	virtual void SetLinearVelocity(const palVector3& velocity);
-	virtual void SetAngularVelocity(const palVector3& velocity_rad);
+	virtual void SetLinearVelocity(const palVector3& velocity) PAL_FINAL;
+	virtual void SetAngularVelocity(const palVector3& velocity_rad) PAL_FINAL;
 
 	//@return if the body is active or sleeping
-	virtual bool IsActive() const;
+	virtual bool IsActive() const PAL_FINAL;
 
 	virtual void SetActive(bool active);
 
@@ -270,7 +315,7 @@ private:
 	static const std::bitset<DUMMY_ACTIVATION_SETTING_TYPE> SUPPORTED_SETTINGS;
 };
 
-class palBulletGenericBody : virtual public palBulletBody, public palGenericBody {
+class palBulletGenericBody PAL_FINAL : virtual public palBulletBody, public palGenericBody {
 public:
 	palBulletGenericBody();
 	virtual ~palBulletGenericBody();
@@ -316,6 +361,8 @@ protected:
 	bool IsUsingConcaveShape() const;
 	bool IsUsingOneCenteredGeometry() const;
 	void InitCompoundIfNull();
+	void DeleteCompound();
+	void QueueCompoundTreeIfLarge();
 private:
 	bool m_bGravityEnabled;
 	btCompoundShape* m_pCompound;
@@ -340,7 +387,7 @@ protected:
 	btCollisionShape* m_pbtShape;
 };
 
-class palBulletBoxGeometry : public palBulletGeometry, public palBoxGeometry  {
+class palBulletBoxGeometry PAL_FINAL : public palBulletGeometry, public palBoxGeometry  {
 public:
 	palBulletBoxGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float width, Float height, Float depth, Float mass);
@@ -350,7 +397,7 @@ protected:
 	FACTORY_CLASS(palBulletBoxGeometry,palBoxGeometry,Bullet,1)
 };
 
-class palBulletSphereGeometry : public palSphereGeometry, public palBulletGeometry {
+class palBulletSphereGeometry PAL_FINAL : public palSphereGeometry, public palBulletGeometry {
 public:
 	palBulletSphereGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float mass);
@@ -360,7 +407,7 @@ protected:
 	FACTORY_CLASS(palBulletSphereGeometry,palSphereGeometry,Bullet,1)
 };
 
-class palBulletCapsuleGeometry : public palCapsuleGeometry, public palBulletGeometry {
+class palBulletCapsuleGeometry PAL_FINAL : public palCapsuleGeometry, public palBulletGeometry {
 public:
 	palBulletCapsuleGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float length, Float mass);
@@ -370,7 +417,7 @@ protected:
 	FACTORY_CLASS(palBulletCapsuleGeometry,palCapsuleGeometry,Bullet,1)
 };
 
-class palBulletCylinderGeometry : public palCylinderGeometry, public palBulletGeometry {
+class palBulletCylinderGeometry PAL_FINAL : public palCylinderGeometry, public palBulletGeometry {
 public:
 	palBulletCylinderGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float length, Float mass);
@@ -412,38 +459,65 @@ public:
 	virtual void Init(Float x, Float y, Float z, const Float *pVertices, int nVertices, const int *pIndices, int nIndices);
 	using palBulletBodyBase::GetLocationMatrix;
 protected:
+	/// Copies the mesh and builds its shape, without touching the world
+	void BuildShape(const Float *pVertices, int nVertices, const int *pIndices, int nIndices);
+	/// Makes the static body from the shape BuildShape made
+	void BuildMeshBody(Float x, Float y, Float z);
 	btBvhTriangleMeshShape *m_pbtTriMeshShape;
 	PAL_VECTOR<int> m_Indices;
 	PAL_VECTOR<Float> m_Vertices;
 	FACTORY_CLASS(palBulletTerrainMesh,palTerrainMesh,Bullet,1)
 };
 
+/** Bullet terrain heightmap.
+	Prepare builds the triangle mesh shape and its tree, Init only makes the body.
+*/
 class palBulletTerrainHeightmap : public palTerrainHeightmap, private palBulletTerrainMesh {
 public:
 	palBulletTerrainHeightmap();
+	virtual bool Prepare(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	virtual void Init(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	using palBulletBodyBase::GetLocationMatrix;
 protected:
 	FACTORY_CLASS(palBulletTerrainHeightmap,palTerrainHeightmap,Bullet,1)
 };
 
+/** Bullet static instance set.
+	The instances are the children of one static compound shape, so the whole set is a single object in the broadphase.
+	The compound keeps its children in a dynamic AABB tree.
+ */
+class palBulletStaticInstanceSet : public palStaticInstanceSet, virtual public palBulletBodyBase {
+public:
+	palBulletStaticInstanceSet();
+	virtual ~palBulletStaticInstanceSet();
+	virtual void Finalize();
+	virtual const palMatrix4x4& GetLocationMatrix() const;
+protected:
+	btCollisionShape *CreateShape(unsigned int instance) const;
+	btCompoundShape *m_pCompound;
+	PAL_VECTOR<btCollisionShape*> m_Shapes; //!< box, sphere and capsule shapes, shared by the instances with the same dimensions
+	PAL_VECTOR<btConvexHullShape*> m_Hulls; //!< one per convex shape, see palBulletPhysics::AcquireConvexHull
+	FACTORY_CLASS(palBulletStaticInstanceSet,palStaticInstanceSet,Bullet,1)
+};
+
 
-class palBulletConvexGeometry : public palBulletGeometry, public palConvexGeometry  {
+class palBulletConvexGeometry PAL_FINAL : public palBulletGeometry, public palConvexGeometry  {
 public:
 	palBulletConvexGeometry();
-	virtual ~palBulletConvexGeometry() {};
+	virtual ~palBulletConvexGeometry();
 	virtual void Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, Float mass);
 	virtual void Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, const int *pIndices, int nIndices, Float mass);
 protected:
 	using palConvexGeometry::CalculateInertia;
 	btConvexHullShape *m_pbtConvexShape;
+	bool m_bSharedHull; //!< m_pbtConvexShape belongs to the physics, see palBulletPhysics::AcquireConvexHull
 	void InternalInit(const Float *pVertices, unsigned int nVertices, const int *pIndices, int nIndices);
 	FACTORY_CLASS(palBulletConvexGeometry,palConvexGeometry,Bullet,1)
 };
 
 class btTriangleInfoMap;
 
-class palBulletConcaveGeometry : public palBulletGeometry, public palConcaveGeometry  {
+class palBulletConcaveGeometry PAL_FINAL : public palBulletGeometry, public palConcaveGeometry  {
 public:
 	palBulletConcaveGeometry();
 	virtual ~palBulletConcaveGeometry();
@@ -475,6 +549,7 @@ public:
 	palBulletPSDSensor();
 	virtual void Init(palBody *body, Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range); //position, direction
 	virtual Float GetDistance() const;
+	virtual bool GetWorldRay(const palMatrix4x4& bodyLocation, palRay& ray) const;
 protected:
 	Float m_fRelativePosX;
 	Float m_fRelativePosY;
@@ -668,15 +743,15 @@ inline void convertPalMatToBtTransform(btTransform& xform, const palMatrix4x4& p
 
 inline void convertBtTransformToPalMat(palMatrix4x4& palMat, const btTransform& xform)
 {
-//#if BT_SCALAR_IS_PAL_FLOAT
-//	xform.getOpenGLMatrix(palMat._mat);
-//#else
+#if BT_SCALAR_IS_PAL_FLOAT
+	xform.getOpenGLMatrix(palMat._mat);
+#else
 	btScalar mat[4*4];
 	xform.getOpenGLMatrix(mat);
 	for (unsigned i = 0; i < 16; ++i) {
 		palMat._mat[i] = Float(mat[i]);
 	}
-//#endif
+#endif
 }
 
 #ifdef STATIC_CALLHACK
@@ -17,6 +17,7 @@
  -get to 1.0 (ie: same as pal.h)
  */
 #include <pal/pal.inl>
+#include <pal/palStateBuffer.h>
 
 #ifndef NDEBUG
 #ifdef MICROSOFT_VC
@@ -28,6 +29,7 @@
 #endif
 
 #include <cassert>
+#include <algorithm>
 
 FACTORY_CLASS_IMPLEMENTATION_BEGIN_GROUP
 ;	//FACTORY_CLASS_IMPLEMENTATION(palODEMaterial);
@@ -41,6 +43,7 @@ FACTORY_CLASS_IMPLEMENTATION(palODEConvexGeometry);
 FACTORY_CLASS_IMPLEMENTATION(palODEConcaveGeometry);
 
 FACTORY_CLASS_IMPLEMENTATION(palODEGenericBody);
+FACTORY_CLASS_IMPLEMENTATION(palODEStaticInstanceSet);
 
 FACTORY_CLASS_IMPLEMENTATION(palODERigidLink);
 FACTORY_CLASS_IMPLEMENTATION(palODESphericalLink);
@@ -52,6 +55,8 @@ FACTORY_CLASS_IMPLEMENTATION(palODETerrainPlane);
 FACTORY_CLASS_IMPLEMENTATION(palODETerrainMesh);
 FACTORY_CLASS_IMPLEMENTATION(palODETerrainHeightmap);
 
+FACTORY_CLASS_IMPLEMENTATION(palODEPSDSensor);
+
 FACTORY_CLASS_IMPLEMENTATION(palODEMotor);
 
 FACTORY_CLASS_IMPLEMENTATION_END_GROUP;
@@ -62,6 +67,33 @@ FACTORY_CLASS_IMPLEMENTATION_END_GROUP;
 static dWorldID g_world;
 static dSpaceID g_space;
 static dJointGroupID g_contactgroup;
+#define MAX_CONTACTS 8 // maximum number of contact points per body
+dContact g_contactArray[MAX_CONTACTS];
+static int g_maxContactsPerPair = 4; // contacts kept per pair after reduction, see ReduceContacts
+static dReal g_contactMergeDistance = dReal(0.001);
+static int g_quickStepIterations = 0; // 0 steps with dWorldStep instead of dWorldQuickStep
+static bool g_warmStart = false;
+static dReal g_warmStartDistance = dReal(0.05);
+static dReal g_warmStartScale = dReal(0.5);
+#ifdef dQUICKSTEP_DETERMINISTIC
+static dThreadingImplementationID g_threading = NULL; // NULL steps on the calling thread only
+static dThreadingThreadPoolID g_threadPool = NULL;
+#endif
+
+/* A contact of the last step, kept so the lambda QuickStep found for it can start off the matching contact of this step.
+ * Contacts are matched by geom pair (and instance, for static instance sets) and the features of both geoms they are on,
+ * then by the nearest position, so the order the collider returns them in does not matter.
+ */
+struct ODECachedContact {
+	dGeomID o1, o2;
+	int instance1, instance2;
+	int feature1, feature2; //!< see ContactFeature
+	dReal pos[3];
+	dReal lambda[6];
+	dJointID joint; //!< the contact joint made this step, or for the last step's contacts the one it was matched to
+};
+static PAL_VECTOR<ODECachedContact> g_contactCache; // the last step's contacts, sorted by pair
+static PAL_VECTOR<ODECachedContact> g_stepContacts; // this step's contacts
 
 /*
  palODEMaterial::palODEMaterial() {
@@ -72,36 +104,34 @@ static dJointGroupID g_contactgroup;
  }
  */
 
-static dGeomID CreateTriMesh(const Float *pVertices, int nVertices, const int *pIndices, int nIndices) {
-	dGeomID odeGeom;
-	int i;
-	dVector3 *spacedvert = new dVector3[nVertices];
-#if 0
-	dTriIndex *dIndices = new dTriIndex[nIndices];
-#else
-	int *dIndices = new int[nIndices];
-#endif
-
-	for (i = 0; i < nVertices; i++) {
-		spacedvert[i][0] = pVertices[i * 3 + 0];
-		spacedvert[i][1] = pVertices[i * 3 + 1];
-		spacedvert[i][2] = pVertices[i * 3 + 2];
+/* Builds a trimesh from PAL arrays. The vertices and indices are read by ODE in place when their layout matches
+   (see ODE_REAL_IS_PAL_FLOAT) and the caller keeps them for the life of the geom (bPersistentVertices, bPersistentIndices),
+   otherwise they are converted into buffers. */
+static dGeomID CreateTriMesh(const Float *pVertices, int nVertices, bool bPersistentVertices,
+		const int *pIndices, int nIndices, bool bPersistentIndices, palODEMeshBuffers& buffers) {
+	const void *vertices = pVertices;
+	if (!ODE_REAL_IS_PAL_FLOAT || !bPersistentVertices) {
+		buffers.m_Vertices.assign(pVertices, pVertices + nVertices * 3);
+		vertices = buffers.m_Vertices.empty() ? NULL : &buffers.m_Vertices[0];
 	}
-
-	for (i = 0; i < nIndices; i++) {
-		dIndices[i] = pIndices[i];
+	const void *indices = pIndices;
+	if (!ODE_TRIINDEX_IS_INT || !bPersistentIndices) {
+		buffers.m_Indices.assign(pIndices, pIndices + nIndices);
+		indices = buffers.m_Indices.empty() ? NULL : &buffers.m_Indices[0];
 	}
 
 	// build the trimesh data
 	dTriMeshDataID data = dGeomTriMeshDataCreate();
-	dGeomTriMeshDataBuildSimple(data, (dReal*)spacedvert, nVertices, (const dTriIndex*)dIndices,
-			nIndices);
+#if defined(dDOUBLE)
+	dGeomTriMeshDataBuildDouble(data, vertices, 3 * sizeof(dReal), nVertices, indices, nIndices, 3 * sizeof(dTriIndex));
+#else
+	dGeomTriMeshDataBuildSingle(data, vertices, 3 * sizeof(dReal), nVertices, indices, nIndices, 3 * sizeof(dTriIndex));
+#endif
 	// build the trimesh geom
-	odeGeom = dCreateTriMesh(g_space, data, 0, 0, 0);
-	return odeGeom;
+	return dCreateTriMesh(g_space, data, 0, 0, 0);
 }
 
-palODEPhysics::palODEPhysics() : m_initialized(false) {
+palODEPhysics::palODEPhysics() : m_initialized(false), m_RayBatchSpace(0) {
 }
 
 const char* palODEPhysics::GetVersion() const {
@@ -125,6 +155,14 @@ void palODEPhysics::GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>& de
 	descriptions["ODE_NoInitOrShutdown"] = "Defaults to FALSE.  If set to true, the global ode init won't be called, nor the global shutdown.  This is so you can manage this yourself.";
 	descriptions["WorldERP"] = "The Global value of the Error Reduction Parameter. Default is 0.2. See http://www.ode.org/ode-latest-userguide.html#sec_3_8_2";
 	descriptions["WorldCFM"] = "The Global value of the Constraint Force Mixing Parameter. Default is 10^-5 (single) or 10^-10 (double).  See http://www.ode.org/ode-latest-userguide.html#sec_3_8_2";
+	descriptions["ODE_MaxContactsPerPair"] = "Defaults to 4, from 1 to 8.  The contacts of each colliding pair are reduced to this many, keeping the deepest and those that span the contact patch, before contact joints are made.  8 keeps every contact ODE generates.";
+	descriptions["ODE_ContactMergeDistance"] = "Defaults to 0.001.  Contacts of a pair closer than this to a deeper one are merged into it.  0 disables merging.";
+	descriptions["ODE_QuickStepIterations"] = "Defaults to 0, which steps with dWorldStep.  If set, the world is stepped with dWorldQuickStep using this many iterations.";
+	descriptions["ODE_WarmStart"] = "Defaults to FALSE.  If set to true and ODE_QuickStepIterations is set, each contact starts from the force its match had on the last step, so fewer iterations keep stacks stable.  Needs the ODE bundled with PAL.";
+	descriptions["ODE_WarmStartDistance"] = "Defaults to 0.05.  How far a contact can be from one on the same features of the same pair on the last step and still be matched to it for ODE_WarmStart.";
+	descriptions["ODE_WarmStartScale"] = "Defaults to 0.5.  The fraction of the force of the matched contact that ODE_WarmStart starts from, from 0 to 1.  Values near 1 make stacks bounce.";
+	descriptions["ODE_Threads"] = "Defaults to 1.  The number of threads stepping the world.  Islands are stepped in parallel, and big islands with ODE_QuickStepIterations set are also solved by several threads.  Needs the ODE bundled with PAL, built with its builtin threading.";
+	descriptions["ODE_Deterministic"] = "Defaults to FALSE.  If set to true, a world stepped with ODE_QuickStepIterations gives the same result whatever ODE_Threads is, at the cost of stepping the islands one at a time.  Needs the ODE bundled with PAL.";
 }
 
 void palODEPhysics::Init(const palPhysicsDesc& desc) {
@@ -146,6 +184,42 @@ void palODEPhysics::Init(const palPhysicsDesc& desc) {
 	dReal cfm = GetInitProperty("WorldCFM", dWorldGetCFM(g_world), dReal(0.0), dReal(1.0));
 	dWorldSetCFM (g_world, cfm);
 
+	g_maxContactsPerPair = GetInitProperty("ODE_MaxContactsPerPair", 4, 1, MAX_CONTACTS);
+	g_contactMergeDistance = GetInitProperty("ODE_ContactMergeDistance", dReal(0.001), dReal(0.0), dReal(1.0));
+
+	g_quickStepIterations = GetInitProperty("ODE_QuickStepIterations", 0, 0, 1000);
+	if (g_quickStepIterations > 0) {
+		dWorldSetQuickStepNumIterations(g_world, g_quickStepIterations);
+	}
+#ifdef dQUICKSTEP_WARM_STARTING
+	g_warmStart = g_quickStepIterations > 0 && GetInitProperty("ODE_WarmStart") == "true";
+	dWorldSetQuickStepWarmStarting(g_world, g_warmStart ? 1 : 0);
+#else
+	g_warmStart = false;
+#endif
+	g_warmStartDistance = GetInitProperty("ODE_WarmStartDistance", dReal(0.05), dReal(0.0), dReal(10.0));
+	g_warmStartScale = GetInitProperty("ODE_WarmStartScale", dReal(0.5), dReal(0.0), dReal(1.0));
+#ifdef dQUICKSTEP_DETERMINISTIC
+	// ODE built without its builtin threading has no implementation to allocate, and steps single threaded
+	int threads = GetInitProperty("ODE_Threads", 1, 1, 64);
+	if (threads > 1) {
+		g_threading = dThreadingAllocateMultiThreadedImplementation();
+		if (g_threading != NULL) {
+			g_threadPool = dThreadingAllocateThreadPool(threads, 0, dAllocateFlagBasicData, NULL);
+			if (g_threadPool != NULL) {
+				dThreadingThreadPoolServeMultiThreadedImplementation(g_threadPool, g_threading);
+				dWorldSetStepThreadingImplementation(g_world, dThreadingImplementationGetFunctions(g_threading), g_threading);
+			} else {
+				dThreadingFreeImplementation(g_threading);
+				g_threading = NULL;
+			}
+		}
+	}
+	dWorldSetQuickStepDeterministic(g_world, GetInitProperty("ODE_Deterministic") == "true" ? 1 : 0);
+#endif
+	g_contactCache.clear();
+	g_stepContacts.clear();
+
 	m_initialized = true;
 }
 ;
@@ -162,8 +236,176 @@ typedef PAL_MULTIMAP <palBodyBase*, palBodyBase*> ListenMap;
 typedef ListenMap::iterator ListenIterator;
 typedef ListenMap::const_iterator ListenConstIterator;
 ListenMap pallisten;
-#define MAX_CONTACTS 8 // maximum number of contact points per body
-dContact g_contactArray[MAX_CONTACTS];
+
+static dReal ContactDistance2(const dContact& a, const dContact& b) {
+	dReal d[3] = { a.geom.pos[0] - b.geom.pos[0], a.geom.pos[1] - b.geom.pos[1], a.geom.pos[2] - b.geom.pos[2] };
+	return d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+}
+
+// twice the squared area of the triangle a, b, c
+static dReal ContactArea2(const dContact& a, const dContact& b, const dContact& c) {
+	dReal u[3], v[3];
+	for (int i = 0; i < 3; i++) {
+		u[i] = b.geom.pos[i] - a.geom.pos[i];
+		v[i] = c.geom.pos[i] - a.geom.pos[i];
+	}
+	dReal n[3] = { u[1]*v[2] - u[2]*v[1], u[2]*v[0] - u[0]*v[2], u[0]*v[1] - u[1]*v[0] };
+	return n[0]*n[0] + n[1]*n[1] + n[2]*n[2];
+}
+
+static bool ContactPairLess(const ODECachedContact& a, const ODECachedContact& b) {
+	if (a.o1 != b.o1) return a.o1 < b.o1;
+	if (a.o2 != b.o2) return a.o2 < b.o2;
+	if (a.instance1 != b.instance1) return a.instance1 < b.instance1;
+	if (a.instance2 != b.instance2) return a.instance2 < b.instance2;
+	if (a.feature1 != b.feature1) return a.feature1 < b.feature1;
+	return a.feature2 < b.feature2;
+}
+
+/* The feature of geom g the world point p is on. For a box, each axis of its own frame tells whether p is towards
+ * the negative end, the middle or the positive end, which separates its corners, edges and faces.
+ * A trimesh uses the triangle the collider reported (side), anything else is a single feature.
+ */
+static int ContactFeature(dGeomID g, const dReal *p, int side) {
+	switch (dGeomGetClass(g)) {
+	case dBoxClass: {
+		dVector3 lengths;
+		dGeomBoxGetLengths(g, lengths);
+		const dReal *pos = dGeomGetPosition(g);
+		const dReal *R = dGeomGetRotation(g);
+		dReal d[3] = { p[0] - pos[0], p[1] - pos[1], p[2] - pos[2] };
+		int feature = 0;
+		for (int a = 0; a < 3; a++) {
+			// column a of R is axis a of the box
+			dReal l = R[a]*d[0] + R[4+a]*d[1] + R[8+a]*d[2];
+			dReal quarter = lengths[a] * dReal(0.25);
+			feature = feature * 3 + (l > quarter ? 2 : (l < -quarter ? 0 : 1));
+		}
+		return feature;
+	}
+	case dTriMeshClass:
+		return side;
+	default:
+		return 0;
+	}
+}
+
+/* Starts a new contact joint from the lambda of the nearest unmatched contact on the same features on the last step,
+ * and remembers the joint so its lambda can be cached after the step.
+ * The cached lambda is scaled down and kept inside the friction cone: it includes the push QuickStep gave against
+ * the penetration of the last step, and starting from all of it made stacks bounce.
+ */
+static void WarmStartContact(dJointID joint, const dContact& contact, dGeomID o1, dGeomID o2, int instance1, int instance2) {
+	ODECachedContact entry;
+	entry.o1 = o1;
+	entry.o2 = o2;
+	entry.instance1 = instance1;
+	entry.instance2 = instance2;
+	entry.feature1 = ContactFeature(o1, contact.geom.pos, contact.geom.side1);
+	entry.feature2 = ContactFeature(o2, contact.geom.pos, contact.geom.side2);
+	for (int i = 0; i < 3; i++) entry.pos[i] = contact.geom.pos[i];
+	for (int i = 0; i < 6; i++) entry.lambda[i] = 0;
+	entry.joint = joint;
+
+	ODECachedContact* best = NULL;
+	dReal bestDistance2 = g_warmStartDistance * g_warmStartDistance;
+	PAL_VECTOR<ODECachedContact>::iterator it = std::lower_bound(g_contactCache.begin(), g_contactCache.end(), entry, ContactPairLess);
+	for (; it != g_contactCache.end() && !ContactPairLess(entry, *it); ++it) {
+		if (it->joint != 0) continue;
+		dReal d[3] = { it->pos[0] - entry.pos[0], it->pos[1] - entry.pos[1], it->pos[2] - entry.pos[2] };
+		dReal distance2 = d[0]*d[0] + d[1]*d[1] + d[2]*d[2];
+		if (distance2 <= bestDistance2) {
+			bestDistance2 = distance2;
+			best = &*it;
+		}
+	}
+	if (best != NULL) {
+		best->joint = joint;
+#ifdef dQUICKSTEP_WARM_STARTING
+		// a contact joint has the normal row, then up to two friction rows
+		dReal lambda[6] = { 0, 0, 0, 0, 0, 0 };
+		lambda[0] = std::max(best->lambda[0], dReal(0)) * g_warmStartScale;
+		dReal mu[2] = { contact.surface.mu, (contact.surface.mode & dContactMu2) ? contact.surface.mu2 : contact.surface.mu };
+		for (int i = 0; i < 2; i++) {
+			lambda[i + 1] = best->lambda[i + 1] * g_warmStartScale;
+			if (mu[i] < dInfinity) {
+				dReal limit = mu[i] * lambda[0];
+				lambda[i + 1] = std::max(std::min(lambda[i + 1], limit), -limit);
+			}
+		}
+		dJointSetLambda(joint, lambda);
+#endif
+	}
+	g_stepContacts.push_back(entry);
+}
+
+// reads back the lambda of this step's contact joints, before they are destroyed, and makes them the cache for the next step
+static void UpdateContactCache() {
+	for (unsigned int i = 0; i < g_stepContacts.size(); i++) {
+#ifdef dQUICKSTEP_WARM_STARTING
+		dJointGetLambda(g_stepContacts[i].joint, g_stepContacts[i].lambda);
+#endif
+		g_stepContacts[i].joint = 0;
+	}
+	std::sort(g_stepContacts.begin(), g_stepContacts.end(), ContactPairLess);
+	g_contactCache.swap(g_stepContacts);
+	g_stepContacts.clear();
+}
+
+/* Reduces the contacts of a pair in place, and returns how many are left.
+ * Points closer than the merge distance to a deeper one are dropped. If more than maxContacts remain,
+ * the deepest is kept, then the one furthest from it, then the one making the largest triangle with those,
+ * and after that each next point is the one furthest from all the points kept so far.
+ * This keeps the outline of the contact patch, which is what keeps stacked bodies stable.
+ */
+static int ReduceContacts(dContact* contacts, int count, int maxContacts, dReal mergeDistance) {
+	// deepest first, so merging keeps the deepest of each cluster
+	for (int i = 1; i < count; i++) {
+		for (int j = i; j > 0 && contacts[j].geom.depth > contacts[j - 1].geom.depth; j--) {
+			std::swap(contacts[j], contacts[j - 1]);
+		}
+	}
+	if (mergeDistance > 0) {
+		dReal merge2 = mergeDistance * mergeDistance;
+		int kept = 0;
+		for (int i = 0; i < count; i++) {
+			bool duplicate = false;
+			for (int j = 0; j < kept && !duplicate; j++) {
+				duplicate = ContactDistance2(contacts[i], contacts[j]) < merge2;
+			}
+			if (!duplicate) {
+				contacts[kept++] = contacts[i];
+			}
+		}
+		count = kept;
+	}
+	if (maxContacts <= 0 || count <= maxContacts) {
+		return count;
+	}
+	for (int k = 1; k < maxContacts; k++) {
+		int best = k;
+		dReal bestScore = -1;
+		for (int i = k; i < count; i++) {
+			dReal score;
+			if (k == 1) {
+				score = ContactDistance2(contacts[i], contacts[0]);
+			} else if (k == 2) {
+				score = ContactArea2(contacts[0], contacts[1], contacts[i]);
+			} else {
+				score = ContactDistance2(contacts[i], contacts[0]);
+				for (int j = 1; j < k; j++) {
+					score = std::min(score, ContactDistance2(contacts[i], contacts[j]));
+				}
+			}
+			if (score > bestScore) {
+				bestScore = score;
+				best = i;
+			}
+		}
+		std::swap(contacts[k], contacts[best]);
+	}
+	return maxContacts;
+}
 
 
 static bool listenCollision(palBodyBase* body1, palBodyBase* body2) {
@@ -195,6 +437,9 @@ bool IsCollisionResponseEnabled(dBodyID dbody) {
 	return true;
 }
 
+static void CollideGeoms(dGeomID o1, dGeomID o2, palBodyBase* pb1, palBodyBase* pb2,
+		palMaterial* pm1, palMaterial* pm2, int instance1, int instance2);
+
 /* this is called by dSpaceCollide when two objects in space are
  * potentially colliding.
  */
@@ -216,33 +461,44 @@ static void nearCallback(void *data, dGeomID o1, dGeomID o2) {
 		return;
 	}
 
-	int i = 0;
 	dBodyID b1 = dGeomGetBody(o1);
 	dBodyID b2 = dGeomGetBody(o2);
 
-	palBodyBase* pb1 = NULL,* pb2 = NULL;
-	if (b1 != 0)
-		pb1 = static_cast<palBodyBase *> (dBodyGetData(b1));
-	if (b2 != 0)
-		pb2 = static_cast<palBodyBase *> (dBodyGetData(b2));
+	palBodyBase* pb1 = (b1 != 0) ? static_cast<palBodyBase *> (dBodyGetData(b1)) : NULL;
+	palBodyBase* pb2 = (b2 != 0) ? static_cast<palBodyBase *> (dBodyGetData(b2)) : NULL;
+	// nothing PAL knows about, eg: two static geoms
+	if (pb1 == NULL && pb2 == NULL)
+		return;
 
 	if (b1 != 0 && b2 != 0 && dAreConnectedExcluding(b1, b2, dJointTypeContact))
 		return;
 
+	palMaterial * pm1 = (pb1 != NULL) ? pb1->GetMaterial() : NULL;
+	palMaterial * pm2 = (pb2 != NULL) ? pb2->GetMaterial() : NULL;
+	CollideGeoms(o1, o2, pb1, pb2, pm1, pm2, -1, -1);
+}
+
+/* Collides two geoms, creates the contact joints and reports the contacts.
+ * The materials are passed in because a geom of a static instance set has its own,
+ * as is the instance (-1 for anything else).
+ */
+static void CollideGeoms(dGeomID o1, dGeomID o2, palBodyBase* pb1, palBodyBase* pb2,
+		palMaterial* pm1, palMaterial* pm2, int instance1, int instance2) {
+	int i = 0;
+	dBodyID b1 = dGeomGetBody(o1);
+	dBodyID b2 = dGeomGetBody(o2);
+
 	bool response = true;
 	if (b1)
 		response = response && IsCollisionResponseEnabled(b1);
 	if (b2)
 		response = response && IsCollisionResponseEnabled(b2);
 
-
-
-
 	palMaterialDesc finalMaterial;
-	palMaterial * pm1 = pb1->GetMaterial();
-	palMaterial * pm2 = pb2->GetMaterial();
 
-	palPhysics* curPhysics = static_cast<palPhysics*>(pb1->GetParent());
+	if (pb1 == NULL && pb2 == NULL)
+		return;
+	palPhysics* curPhysics = static_cast<palPhysics*>((pb1 != NULL ? pb1 : pb2)->GetParent());
 	palCollisionDetection* curCollision = curPhysics->asCollisionDetection();
 	if (curCollision == nullptr) {
 		static bool printed = false;
@@ -256,7 +512,19 @@ static void nearCallback(void *data, dGeomID o1, dGeomID o2) {
 
 	palMaterials* materials = curPhysics->GetMaterials();
 
+	// The material pair is the same for every contact, only a custom callback needs to see each one.
+	const palMaterialPair* matPair = NULL;
+	bool perContactMaterial = false;
+	if (materials != NULL && pm1 != NULL && pm2 != NULL) {
+		matPair = materials->GetInteraction(pm1->GetId(), pm2->GetId());
+		// without the table, fall back to combining the materials for each contact
+		perContactMaterial = (matPair == NULL) || matPair->HasCallback();
+	}
+
 	int numc = dCollide(o1, o2, MAX_CONTACTS, &g_contactArray[0].geom, sizeof(dContact));
+	if (numc > 1) {
+		numc = ReduceContacts(g_contactArray, numc, g_maxContactsPerPair, g_contactMergeDistance);
+	}
 
 	if (numc > 0) {
 		for (i = 0; i < numc; i++) {
@@ -272,33 +540,54 @@ static void nearCallback(void *data, dGeomID o1, dGeomID o2) {
 
 			cp.m_pBody1 = pb1;
 			cp.m_pBody2 = pb2;
+			cp.m_nInstance1 = instance1;
+			cp.m_nInstance2 = instance2;
 
-			if (!materials->HandleCustomInteraction(pm1, pm2, finalMaterial, cp, true))
+			g_contactArray[i].surface.mode = dContactBounce //| dContactSoftERP | dContactSoftCFM
+					| dContactApprox1;
+			//remove dContactSoftCFM | dContactApprox1 for bounce..
+			if (perContactMaterial)
 			{
-				finalMaterial.m_fStatic = Float(dInfinity);
-				finalMaterial.m_fRestitution = Float(0.1);
-				finalMaterial.m_bEnableAnisotropicFriction = false;
+				if (!materials->HandleCustomInteraction(pm1, pm2, finalMaterial, cp, true))
+				{
+					finalMaterial.m_fStatic = Float(dInfinity);
+					finalMaterial.m_fRestitution = Float(0.1);
+					finalMaterial.m_bEnableAnisotropicFriction = false;
+				}
+				else
+				{
+					for (unsigned vidx = 0; vidx < 3; ++vidx)
+					{
+						g_contactArray[i].geom.pos[vidx] = dReal(cp.m_vContactPosition[vidx]);
+						g_contactArray[i].geom.normal[vidx] = dReal(cp.m_vContactNormal[vidx]);
+					}
+					g_contactArray[i].geom.depth = dReal(cp.m_fDistance);
+				}
+
+				g_contactArray[i].surface.mu = finalMaterial.m_fStatic;
+				g_contactArray[i].surface.bounce = finalMaterial.m_fRestitution;
+				if (finalMaterial.m_bEnableAnisotropicFriction)
+				{
+					g_contactArray[i].surface.mu = finalMaterial.m_fStatic * finalMaterial.m_vStaticAnisotropic[0];
+					g_contactArray[i].surface.mode |= dContactMu2;
+					g_contactArray[i].surface.mu2 = finalMaterial.m_fStatic * finalMaterial.m_vStaticAnisotropic[1];
+				}
 			}
-			else
+			else if (matPair != NULL)
 			{
-				for (unsigned vidx = 0; vidx < 3; ++vidx)
+				g_contactArray[i].surface.mu = matPair->m_fStatic;
+				g_contactArray[i].surface.bounce = matPair->m_fRestitution;
+				if (matPair->m_nFlags & PAL_MATERIAL_PAIR_ANISOTROPIC)
 				{
-					g_contactArray[i].geom.pos[vidx] = dReal(cp.m_vContactPosition[vidx]);
-					g_contactArray[i].geom.normal[vidx] = dReal(cp.m_vContactNormal[vidx]);
+					g_contactArray[i].surface.mu = matPair->m_fStaticAnisotropic[0];
+					g_contactArray[i].surface.mode |= dContactMu2;
+					g_contactArray[i].surface.mu2 = matPair->m_fStaticAnisotropic[1];
 				}
-				g_contactArray[i].geom.depth = dReal(cp.m_fDistance);
 			}
-
-			g_contactArray[i].surface.mode = dContactBounce //| dContactSoftERP | dContactSoftCFM
-					| dContactApprox1;
-			//remove dContactSoftCFM | dContactApprox1 for bounce..
-			g_contactArray[i].surface.mu = finalMaterial.m_fStatic;
-			g_contactArray[i].surface.bounce = finalMaterial.m_fRestitution;
-			if (finalMaterial.m_bEnableAnisotropicFriction)
+			else
 			{
-				g_contactArray[i].surface.mu = finalMaterial.m_fStatic * finalMaterial.m_vStaticAnisotropic[0];
-				g_contactArray[i].surface.mode |= dContactMu2;
-				g_contactArray[i].surface.mu2 = finalMaterial.m_fStatic * finalMaterial.m_vStaticAnisotropic[1];
+				g_contactArray[i].surface.mu = dInfinity;
+				g_contactArray[i].surface.bounce = 0.1;
 			}
 			//			g_contactArray[i].surface.slip1 = 0.1; // friction
 			//			g_contactArray[i].surface.slip2 = 0.1;
@@ -309,19 +598,13 @@ static void nearCallback(void *data, dGeomID o1, dGeomID o2) {
 			{
 				dJointID c = dJointCreateContact(g_world, g_contactgroup, &g_contactArray[i]);
 				dJointAttach(c, b1, b2);
+				if (g_warmStart) {
+					WarmStartContact(c, g_contactArray[i], o1, o2, instance1, instance2);
+				}
 			}
 
-			bool dolisten = false;
-			if (pb1 != NULL)
-			{
-				dolisten = listenCollision(pb1, pb2);
-			}
-			else if (pb2 != NULL)
-			{
-				dolisten = listenCollision(pb2, pb1);
-			}
-
-			if (!dolisten) continue;
+			// either body may be NULL, listenCollision orders them itself
+			if (!listenCollision(pb1, pb2)) continue;
 
 			curPhysics->asCollisionDetection()->EmitContact(cp);
 		}
@@ -354,6 +637,9 @@ static void OdeRayCallback(void* data, dGeomID o1, dGeomID o2) {
 
 		dContactGeom &c = contactArray[closest];
 		palRayHit *phit = static_cast<palRayHit *> (data);
+		if (phit->m_bHit && phit->m_fDistance <= c.depth) {
+			return;
+		}
 		phit->Clear();
 		phit->SetHitPosition(c.pos[0], c.pos[1], c.pos[2]);
 		phit->SetHitNormal(c.normal[0], c.normal[1], c.normal[2]);
@@ -426,8 +712,85 @@ void palODEPhysics::RayCast(Float x, Float y, Float z, Float dx, Float dy, Float
 		palRayHit& hit) const {
 	dGeomID odeRayId = dCreateRay(0, range);
 	dGeomRaySet(odeRayId, x, y, z, dx, dy, dz);
+	hit.Clear();
 	dSpaceCollide2((dGeomID)ODEGetSpace(), odeRayId, &hit, &OdeRayCallback);
+	RayCastStaticInstanceSets(odeRayId, &hit, &OdeRayCallback);
+}
+
+void palODEPhysics::RayCastStaticInstanceSets(dGeomID ray, void *data, dNearCallback *callback) const {
+	for (unsigned int i = 0; i < m_StaticInstanceSets.size(); i++) {
+		const palODEStaticInstanceSet *set = m_StaticInstanceSets[i];
+		set->ODEQuery(ray, m_InstanceQuery);
+		for (unsigned int j = 0; j < m_InstanceQuery.size(); j++) {
+			callback(data, set->ODEGetGeom(m_InstanceQuery[j]), ray);
+		}
+	}
+}
+
+static void OdeRayBatchCallback(void* data, dGeomID o1, dGeomID o2) {
+	//o1 == world geom, o2 == ray from the batch space
+	if (dGeomIsSpace(o1) || dGeomIsSpace(o2)) {
+		dSpaceCollide2(o1, o2, data, &OdeRayBatchCallback);
+		return;
+	}
+	dContactGeom contactArray[MAX_CONTACTS];
+	int numColls = dCollide(o1, o2, MAX_CONTACTS, contactArray, sizeof(dContactGeom));
+	if (numColls == 0) {
+		return;
+	}
+
+	int closest = 0;
+	for (int i = 1; i < numColls; i++) {
+		if (contactArray[i].depth < contactArray[closest].depth) {
+			closest = i;
+		}
+	}
+
+	// every geom the ray touches reports here, keep the nearest.
+	dContactGeom &c = contactArray[closest];
+	palRayHit *phit = static_cast<palRayHit *> (dGeomGetData(o2));
+	if (phit->m_bHit && phit->m_fDistance <= c.depth) {
+		return;
+	}
+	phit->Clear();
+	phit->SetHitPosition(c.pos[0], c.pos[1], c.pos[2]);
+	phit->SetHitNormal(c.normal[0], c.normal[1], c.normal[2]);
+	phit->m_bHit = true;
 
+	phit->m_fDistance = c.depth;
+	phit->m_pBody = reinterpret_cast<palBodyBase*> (dGeomGetData(c.g1));
+}
+
+void palODEPhysics::RayCastBatch(const palRay* rays, palRayHit* hits, unsigned count) const {
+	if (count == 0) {
+		return;
+	}
+	// All rays go into one space so the world space is traversed once for the whole batch.
+	if (m_RayBatchSpace == 0) {
+		m_RayBatchSpace = dHashSpaceCreate(0);
+	}
+	while (m_RayBatchGeoms.size() < count) {
+		m_RayBatchGeoms.push_back(dCreateRay(m_RayBatchSpace, 1));
+	}
+	for (unsigned i = 0; i < m_RayBatchGeoms.size(); i++) {
+		dGeomID ray = m_RayBatchGeoms[i];
+		if (i < count) {
+			dGeomRaySetLength(ray, rays[i].m_fRange);
+			dGeomRaySet(ray, rays[i].m_vOrigin.x, rays[i].m_vOrigin.y, rays[i].m_vOrigin.z,
+					rays[i].m_vDirection.x, rays[i].m_vDirection.y, rays[i].m_vDirection.z);
+			dGeomSetData(ray, &hits[i]);
+			hits[i].Clear();
+			dGeomEnable(ray);
+		} else {
+			dGeomDisable(ray);
+		}
+	}
+	dSpaceCollide2((dGeomID)ODEGetSpace(), (dGeomID)m_RayBatchSpace, NULL, &OdeRayBatchCallback);
+	if (!m_StaticInstanceSets.empty()) {
+		for (unsigned i = 0; i < count; i++) {
+			RayCastStaticInstanceSets(m_RayBatchGeoms[i], NULL, &OdeRayBatchCallback);
+		}
+	}
 }
 
 void palODEPhysics::RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range,
@@ -439,6 +802,7 @@ void palODEPhysics::RayCast(Float x, Float y, Float z, Float dx, Float dy, Float
 	data.m_callback = &callback;
 	data.m_filter = groupFilter;
 	dSpaceCollide2((dGeomID)ODEGetSpace(), odeRayId, &data, &OdeRayCallbackCallback);
+	RayCastStaticInstanceSets(odeRayId, &data, &OdeRayCallbackCallback);
 }
 
 
@@ -530,13 +894,185 @@ void palODEPhysics::SetGravity(Float gravity_x, Float gravity_y, Float gravity_z
 void palODEPhysics::Iterate(Float timestep) {
 	ClearContacts();
 	dSpaceCollide(g_space, 0, &nearCallback);//evvvil
-	dWorldStep(g_world, timestep);
+	CollideStaticInstanceSets();
+	if (g_quickStepIterations > 0) {
+		dWorldQuickStep(g_world, timestep);
+	} else {
+		dWorldStep(g_world, timestep);
+	}
+	if (g_warmStart) {
+		UpdateContactCache();
+	}
 
 	dJointGroupEmpty(g_contactgroup);
 }
 
+/* The state is the world state (bodies and joint lambdas), the seed QuickStep reorders the joints with,
+ * the order of the geoms in the space and the contact cache used for warm starting.
+ * The space keeps the geoms that moved last at the front, and dSpaceCollide finds the pairs in that order,
+ * which is the order the contact joints are made and solved in, so it has to be restored for identical results.
+ */
+#ifdef dWORLD_SAVE_STATE
+static PAL_VECTOR<dGeomID> g_stateGeoms; // scratch for the geom order
+static PAL_VECTOR<dGeomID> g_stateGeomsSorted;
+#endif
+
+bool palODEPhysics::SaveEngineState(palStateBuffer& state) const {
+#ifdef dWORLD_SAVE_STATE
+	size_t worldSize = dWorldGetStateSize(g_world);
+	state.Write(worldSize);
+	dWorldSaveState(g_world, state.Append(worldSize));
+	state.Write(dRandGetSeed());
+
+	int geoms = dSpaceGetNumGeoms(g_space);
+	g_stateGeoms.resize(geoms);
+	for (int i = 0; i < geoms; i++) {
+		g_stateGeoms[i] = dSpaceGetGeom(g_space, i);
+	}
+	state.Write(geoms);
+	state.Write(g_stateGeoms.empty() ? NULL : &g_stateGeoms[0], geoms * sizeof(dGeomID));
+
+	size_t contacts = g_contactCache.size();
+	state.Write(contacts);
+	state.Write(g_contactCache.empty() ? NULL : &g_contactCache[0], contacts * sizeof(ODECachedContact));
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool palODEPhysics::RestoreEngineState(const palStateBuffer& state) {
+#ifdef dWORLD_SAVE_STATE
+	size_t worldSize;
+	if (!state.Read(worldSize) || worldSize != dWorldGetStateSize(g_world)) {
+		return false;
+	}
+	const void *world = state.Take(worldSize);
+	unsigned long seed;
+	int geoms;
+	if (world == NULL || !state.Read(seed) || !state.Read(geoms) || geoms != dSpaceGetNumGeoms(g_space)) {
+		return false;
+	}
+	g_stateGeoms.resize(geoms);
+	size_t contacts;
+	if (!state.Read(g_stateGeoms.empty() ? NULL : &g_stateGeoms[0], geoms * sizeof(dGeomID)) || !state.Read(contacts)
+			|| contacts * sizeof(ODECachedContact) != state.GetRemaining()) {
+		return false;
+	}
+	// the space has to hold the same geoms, the saved ones may have been destroyed
+	g_stateGeomsSorted.resize(geoms);
+	for (int i = 0; i < geoms; i++) {
+		g_stateGeomsSorted[i] = dSpaceGetGeom(g_space, i);
+	}
+	bool sameOrder = g_stateGeomsSorted == g_stateGeoms;
+	if (!sameOrder) {
+		std::sort(g_stateGeomsSorted.begin(), g_stateGeomsSorted.end());
+		PAL_VECTOR<dGeomID> saved(g_stateGeoms);
+		std::sort(saved.begin(), saved.end());
+		if (saved != g_stateGeomsSorted) {
+			return false;
+		}
+	}
+
+	if (!dWorldRestoreState(g_world, world, worldSize)) {
+		return false;
+	}
+	dRandSetSeed(seed);
+	// restoring the bodies moved their geoms to the front, so the order is checked again.
+	// dSpaceAdd adds to the front, so adding the geoms last to first gives the saved order.
+	for (int i = 0; i < geoms; i++) {
+		if (dSpaceGetGeom(g_space, i) != g_stateGeoms[i]) {
+			for (int j = 0; j < geoms; j++) {
+				dSpaceRemove(g_space, g_stateGeoms[j]);
+			}
+			for (int j = geoms - 1; j >= 0; j--) {
+				dSpaceAdd(g_space, g_stateGeoms[j]);
+			}
+			break;
+		}
+	}
+
+	g_contactCache.resize(contacts);
+	state.Read(g_contactCache.empty() ? NULL : &g_contactCache[0], contacts * sizeof(ODECachedContact));
+	g_stepContacts.clear();
+	return true;
+#else
+	return false;
+#endif
+}
+
+void palODEPhysics::AddStaticInstanceSet(palODEStaticInstanceSet *set) {
+	if (std::find(m_StaticInstanceSets.begin(), m_StaticInstanceSets.end(), set) == m_StaticInstanceSets.end()) {
+		m_StaticInstanceSets.push_back(set);
+	}
+}
+
+void palODEPhysics::RemoveStaticInstanceSet(palODEStaticInstanceSet *set) {
+	m_StaticInstanceSets.erase(std::remove(m_StaticInstanceSets.begin(), m_StaticInstanceSets.end(), set),
+			m_StaticInstanceSets.end());
+}
+
+void palODEPhysics::CollideStaticInstanceSets() {
+	if (m_StaticInstanceSets.empty()) {
+		return;
+	}
+	CollideStaticInstanceSets(g_space);
+}
+
+void palODEPhysics::CollideStaticInstanceSets(dSpaceID space) {
+	int count = dSpaceGetNumGeoms(space);
+	for (int i = 0; i < count; i++) {
+		dGeomID geom = dSpaceGetGeom(space, i);
+		if (!dGeomIsEnabled(geom)) {
+			continue;
+		}
+		// eg: the space of a compound body
+		if (dGeomIsSpace(geom)) {
+			CollideStaticInstanceSets((dSpaceID)geom);
+			continue;
+		}
+		// nothing that can't move needs to be tested against the static instances
+		dBodyID body = dGeomGetBody(geom);
+		if (body == 0 || dBodyIsKinematic(body) || !dBodyIsEnabled(body)) {
+			continue;
+		}
+		palBodyBase *pb = static_cast<palBodyBase *> (dBodyGetData(body));
+		for (unsigned int s = 0; s < m_StaticInstanceSets.size(); s++) {
+			palODEStaticInstanceSet *set = m_StaticInstanceSets[s];
+			set->ODEQuery(geom, m_InstanceQuery);
+			for (unsigned int j = 0; j < m_InstanceQuery.size(); j++) {
+				int instance = m_InstanceQuery[j];
+				CollideGeoms(set->ODEGetGeom(instance), geom, set, pb,
+						set->GetInstanceMaterial(instance), (pb != NULL) ? pb->GetMaterial() : NULL, instance, -1);
+			}
+		}
+	}
+}
+
 void palODEPhysics::Cleanup() {
+	// the instance geoms are not in the world space, so they have to go before ODE does
+	for (unsigned int i = 0; i < m_StaticInstanceSets.size(); i++) {
+		m_StaticInstanceSets[i]->ODECleanup();
+	}
+	m_StaticInstanceSets.clear();
+	g_contactCache.clear();
+	g_stepContacts.clear();
+	if (m_RayBatchSpace != 0) {
+		dSpaceDestroy(m_RayBatchSpace);
+		m_RayBatchSpace = 0;
+		m_RayBatchGeoms.clear();
+	}
 	if (m_initialized) {
+#ifdef dQUICKSTEP_DETERMINISTIC
+		if (g_threading != NULL) {
+			dThreadingImplementationShutdownProcessing(g_threading);
+			dThreadingFreeThreadPool(g_threadPool);
+			dWorldSetStepThreadingImplementation(g_world, NULL, NULL);
+			dThreadingFreeImplementation(g_threading);
+			g_threading = NULL;
+			g_threadPool = NULL;
+		}
+#endif
 		dJointGroupDestroy(g_contactgroup);
 		dSpaceDestroy(g_space);
 		dWorldDestroy(g_world);
@@ -587,6 +1123,10 @@ void palODEPhysics::SetGroupCollision(palGroup a, palGroup b, bool collide) {
 
 		SetGroupCollisionOnGeom(bits, otherBits, geom, collide);
 	}
+
+	for (unsigned int i = 0; i < m_StaticInstanceSets.size(); i++) {
+		m_StaticInstanceSets[i]->SetGroup(m_StaticInstanceSets[i]->GetGroup());
+	}
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -666,7 +1206,7 @@ static void convODEFromPAL(dReal pos[3], dReal R[12], const palMatrix4x4& locati
 }
 
 static void convODEToPAL(const dReal *pos, const dReal *R, palMatrix4x4& m_mLoc) {
-	mat_identity(&m_mLoc);
+	//every element is written, no need to clear the matrix first
 	//this code is correct!
 	//it just looks wrong, because R is a padded SSE structure!
 	m_mLoc._mat[0] = R[0];
@@ -1168,7 +1708,7 @@ void palODEConvexGeometry::Init(const palMatrix4x4 &pos, const Float *pVertices,
 	HullLibrary hl;
 	/*HullError ret =*/ hl.CreateConvexHull(desc, dresult);
 
-	odeGeom = CreateTriMesh(pVertices, nVertices, (int*)dresult.mIndices, dresult.mNumFaces * 3);
+	odeGeom = CreateTriMesh(&m_vfVertices[0], nVertices, true, (int*)dresult.mIndices, dresult.mNumFaces * 3, false, m_MeshBuffers);
 	SetPosition(pos);
 
 	hl.ReleaseResult(dresult);
@@ -1186,7 +1726,7 @@ void palODEConvexGeometry::Init(const palMatrix4x4 &pos, const Float *pVertices,
 void palODEConvexGeometry::Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, const int *pIndices, int nIndices, Float mass){
 	palConvexGeometry::Init(pos,pVertices,nVertices,pIndices,nIndices,mass);
 
-	odeGeom = CreateTriMesh(pVertices,nVertices,pIndices,nIndices);
+	odeGeom = CreateTriMesh(&m_vfVertices[0], nVertices, true, m_pIndices, m_nIndices, true, m_MeshBuffers);
 	SetPosition(pos);
 
 	if (m_pBody) {
@@ -1209,7 +1749,7 @@ palODEConcaveGeometry::palODEConcaveGeometry() {
 void palODEConcaveGeometry::Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, const int *pIndices, int nIndices, Float mass){
 	palConcaveGeometry::Init(pos,pVertices,nVertices,pIndices,nIndices,mass);
 
-	odeGeom = CreateTriMesh(pVertices,nVertices,pIndices,nIndices);
+	odeGeom = CreateTriMesh(m_pUntransformedVertices, nVertices, true, m_pIndices, nIndices, true, m_MeshBuffers);
 
 
 	if (m_pBody) {
@@ -1383,6 +1923,312 @@ bool palODEGenericBody::IsStatic() const {
 	return palGenericBody::IsStatic();
 }
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+palODEStaticInstanceSet::palODEStaticInstanceSet()
+: m_fCellSize(1)
+, m_nQuery(0)
+, m_nCategoryBits(~0UL)
+, m_nCollideBits(~0UL)
+{
+	m_nAxis[0] = 0;
+	m_nAxis[1] = 2;
+	m_fGridMin[0] = m_fGridMin[1] = 0;
+	m_nCells[0] = m_nCells[1] = 0;
+}
+
+palODEStaticInstanceSet::~palODEStaticInstanceSet() {
+	palODEPhysics* odePhysics = dynamic_cast<palODEPhysics*>(palFactory::GetInstance()->GetActivePhysics());
+	if (odePhysics) {
+		odePhysics->RemoveStaticInstanceSet(this);
+		odePhysics->CleanupNotifications(this);
+	}
+	ODECleanup();
+}
+
+void palODEStaticInstanceSet::ODECleanup() {
+	for (unsigned int i = 0; i < m_Geoms.size(); i++) {
+		if (m_Geoms[i] != 0)
+			dGeomDestroy(m_Geoms[i]);
+	}
+	m_Geoms.clear();
+	for (unsigned int i = 0; i < m_ConvexMeshes.size(); i++) {
+		if (m_ConvexMeshes[i].m_Data != 0)
+			dGeomTriMeshDataDestroy(m_ConvexMeshes[i].m_Data);
+	}
+	m_ConvexMeshes.clear();
+	m_CellStart.clear();
+	m_CellInstances.clear();
+}
+
+void palODEStaticInstanceSet::BuildConvexMesh(int shape) {
+	ConvexMesh& mesh = m_ConvexMeshes[shape];
+	if (mesh.m_Data != 0)
+		return;
+	const PAL_VECTOR<Float>& vertices = m_ConvexVertices[shape];
+	const PAL_VECTOR<int>& indices = m_ConvexIndices[shape];
+	unsigned int nVertices = (unsigned int)vertices.size() / 3;
+	unsigned int i;
+
+	if (!indices.empty()) {
+		mesh.m_Vertices.resize(nVertices * 4);
+		for (i = 0; i < nVertices; i++) {
+			mesh.m_Vertices[i * 4 + 0] = vertices[i * 3 + 0];
+			mesh.m_Vertices[i * 4 + 1] = vertices[i * 3 + 1];
+			mesh.m_Vertices[i * 4 + 2] = vertices[i * 3 + 2];
+			mesh.m_Vertices[i * 4 + 3] = 0;
+		}
+		mesh.m_Indices.assign(indices.begin(), indices.end());
+	} else {
+		HullDesc desc;
+		desc.SetHullFlag(QF_TRIANGLES);
+		desc.mVcount = nVertices;
+		desc.mVertices = new double[desc.mVcount * 3];
+		for (i = 0; i < desc.mVcount * 3; i++) {
+			desc.mVertices[i] = vertices[i];
+		}
+		desc.mVertexStride = sizeof(double) * 3;
+
+		HullResult dresult;
+		HullLibrary hl;
+		if (hl.CreateConvexHull(desc, dresult) == QE_OK) {
+			mesh.m_Vertices.resize(dresult.mNumOutputVertices * 4);
+			for (i = 0; i < dresult.mNumOutputVertices; i++) {
+				mesh.m_Vertices[i * 4 + 0] = dReal(dresult.mOutputVertices[i * 3 + 0]);
+				mesh.m_Vertices[i * 4 + 1] = dReal(dresult.mOutputVertices[i * 3 + 1]);
+				mesh.m_Vertices[i * 4 + 2] = dReal(dresult.mOutputVertices[i * 3 + 2]);
+				mesh.m_Vertices[i * 4 + 3] = 0;
+			}
+			mesh.m_Indices.assign(dresult.mIndices, dresult.mIndices + dresult.mNumFaces * 3);
+			hl.ReleaseResult(dresult);
+		}
+		delete [] desc.mVertices;
+	}
+	if (mesh.m_Indices.empty())
+		return;
+
+	// ODE keeps pointers to the arrays, they live as long as the set
+	mesh.m_Data = dGeomTriMeshDataCreate();
+	dGeomTriMeshDataBuildSimple(mesh.m_Data, &mesh.m_Vertices[0], (int)mesh.m_Vertices.size() / 4,
+			&mesh.m_Indices[0], (int)mesh.m_Indices.size());
+}
+
+dGeomID palODEStaticInstanceSet::CreateGeom(unsigned int instance) {
+	const palStaticInstance& inst = m_Instances[instance];
+	dGeomID geom = 0;
+	dReal pos[3];
+	dReal R[12];
+	convODEFromPAL(pos, R, inst.m_mLoc);
+
+	switch (inst.m_Type) {
+	case PAL_GEOM_BOX: {
+		palVector3 dim = GetBoxXYZDimensions(instance);
+		geom = dCreateBox(0, dim.x, dim.y, dim.z);
+		break;
+	}
+	case PAL_GEOM_SPHERE:
+		geom = dCreateSphere(0, inst.m_fDimensions[0]);
+		break;
+	case PAL_GEOM_CAPSULE: {
+		// sized as palODECapsuleGeometry, and turned from the ODE z axis to the up axis
+		geom = dCreateCapsule(0, inst.m_fDimensions[0], inst.m_fDimensions[1] + inst.m_fDimensions[0]);
+		dMatrix3 axisR;
+		dMatrix3 instR;
+		int upAxis = GetUpAxis();
+		if (upAxis == 1) {
+			dRFromAxisAndAngle(axisR, 1, 0, 0, M_PI/2);
+		} else if (upAxis == 0) {
+			dRFromAxisAndAngle(axisR, 0, 1, 0, M_PI/2);
+		} else {
+			dRSetIdentity(axisR);
+		}
+		memcpy(instR, R, sizeof(instR));
+		dMultiply0_333(R, instR, axisR);
+		break;
+	}
+	case PAL_GEOM_CONVEX:
+		BuildConvexMesh(inst.m_nShape);
+		if (m_ConvexMeshes[inst.m_nShape].m_Data != 0)
+			geom = dCreateTriMesh(0, m_ConvexMeshes[inst.m_nShape].m_Data, 0, 0, 0);
+		break;
+	default:
+		break;
+	}
+
+	if (geom != 0) {
+		dGeomSetPosition(geom, pos[0], pos[1], pos[2]);
+		dGeomSetRotation(geom, R);
+		dGeomSetData(geom, static_cast<palBodyBase *>(this));
+	}
+	return geom;
+}
+
+// the range of cells covering [lo, hi] along one grid axis, false if it misses the grid
+static bool GridRange(dReal lo, dReal hi, dReal origin, dReal cellSize, int cells, int& first, int& last) {
+	dReal f = (lo - origin) / cellSize;
+	dReal l = (hi - origin) / cellSize;
+	if (l < 0 || f >= dReal(cells))
+		return false;
+	first = (f <= 0) ? 0 : int(f);
+	last = (l >= dReal(cells - 1)) ? cells - 1 : int(l);
+	return true;
+}
+
+void palODEStaticInstanceSet::BuildGrid() {
+	int upAxis = GetUpAxis();
+	m_nAxis[0] = (upAxis == 0) ? 1 : 0;
+	m_nAxis[1] = (upAxis == 2) ? 1 : 2;
+
+	unsigned int count = (unsigned int)m_Geoms.size();
+	m_CellStart.clear();
+	m_CellInstances.clear();
+	m_QueryMark.assign(count, 0);
+	m_nQuery = 0;
+	m_nCells[0] = m_nCells[1] = 0;
+	if (count == 0)
+		return;
+
+	dReal lo[2] = { dInfinity, dInfinity };
+	dReal hi[2] = { -dInfinity, -dInfinity };
+	dReal extent = 0;
+	unsigned int i;
+	int a;
+	for (i = 0; i < count; i++) {
+		for (a = 0; a < 2; a++) {
+			dReal mn = m_AABBs[i * 6 + m_nAxis[a] * 2];
+			dReal mx = m_AABBs[i * 6 + m_nAxis[a] * 2 + 1];
+			lo[a] = std::min(lo[a], mn);
+			hi[a] = std::max(hi[a], mx);
+			extent += mx - mn;
+		}
+	}
+	extent /= dReal(count * 2);
+
+	// cells hold a few instances each if they are spread evenly, and are no smaller than an average instance.
+	dReal area = (hi[0] - lo[0]) * (hi[1] - lo[1]);
+	m_fCellSize = std::max(extent, dReal(sqrt(area * 4 / dReal(count))));
+	for (a = 0; a < 2; a++) {
+		m_fCellSize = std::max(m_fCellSize, (hi[a] - lo[a]) / dReal(1024));
+	}
+	if (!(m_fCellSize > 0))
+		m_fCellSize = 1;
+	for (a = 0; a < 2; a++) {
+		m_fGridMin[a] = lo[a];
+		m_nCells[a] = int((hi[a] - lo[a]) / m_fCellSize) + 1;
+	}
+
+	// count the instances in each cell, then fill them in
+	m_CellStart.assign(m_nCells[0] * m_nCells[1] + 1, 0);
+	int first[2], last[2];
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = 0; i < count; i++) {
+			for (a = 0; a < 2; a++) {
+				GridRange(m_AABBs[i * 6 + m_nAxis[a] * 2], m_AABBs[i * 6 + m_nAxis[a] * 2 + 1],
+						m_fGridMin[a], m_fCellSize, m_nCells[a], first[a], last[a]);
+			}
+			for (int y = first[1]; y <= last[1]; y++) {
+				for (int x = first[0]; x <= last[0]; x++) {
+					int cell = y * m_nCells[0] + x;
+					if (pass == 0)
+						m_CellStart[cell + 1]++;
+					else
+						m_CellInstances[m_CellStart[cell]++] = (int)i;
+				}
+			}
+		}
+		if (pass == 0) {
+			for (unsigned int c = 1; c < m_CellStart.size(); c++)
+				m_CellStart[c] += m_CellStart[c - 1];
+			m_CellInstances.resize(m_CellStart.back());
+		} else {
+			// the fill moved each start to the next cell's start
+			for (unsigned int c = m_CellStart.size() - 1; c > 0; c--)
+				m_CellStart[c] = m_CellStart[c - 1];
+			m_CellStart[0] = 0;
+		}
+	}
+}
+
+void palODEStaticInstanceSet::Finalize() {
+	if (m_bFinalized)
+		return;
+	palStaticInstanceSet::Finalize();
+
+	unsigned int count = GetNumInstances();
+	m_ConvexMeshes.resize(m_ConvexVertices.size());
+	for (unsigned int i = 0; i < m_ConvexMeshes.size(); i++)
+		m_ConvexMeshes[i].m_Data = 0;
+	m_Geoms.resize(count);
+	m_AABBs.resize(count * 6);
+	for (unsigned int i = 0; i < count; i++) {
+		m_Geoms[i] = CreateGeom(i);
+		if (m_Geoms[i] != 0) {
+			dGeomGetAABB(m_Geoms[i], &m_AABBs[i * 6]);
+		} else {
+			// an instance ODE can't represent, it is never found
+			for (int a = 0; a < 3; a++) {
+				m_AABBs[i * 6 + a * 2] = dInfinity;
+				m_AABBs[i * 6 + a * 2 + 1] = -dInfinity;
+			}
+		}
+	}
+	BuildGrid();
+	SetGroup(GetGroup());
+
+	palODEPhysics *physics = dynamic_cast<palODEPhysics *>(GetParent());
+	if (physics)
+		physics->AddStaticInstanceSet(this);
+}
+
+void palODEStaticInstanceSet::SetGroup(palGroup group) {
+	palStaticInstanceSet::SetGroup(group);
+	palODEPhysics *physics = dynamic_cast<palODEPhysics *>(GetParent());
+	m_nCategoryBits = 1L << (unsigned long)(group);
+	if (physics && physics->m_CollisionMasks.size() > (unsigned long)(group)) {
+		m_nCollideBits = physics->m_CollisionMasks[group];
+	} else {
+		// all bits on by default.
+		m_nCollideBits = ~0UL;
+	}
+}
+
+void palODEStaticInstanceSet::ODEQuery(dGeomID geom, PAL_VECTOR<int>& instances) const {
+	instances.clear();
+	if (m_CellStart.empty())
+		return;
+	// the same test the ODE spaces make
+	if (!(m_nCategoryBits & dGeomGetCollideBits(geom)) && !(dGeomGetCategoryBits(geom) & m_nCollideBits))
+		return;
+
+	dReal aabb[6];
+	dGeomGetAABB(geom, aabb);
+	int first[2], last[2];
+	for (int a = 0; a < 2; a++) {
+		if (!GridRange(aabb[m_nAxis[a] * 2], aabb[m_nAxis[a] * 2 + 1], m_fGridMin[a], m_fCellSize, m_nCells[a], first[a], last[a]))
+			return;
+	}
+
+	if (++m_nQuery == 0) {
+		std::fill(m_QueryMark.begin(), m_QueryMark.end(), 0);
+		m_nQuery = 1;
+	}
+	for (int y = first[1]; y <= last[1]; y++) {
+		for (int x = first[0]; x <= last[0]; x++) {
+			int cell = y * m_nCells[0] + x;
+			for (unsigned int k = m_CellStart[cell]; k < m_CellStart[cell + 1]; k++) {
+				int i = m_CellInstances[k];
+				if (m_QueryMark[i] == m_nQuery)
+					continue;
+				m_QueryMark[i] = m_nQuery;
+				const dReal *b = &m_AABBs[i * 6];
+				if (b[0] > aabb[1] || b[1] < aabb[0] || b[2] > aabb[3] || b[3] < aabb[2] || b[4] > aabb[5] || b[5] < aabb[4])
+					continue;
+				instances.push_back(i);
+			}
+		}
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 palODELinkData::palODELinkData() {
 	odeJoint = 0;
@@ -1933,137 +2779,74 @@ void palODEOrientatedTerrainPlane::Init(Float x, Float y, Float z, Float nx, Flo
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-palODETerrainHeightmap::palODETerrainHeightmap() {
+palODETerrainHeightmap::palODETerrainHeightmap()
+: m_TriMeshData(0) {}
+
+palODETerrainHeightmap::~palODETerrainHeightmap() {
+	// the geom uses the data, so it goes first
+	if (odeGeom) {
+		dGeomDestroy(odeGeom);
+		odeGeom = 0;
+	}
+	if (m_TriMeshData)
+		dGeomTriMeshDataDestroy(m_TriMeshData);
+	m_TriMeshData = 0;
 }
 
-void palODETerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth,
+bool palODETerrainHeightmap::Prepare(Float px, Float py, Float pz, Float width, Float depth,
 		int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
-#if 0
-	palTerrainHeightmap::Init(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
-	int iTriIndex;
-	float fTerrainX, fTerrainZ;
-	int x,z;
-
-	dVector3 *vertices; // vertex array for trimesh geom
-	int *indices; // index array for trimesh geom
-	int vertexcount; // number of vertices in the vertex array
-	int indexcount; // number of indices in the index array
-
-	int nv=m_iDataWidth*m_iDataDepth;
-	int ni=(m_iDataWidth-1)*(m_iDataDepth-1)*2*3;
-
-	vertexcount=nv;
-	indexcount=ni;
+	if (m_TriMeshData)
+		return true;
+	int x, z;
+	int xDim = terrain_data_width;
+	int zDim = terrain_data_depth;
+
+	// relative to the geom, which Init places at the position
+	m_TriVertices.resize(xDim * zDim * 4);
+	Float fTerrainZ = -depth / 2;
+	for (z = 0; z < zDim; z++) {
+		Float fTerrainX = -width / 2;
+		for (x = 0; x < xDim; x++) {
+			dReal *v = &m_TriVertices[(x + z * xDim) * 4];
+			v[0] = fTerrainX;
+			v[1] = pHeightmap[x + z * xDim];
+			v[2] = fTerrainZ;
+			v[3] = 0;
+			fTerrainX += (width / (xDim - 1));
+		}
+		fTerrainZ += (depth / (zDim - 1));
+	}
 
-	vertices = new dVector3[nv];
-	indices = new int[ni];
+	m_TriIndices.resize((xDim - 1) * (zDim - 1) * 2 * 3);
+	dTriIndex *ind = m_TriIndices.empty() ? 0 : &m_TriIndices[0];
+	for (z = 0; z < zDim - 1; z++)
+		for (x = 0; x < xDim - 1; x++) {
+			*ind++ = (z * xDim) + x;
+			*ind++ = (z * xDim) + xDim + x;
+			*ind++ = (z * xDim) + x + 1;
 
-	// Set the vertex values
-	fTerrainZ = -m_fDepth/2;
-	for (z=0; z<m_iDataDepth; z++)
-	{
-		fTerrainX = -m_fWidth/2;
-		for (x=0; x<m_iDataWidth; x++)
-		{
-			//triVertices[x + z*m_iDataWidth].Set(fTerrainX, gfTerrainHeights[x][z], fTerrainZ);
-			vertices[x + z*m_iDataWidth][0]=fTerrainX;
-			vertices[x + z*m_iDataWidth][1]=pHeightmap[x+z*m_iDataWidth];
-			vertices[x + z*m_iDataWidth][2]=fTerrainZ;
-			printf("(%d,%d),%f\n",x,z,pHeightmap[x+z*m_iDataWidth]);
-			fTerrainX += (m_fWidth / (m_iDataWidth-1));
-		}
-		fTerrainZ += (m_fDepth / (m_iDataDepth-1));
-	}
-
-	int xDim=m_iDataWidth;
-	int yDim=m_iDataDepth;
-	int y;
-	for (y=0;y < yDim-1;y++)
-		for (x=0;x < xDim-1;x++) {
-			/*
-		 //		SetIndex(((x+y*(xDim-1))*2)+0,(y*xDim)+x,(y*xDim)+xDim+x,(y*xDim)+x+1);
-		 indices[(((x+y*(xDim-1))*2)+0)*3+0]=(y*xDim)+x;
-		 indices[(((x+y*(xDim-1))*2)+0)*3+1]=(y*xDim)+xDim+x;
-		 indices[(((x+y*(xDim-1))*2)+0)*3+2]=(y*xDim)+x+1;
-
-		 //		SetIndex(((x+y*(xDim-1))*2)+1,(y*xDim)+x+1,(y*xDim)+xDim+x,(y*xDim)+x+xDim+1);
-
-		 indices[(((x+y*(xDim-1))*2)+1)*3+0]=(y*xDim)+x+1;
-		 indices[(((x+y*(xDim-1))*2)+1)*3+1]=(y*xDim)+xDim+x;
-		 indices[(((x+y*(xDim-1))*2)+1)*3+2]=(y*xDim)+x+xDim+1;
-			 */
-			indices[iTriIndex*3+0]=(y*xDim)+x;
-			indices[iTriIndex*3+1]=(y*xDim)+xDim+x;
-			indices[iTriIndex*3+2]=(y*xDim)+x+1;
-			// Move to the next triangle in the array
-			iTriIndex += 1;
-
-			indices[iTriIndex*3+0]=(y*xDim)+x+1;
-			indices[iTriIndex*3+1]=(y*xDim)+xDim+x;
-			indices[iTriIndex*3+2]=(y*xDim)+x+xDim+1;
-			// Move to the next triangle in the array
-			iTriIndex += 1;
+			*ind++ = (z * xDim) + x + 1;
+			*ind++ = (z * xDim) + xDim + x;
+			*ind++ = (z * xDim) + x + xDim + 1;
 		}
 
-	// build the trimesh data
-	dTriMeshDataID data=dGeomTriMeshDataCreate();
-	dGeomTriMeshDataBuildSimple(data,(dReal*)vertices,vertexcount,indices,indexcount);
-	// build the trimesh geom
-	odeGeom=dCreateTriMesh(g_space,data,0,0,0);
-	// set the geom position
-	dGeomSetPosition(odeGeom,m_fPosX,m_fPosY,m_fPosZ);
-	// in our application we don't want geoms constructed with meshes (the terrain) to have a body
-	dGeomSetBody(odeGeom,0);
-#else
+	// building the data does not touch the space
+	m_TriMeshData = dGeomTriMeshDataCreate();
+	dGeomTriMeshDataBuildSimple(m_TriMeshData, &m_TriVertices[0], xDim * zDim,
+			m_TriIndices.empty() ? 0 : &m_TriIndices[0], (int)m_TriIndices.size());
+	return true;
+}
+
+void palODETerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth,
+		int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
 	palTerrainHeightmap::Init(px, py, pz, width, depth, terrain_data_width, terrain_data_depth,
 			pHeightmap);
-	int iTriIndex;
-	float fTerrainX, fTerrainZ;
-	int x, z;
-
-	int nv = m_iDataWidth * m_iDataDepth;
-	int ni = (m_iDataWidth - 1) * (m_iDataDepth - 1) * 2 * 3;
-
-	Float *v = new Float[nv * 3];
-	int *ind = new int[ni];
-
-	// Set the vertex values
-	fTerrainZ = -m_fDepth / 2;
-	for (z = 0; z < m_iDataDepth; z++) {
-		fTerrainX = -m_fWidth / 2;
-		for (x = 0; x < m_iDataWidth; x++) {
-			v[(x + z * m_iDataWidth) * 3 + 0] = fTerrainX + m_mLoc._41;
-			v[(x + z * m_iDataWidth) * 3 + 1] = pHeightmap[x + z * m_iDataWidth] + m_mLoc._42;
-			v[(x + z * m_iDataWidth) * 3 + 2] = fTerrainZ + m_mLoc._43;
-
-			fTerrainX += (m_fWidth / (m_iDataWidth - 1));
-		}
-		fTerrainZ += (m_fDepth / (m_iDataDepth - 1));
-	}
-
-	iTriIndex = 0;
-	int xDim = m_iDataWidth;
-	int yDim = m_iDataDepth;
-	int y;
-	for (y = 0; y < yDim - 1; y++)
-		for (x = 0; x < xDim - 1; x++) {
-			ind[iTriIndex * 3 + 0] = (y * xDim) + x;
-			ind[iTriIndex * 3 + 1] = (y * xDim) + xDim + x;
-			ind[iTriIndex * 3 + 2] = (y * xDim) + x + 1;
-			// Move to the next triangle in the array
-			iTriIndex += 1;
-
-			ind[iTriIndex * 3 + 0] = (y * xDim) + x + 1;
-			ind[iTriIndex * 3 + 1] = (y * xDim) + xDim + x;
-			ind[iTriIndex * 3 + 2] = (y * xDim) + x + xDim + 1;
-			// Move to the next triangle in the array
-			iTriIndex += 1;
-		}
-	palODETerrainMesh::Init(px, py, pz, v, nv, ind, ni);
-
-	delete[] v;
-	delete[] ind;
-#endif
+	Prepare(px, py, pz, width, depth, terrain_data_width, terrain_data_depth, pHeightmap);
+	odeGeom = dCreateTriMesh(g_space, m_TriMeshData, 0, 0, 0);
+	dGeomSetPosition(odeGeom, px, py, pz);
+	// in our application we don't want geoms constructed with meshes (the terrain) to have a body
+	dGeomSetBody(odeGeom, 0);
+	dGeomSetData(odeGeom, static_cast<palBodyBase *> (this));
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -2084,7 +2867,7 @@ void palODETerrainMesh::Init(Float px, Float py, Float pz, const Float *pVertice
 		const int *pIndices, int nIndices) {
 	palTerrainMesh::Init(px, py, pz, pVertices, nVertices, pIndices, nIndices);
 
-	odeGeom = CreateTriMesh(pVertices, nVertices, pIndices, nIndices);
+	odeGeom = CreateTriMesh(pVertices, nVertices, false, pIndices, nIndices, false, m_MeshBuffers);
 	// set the geom position
 	dGeomSetPosition(odeGeom, m_mLoc._41, m_mLoc._42, m_mLoc._43);
 	// in our application we don't want geoms constructed with meshes (the terrain) to have a body
@@ -2095,6 +2878,45 @@ void palODETerrainMesh::Init(Float px, Float py, Float pz, const Float *pVertice
 }
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+palODEPSDSensor::palODEPSDSensor()
+: m_fRelativePosX(0), m_fRelativePosY(0), m_fRelativePosZ(0) {
+}
+
+void palODEPSDSensor::Init(palBody *body, Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range) {
+	palPSDSensor::Init(body,x,y,z,dx,dy,dz,range);
+	palVector3 pos;
+	body->GetPosition(pos);
+	m_fRelativePosX = m_fPosX - pos.x;
+	m_fRelativePosY = m_fPosY - pos.y;
+	m_fRelativePosZ = m_fPosZ - pos.z;
+}
+
+bool palODEPSDSensor::GetWorldRay(const palMatrix4x4& bodyLocation, palRay& ray) const {
+	palVector3 relative(m_fRelativePosX, m_fRelativePosY, m_fRelativePosZ);
+	palVector3 axis(m_fAxisX, m_fAxisY, m_fAxisZ);
+	vec_mat_transform(&ray.m_vOrigin, &bodyLocation, &relative);
+	vec_mat_mul(&ray.m_vDirection, &bodyLocation, &axis);
+	vec_norm(&ray.m_vDirection);
+	ray.m_fRange = m_fRange;
+	return true;
+}
+
+Float palODEPSDSensor::GetDistance() const {
+	// the reading palSensorManager took from its batch of rays
+	if (m_pManager != NULL)
+		return m_fReading;
+
+	palRay ray;
+	GetWorldRay(m_pBody->GetLocationMatrix(), ray);
+	palRayHit hit;
+	static_cast<const palODEPhysics*>(GetParent())->RayCast(ray.m_vOrigin.x, ray.m_vOrigin.y, ray.m_vOrigin.z,
+			ray.m_vDirection.x, ray.m_vDirection.y, ray.m_vDirection.z, m_fRange, hit);
+	if (hit.m_bHitPosition && hit.m_pBody)
+		return hit.m_fDistance;
+	return m_fRange;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 palODEMotor::palODEMotor(): m_Link(0), odeJoint(0) {
 }
 
@@ -13,6 +13,16 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 0.1.21: 19/10/26 - Warm started contacts matched by feature, scaled and clamped (ODE_WarmStartScale)
+		Version 0.1.20: 19/10/26 - PSD sensor, batched by palSensorManager
+		Version 0.1.19: 19/10/26 - Meshes passed to ODE in place when the precision matches
+		Version 0.1.18: 19/10/26 - Final leaf classes and body overrides in the static single engine build
+		Version 0.1.17: 19/10/26 - Save and restore state
+		Version 0.1.16: 19/10/26 - Heightmaps built ahead by Prepare
+		Version 0.1.15: 19/10/26 - Threaded stepping and deterministic QuickStep (ODE_Threads, ODE_Deterministic)
+		Version 0.1.14: 19/10/26 - QuickStep with warm started contacts (ODE_QuickStepIterations, ODE_WarmStart)
+		Version 0.1.13: 19/10/26 - Contact reduction (ODE_MaxContactsPerPair)
+		Version 0.1.12: 19/10/26 - Static instance set
 		Version 0.1.11: 06/26/14 - DG - deleted the subclass of materials and added support for custom material callbacks.
 		Version 0.1.10: 16/09/09 - AB: Fixed some bugs, introduced a new bug to the compound body (4x3 vs 4x4)
 		Version 0.1.09: 18/02/09 - Public set/get for ODE functionality & documentation
@@ -54,6 +64,28 @@
 
 #include <ode/ode.h>
 
+/* ODE_REAL_IS_PAL_FLOAT is 1 when dReal and Float are the same type (dSINGLE without DOUBLE_PRECISION, or dDOUBLE with it).
+   ODE_TRIINDEX_IS_INT is 1 when dTriIndex is a 32 bit index like the PAL int indices.
+   When they are, a PAL mesh (3 Float per vertex, 3 int per triangle) is handed to ODE in place with its own strides,
+   so it has to outlive the trimesh: the geometries pass the copies they keep, and copy only what does not match.
+   Rotations are not reinterpreted: ODE keeps them as a 3x4 row major matrix, the transpose of the PAL rotation. */
+#if defined(dDOUBLE) == defined(DOUBLE_PRECISION)
+#define ODE_REAL_IS_PAL_FLOAT 1
+#else
+#define ODE_REAL_IS_PAL_FLOAT 0
+#endif
+#if defined(dTRIMESH_16BIT_INDICES)
+#define ODE_TRIINDEX_IS_INT 0
+#else
+#define ODE_TRIINDEX_IS_INT 1
+#endif
+
+/// The copies of a mesh handed to ODE, for the parts whose layout does not match the PAL one
+struct palODEMeshBuffers {
+	PAL_VECTOR<dReal> m_Vertices;
+	PAL_VECTOR<dTriIndex> m_Indices;
+};
+
 #if defined(_MSC_VER)
 #pragma warning(disable : 4250)
 
@@ -75,11 +107,15 @@
 
 #define ODE_MATINDEXLOOKUP int
 
+class palODEStaticInstanceSet;
+
 /** ODE Physics Class
 	Additionally Supports:
 		- Collision Detection
+		- Saving and restoring state, with the ODE bundled with PAL. Results after a restore are identical
+		  unless ODE_Threads is set without ODE_Deterministic.
  */
-class palODEPhysics: public palPhysics, public palCollisionDetectionExtended {
+class palODEPhysics PAL_FINAL : public palPhysics, public palCollisionDetectionExtended {
 public:
 	palODEPhysics();
 	virtual void Init(const palPhysicsDesc& desc);
@@ -96,6 +132,7 @@ public:
 	virtual void RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range, palRayHit& hit) const;
 	virtual void RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz,
 			Float range, palRayHitCallback& callback, palGroupFlags groupFilter = ~0) const;
+	virtual void RayCastBatch(const palRay* rays, palRayHit* hits, unsigned count) const;
 	virtual void NotifyCollision(palBodyBase *a, palBodyBase *b, bool enabled);
 	virtual void NotifyCollision(palBodyBase *pBody, bool enabled);
 	void CleanupNotifications(palBodyBase* geom);
@@ -118,13 +155,29 @@ public:
 
 	virtual void Cleanup();
 
+	/// Called by a static instance set when it is finalized, so it is collided against the dynamic bodies each step
+	void AddStaticInstanceSet(palODEStaticInstanceSet *set);
+	void RemoveStaticInstanceSet(palODEStaticInstanceSet *set);
+
 	PAL_VECTOR<unsigned long> m_CollisionMasks;
 
 protected:
 	void Iterate(Float timestep);
+	virtual bool SaveEngineState(palStateBuffer& state) const;
+	virtual bool RestoreEngineState(const palStateBuffer& state);
+	void CollideStaticInstanceSets();
+	/// collides the geoms of a space, and of the spaces inside it, with the static instance sets
+	void CollideStaticInstanceSets(dSpaceID space);
+
+	void RayCastStaticInstanceSets(dGeomID ray, void *data, dNearCallback *callback) const;
+
+	PAL_VECTOR<palODEStaticInstanceSet *> m_StaticInstanceSets;
+	mutable PAL_VECTOR<int> m_InstanceQuery; //!< reused by the static instance set queries
 
 	FACTORY_CLASS(palODEPhysics,palPhysics,ODE,1)
 	bool m_initialized;
+	mutable dSpaceID m_RayBatchSpace; //!< holds the ray geoms reused by RayCastBatch
+	mutable PAL_VECTOR<dGeomID> m_RayBatchGeoms;
 };
 
 /** The ODE Body class
@@ -160,24 +213,24 @@ public:
 	virtual void ApplyAngularImpulse(Float ix, Float iy, Float iz);
 #endif
 
-	virtual void ApplyForce(Float fx, Float fy, Float fz);
-	virtual void ApplyTorque(Float tx, Float ty, Float tz);
+	virtual void ApplyForce(Float fx, Float fy, Float fz) PAL_FINAL;
+	virtual void ApplyTorque(Float tx, Float ty, Float tz) PAL_FINAL;
 
-	virtual void GetLinearVelocity(palVector3& velocity) const;
-	virtual void GetAngularVelocity(palVector3& velocity_rad) const;
+	virtual void GetLinearVelocity(palVector3& velocity) const PAL_FINAL;
+	virtual void GetAngularVelocity(palVector3& velocity_rad) const PAL_FINAL;
 
-	virtual void SetLinearVelocity(const palVector3& velocity);
-	virtual void SetAngularVelocity(const palVector3& velocity_rad);
+	virtual void SetLinearVelocity(const palVector3& velocity) PAL_FINAL;
+	virtual void SetAngularVelocity(const palVector3& velocity_rad) PAL_FINAL;
 
 	//@return if the body is active or sleeping
-	virtual bool IsActive() const;
+	virtual bool IsActive() const PAL_FINAL;
 
 	virtual void SetActive(bool active);
 
 	virtual void SetGroup(palGroup group);
 
 	//virtual void a() {};
-	virtual const palMatrix4x4& GetLocationMatrix() const;
+	virtual const palMatrix4x4& GetLocationMatrix() const PAL_FINAL;
 
 	virtual palActivationSettings* asActivationSettings() { return this; }
 
@@ -240,7 +293,7 @@ protected:
 	dGeomID odeGeom; // the ODE geometries representing this body
 };
 
-class palODEBoxGeometry : virtual public palBoxGeometry, virtual public palODEGeometry {
+class palODEBoxGeometry PAL_FINAL : virtual public palBoxGeometry, virtual public palODEGeometry {
 public:
 	palODEBoxGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float width, Float height, Float depth, Float mass);
@@ -249,7 +302,7 @@ protected:
 	FACTORY_CLASS(palODEBoxGeometry,palBoxGeometry,ODE,1)
 };
 
-class palODESphereGeometry : virtual public palSphereGeometry, virtual public palODEGeometry {
+class palODESphereGeometry PAL_FINAL : virtual public palSphereGeometry, virtual public palODEGeometry {
 public:
 	palODESphereGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float mass);
@@ -258,7 +311,7 @@ protected:
 	FACTORY_CLASS(palODESphereGeometry,palSphereGeometry,ODE,1)
 };
 
-class palODECapsuleGeometry : virtual public palCapsuleGeometry, virtual public palODEGeometry {
+class palODECapsuleGeometry PAL_FINAL : virtual public palCapsuleGeometry, virtual public palODEGeometry {
 public:
 	palODECapsuleGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float length, Float mass);
@@ -271,7 +324,7 @@ private:
 	unsigned int m_upAxis;
 };
 
-class palODECylinderGeometry : virtual public palCylinderGeometry, virtual public palODEGeometry {
+class palODECylinderGeometry PAL_FINAL : virtual public palCylinderGeometry, virtual public palODEGeometry {
 public:
 	palODECylinderGeometry();
 	virtual void Init(const palMatrix4x4 &pos, Float radius, Float length, Float mass);
@@ -284,27 +337,29 @@ private:
 	unsigned int m_upAxis;
 };
 
-class palODEConvexGeometry : virtual public palConvexGeometry, virtual public palODEGeometry  {
+class palODEConvexGeometry PAL_FINAL : virtual public palConvexGeometry, virtual public palODEGeometry  {
 public:
 	palODEConvexGeometry();
 	virtual void Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, Float mass);
 	virtual void Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, const int *pIndices, int nIndices, Float mass);
 	virtual void CalculateMassParams(dMass& odeMass, Float massScalar) const;
 protected:
+	palODEMeshBuffers m_MeshBuffers;
 	FACTORY_CLASS(palODEConvexGeometry,palConvexGeometry,ODE,1)
 };
 
-class palODEConcaveGeometry : virtual public palConcaveGeometry, virtual public palODEGeometry  {
+class palODEConcaveGeometry PAL_FINAL : virtual public palConcaveGeometry, virtual public palODEGeometry  {
 public:
 	palODEConcaveGeometry();
 	virtual void Init(const palMatrix4x4 &pos, const Float *pVertices, int nVertices, const int *pIndices, int nIndices, Float mass);
 	virtual void CalculateMassParams(dMass& odeMass, Float massScalar) const;
 protected:
+	palODEMeshBuffers m_MeshBuffers;
 	FACTORY_CLASS(palODEConcaveGeometry,palConcaveGeometry,ODE,1)
 };
 
 
-class palODEGenericBody : virtual public palODEBody, virtual public palGenericBody {
+class palODEGenericBody PAL_FINAL : virtual public palODEBody, virtual public palGenericBody {
 public:
 	palODEGenericBody();
 
@@ -340,6 +395,59 @@ protected:
 	FACTORY_CLASS(palODEGenericBody, palGenericBody, ODE, 1);
 };
 
+/** The ODE static instance set.
+	ODE spaces test a single geom against a space by visiting every geom in it (and the quadtree space
+	only divides the x and y axes), so the instance geoms are not placed in a space.
+	Instead they are sorted into a grid over the two axes perpendicular to the up axis, and each step
+	only the enabled dynamic bodies are tested against it.
+ */
+class palODEStaticInstanceSet : public palStaticInstanceSet {
+public:
+	palODEStaticInstanceSet();
+	virtual ~palODEStaticInstanceSet();
+
+	virtual void Finalize();
+	virtual void SetGroup(palGroup group);
+
+	/// Destroys the ODE geoms, called when the set or the physics is deleted
+	void ODECleanup();
+
+	/** Finds the instances whose bounds overlap the bounds of a geom, and whose collision group may collide with it.
+	\param geom The geom to test
+	\param instances Filled with the instances found
+	 */
+	void ODEQuery(dGeomID geom, PAL_VECTOR<int>& instances) const;
+	/// \return The ODE geom of an instance
+	dGeomID ODEGetGeom(int instance) const { return m_Geoms[instance]; }
+
+protected:
+	struct ConvexMesh {
+		PAL_VECTOR<dReal> m_Vertices; //!< 4 per vertex, as dVector3
+		PAL_VECTOR<dTriIndex> m_Indices;
+		dTriMeshDataID m_Data;
+	};
+
+	dGeomID CreateGeom(unsigned int instance);
+	void BuildConvexMesh(int shape);
+	void BuildGrid();
+
+	PAL_VECTOR<dGeomID> m_Geoms;
+	PAL_VECTOR<dReal> m_AABBs; //!< 6 per instance, in the order of dGeomGetAABB
+	PAL_VECTOR<ConvexMesh> m_ConvexMeshes; //!< trimesh data shared by the instances of each convex shape
+	int m_nAxis[2]; //!< the axes of the grid
+	dReal m_fGridMin[2];
+	dReal m_fCellSize;
+	int m_nCells[2];
+	PAL_VECTOR<unsigned int> m_CellStart; //!< the instances of cell c are m_CellInstances[m_CellStart[c]] up to m_CellInstances[m_CellStart[c+1]]
+	PAL_VECTOR<int> m_CellInstances;
+	mutable PAL_VECTOR<unsigned int> m_QueryMark; //!< so an instance spanning several cells is only found once per query
+	mutable unsigned int m_nQuery;
+	unsigned long m_nCategoryBits;
+	unsigned long m_nCollideBits;
+
+	FACTORY_CLASS(palODEStaticInstanceSet,palStaticInstanceSet,ODE,1)
+};
+
 /** The ODE Link class
  */
 class palODELinkData {
@@ -501,15 +609,24 @@ public:
 	virtual void Init(Float x, Float y, Float z, const Float *pVertices, int nVertices, const int *pIndices, int nIndices);
 	//	palMatrix4x4& GetLocationMatrix() const;
 protected:
+	palODEMeshBuffers m_MeshBuffers; //!< the terrain does not keep the mesh, so ODE always gets a copy
 	FACTORY_CLASS(palODETerrainMesh,palTerrainMesh,ODE,1)
 };
 
+/** ODE terrain heightmap.
+	Prepare builds the trimesh data (with its collision tree), Init only makes the geom in the space.
+*/
 class palODETerrainHeightmap : virtual public palTerrainHeightmap, virtual private palODETerrainMesh {
 public:
 	palODETerrainHeightmap();
+	virtual ~palODETerrainHeightmap();
+	virtual bool Prepare(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	virtual void Init(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	//	palMatrix4x4& GetLocationMatrix() const;
 protected:
+	dTriMeshDataID m_TriMeshData; //!< 0 until Prepare
+	PAL_VECTOR<dReal> m_TriVertices; //!< the trimesh data points into these, as dVector3
+	PAL_VECTOR<dTriIndex> m_TriIndices;
 	FACTORY_CLASS(palODETerrainHeightmap,palTerrainHeightmap,ODE,1)
 };
 
@@ -517,12 +634,12 @@ class palODEPSDSensor : public palPSDSensor {
 public:
 	palODEPSDSensor();
 	virtual void Init(palBody *body, Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range); //position, direction
-	Float GetDistance() const;
+	virtual Float GetDistance() const;
+	virtual bool GetWorldRay(const palMatrix4x4& bodyLocation, palRay& ray) const;
 protected:
 	Float m_fRelativePosX;
 	Float m_fRelativePosY;
 	Float m_fRelativePosZ;
-	dGeomID odeRayId;
 	FACTORY_CLASS(palODEPSDSensor,palPSDSensor,ODE,1)
 };
 
@@ -3,7 +3,10 @@
 #endif
 //#include "palSolver.h"   // EMD: necessary or get debug error //AB: Should be from tokamak_pal.h? is this a linux only issue?
 #include <math.h>
+#include <string.h>
+#include <algorithm>
 #include "tokamak_pal.h"
+#include <pal/palStateBuffer.h>
 
 #ifdef USE_QHULL
 // EMD: added this block
@@ -83,6 +86,7 @@ FACTORY_CLASS_IMPLEMENTATION(palTokamakOrientatedTerrainPlane);
 FACTORY_CLASS_IMPLEMENTATION(palTokamakTerrainPlane);
 FACTORY_CLASS_IMPLEMENTATION(palTokamakTerrainHeightmap);
 FACTORY_CLASS_IMPLEMENTATION(palTokamakTerrainMesh);
+FACTORY_CLASS_IMPLEMENTATION(palTokamakStaticInstanceSet);
 
 FACTORY_CLASS_IMPLEMENTATION(palTokamakPSDSensor);
 FACTORY_CLASS_IMPLEMENTATION(palTokamakContactSensor);
@@ -90,7 +94,18 @@ FACTORY_CLASS_IMPLEMENTATION_END_GROUP;
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //globals:
-void gGetLocationMatrix(palMatrix4x4 &Loc, neT3 t) {
+#if TOKAMAK_T3_IS_PAL_MATRIX
+static_assert(sizeof(neT3) == sizeof(palMatrix4x4), "neT3 is expected to be 16 f32, like palMatrix4x4");
+#endif
+
+void gGetLocationMatrix(palMatrix4x4 &Loc, const neT3& t) {
+#if TOKAMAK_T3_IS_PAL_MATRIX
+	memcpy(Loc._mat, &t, sizeof(Loc._mat));
+	Loc._14 = 0;
+	Loc._24 = 0;
+	Loc._34 = 0;
+	Loc._44 = 1.0f;
+#else
 	Loc._11 = t.rot[0][0];
 	Loc._21 = t.rot[1][0];
 	Loc._31 = t.rot[2][0];
@@ -110,13 +125,778 @@ void gGetLocationMatrix(palMatrix4x4 &Loc, neT3 t) {
 	Loc._24 = 0;
 	Loc._34 = 0;
 	Loc._44 = 1.0f;
+#endif
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 //int palTokamakMaterial::g_materialcount = 1;
 neSimulator *gSim = NULL;
-neAnimatedBody *gFloor = NULL;
 static int g_materialcount = 1;
+
+/* PAL keeps a bounding volume tree over the bodies and the terrain triangles for collision queries,
+   as the Tokamak regions and terrain tree are not exposed by its API.
+   Items are boxes, given as 6 floats (min xyz, max xyz) each. */
+class TokamakAABBTree {
+public:
+	//takes the bounds, the vector is emptied
+	void Build(PAL_VECTOR<Float> &bounds);
+	void Clear();
+	const Float *GetBounds(int item) const {return &m_Bounds[item*6];}
+	/* calls test(item, range) for each item whose box the ray passes through within range,
+	   test returns the new range, and the walk stops when it is 0. Returns the final range */
+	template <typename Test> Float RayCast(const neV3 &origin, const neV3 &dir, Float range, Test &test) const;
+	//calls test(item) for each item whose box overlaps the given box
+	template <typename Test> void Query(const Float *min, const Float *max, Test &test) const;
+private:
+	enum {LEAF_SIZE = 4, MAX_DEPTH = 64};
+	struct Node {
+		Float m_fMin[3];
+		Float m_fMax[3];
+		int m_nChild; //!< first item of a leaf, or the first of the two children
+		int m_nCount; //!< items in a leaf, 0 for an inner node
+	};
+	struct CenterLess {
+		const Float *m_pBounds;
+		int m_nAxis;
+		bool operator()(int a, int b) const {
+			return m_pBounds[a*6+m_nAxis]+m_pBounds[a*6+3+m_nAxis] < m_pBounds[b*6+m_nAxis]+m_pBounds[b*6+3+m_nAxis];
+		}
+	};
+	void BuildNode(int node, int first, int count, int depth);
+	PAL_VECTOR<Node> m_Nodes;
+	PAL_VECTOR<int> m_Items;
+	PAL_VECTOR<Float> m_Bounds;
+};
+
+void TokamakAABBTree::Clear() {
+	m_Nodes.clear();
+	m_Items.clear();
+	m_Bounds.clear();
+}
+
+void TokamakAABBTree::Build(PAL_VECTOR<Float> &bounds) {
+	Clear();
+	m_Bounds.swap(bounds);
+	int count = (int)m_Bounds.size()/6;
+	if (count == 0)
+		return;
+	m_Items.resize(count);
+	for (int i=0;i<count;i++)
+		m_Items[i] = i;
+	m_Nodes.reserve(2*(count/LEAF_SIZE+1));
+	m_Nodes.push_back(Node());
+	BuildNode(0,0,count,1);
+}
+
+void TokamakAABBTree::BuildNode(int node, int first, int count, int depth) {
+	Node n;
+	for (int a=0;a<3;a++) {
+		n.m_fMin[a] = m_Bounds[m_Items[first]*6+a];
+		n.m_fMax[a] = m_Bounds[m_Items[first]*6+3+a];
+	}
+	for (int i=first+1;i<first+count;i++) {
+		const Float *b = &m_Bounds[m_Items[i]*6];
+		for (int a=0;a<3;a++) {
+			n.m_fMin[a] = std::min(n.m_fMin[a],b[a]);
+			n.m_fMax[a] = std::max(n.m_fMax[a],b[3+a]);
+		}
+	}
+	if (count <= LEAF_SIZE || depth >= MAX_DEPTH) {
+		n.m_nChild = first;
+		n.m_nCount = count;
+		m_Nodes[node] = n;
+		return;
+	}
+	//split at the median along the longest axis
+	CenterLess less;
+	less.m_pBounds = &m_Bounds[0];
+	less.m_nAxis = 0;
+	for (int a=1;a<3;a++)
+		if (n.m_fMax[a]-n.m_fMin[a] > n.m_fMax[less.m_nAxis]-n.m_fMin[less.m_nAxis])
+			less.m_nAxis = a;
+	int half = count/2;
+	std::nth_element(m_Items.begin()+first,m_Items.begin()+first+half,m_Items.begin()+first+count,less);
+	n.m_nChild = (int)m_Nodes.size();
+	n.m_nCount = 0;
+	m_Nodes[node] = n;
+	m_Nodes.push_back(Node());
+	m_Nodes.push_back(Node());
+	BuildNode(n.m_nChild,first,half,depth+1);
+	BuildNode(n.m_nChild+1,first+half,count-half,depth+1);
+}
+
+static bool gRayHitsBox(const Float *min, const Float *max, const neV3 &origin, const neV3 &invDir, Float range) {
+	Float tmin = 0;
+	Float tmax = range;
+	for (int a=0;a<3;a++) {
+		Float t1 = (min[a]-origin[a])*invDir[a];
+		Float t2 = (max[a]-origin[a])*invDir[a];
+		if (t1 > t2)
+			std::swap(t1,t2);
+		tmin = std::max(tmin,t1);
+		tmax = std::min(tmax,t2);
+		if (tmin > tmax)
+			return false;
+	}
+	return true;
+}
+
+template <typename Test> Float TokamakAABBTree::RayCast(const neV3 &origin, const neV3 &dir, Float range, Test &test) const {
+	if (m_Nodes.empty())
+		return range;
+	neV3 invDir;
+	for (int a=0;a<3;a++)
+		invDir[a] = (dir[a] != 0) ? 1/dir[a] : 1e30f;
+	int stack[MAX_DEPTH+1];
+	int top = 0;
+	stack[top++] = 0;
+	while (top) {
+		const Node &n = m_Nodes[stack[--top]];
+		if (!gRayHitsBox(n.m_fMin,n.m_fMax,origin,invDir,range))
+			continue;
+		if (n.m_nCount) {
+			for (int i=0;i<n.m_nCount;i++) {
+				range = test(m_Items[n.m_nChild+i],range);
+				if (range <= 0)
+					return 0;
+			}
+		} else {
+			stack[top++] = n.m_nChild;
+			stack[top++] = n.m_nChild+1;
+		}
+	}
+	return range;
+}
+
+template <typename Test> void TokamakAABBTree::Query(const Float *min, const Float *max, Test &test) const {
+	if (m_Nodes.empty())
+		return;
+	int stack[MAX_DEPTH+1];
+	int top = 0;
+	stack[top++] = 0;
+	while (top) {
+		const Node &n = m_Nodes[stack[--top]];
+		if (n.m_fMin[0] > max[0] || n.m_fMin[1] > max[1] || n.m_fMin[2] > max[2]
+			|| n.m_fMax[0] < min[0] || n.m_fMax[1] < min[1] || n.m_fMax[2] < min[2])
+			continue;
+		if (n.m_nCount) {
+			for (int i=0;i<n.m_nCount;i++) {
+				const Float *b = GetBounds(m_Items[n.m_nChild+i]);
+				if (b[0] <= max[0] && b[1] <= max[1] && b[2] <= max[2] && b[3] >= min[0] && b[4] >= min[1] && b[5] >= min[2])
+					test(m_Items[n.m_nChild+i]);
+			}
+		} else {
+			stack[top++] = n.m_nChild;
+			stack[top++] = n.m_nChild+1;
+		}
+	}
+}
+
+/* Every body made of terrain triangles is a Tokamak terrain tile of its own (neSimulator::AddTerrainMesh),
+   so it is added, changed and removed without touching the others.
+   PAL keeps the triangles of each part with a tree over them, and a tree over the parts, for the queries. */
+struct TokamakTerrainPart {
+	TokamakTerrainPart() : m_pOwner(NULL), m_nTile(-1), m_pTile(NULL) {}
+	const palBodyBase *m_pOwner;
+	s32 m_nTile; //!< the Tokamak tile, -1 if none
+	neTerrainTile *m_pTile; //!< a tile built ahead (see gBuildTerrainPart), not yet given to Tokamak
+	PAL_VECTOR<neV3> m_Vertices;
+	PAL_VECTOR<neTriangle> m_Triangles;
+	TokamakAABBTree m_Tree; //!< over m_Triangles
+};
+static PAL_VECTOR<TokamakTerrainPart> g_TerrainParts;
+static TokamakAABBTree g_TerrainPartTree; //!< over the bounds of g_TerrainParts
+static neSimulator::TERRAIN_TREE_TYPE g_TerrainTreeType = neSimulator::TERRAIN_TREE_BVH; //!< the one gSim builds
+
+static void gRebuildTerrainPartTree() {
+	PAL_VECTOR<Float> bounds(g_TerrainParts.size()*6);
+	for (unsigned int i=0;i<g_TerrainParts.size();i++) {
+		const TokamakTerrainPart &part = g_TerrainParts[i];
+		for (int a=0;a<3;a++) {
+			bounds[i*6+a] = 1e30f;
+			bounds[i*6+3+a] = -1e30f;
+		}
+		for (unsigned int j=0;j<part.m_Vertices.size();j++)
+			for (int a=0;a<3;a++) {
+				bounds[i*6+a] = std::min(bounds[i*6+a],part.m_Vertices[j][a]);
+				bounds[i*6+3+a] = std::max(bounds[i*6+3+a],part.m_Vertices[j][a]);
+			}
+	}
+	g_TerrainPartTree.Build(bounds);
+}
+
+//gives the part to Tokamak as a tile, replacing the one it had
+static void gUpdateTerrainTile(TokamakTerrainPart &part) {
+	if (!gSim) {
+		if (part.m_pTile)
+			neSimulator::FreeTerrainTile(part.m_pTile);
+		part.m_pTile = NULL;
+		return;
+	}
+	if (part.m_nTile >= 0)
+		gSim->RemoveTerrainMesh(part.m_nTile);
+	part.m_nTile = -1;
+	if (part.m_pTile) {
+		part.m_nTile = gSim->AddTerrainTile(part.m_pTile);
+		part.m_pTile = NULL;
+		return;
+	}
+	if (part.m_Triangles.empty())
+		return;
+	neTriangleMesh triMesh;
+	triMesh.vertexCount = (s32)part.m_Vertices.size();
+	triMesh.triangleCount = (s32)part.m_Triangles.size();
+	triMesh.vertices = &part.m_Vertices[0];
+	triMesh.triangles = &part.m_Triangles[0];
+	part.m_nTile = gSim->AddTerrainMesh(&triMesh);
+}
+
+/* fills in a part with the triangles of a body, the vectors are emptied.
+   It reads no globals but g_TerrainTreeType, so it may run on any thread while gSim steps,
+   and with buildTile it builds the Tokamak tile too, to be added by gSetTerrainPart */
+static void gBuildTerrainPart(TokamakTerrainPart &part, PAL_VECTOR<neV3> &vertices, PAL_VECTOR<neTriangle> &triangles, bool buildTile) {
+	part.m_Vertices.swap(vertices);
+	part.m_Triangles.swap(triangles);
+	vertices.clear();
+	triangles.clear();
+	PAL_VECTOR<Float> bounds(part.m_Triangles.size()*6);
+	for (unsigned int j=0;j<part.m_Triangles.size();j++) {
+		const neTriangle &tri = part.m_Triangles[j];
+		for (int a=0;a<3;a++) {
+			Float v0 = part.m_Vertices[tri.indices[0]][a];
+			Float v1 = part.m_Vertices[tri.indices[1]][a];
+			Float v2 = part.m_Vertices[tri.indices[2]][a];
+			bounds[j*6+a] = std::min(v0,std::min(v1,v2));
+			bounds[j*6+3+a] = std::max(v0,std::max(v1,v2));
+		}
+	}
+	part.m_Tree.Build(bounds);
+	if (buildTile && !part.m_Triangles.empty() && !part.m_pTile) {
+		neTriangleMesh triMesh;
+		triMesh.vertexCount = (s32)part.m_Vertices.size();
+		triMesh.triangleCount = (s32)part.m_Triangles.size();
+		triMesh.vertices = &part.m_Vertices[0];
+		triMesh.triangles = &part.m_Triangles[0];
+		part.m_pTile = neSimulator::BuildTerrainTile(&triMesh,g_TerrainTreeType);
+	}
+}
+
+//frees what a part built by gBuildTerrainPart holds
+static void gFreeTerrainPart(TokamakTerrainPart &part) {
+	if (part.m_pTile)
+		neSimulator::FreeTerrainTile(part.m_pTile);
+	part.m_pTile = NULL;
+	part.m_Vertices.clear();
+	part.m_Triangles.clear();
+	part.m_Tree.Clear();
+}
+
+//replaces the triangles of a body in the terrain with a part from gBuildTerrainPart, which is left empty
+static void gSetTerrainPart(const palBodyBase *owner, TokamakTerrainPart &built) {
+	unsigned int i;
+	for (i=0;i<g_TerrainParts.size();i++)
+		if (g_TerrainParts[i].m_pOwner == owner)
+			break;
+	if (i == g_TerrainParts.size()) {
+		g_TerrainParts.push_back(TokamakTerrainPart());
+		g_TerrainParts[i].m_pOwner = owner;
+	}
+	TokamakTerrainPart &part = g_TerrainParts[i];
+	part.m_Vertices.swap(built.m_Vertices);
+	part.m_Triangles.swap(built.m_Triangles);
+	std::swap(part.m_Tree,built.m_Tree);
+	part.m_pTile = built.m_pTile;
+	built.m_pTile = NULL;
+	gFreeTerrainPart(built);
+	gUpdateTerrainTile(part);
+	gRebuildTerrainPartTree();
+}
+
+//replaces the triangles of a body in the terrain, the vectors are emptied
+static void gSetTerrainPart(const palBodyBase *owner, PAL_VECTOR<neV3> &vertices, PAL_VECTOR<neTriangle> &triangles) {
+	TokamakTerrainPart built;
+	gBuildTerrainPart(built,vertices,triangles,false);
+	gSetTerrainPart(owner,built);
+}
+
+//sets the material of all the triangles of a body in the terrain
+static void gSetTerrainPartMaterial(const palBodyBase *owner, s32 material) {
+	for (unsigned int i=0;i<g_TerrainParts.size();i++)
+		if (g_TerrainParts[i].m_pOwner == owner) {
+			TokamakTerrainPart &part = g_TerrainParts[i];
+			for (unsigned int j=0;j<part.m_Triangles.size();j++)
+				part.m_Triangles[j].materialID = material;
+			gUpdateTerrainTile(part);
+			return;
+		}
+}
+
+static void gRemoveTerrainPart(const palBodyBase *owner) {
+	for (unsigned int i=0;i<g_TerrainParts.size();i++)
+		if (g_TerrainParts[i].m_pOwner == owner) {
+			if (gSim && g_TerrainParts[i].m_nTile >= 0)
+				gSim->RemoveTerrainMesh(g_TerrainParts[i].m_nTile);
+			g_TerrainParts.erase(g_TerrainParts.begin()+i);
+			gRebuildTerrainPartTree();
+			return;
+		}
+}
+
+//the terrain triangle nearest a point (eg: a contact with the terrain) and its part, or -1
+static int gFindTerrainTriangle(const neV3 &point, int &part) {
+	const Float tolerance = 0.05f;
+	struct Nearest {
+		const neV3 *m_pPoint;
+		Float m_fMin[3];
+		Float m_fMax[3];
+		const TokamakTerrainPart *m_pPart;
+		int m_nPart;
+		int m_nTriangle;
+		Float m_fDistance;
+		struct Triangle {
+			Nearest *m_pNearest;
+			void operator()(int tri) {
+				m_pNearest->TestTriangle(tri);
+			}
+		};
+		void TestTriangle(int tri) {
+			const neTriangle &t = m_pPart->m_Triangles[tri];
+			const neV3 &v0 = m_pPart->m_Vertices[t.indices[0]];
+			neV3 normal = (m_pPart->m_Vertices[t.indices[1]]-v0).Cross(m_pPart->m_Vertices[t.indices[2]]-v0);
+			Float len = normal.Length();
+			if (len <= 0)
+				return;
+			Float d = fabs(normal.Dot(*m_pPoint-v0))/len;
+			if (d < m_fDistance) {
+				m_fDistance = d;
+				m_nTriangle = tri;
+				m_nPart = (int)(m_pPart-&g_TerrainParts[0]);
+			}
+		}
+		void operator()(int p) {
+			m_pPart = &g_TerrainParts[p];
+			Triangle test;
+			test.m_pNearest = this;
+			m_pPart->m_Tree.Query(m_fMin,m_fMax,test);
+		}
+	} nearest;
+	nearest.m_pPoint = &point;
+	nearest.m_nPart = -1;
+	nearest.m_nTriangle = -1;
+	nearest.m_fDistance = 1e30f;
+	for (int a=0;a<3;a++) {
+		nearest.m_fMin[a] = point[a]-tolerance;
+		nearest.m_fMax[a] = point[a]+tolerance;
+	}
+	g_TerrainPartTree.Query(nearest.m_fMin,nearest.m_fMax,nearest);
+	part = nearest.m_nPart;
+	return nearest.m_nTriangle;
+}
+
+/* Every Tokamak rigid and animated body made by PAL has an entry here, and the user data of the
+   Tokamak body is the entry index plus one, so collision callbacks can find the PAL body. */
+struct TokamakBodyEntry {
+	palBodyBase *m_pBody; //!< NULL for a free entry
+	neRigidBody *m_pRigid;
+	neAnimatedBody *m_pAnimated;
+	int m_nSensors; //!< contact sensors on the body
+	bool m_bReports; //!< the body has the collision ID that reports its collisions
+};
+static PAL_VECTOR<TokamakBodyEntry> g_Bodies;
+static PAL_VECTOR<u32> g_FreeBodies;
+static TokamakAABBTree g_BodyTree;
+static PAL_VECTOR<u32> g_BodyTreeEntries; //!< the entry of each item in the body tree
+static bool g_bBodyTreeDirty = true; //!< set when a body is added, removed or moved
+static palTokamakPhysics *g_pPhysics = NULL;
+
+static void gRegisterBody(palBodyBase *body, neRigidBody *rigid, neAnimatedBody *animated) {
+	TokamakBodyEntry entry;
+	entry.m_pBody = body;
+	entry.m_pRigid = rigid;
+	entry.m_pAnimated = animated;
+	entry.m_nSensors = 0;
+	entry.m_bReports = false;
+	u32 index;
+	if (!g_FreeBodies.empty()) {
+		index = g_FreeBodies.back();
+		g_FreeBodies.pop_back();
+		g_Bodies[index] = entry;
+	} else {
+		index = (u32)g_Bodies.size();
+		g_Bodies.push_back(entry);
+	}
+	if (rigid)
+		rigid->SetUserData(index+1);
+	if (animated)
+		animated->SetUserData(index+1);
+	g_bBodyTreeDirty = true;
+}
+
+static void gUnregisterBody(u32 userData) {
+	if (userData == 0 || userData > g_Bodies.size() || g_Bodies[userData-1].m_pBody == NULL)
+		return;
+	g_Bodies[userData-1].m_pBody = NULL;
+	g_FreeBodies.push_back(userData-1);
+	g_bBodyTreeDirty = true;
+}
+
+//for bodies that do not keep their Tokamak body, eg: the terrain planes
+static void gUnregisterBody(const palBodyBase *body) {
+	for (u32 i=0;i<g_Bodies.size();i++)
+		if (g_Bodies[i].m_pBody == body)
+			gUnregisterBody(i+1);
+}
+
+static palBodyBase *gGetBody(u32 userData) {
+	if (userData == 0 || userData > g_Bodies.size())
+		return NULL;
+	return g_Bodies[userData-1].m_pBody;
+}
+
+static TokamakBodyEntry *gFindBodyEntry(const palBodyBase *body) {
+	palTokamakBody *ptb = dynamic_cast<palTokamakBody *>(const_cast<palBodyBase *>(body));
+	if (ptb && ptb->TokamakGetRigidBody()) {
+		u32 userData = ptb->TokamakGetRigidBody()->GetUserData();
+		if (userData && userData <= g_Bodies.size() && g_Bodies[userData-1].m_pBody == body)
+			return &g_Bodies[userData-1];
+		return NULL;
+	}
+	for (u32 i=0;i<g_Bodies.size();i++)
+		if (g_Bodies[i].m_pBody == body)
+			return &g_Bodies[i];
+	return NULL;
+}
+
+//the world transform of each geometry of a body
+static neT3 gGetGeometryTransform(const TokamakBodyEntry &entry, neGeometry *geom) {
+	neT3 body = entry.m_pRigid ? entry.m_pRigid->GetTransform() : entry.m_pAnimated->GetTransform();
+	return body * geom->GetTransform();
+}
+
+static neGeometry *gFirstGeometry(const TokamakBodyEntry &entry) {
+	if (entry.m_pRigid) {
+		entry.m_pRigid->BeginIterateGeometry();
+		return entry.m_pRigid->GetNextGeometry();
+	}
+	entry.m_pAnimated->BeginIterateGeometry();
+	return entry.m_pAnimated->GetNextGeometry();
+}
+
+static neGeometry *gNextGeometry(const TokamakBodyEntry &entry) {
+	return entry.m_pRigid ? entry.m_pRigid->GetNextGeometry() : entry.m_pAnimated->GetNextGeometry();
+}
+
+//the half extents of a geometry along its own axes, false if it is not a box, sphere or cylinder
+static bool gGetGeometryExtents(neGeometry *geom, neV3 &half) {
+	neV3 size;
+	f32 diameter, height;
+	if (geom->GetBoxSize(size)) {
+		half = size*0.5f;
+		return true;
+	}
+	if (geom->GetSphereDiameter(diameter)) {
+		half.Set(diameter*0.5f,diameter*0.5f,diameter*0.5f);
+		return true;
+	}
+	if (geom->GetCylinder(diameter,height)) {
+		half.Set(diameter*0.5f,height*0.5f+diameter*0.5f,diameter*0.5f);
+		return true;
+	}
+	return false;
+}
+
+static void gUpdateBodyTree() {
+	if (!g_bBodyTreeDirty)
+		return;
+	g_bBodyTreeDirty = false;
+	PAL_VECTOR<Float> bounds;
+	g_BodyTreeEntries.clear();
+	for (u32 i=0;i<g_Bodies.size();i++) {
+		const TokamakBodyEntry &entry = g_Bodies[i];
+		if (!entry.m_pBody)
+			continue;
+		Float b[6] = {1e30f,1e30f,1e30f,-1e30f,-1e30f,-1e30f};
+		for (neGeometry *geom = gFirstGeometry(entry); geom; geom = gNextGeometry(entry)) {
+			neV3 half;
+			if (!gGetGeometryExtents(geom,half))
+				continue;
+			neT3 t = gGetGeometryTransform(entry,geom);
+			for (int a=0;a<3;a++) {
+				Float e = fabs(t.rot[0][a])*half[0]+fabs(t.rot[1][a])*half[1]+fabs(t.rot[2][a])*half[2];
+				b[a] = std::min(b[a],t.pos[a]-e);
+				b[3+a] = std::max(b[3+a],t.pos[a]+e);
+			}
+		}
+		if (b[0] > b[3])
+			continue;
+		bounds.insert(bounds.end(),b,b+6);
+		g_BodyTreeEntries.push_back(i);
+	}
+	g_BodyTree.Build(bounds);
+}
+
+/* ray tests in the frame of the shape, with a normalised direction.
+   A ray that starts inside the shape does not hit it. */
+static bool gRaySphere(const neV3 &o, const neV3 &d, Float radius, Float range, Float &t) {
+	Float b = o.Dot(d);
+	Float c = o.Dot(o)-radius*radius;
+	if (c < 0)
+		return false;
+	Float disc = b*b-c;
+	if (disc < 0)
+		return false;
+	Float hit = -b-sqrt(disc);
+	if (hit < 0 || hit > range)
+		return false;
+	t = hit;
+	return true;
+}
+
+static bool gRayBox(const neV3 &o, const neV3 &d, const neV3 &half, Float range, Float &t, neV3 &normal) {
+	Float tnear = -1e30f;
+	Float tfar = 1e30f;
+	int axis = -1;
+	Float side = 0;
+	for (int a=0;a<3;a++) {
+		if (d[a] == 0) {
+			if (o[a] < -half[a] || o[a] > half[a])
+				return false;
+			continue;
+		}
+		Float t1 = (-half[a]-o[a])/d[a];
+		Float t2 = (half[a]-o[a])/d[a];
+		Float s = -1;
+		if (t1 > t2) {
+			std::swap(t1,t2);
+			s = 1;
+		}
+		if (t1 > tnear) {
+			tnear = t1;
+			axis = a;
+			side = s;
+		}
+		tfar = std::min(tfar,t2);
+		if (tnear > tfar)
+			return false;
+	}
+	if (axis < 0 || tnear < 0 || tnear > range)
+		return false;
+	t = tnear;
+	normal.SetZero();
+	normal[axis] = side;
+	return true;
+}
+
+//a Tokamak cylinder is a capsule along its y axis
+static bool gRayCapsule(const neV3 &o, const neV3 &d, Float radius, Float halfHeight, Float range, Float &t, neV3 &normal) {
+	neV3 axisPoint;
+	axisPoint.Set(0,std::max(-halfHeight,std::min(halfHeight,o[1])),0);
+	if ((o-axisPoint).Dot(o-axisPoint) < radius*radius)
+		return false;
+	bool found = false;
+	Float a = d[0]*d[0]+d[2]*d[2];
+	if (a > 0) {
+		Float b = o[0]*d[0]+o[2]*d[2];
+		Float c = o[0]*o[0]+o[2]*o[2]-radius*radius;
+		Float disc = b*b-a*c;
+		if (disc >= 0) {
+			Float hit = (-b-sqrt(disc))/a;
+			Float y = o[1]+d[1]*hit;
+			if (hit >= 0 && hit <= range && y >= -halfHeight && y <= halfHeight) {
+				t = range = hit;
+				normal.Set(o[0]+d[0]*hit,0,o[2]+d[2]*hit);
+				found = true;
+			}
+		}
+	}
+	for (int end=-1;end<=1;end+=2) {
+		neV3 center;
+		center.Set(0,end*halfHeight,0);
+		Float hit;
+		if (gRaySphere(o-center,d,radius,range,hit)) {
+			t = range = hit;
+			normal = o+d*hit-center;
+			found = true;
+		}
+	}
+	if (found)
+		normal.Normalize();
+	return found;
+}
+
+//a two sided ray triangle test, the normal faces the ray
+static bool gRayTriangle(const neV3 &o, const neV3 &d, const neV3 &v0, const neV3 &v1, const neV3 &v2, Float range, Float &t, neV3 &normal) {
+	neV3 e1 = v1-v0;
+	neV3 e2 = v2-v0;
+	neV3 p = d.Cross(e2);
+	Float det = e1.Dot(p);
+	if (fabs(det) < 1e-12f)
+		return false;
+	Float inv = 1/det;
+	neV3 s = o-v0;
+	Float u = s.Dot(p)*inv;
+	if (u < 0 || u > 1)
+		return false;
+	neV3 q = s.Cross(e1);
+	Float v = d.Dot(q)*inv;
+	if (v < 0 || u+v > 1)
+		return false;
+	Float hit = e2.Dot(q)*inv;
+	if (hit < 0 || hit > range)
+		return false;
+	t = hit;
+	normal = e1.Cross(e2);
+	if (normal.Dot(d) > 0)
+		normal = -normal;
+	normal.Normalize();
+	return true;
+}
+
+//the closest geometry of a body hit by a ray in world space
+static neGeometry *gRayBody(const TokamakBodyEntry &entry, const neV3 &origin, const neV3 &dir, Float range, Float &t, neV3 &normal) {
+	neGeometry *closest = NULL;
+	for (neGeometry *geom = gFirstGeometry(entry); geom; geom = gNextGeometry(entry)) {
+		neT3 tr = gGetGeometryTransform(entry,geom);
+		//into the frame of the geometry
+		neV3 rel = origin-tr.pos;
+		neV3 o, d;
+		o.Set(rel.Dot(tr.rot[0]),rel.Dot(tr.rot[1]),rel.Dot(tr.rot[2]));
+		d.Set(dir.Dot(tr.rot[0]),dir.Dot(tr.rot[1]),dir.Dot(tr.rot[2]));
+		neV3 size, n;
+		f32 diameter, height;
+		Float hit;
+		bool found = false;
+		if (geom->GetBoxSize(size)) {
+			found = gRayBox(o,d,size*0.5f,range,hit,n);
+		} else if (geom->GetSphereDiameter(diameter)) {
+			found = gRaySphere(o,d,diameter*0.5f,range,hit);
+			if (found)
+				n = (o+d*hit)*(2/diameter);
+		} else if (geom->GetCylinder(diameter,height)) {
+			found = gRayCapsule(o,d,diameter*0.5f,height*0.5f,range,hit,n);
+		}
+		if (found) {
+			t = range = hit;
+			normal = tr.rot[0]*n[0]+tr.rot[1]*n[1]+tr.rot[2]*n[2];
+			closest = geom;
+		}
+	}
+	return closest;
+}
+
+//the PAL geometry of a Tokamak geometry
+static palGeometry *gFindGeometry(palBodyBase *body, neGeometry *geom) {
+	for (unsigned int i=0;i<body->m_Geometries.size();i++) {
+		palTokamakGeometry *ptg = dynamic_cast<palTokamakGeometry *>(body->m_Geometries[i]);
+		if (ptg && ptg->TokamakGetGeometry() == geom)
+			return body->m_Geometries[i];
+	}
+	return NULL;
+}
+
+typedef PAL_MULTIMAP <palBodyBase*, palBodyBase*> ListenMap;
+typedef ListenMap::iterator ListenIterator;
+typedef ListenMap::const_iterator ListenConstIterator;
+static ListenMap g_Listen;
+
+static bool gListenCollision(palBodyBase* body1, palBodyBase* body2) {
+	if (g_Listen.empty())
+		return false;
+	// The greater one is the key, which also works for NULL.
+	palBodyBase* b0 = body1 > body2 ? body1: body2;
+	palBodyBase* b1 = body1 < body2 ? body1: body2;
+
+	std::pair<ListenConstIterator, ListenConstIterator> range = g_Listen.equal_range(b0);
+	for (ListenConstIterator i = range.first; i != range.second; ++i) {
+		if (i->second == b1 || i->second == NULL) {
+			return true;
+		}
+	}
+	// a body listening for all its collisions is keyed by itself
+	if (b1 != NULL) {
+		range = g_Listen.equal_range(b1);
+		for (ListenConstIterator i = range.first; i != range.second; ++i) {
+			if (i->second == NULL) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/* Collision groups map to Tokamak collision IDs. Bodies with a contact sensor, or that are listened to,
+   use the ID of their group plus TOKAMAK_MAX_GROUPS, and only pairs with such an ID have the callback
+   response, so the other collisions never reach the callback. */
+#define TOKAMAK_MAX_GROUPS 32
+static palGroupFlags g_GroupMasks[TOKAMAK_MAX_GROUPS];
+static bool g_bCollisionCallbacks = false; //!< the callback has been installed
+
+//the collisions reported during a step, handled once the step is done
+static PAL_VECTOR<neCollisionInfo> g_Collisions;
+
+static void CollisionCallback(neCollisionInfo & collisionInfo) {
+	g_Collisions.push_back(collisionInfo);
+}
+
+static void gProcessCollisions();
+
+static void gResetCollisionGroups() {
+	for (int i=0;i<TOKAMAK_MAX_GROUPS;i++)
+		g_GroupMasks[i] = ~palGroupFlags(0);
+	g_bCollisionCallbacks = false;
+}
+
+static void gUpdateCollisionTable() {
+	if (!gSim)
+		return;
+	neCollisionTable *table = gSim->GetCollisionTable();
+	for (int a=0;a<2*TOKAMAK_MAX_GROUPS;a++)
+		for (int b=a;b<2*TOKAMAK_MAX_GROUPS;b++) {
+			int ga = a % TOKAMAK_MAX_GROUPS;
+			int gb = b % TOKAMAK_MAX_GROUPS;
+			int response = (g_GroupMasks[ga] & (palGroupFlags(1) << gb)) ? neCollisionTable::RESPONSE_IMPULSE : neCollisionTable::RESPONSE_IGNORE;
+			if (g_bCollisionCallbacks && (a >= TOKAMAK_MAX_GROUPS || b >= TOKAMAK_MAX_GROUPS))
+				response |= neCollisionTable::RESPONSE_CALLBACK;
+			table->Set(a,b,(neCollisionTable::neReponseBitFlag)response);
+		}
+}
+
+static void gEnableCollisionCallbacks() {
+	if (g_bCollisionCallbacks || !gSim)
+		return;
+	g_bCollisionCallbacks = true;
+	gUpdateCollisionTable();
+	gSim->SetCollisionCallback(CollisionCallback);
+}
+
+static void gApplyCollisionID(const TokamakBodyEntry &entry) {
+	palGroup group = entry.m_pBody->GetGroup();
+	s32 id = (group >= 0 && group < TOKAMAK_MAX_GROUPS) ? group : 0;
+	if (entry.m_bReports)
+		id += TOKAMAK_MAX_GROUPS;
+	if (entry.m_pRigid)
+		entry.m_pRigid->SetCollisionID(id);
+	if (entry.m_pAnimated)
+		entry.m_pAnimated->SetCollisionID(id);
+}
+
+//gives the body the reporting collision ID if it has a contact sensor or is listened to
+static void gUpdateReporting(const palBodyBase *body) {
+	TokamakBodyEntry *entry = gFindBodyEntry(body);
+	if (!entry)
+		return;
+	bool reports = entry->m_nSensors > 0 || g_Listen.find(const_cast<palBodyBase *>(body)) != g_Listen.end();
+	for (ListenConstIterator i = g_Listen.begin(); !reports && i != g_Listen.end(); ++i)
+		if (i->second == body)
+			reports = true;
+	if (reports == entry->m_bReports)
+		return;
+	entry->m_bReports = reports;
+	gApplyCollisionID(*entry);
+	if (reports)
+		gEnableCollisionCallbacks();
+}
+
 /*
 TokamakMaterial::TokamakMaterial() {
 };
@@ -172,6 +952,13 @@ const char* palTokamakPhysics::GetPALVersion() const {
 	return verbuf;
 }
 
+void palTokamakPhysics::GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>& descriptions) const
+{
+	palPhysics::GetPropertyDocumentation(descriptions);
+	descriptions["Tokamak_CollisionThreads"] = "Defaults to 1, from 1 to 64.  The number of threads the body to body collision tests run on.  With more than one, all the pairs are tested before any contact is registered, so the result is slightly different from one thread, but the same whatever the number of threads.";
+	descriptions["Tokamak_TerrainTree"] = "Defaults to BVH.  The tree Tokamak builds over the terrain triangles, BVH or Quadtree.  The quadtree is the one of earlier versions, slower to build and to query.";
+}
+
 void palTokamakPhysics::Init(const palPhysicsDesc& desc) {
 	palPhysics::Init(desc); //set member variables
 
@@ -187,14 +974,41 @@ void palTokamakPhysics::Init(const palPhysicsDesc& desc) {
 
 	// Create and initialise the simulator
 	gSim = neSimulator::CreateSimulator(sizeInfo, NULL, &gravity);
+	gSim->SetCollisionThreadCount(GetInitProperty("Tokamak_CollisionThreads", 1, 1, 64));
+	g_TerrainTreeType = neSimulator::TERRAIN_TREE_BVH;
+	if (GetInitProperty("Tokamak_TerrainTree") == "Quadtree")
+		g_TerrainTreeType = neSimulator::TERRAIN_TREE_QUADTREE;
+	gSim->SetTerrainTreeType(g_TerrainTreeType);
+	g_pPhysics = this;
+	gSim->SetStepCallback(&palTokamakPhysics::StepActions);
+	m_bSubstepActions = true;
+	gResetCollisionGroups();
 };
 
+void palTokamakPhysics::StepActions(f32 timeStep) {
+	if (g_pPhysics)
+		g_pPhysics->CallActions(timeStep);
+}
+
 void palTokamakPhysics::Cleanup() {
 	neSimulator::DestroySimulator(gSim);
 	gSim = NULL;
+	g_pPhysics = NULL;
+	g_TerrainParts.clear();
+	g_TerrainPartTree.Clear();
+	g_Bodies.clear();
+	g_FreeBodies.clear();
+	g_BodyTree.Clear();
+	g_BodyTreeEntries.clear();
+	g_bBodyTreeDirty = true;
+	g_Listen.clear();
+	g_Collisions.clear();
+	ClearContacts();
 };
 
 void palTokamakPhysics::Iterate(Float timestep) {
+	ClearContacts();
+	g_bBodyTreeDirty = true;
 	if (m_fFixedTimeStep > 0.0)
 	{
       gSim->Advance(timestep, set_substeps);
@@ -206,8 +1020,29 @@ void palTokamakPhysics::Iterate(Float timestep) {
 		Float stepTime = m_fFixedTimeStep / Float(set_substeps);
 		gSim->Advance(timestep, stepTime, stepTime);
 	}
+	gProcessCollisions();
 };
 
+bool palTokamakPhysics::SaveEngineState(palStateBuffer& state) const {
+	if (gSim == NULL)
+		return false;
+	s32 size = gSim->GetStateSize();
+	state.Write(size);
+	gSim->SaveState(state.Append(size));
+	return true;
+}
+
+bool palTokamakPhysics::RestoreEngineState(const palStateBuffer& state) {
+	s32 size;
+	if (gSim == NULL || !state.Read(size) || size < 0)
+		return false;
+	const void *data = state.Take(size);
+	if (data == NULL || !gSim->RestoreState(data, size))
+		return false;
+	g_bBodyTreeDirty = true;
+	return true;
+}
+
 neSimulator* palTokamakPhysics::TokamakGetSimulator() {
 	return gSim;
 }
@@ -241,18 +1076,191 @@ bool palTokamakPhysics::GetHardware(void) const {
 	return false;
 }
 
+void palTokamakPhysics::SetCollisionAccuracy(Float /*fAccuracy*/) {
+}
+
+void palTokamakPhysics::SetGroupCollision(palGroup a, palGroup b, bool enabled) {
+	if (a < 0 || b < 0 || a >= TOKAMAK_MAX_GROUPS || b >= TOKAMAK_MAX_GROUPS)
+		return;
+	if (enabled) {
+		g_GroupMasks[a] |= palGroupFlags(1) << b;
+		g_GroupMasks[b] |= palGroupFlags(1) << a;
+	} else {
+		g_GroupMasks[a] &= ~(palGroupFlags(1) << b);
+		g_GroupMasks[b] &= ~(palGroupFlags(1) << a);
+	}
+	gUpdateCollisionTable();
+}
+
+//keeps the closest hit for the single hit raycast
+class TokamakClosestRayHit : public palRayHitCallback {
+public:
+	TokamakClosestRayHit(palRayHit &hit) : m_Hit(hit) {}
+	Float AddHit(palRayHit &hit) {
+		if (!m_Hit.m_bHit || hit.m_fDistance < m_Hit.m_fDistance)
+			m_Hit = hit;
+		return m_Hit.m_fDistance;
+	}
+	palRayHit &m_Hit;
+};
+
+void palTokamakPhysics::RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range, palRayHit& hit) const {
+	hit.Clear();
+	TokamakClosestRayHit closest(hit);
+	RayCast(x,y,z,dx,dy,dz,range,closest);
+}
+
+void palTokamakPhysics::RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz,
+		Float range, palRayHitCallback& callback, palGroupFlags groupFilter) const {
+	neV3 origin, dir;
+	origin.Set(x,y,z);
+	dir.Set(dx,dy,dz);
+
+	struct Test {
+		const neV3 *m_pOrigin;
+		const neV3 *m_pDir;
+		palRayHitCallback *m_pCallback;
+		palGroupFlags m_Filter;
+		bool m_bTerrain;
+		const TokamakTerrainPart *m_pPart; //!< the part whose triangles are tested, NULL while testing the parts
+		Float m_fRange; //!< the range left after the triangles of a part
+
+		bool Accept(palBodyBase *body) const {
+			palGroup group = body->GetGroup();
+			return group < 0 || group >= TOKAMAK_MAX_GROUPS || (m_Filter & (palGroupFlags(1) << group));
+		}
+		Float Report(palBodyBase *body, palGeometry *geom, Float t, const neV3 &normal) {
+			palRayHit hit;
+			hit.Clear();
+			hit.m_bHit = true;
+			hit.m_pBody = body;
+			hit.m_pGeom = geom;
+			hit.m_fDistance = t;
+			neV3 p = *m_pOrigin+*m_pDir*t;
+			hit.SetHitPosition(p[0],p[1],p[2]);
+			hit.SetHitNormal(normal[0],normal[1],normal[2]);
+			return m_pCallback->AddHit(hit);
+		}
+		Float operator()(int item, Float range) {
+			Float t;
+			neV3 normal;
+			if (m_bTerrain && !m_pPart) {
+				//a part, the ray goes on through its triangles
+				const TokamakTerrainPart &part = g_TerrainParts[item];
+				if (!Accept(const_cast<palBodyBase *>(part.m_pOwner)))
+					return range;
+				m_pPart = &part;
+				m_fRange = range;
+				part.m_Tree.RayCast(*m_pOrigin,*m_pDir,range,*this);
+				m_pPart = NULL;
+				return m_fRange;
+			}
+			if (m_bTerrain) {
+				const neTriangle &tri = m_pPart->m_Triangles[item];
+				const PAL_VECTOR<neV3> &vertices = m_pPart->m_Vertices;
+				if (gRayTriangle(*m_pOrigin,*m_pDir,vertices[tri.indices[0]],vertices[tri.indices[1]],vertices[tri.indices[2]],range,t,normal))
+					m_fRange = Report(const_cast<palBodyBase *>(m_pPart->m_pOwner),NULL,t,normal);
+				return m_fRange;
+			}
+			const TokamakBodyEntry &entry = g_Bodies[g_BodyTreeEntries[item]];
+			if (!Accept(entry.m_pBody))
+				return range;
+			neGeometry *geom = gRayBody(entry,*m_pOrigin,*m_pDir,range,t,normal);
+			if (!geom)
+				return range;
+			return Report(entry.m_pBody,gFindGeometry(entry.m_pBody,geom),t,normal);
+		}
+	} test;
+	test.m_pOrigin = &origin;
+	test.m_pDir = &dir;
+	test.m_pCallback = &callback;
+	test.m_Filter = groupFilter;
+	test.m_pPart = NULL;
+
+	gUpdateBodyTree();
+	test.m_bTerrain = false;
+	//the terrain only has to be tested up to what the callback still wants after the bodies
+	range = g_BodyTree.RayCast(origin,dir,range,test);
+	if (range <= 0)
+		return;
+	test.m_bTerrain = true;
+	g_TerrainPartTree.RayCast(origin,dir,range,test);
+}
+
+void palTokamakPhysics::NotifyCollision(palBodyBase *body1, palBodyBase *body2, bool enabled) {
+	bool found = false;
+	std::pair<ListenIterator, ListenIterator> range;
+
+	// The greater one is the key, which also works for NULL.
+	palBodyBase* b0 = body1 > body2 ? body1: body2;
+	palBodyBase* b1 = body1 < body2 ? body1: body2;
+
+	if (b0 != NULL)
+	{
+		range = g_Listen.equal_range(b0);
+
+		for (ListenIterator i = range.first; i != range.second; ++i) {
+			if (i->second ==  b1) {
+				if (enabled) {
+					found = true;
+				} else {
+					g_Listen.erase(i);
+				}
+				break;
+			}
+		}
+
+		if (!found && enabled)
+		{
+			g_Listen.insert(range.second, std::make_pair(b0, b1));
+		}
+		gUpdateReporting(b0);
+		if (b1 != NULL)
+			gUpdateReporting(b1);
+	}
+}
+
+void palTokamakPhysics::NotifyCollision(palBodyBase *pBody, bool enabled) {
+	NotifyCollision(pBody, NULL, enabled);
+}
+
+void palTokamakPhysics::CleanupNotifications(palBodyBase *pBody) {
+	if (pBody == NULL)
+		return;
+	std::pair<ListenIterator, ListenIterator> range = g_Listen.equal_range(pBody);
+	g_Listen.erase(range.first, range.second);
+	// only greater keys have this body as a value
+	ListenIterator i = range.second;
+	while (i != g_Listen.end()) {
+		if (i->second == pBody) {
+			ListenIterator oldI = i;
+			++i;
+			g_Listen.erase(oldI);
+		} else {
+			++i;
+		}
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 
 palTokamakBody::palTokamakBody() {
+	m_ptokBody = NULL;
 	if (gSim!=NULL) {
 	m_ptokBody = gSim->CreateRigidBody();
+	gRegisterBody(this,m_ptokBody,NULL);
 //	m_ptokGeom = m_ptokBody->AddGeometry();
 	}
 };
 
 palTokamakBody::~palTokamakBody() {
 if (m_ptokBody) {
+		gUnregisterBody(m_ptokBody->GetUserData());
+		if (g_pPhysics) {
+			g_pPhysics->CleanupNotifications(this);
+			g_pPhysics->ClearContacts(this);
+		}
 		gSim->FreeRigidBody(m_ptokBody);
 		Cleanup();
 //		delete m_ptokBody;
@@ -267,6 +1275,12 @@ void palTokamakBody::SetPosition(Float x, Float y, Float z) {
 };*/
 
 void BuildRotMatrix(neM3 &rot,const palMatrix4x4& loc) {
+#if TOKAMAK_T3_IS_PAL_MATRIX
+	memcpy(&rot, loc._mat, sizeof(rot));
+	rot.M[0].v[3] = 0;
+	rot.M[1].v[3] = 0;
+	rot.M[2].v[3] = 0;
+#else
 	rot[0][0] = loc._11;
 	rot[1][0] = loc._21;
 	rot[2][0] = loc._31;
@@ -278,6 +1292,7 @@ void BuildRotMatrix(neM3 &rot,const palMatrix4x4& loc) {
 	rot[0][2] = loc._13;
 	rot[1][2] = loc._23;
 	rot[2][2] = loc._33;
+#endif
 }
 
 
@@ -301,6 +1316,7 @@ void palTokamakBody::SetPosition(const palMatrix4x4& loc) {
 	rot[2][2] = loc._33;
 */
 	m_ptokBody->SetRotation(rot);
+	g_bBodyTreeDirty = true;
 }
 
 const palMatrix4x4& palTokamakBody::GetLocationMatrix() const {
@@ -401,6 +1417,15 @@ void palTokamakBody::SetMaterial(palMaterial *material) {
 	palBody::SetMaterial(material);
 }
 
+void palTokamakBody::SetGroup(palGroup group) {
+	palBodyBase::SetGroup(group);
+	if (m_ptokBody) {
+		TokamakBodyEntry *entry = gFindBodyEntry(this);
+		if (entry)
+			gApplyCollisionID(*entry);
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 palTokamakGeometry::palTokamakGeometry() {
 	m_ptokGeom = NULL;
@@ -430,6 +1455,7 @@ void palTokamakGeometry::SetPosition(const palMatrix4x4& loc) {
 	t.rot[1][2] = loc._23;
 	t.rot[2][2] = loc._33;
 	m_ptokGeom->SetTransform(t);
+	g_bBodyTreeDirty = true;
 }
 
 void palTokamakGeometry::SetMaterial(palMaterial *material) {
@@ -1462,7 +2488,17 @@ void palTokamakPrismaticLink::Init(palBodyBase *parent, palBodyBase *child, Floa
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-palTokamakOrientatedTerrainPlane::palTokamakOrientatedTerrainPlane() {
+palTokamakOrientatedTerrainPlane::palTokamakOrientatedTerrainPlane()
+: m_pFloor(NULL) {
+}
+
+palTokamakOrientatedTerrainPlane::~palTokamakOrientatedTerrainPlane() {
+	gUnregisterBody(this);
+	if (g_pPhysics) {
+		g_pPhysics->CleanupNotifications(this);
+		g_pPhysics->ClearContacts(this);
+	}	if (gSim && m_pFloor)
+		gSim->FreeAnimatedBody(m_pFloor);
 }
 
 void palTokamakOrientatedTerrainPlane::Init(Float x, Float y, Float z, Float nx, Float ny, Float nz, Float min_size) {
@@ -1471,39 +2507,50 @@ void palTokamakOrientatedTerrainPlane::Init(Float x, Float y, Float z, Float nx,
 	neGeometry *geom;	// Pointer to a Geometry object which we'll use to define the shape/size of each cube
 
 	// Create an animated body for the floor
-	gFloor = gSim->CreateAnimatedBody();
+	m_pFloor = gSim->CreateAnimatedBody();
 	// Add geometry to the floor and set it to be a box with size as defined by the FLOORSIZE constant
-	geom = gFloor->AddGeometry();
+	geom = m_pFloor->AddGeometry();
 	neV3 boxSize1;		// The length, width and height of the cube
 	boxSize1.Set(min_size, 0.0f, min_size);
 	geom->SetBoxSize(boxSize1[0],boxSize1[1],boxSize1[2]);
-	gFloor->UpdateBoundingInfo();
+	m_pFloor->UpdateBoundingInfo();
 	// Set the position of the box within the simulator
 	neV3 pos;			// The position of each object
 	pos.Set(x, y, z);
-	gFloor->SetPos(pos);
+	m_pFloor->SetPos(pos);
 
 	neM3 rot;
 	BuildRotMatrix(rot,m_mLoc);
-	gFloor->SetRotation(rot);
+	m_pFloor->SetRotation(rot);
 
 	neRigidBody * hint = NULL;
-	gFloor->Active(true,hint);
+	m_pFloor->Active(true,hint);
+	gRegisterBody(this,NULL,m_pFloor);
 
 }
 
 void palTokamakOrientatedTerrainPlane::SetMaterial(palMaterial *material) {
 	palTokamakMaterial *ptmU = dynamic_cast<palTokamakMaterial *> (material);
 
-	gFloor->BeginIterateGeometry();
-	neGeometry * geom = gFloor->GetNextGeometry();
+	m_pFloor->BeginIterateGeometry();
+	neGeometry * geom = m_pFloor->GetNextGeometry();
 	while (geom) {
 		geom->SetMaterialIndex(ptmU->m_Index);
-		geom = gFloor->GetNextGeometry();
+		geom = m_pFloor->GetNextGeometry();
 	}
 }
 
-palTokamakTerrainPlane::palTokamakTerrainPlane() {
+palTokamakTerrainPlane::palTokamakTerrainPlane()
+: m_pFloor(NULL) {
+}
+
+palTokamakTerrainPlane::~palTokamakTerrainPlane() {
+	gUnregisterBody(this);
+	if (g_pPhysics) {
+		g_pPhysics->CleanupNotifications(this);
+		g_pPhysics->ClearContacts(this);
+	}	if (gSim && m_pFloor)
+		gSim->FreeAnimatedBody(m_pFloor);
 }
 
 void palTokamakTerrainPlane::Init(Float x, Float y, Float z, Float min_size) {
@@ -1511,13 +2558,13 @@ void palTokamakTerrainPlane::Init(Float x, Float y, Float z, Float min_size) {
 	neGeometry *geom;	// Pointer to a Geometry object which we'll use to define the shape/size of each cube
 
 	// Create an animated body for the floor
-	gFloor = gSim->CreateAnimatedBody();
+	m_pFloor = gSim->CreateAnimatedBody();
 	// Add geometry to the floor and set it to be a box with size as defined by the FLOORSIZE constant
-	geom = gFloor->AddGeometry();
+	geom = m_pFloor->AddGeometry();
 	neV3 boxSize1;		// The length, width and height of the cube
 	boxSize1.Set(min_size, 0.0f, min_size);
 	geom->SetBoxSize(boxSize1[0],boxSize1[1],boxSize1[2]);
-	gFloor->UpdateBoundingInfo();
+	m_pFloor->UpdateBoundingInfo();
 /*	// Set the material for the floor
 	if (m_pMaterial!=NULL) {
 		palTokamakMaterial *ptm = dynamic_cast<palTokamakMaterial *>(m_pMaterial);
@@ -1528,31 +2575,38 @@ void palTokamakTerrainPlane::Init(Float x, Float y, Float z, Float min_size) {
 	// Set the position of the box within the simulator
 	neV3 pos;			// The position of each object
 	pos.Set(x, y, z);
-	gFloor->SetPos(pos);
+	m_pFloor->SetPos(pos);
 	neRigidBody * hint = NULL;
-	gFloor->Active(true,hint);
+	m_pFloor->Active(true,hint);
+	gRegisterBody(this,NULL,m_pFloor);
 }
 
 void palTokamakTerrainPlane::SetMaterial(palMaterial *material) {
 	palTokamakMaterial *ptmU = dynamic_cast<palTokamakMaterial *> (material);
 
-	gFloor->BeginIterateGeometry();
-	neGeometry * geom = gFloor->GetNextGeometry();
+	m_pFloor->BeginIterateGeometry();
+	neGeometry * geom = m_pFloor->GetNextGeometry();
 	while (geom) {
 		geom->SetMaterialIndex(ptmU->m_Index);
-		geom = gFloor->GetNextGeometry();
+		geom = m_pFloor->GetNextGeometry();
 	}
 }
 
 const palMatrix4x4& palTokamakTerrainPlane::GetLocationMatrix() const{
-	if (gFloor)
-		gGetLocationMatrix(m_mLoc,gFloor->GetTransform());
+	if (m_pFloor)
+		gGetLocationMatrix(m_mLoc,m_pFloor->GetTransform());
 	return m_mLoc;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-palTokamakTerrainHeightmap::palTokamakTerrainHeightmap() {
+palTokamakTerrainHeightmap::palTokamakTerrainHeightmap()
+: m_pPrepared(NULL) {}
+
+palTokamakTerrainHeightmap::~palTokamakTerrainHeightmap() {
+	if (m_pPrepared)
+		gFreeTerrainPart(*m_pPrepared);
+	delete m_pPrepared;
 }
 
 void palTokamakTerrainHeightmap::SetMaterial(palMaterial *material) {
@@ -1563,56 +2617,50 @@ const palMatrix4x4& palTokamakTerrainHeightmap::GetLocationMatrix() const {
 	return palTokamakTerrainMesh::GetLocationMatrix();
 }
 
-void palTokamakTerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
-	palTerrainHeightmap::Init(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
-	int iTriIndex;
-	float fTerrainX, fTerrainZ;
+bool palTokamakTerrainHeightmap::Prepare(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
+	if (m_pPrepared)
+		return true;
 	int x,z;
-
-	int nv=m_iDataWidth*m_iDataDepth;
-	int ni=(m_iDataWidth-1)*(m_iDataDepth-1)*2*3;
-
-	Float *v = new Float[nv*3];
-	int *ind = new int[ni];
-
-	// Set the vertex values
-	fTerrainZ = -m_fDepth/2;
-	for (z=0; z<m_iDataDepth; z++)
-	{
-		fTerrainX = -m_fWidth/2;
-		for (x=0; x<m_iDataWidth; x++)
-		{
-			v[(x + z*m_iDataWidth)*3+0]=fTerrainX;
-			v[(x + z*m_iDataWidth)*3+1]=pHeightmap[x+z*m_iDataWidth];
-			v[(x + z*m_iDataWidth)*3+2]=fTerrainZ;
-
-		fTerrainX += (m_fWidth / (m_iDataWidth-1));
+	int xDim=terrain_data_width;
+	int zDim=terrain_data_depth;
+	PAL_VECTOR<neV3> vertices(xDim*zDim);
+	PAL_VECTOR<neTriangle> triangles((xDim-1)*(zDim-1)*2);
+
+	// the vertices are in world space, as the mesh gives them to Tokamak
+	Float fTerrainZ = pz-depth/2;
+	for (z=0; z<zDim; z++) {
+		Float fTerrainX = px-width/2;
+		for (x=0; x<xDim; x++) {
+			vertices[x + z*xDim].Set(fTerrainX,pHeightmap[x+z*xDim]+py,fTerrainZ);
+			fTerrainX += (width / (xDim-1));
 		}
-		fTerrainZ += (m_fDepth / (m_iDataDepth-1));
+		fTerrainZ += (depth / (zDim-1));
 	}
 
-	iTriIndex = 0;
-	int xDim=m_iDataWidth;
-	int yDim=m_iDataDepth;
-	int y;
-	for (y=0;y < yDim-1;y++)
+	int iTriIndex = 0;
+	for (z=0;z < zDim-1;z++)
 	for (x=0;x < xDim-1;x++) {
-		ind[iTriIndex*3+0]=(y*xDim)+x;
-		ind[iTriIndex*3+1]=(y*xDim)+xDim+x;
-		ind[iTriIndex*3+2]=(y*xDim)+x+1;
-		// Move to the next triangle in the array
-		iTriIndex += 1;
-
-		ind[iTriIndex*3+0]=(y*xDim)+x+1;
-		ind[iTriIndex*3+1]=(y*xDim)+xDim+x;
-		ind[iTriIndex*3+2]=(y*xDim)+x+xDim+1;
-		// Move to the next triangle in the array
-		iTriIndex += 1;
+		neTriangle &t0 = triangles[iTriIndex++];
+		t0.indices[0]=(z*xDim)+x;
+		t0.indices[1]=(z*xDim)+xDim+x;
+		t0.indices[2]=(z*xDim)+x+1;
+
+		neTriangle &t1 = triangles[iTriIndex++];
+		t1.indices[0]=(z*xDim)+x+1;
+		t1.indices[1]=(z*xDim)+xDim+x;
+		t1.indices[2]=(z*xDim)+x+xDim+1;
 	}
-	palTokamakTerrainMesh::Init(px,py,pz,v,nv,ind,ni);
+	m_pPrepared = new TokamakTerrainPart;
+	gBuildTerrainPart(*m_pPrepared,vertices,triangles,true);
+	return true;
+}
 
-	delete [] v;
-	delete [] ind;
+void palTokamakTerrainHeightmap::Init(Float px, Float py, Float pz, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap) {
+	palTerrainHeightmap::Init(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
+	Prepare(px,py,pz,width,depth,terrain_data_width,terrain_data_depth,pHeightmap);
+	gSetTerrainPart(this,*m_pPrepared);
+	delete m_pPrepared;
+	m_pPrepared = NULL;
 }
 
 
@@ -1621,16 +2669,14 @@ void palTokamakTerrainHeightmap::Init(Float px, Float py, Float pz, Float width,
 palTokamakTerrainMesh::palTokamakTerrainMesh(){
 }
 
+palTokamakTerrainMesh::~palTokamakTerrainMesh() {
+	gRemoveTerrainPart(this);
+}
+
 void palTokamakTerrainMesh::SetMaterial(palMaterial *material) {
 	palTokamakMaterial *ptmU = dynamic_cast<palTokamakMaterial *> (material);
-	if (gFloor) {
-	gFloor->BeginIterateGeometry();
-	neGeometry * geom = gFloor->GetNextGeometry();
-	while (geom) {
-		geom->SetMaterialIndex(ptmU->m_Index);
-		geom = gFloor->GetNextGeometry();
-	}
-	}
+	if (ptmU)
+		gSetTerrainPartMaterial(this,ptmU->m_Index);
 }
 
 const palMatrix4x4& palTokamakTerrainMesh::GetLocationMatrix() const {
@@ -1649,12 +2695,8 @@ const palMatrix4x4& palTokamakTerrainMesh::GetLocationMatrix() const {
 void palTokamakTerrainMesh::Init(Float px, Float py, Float pz, const Float *pVertices, int nVertices, const int *pIndices, int nIndices) {
 	palTerrainMesh::Init(px,py,pz,pVertices,nVertices,pIndices,nIndices);
 	int i;
-	neTriangleMesh triMesh;
-	triMesh.vertexCount = m_nVertices;
-	triMesh.triangleCount = m_nIndices/3;
-
-	neV3 *triVertices = new neV3[nVertices];
-	neTriangle *triData = new neTriangle[m_nIndices/3];
+	PAL_VECTOR<neV3> triVertices(m_nVertices);
+	PAL_VECTOR<neTriangle> triData(m_nIndices/3);
 
 	for (i=0;i<m_nIndices/3;i++) {
 		triData[i].indices[0]=pIndices[i*3+0];
@@ -1666,14 +2708,197 @@ void palTokamakTerrainMesh::Init(Float px, Float py, Float pz, const Float *pVer
 		triVertices[i].Set(pVertices[i*3+0]+m_mLoc._41,pVertices[i*3+1]+m_mLoc._42,pVertices[i*3+2]+m_mLoc._43);
 	}
 
-	triMesh.vertices = triVertices;
-	triMesh.triangles = triData;
-
 	// Tell the simulator about our mesh
-	gSim->SetTerrainMesh(&triMesh);
+	gSetTerrainPart(this,triVertices,triData);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#include <pal_i/hull.h>
+
+//a sphere (halfLength = 0) or a capsule along the up axis, as rings of points between two poles
+static void gRoundShape(Float radius, Float halfLength, int upAxis, PAL_VECTOR<palVector3> &points, PAL_VECTOR<int> &indices) {
+	const int slices = 8;
+	const int stacks = 6; //even, so there is a ring on the equator
+	int a1 = (upAxis+1)%3;
+	int a2 = (upAxis+2)%3;
+	palVector3 p;
+	vec_set(&p,0,0,0);
+	p[upAxis] = -(radius+halfLength);
+	points.push_back(p);
+	int prevRing = -1; //the first point of the previous ring, -1 for the bottom pole
+	for (int k=1;k<stacks;k++) {
+		Float phi = Float(M_PI)*(Float(k)/stacks-Float(0.5));
+		Float r = radius*cos(phi);
+		Float h = radius*sin(phi);
+		int count = (k == stacks/2 && halfLength > 0) ? 2 : 1;
+		for (int c=0;c<count;c++) {
+			Float offset = (k < stacks/2 || (k == stacks/2 && c == 0)) ? -halfLength : halfLength;
+			if (k == stacks/2 && count == 1)
+				offset = 0;
+			int ring = (int)points.size();
+			for (int j=0;j<slices;j++) {
+				Float theta = Float(2*M_PI)*j/slices;
+				p[upAxis] = h+offset;
+				p[a1] = r*cos(theta);
+				p[a2] = r*sin(theta);
+				points.push_back(p);
+			}
+			for (int j=0;j<slices;j++) {
+				int next = (j+1)%slices;
+				if (prevRing < 0) {
+					indices.push_back(0); indices.push_back(ring+j); indices.push_back(ring+next);
+				} else {
+					indices.push_back(prevRing+j); indices.push_back(ring+j); indices.push_back(ring+next);
+					indices.push_back(prevRing+j); indices.push_back(ring+next); indices.push_back(prevRing+next);
+				}
+			}
+			prevRing = ring;
+		}
+	}
+	vec_set(&p,0,0,0);
+	p[upAxis] = radius+halfLength;
+	int top = (int)points.size();
+	points.push_back(p);
+	for (int j=0;j<slices;j++) {
+		indices.push_back(prevRing+j); indices.push_back(top); indices.push_back(prevRing+(j+1)%slices);
+	}
+}
+
+//the triangles of a convex shape, from its hull if no triangles were given
+static void gConvexShape(const PAL_VECTOR<Float> &vertices, const PAL_VECTOR<int> &indices, PAL_VECTOR<palVector3> &points, PAL_VECTOR<int> &outIndices) {
+	unsigned int i;
+	if (!indices.empty()) {
+		for (i=0;i<vertices.size()/3;i++) {
+			palVector3 p;
+			vec_set(&p,vertices[i*3+0],vertices[i*3+1],vertices[i*3+2]);
+			points.push_back(p);
+		}
+		outIndices = indices;
+		return;
+	}
+	HullDesc desc;
+	desc.SetHullFlag(QF_TRIANGLES);
+	desc.mVcount = (unsigned int)vertices.size()/3;
+	desc.mVertices = new double[desc.mVcount * 3];
+	for (i = 0; i < desc.mVcount * 3; i++) {
+		desc.mVertices[i] = vertices[i];
+	}
+	desc.mVertexStride = sizeof(double) * 3;
+
+	HullResult dresult;
+	HullLibrary hl;
+	if (hl.CreateConvexHull(desc, dresult) == QE_OK) {
+		for (i = 0; i < dresult.mNumOutputVertices; i++) {
+			palVector3 p;
+			vec_set(&p,Float(dresult.mOutputVertices[i*3+0]),Float(dresult.mOutputVertices[i*3+1]),Float(dresult.mOutputVertices[i*3+2]));
+			points.push_back(p);
+		}
+		outIndices.assign(dresult.mIndices, dresult.mIndices + dresult.mNumFaces * 3);
+		hl.ReleaseResult(dresult);
+	}
+	delete [] desc.mVertices;
+}
+
+palTokamakStaticInstanceSet::palTokamakStaticInstanceSet() {
+}
+
+palTokamakStaticInstanceSet::~palTokamakStaticInstanceSet() {
+	if (m_bFinalized)
+		gRemoveTerrainPart(this);
+}
 
-	delete [] triVertices;
-	delete [] triData;
+void palTokamakStaticInstanceSet::Finalize() {
+	if (m_bFinalized)
+		return;
+	palStaticInstanceSet::Finalize();
+
+	//the local triangles of each convex shape, shared by its instances
+	PAL_VECTOR<PAL_VECTOR<palVector3> > convexPoints(GetNumConvexShapes());
+	PAL_VECTOR<PAL_VECTOR<int> > convexIndices(GetNumConvexShapes());
+	for (unsigned int i=0;i<GetNumConvexShapes();i++) {
+		const PAL_VECTOR<Float> *vertices;
+		const PAL_VECTOR<int> *indices;
+		GetConvexShape(i,vertices,indices);
+		gConvexShape(*vertices,*indices,convexPoints[i],convexIndices[i]);
+	}
+
+	static const int boxIndices[36] = {
+		0,1,3, 0,3,2, 4,6,7, 4,7,5, 0,4,5, 0,5,1,
+		2,3,7, 2,7,6, 0,2,6, 0,6,4, 1,5,7, 1,7,3 };
+
+	PAL_VECTOR<neV3> vertices;
+	PAL_VECTOR<neTriangle> triangles;
+	PAL_VECTOR<palVector3> points;
+	PAL_VECTOR<int> indices;
+	for (unsigned int i=0;i<m_Instances.size();i++) {
+		const palStaticInstance &inst = m_Instances[i];
+		const PAL_VECTOR<palVector3> *pPoints = &points;
+		const PAL_VECTOR<int> *pIndices = &indices;
+		points.clear();
+		indices.clear();
+		switch (inst.m_Type) {
+		case PAL_GEOM_BOX:
+			{
+				palVector3 dim = GetBoxXYZDimensions(i);
+				for (int c=0;c<8;c++) {
+					palVector3 p;
+					vec_set(&p,(c&4)?dim.x*0.5f:-dim.x*0.5f,(c&2)?dim.y*0.5f:-dim.y*0.5f,(c&1)?dim.z*0.5f:-dim.z*0.5f);
+					points.push_back(p);
+				}
+				indices.assign(boxIndices,boxIndices+36);
+			}
+			break;
+		case PAL_GEOM_SPHERE:
+			gRoundShape(inst.m_fDimensions[0],0,GetUpAxis(),points,indices);
+			break;
+		case PAL_GEOM_CAPSULE:
+			gRoundShape(inst.m_fDimensions[0],inst.m_fDimensions[1]*0.5f,GetUpAxis(),points,indices);
+			break;
+		case PAL_GEOM_CONVEX:
+			pPoints = &convexPoints[inst.m_nShape];
+			pIndices = &convexIndices[inst.m_nShape];
+			break;
+		default:
+			continue;
+		}
+		if (pPoints->empty())
+			continue;
+
+		palTokamakMaterial *ptm = dynamic_cast<palTokamakMaterial *>(GetInstanceMaterial(i));
+		s32 offset = (s32)vertices.size();
+		palVector3 inside;
+		vec_set(&inside,0,0,0);
+		for (unsigned int j=0;j<pPoints->size();j++) {
+			palVector3 p;
+			vec_mat_transform(&p,&inst.m_mLoc,&(*pPoints)[j]);
+			neV3 v;
+			v.Set(p.x,p.y,p.z);
+			vertices.push_back(v);
+			vec_add(&inside,&inside,&p);
+		}
+		vec_mul(&inside,Float(1)/pPoints->size());
+		neV3 center;
+		center.Set(inside.x,inside.y,inside.z);
+
+		for (unsigned int j=0;j+2<pIndices->size();j+=3) {
+			neTriangle tri;
+			tri.indices[0] = offset+(*pIndices)[j+0];
+			tri.indices[1] = offset+(*pIndices)[j+1];
+			tri.indices[2] = offset+(*pIndices)[j+2];
+			//the shapes are convex, so a triangle faces out if the center is behind it
+			const neV3 &v0 = vertices[tri.indices[0]];
+			neV3 normal = (vertices[tri.indices[1]]-v0).Cross(vertices[tri.indices[2]]-v0);
+			if (normal.Dot(center-v0) > 0) {
+				tri.indices[1] = offset+(*pIndices)[j+2];
+				tri.indices[2] = offset+(*pIndices)[j+1];
+			}
+			tri.materialID = ptm ? ptm->m_Index : 0;
+			tri.userData = i;
+			triangles.push_back(tri);
+		}
+	}
+	gSetTerrainPart(this,vertices,triangles);
 }
 
 
@@ -1704,60 +2929,131 @@ Float palTokamakPSDSensor::GetDistance() const {
 //neRigidBody* g_ContactBody1;
 PAL_MAP<neRigidBody*,PAL_VECTOR<palTokamakContactSensor *> > g_ContactData;
 
-void CollisionCallback (neCollisionInfo & collisionInfo)
-{
-	PAL_MAP<neRigidBody*,PAL_VECTOR<palTokamakContactSensor *> > ::iterator itr;
-	f32 pos[3];
-	if (collisionInfo.typeA == NE_RIGID_BODY)
-	{
-		neRigidBody * rbA = (neRigidBody *)collisionInfo.bodyA;
-		collisionInfo.worldContactPointA.Get(pos);
-		itr=g_ContactData.find(rbA);
-		unsigned int i;
-		if (itr!=g_ContactData.end()) {
-			for (i=0;i<(*itr).second.size();i++) {
-				(*itr).second[i]->m_Contact.x = pos[0];
-				(*itr).second[i]->m_Contact.y = pos[1];
-				(*itr).second[i]->m_Contact.z = pos[2];
-			}
+//the PAL body on one side of a Tokamak collision, and its instance if it is a static instance set
+static palBodyBase *gGetCollisionBody(neByte *body, neBodyType type, const neV3 &point, int &instance) {
+	instance = -1;
+	switch (type) {
+	case NE_RIGID_BODY:
+		return gGetBody(((neRigidBody *)body)->GetUserData());
+	case NE_ANIMATED_BODY:
+		return gGetBody(((neAnimatedBody *)body)->GetUserData());
+	case NE_TERRAIN:
+		{
+			int part;
+			int tri = gFindTerrainTriangle(point,part);
+			if (tri < 0)
+				return NULL;
+			palBodyBase *owner = const_cast<palBodyBase *>(g_TerrainParts[part].m_pOwner);
+			if (dynamic_cast<palStaticInstanceSet *>(owner))
+				instance = (int)g_TerrainParts[part].m_Triangles[tri].userData;
+			return owner;
 		}
+	default:
+		return NULL;
 	}
-	if (collisionInfo.typeB == NE_RIGID_BODY)
-	{
-		neRigidBody * rbB = (neRigidBody *)collisionInfo.bodyB;
-		collisionInfo.worldContactPointB.Get(pos);
-		itr=g_ContactData.find(rbB);
-		unsigned int i;
-		if (itr!=g_ContactData.end()) {
-			for (i=0;i<(*itr).second.size();i++) {
-				(*itr).second[i]->m_Contact.x = pos[0];
-				(*itr).second[i]->m_Contact.y = pos[1];
-				(*itr).second[i]->m_Contact.z = pos[2];
+}
+
+//updates the contact sensors and emits the listened contacts from the collisions of the last step
+static void gProcessCollisions() {
+	for (unsigned int c=0;c<g_Collisions.size();c++) {
+		neCollisionInfo &collisionInfo = g_Collisions[c];
+		if (g_pPhysics && !g_Listen.empty()) {
+			palContactPoint cp;
+			cp.m_pBody1 = gGetCollisionBody(collisionInfo.bodyA,collisionInfo.typeA,collisionInfo.worldContactPointA,cp.m_nInstance1);
+			cp.m_pBody2 = gGetCollisionBody(collisionInfo.bodyB,collisionInfo.typeB,collisionInfo.worldContactPointB,cp.m_nInstance2);
+			if (cp.m_pBody1 && cp.m_pBody2 && gListenCollision(cp.m_pBody1,cp.m_pBody2)) {
+				const neV3 &p = collisionInfo.worldContactPointA;
+				const neV3 &n = collisionInfo.collisionNormal;
+				vec_set(&cp.m_vContactPosition,p[0],p[1],p[2]);
+				vec_set(&cp.m_vContactNormal,n[0],n[1],n[2]);
+				g_pPhysics->EmitContact(cp);
+			}
+		}
+		if (g_ContactData.empty())
+			continue;
+		PAL_MAP<neRigidBody*,PAL_VECTOR<palTokamakContactSensor *> > ::iterator itr;
+		f32 pos[3];
+		if (collisionInfo.typeA == NE_RIGID_BODY)
+		{
+			neRigidBody * rbA = (neRigidBody *)collisionInfo.bodyA;
+			collisionInfo.worldContactPointA.Get(pos);
+			itr=g_ContactData.find(rbA);
+			unsigned int i;
+			if (itr!=g_ContactData.end()) {
+				for (i=0;i<(*itr).second.size();i++) {
+					(*itr).second[i]->m_Contact.x = pos[0];
+					(*itr).second[i]->m_Contact.y = pos[1];
+					(*itr).second[i]->m_Contact.z = pos[2];
+				}
+			}
+		}
+		if (collisionInfo.typeB == NE_RIGID_BODY)
+		{
+			neRigidBody * rbB = (neRigidBody *)collisionInfo.bodyB;
+			collisionInfo.worldContactPointB.Get(pos);
+			itr=g_ContactData.find(rbB);
+			unsigned int i;
+			if (itr!=g_ContactData.end()) {
+				for (i=0;i<(*itr).second.size();i++) {
+					(*itr).second[i]->m_Contact.x = pos[0];
+					(*itr).second[i]->m_Contact.y = pos[1];
+					(*itr).second[i]->m_Contact.z = pos[2];
+				}
 			}
 		}
 	}
+	g_Collisions.clear();
 }
 
 palTokamakContactSensor::palTokamakContactSensor() {
+	m_pTokamakRigid = NULL;
+}
+
+palTokamakContactSensor::~palTokamakContactSensor() {
+	if (!m_pTokamakRigid)
+		return;
+	PAL_MAP<neRigidBody*,PAL_VECTOR<palTokamakContactSensor *> > ::iterator itr;
+	itr=g_ContactData.find(m_pTokamakRigid);
+	if (itr != g_ContactData.end()) {
+		PAL_VECTOR<palTokamakContactSensor *> &v = (*itr).second;
+		v.erase(std::remove(v.begin(),v.end(),this),v.end());
+		if (v.empty())
+			g_ContactData.erase(itr);
+	}
 
+	//the body may already be gone, so its entry is looked up without touching it
+	for (u32 i=0;i<g_Bodies.size();i++) {
+		TokamakBodyEntry &entry = g_Bodies[i];
+		if (entry.m_pBody == m_pBody && entry.m_pRigid == m_pTokamakRigid) {
+			if (entry.m_nSensors > 0)
+				entry.m_nSensors--;
+			gUpdateReporting(entry.m_pBody);
+			break;
+		}
+	}
 }
 
 void palTokamakContactSensor::Init(palBody *body) {
 	palTokamakBody *tb = dynamic_cast<palTokamakBody *> (body);
+	m_pBody = body;
+	m_pTokamakRigid = tb->TokamakGetRigidBody();
 
 	PAL_MAP<neRigidBody*,PAL_VECTOR<palTokamakContactSensor *> > ::iterator itr;
 
-	itr=g_ContactData.find(tb->TokamakGetRigidBody());
+	itr=g_ContactData.find(m_pTokamakRigid);
 	if (itr == g_ContactData.end()) { //nothing found, make a new pair
 		PAL_VECTOR<palTokamakContactSensor *> v;
 		v.push_back(this);
-		g_ContactData.insert(std::make_pair(tb->TokamakGetRigidBody(),v) );
+		g_ContactData.insert(std::make_pair(m_pTokamakRigid,v) );
 	} else {
 		(*itr).second.push_back(this);
 	}
 
-	gSim->GetCollisionTable()->Set(0, 0, neCollisionTable::RESPONSE_IMPULSE_CALLBACK);
-	gSim->SetCollisionCallback(CollisionCallback);
+	TokamakBodyEntry *entry = gFindBodyEntry(body);
+	if (entry) {
+		entry->m_nSensors++;
+		gUpdateReporting(body);
+	}
 }
 
 void palTokamakContactSensor::GetContactPosition(palVector3 &contact) const {
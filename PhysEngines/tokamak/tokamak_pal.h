@@ -13,6 +13,16 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 0.1.35: 19/10/26 - Transforms copied as a block when Float is float
+		Version 0.1.34: 19/10/26 - Save and restore state
+		Version 0.1.33: 19/10/26 - Heightmaps built ahead by Prepare
+		Version 0.1.32: 19/10/26 - Each terrain mesh and static instance set is a separate Tokamak terrain tile
+		Version 0.1.31: 19/10/26 - Terrain tree selection (Tokamak_TerrainTree)
+		Version 0.1.30: 19/10/26 - Actions called every substep
+		Version 0.1.29: 19/10/26 - Collision tests on several threads (Tokamak_CollisionThreads)
+		Version 0.1.28: 19/10/26 - Contact sensors and notifications use collision IDs, collisions buffered per step
+		Version 0.1.27: 19/10/26 - Collision detection: raycasts, contact notification, collision groups
+		Version 0.1.26: 19/10/26 - Static instance set
 		Version 0.1.25: 20/03/09 - 64bit compatibility
 		Version 0.1.24: 22/02/09 - Added solver support for substeps
 		Version 0.1.23: 18/02/09 - Public set/get for Tokamak functionality & documentation
@@ -43,17 +53,28 @@
 		-Set angular velocity
 		-Verify correct operation of compound body
 		-Correct location setting in Geometry: set location (take into account body rotation)
-		-optimize contact sensor via contact ID's
 		-get to 1.0 (ie: same as pal.h)
 */
 
 #include "../pal/pal.h"
 #include "../pal/palFactory.h"
 #include "../pal/palSolver.h"
+#include "../pal/palCollision.h"
 
 //#define USE_QHULL
 
 #include <tokamak.h>
+
+/* TOKAMAK_T3_IS_PAL_MATRIX is 1 when Float is f32 (float). An neT3 is then laid out like a palMatrix4x4:
+   the 3 rows of the rotation and the position are neV3, 4 f32 each (the last one padding), in the order of the
+   PAL rows _1x, _2x, _3x and _4x. Transforms are copied as a block, and the padding replaced by the last PAL column.
+   Meshes are always copied: neTriangle and the padded neV3 do not match the PAL arrays. */
+#if defined(DOUBLE_PRECISION)
+#define TOKAMAK_T3_IS_PAL_MATRIX 0
+#else
+#define TOKAMAK_T3_IS_PAL_MATRIX 1
+#endif
+
 #if defined(_MSC_VER)
 #pragma message("Remember to set compiler definition to : TOKAMAK_USE_DLL")
 //#pragma comment(lib, "tokamak.lib")
@@ -93,8 +114,12 @@ protected:
 /** Tokamak Physics Class
 	Additionally Supports:
 		- Solver
+		- Collision Detection
+	Raycasts are tested against the exact body geometries and terrain triangles, found through
+	a bounding volume tree that PAL keeps alongside the simulator. Tokamak cylinders are capsules.
+	Collision groups 0 to 31 are supported.
 */
-class palTokamakPhysics: public palPhysics, public palSolver  {
+class palTokamakPhysics: public palPhysics, public palSolver, public palCollisionDetectionExtended  {
 public:
 	palTokamakPhysics();
 	void Init(const palPhysicsDesc& desc);
@@ -102,6 +127,8 @@ public:
 	const char* GetVersion() const;
 	const char* GetPALVersion() const;
 
+	/*override*/ void GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>& docOut) const;
+
 	//solver functionality
 	virtual void SetSolverAccuracy(Float fAccuracy);
 	virtual void StartIterate(Float timestep);
@@ -113,6 +140,17 @@ public:
 	virtual void SetHardware(bool status);
 	virtual bool GetHardware(void) const;
 
+	//colision detection functionality
+	virtual void SetCollisionAccuracy(Float fAccuracy);
+	virtual void SetGroupCollision(palGroup a, palGroup b, bool enabled);
+	virtual void RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range, palRayHit& hit) const;
+	virtual void RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz,
+			Float range, palRayHitCallback& callback, palGroupFlags groupFilter = ~0) const;
+	virtual void NotifyCollision(palBodyBase *a, palBodyBase *b, bool enabled);
+	virtual void NotifyCollision(palBodyBase *pBody, bool enabled);
+	void CleanupNotifications(palBodyBase *pBody);
+	virtual palCollisionDetection* asCollisionDetection() { return this; }
+
 	//Tokamak specific:
 	/** Returns the current Tokamak Simulator in use by PAL
 		\return A pointer to the current neSimulator
@@ -122,6 +160,11 @@ protected:
 	int set_substeps;
 	Float m_fFixedTimeStep;
 	void Iterate(Float timestep);
+	/// The resting contacts and stacks are not restored, so results after a restore may differ slightly
+	virtual bool SaveEngineState(palStateBuffer& state) const;
+	virtual bool RestoreEngineState(const palStateBuffer& state);
+	/// Tokamak step callback, calls the actions before each substep
+	static void StepActions(f32 timeStep);
 	FACTORY_CLASS(palTokamakPhysics,palPhysics,Tokamak,1)
 };
 
@@ -163,6 +206,7 @@ public:
 	virtual bool IsActive() const;
 
 	virtual void SetMaterial(palMaterial *material);
+	virtual void SetGroup(palGroup group);
 
 	//virtual void a() {};
 	virtual const palMatrix4x4& GetLocationMatrix() const;
@@ -349,10 +393,12 @@ class TokamakTerrain : virtual public palTerrain {
 class palTokamakTerrainPlane : public palTerrainPlane {
 public:
 	palTokamakTerrainPlane();
+	~palTokamakTerrainPlane();
 	void Init(Float x, Float y, Float z, Float min_size);
 	virtual const palMatrix4x4& GetLocationMatrix() const;
 	virtual void SetMaterial(palMaterial *material);
 protected:
+	neAnimatedBody *m_pFloor;
 	FACTORY_CLASS(palTokamakTerrainPlane,palTerrainPlane,Tokamak,1)
 };
 
@@ -360,16 +406,22 @@ protected:
 class palTokamakOrientatedTerrainPlane :  public palOrientatedTerrainPlane {
 public:
 	palTokamakOrientatedTerrainPlane();
+	~palTokamakOrientatedTerrainPlane();
 	virtual void Init(Float x, Float y, Float z, Float nx, Float ny, Float nz, Float min_size);
 	virtual const palMatrix4x4& GetLocationMatrix() const {return palOrientatedTerrainPlane::GetLocationMatrix();}
 	virtual void SetMaterial(palMaterial *material);
 protected:
+	neAnimatedBody *m_pFloor;
 	FACTORY_CLASS(palTokamakOrientatedTerrainPlane,palOrientatedTerrainPlane,Tokamak,1)
 };
 
+/** Tokamak terrain mesh.
+	Each terrain mesh (and heightmap) is a Tokamak terrain tile of its own, removed with it.
+*/
 class palTokamakTerrainMesh : virtual public palTerrainMesh {
 public:
 	palTokamakTerrainMesh();
+	virtual ~palTokamakTerrainMesh();
 	void Init(Float x, Float y, Float z, const Float *pVertices, int nVertices, const int *pIndices, int nIndices);
 	virtual const palMatrix4x4& GetLocationMatrix() const ;
 	virtual void SetMaterial(palMaterial *material);
@@ -377,16 +429,38 @@ protected:
 	FACTORY_CLASS(palTokamakTerrainMesh,palTerrainMesh,Tokamak,1)
 };
 
+struct TokamakTerrainPart;
+
+/** Tokamak terrain heightmap.
+	Prepare builds the triangles, their tree and the Tokamak tile, Init only adds the tile.
+*/
 class palTokamakTerrainHeightmap : virtual public palTerrainHeightmap, private palTokamakTerrainMesh {
 public:
 	palTokamakTerrainHeightmap();
+	virtual ~palTokamakTerrainHeightmap();
+	virtual bool Prepare(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	void Init(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	virtual const palMatrix4x4& GetLocationMatrix() const;
 	virtual void SetMaterial(palMaterial *material);
 protected:
+	TokamakTerrainPart *m_pPrepared; //!< built by Prepare, NULL once Init has added it
 	FACTORY_CLASS(palTokamakTerrainHeightmap,palTerrainHeightmap,Tokamak,1)
 };
 
+/** Tokamak static instance set.
+	Tokamak collides bodies with terrain triangles only, so the instances are turned into triangles and given
+	to Tokamak as a terrain tile of their own. Spheres and capsules are approximated by low polygon meshes.
+	Each triangle has the material of its instance (read when the set is finalized), and the instance index as its user data.
+*/
+class palTokamakStaticInstanceSet : public palStaticInstanceSet {
+public:
+	palTokamakStaticInstanceSet();
+	virtual ~palTokamakStaticInstanceSet();
+	virtual void Finalize();
+protected:
+	FACTORY_CLASS(palTokamakStaticInstanceSet,palStaticInstanceSet,Tokamak,1)
+};
+
 
 
 class palTokamakPSDSensor : public palPSDSensor {
@@ -420,10 +494,12 @@ protected:
 class palTokamakContactSensor: public palContactSensor {
 public:
 	palTokamakContactSensor();
+	~palTokamakContactSensor();
 	void Init(palBody *body); //location and size?
 	void GetContactPosition(palVector3& contact)  const;
 	palVector3 m_Contact;
 protected:
+	neRigidBody *m_pTokamakRigid; //!< the key of the sensor in the contact data
 	FACTORY_CLASS(palTokamakContactSensor,palContactSensor,Tokamak,1);
 };
 
@@ -25,7 +25,13 @@
 #include "ne_type.h"
 #include "ne_debug.h"
 #include "ne_smath.h"
-//#include <xmmintrin.h>
+#ifdef NE_USE_SSE2
+#include <emmintrin.h>
+#define NEALIGN_V3 NEALIGN16
+#else
+#define NEALIGN_V3
+#endif
+
 /****************************************************************************
 *
 *	neV3
@@ -39,8 +45,7 @@ typedef struct neQ neQ;
 
 typedef struct neM3 neM3;
 
-//struct __declspec(align(16)) neV3
-struct neV3
+struct NEALIGN_V3 neV3
 {
 public:
 
@@ -103,6 +108,12 @@ public:
 	NEINLINE bool	IsFinite		() const;
 	NEINLINE neV3	Project			(const neV3 & v) const;
 
+#ifdef NE_USE_SSE2
+	// x, y and z in an SSE2 register, w cleared; Store writes all four lanes
+	NEINLINE __m128	Load			() const;
+	NEINLINE neV3 &	Store			(__m128 m);
+#endif
+
 //	NEINLINE neV3 & operator = (const neV3& V);
     NEINLINE neV3& operator /= (f32 S);
     NEINLINE neV3& operator *= (f32 S);
@@ -338,6 +349,22 @@ public:
 #endif //USE_OPCODE
 };
 
+/****************************************************************************
+*
+*	Batch kernels
+*
+****************************************************************************/ 
+
+// out[i] = t * in[i], for count transforms
+NEINLINE void neT3MulBatch(neT3 * out, const neT3 & t, const neT3 * in, s32 count);
+
+// out[i] = t * in[i], for count points
+NEINLINE void neT3TransformBatch(neV3 * out, const neT3 & t, const neV3 * in, s32 count);
+
+// the world aligned bounds of count boxes, box i centred on c2w[i].pos with the columns
+// of c2w[i].rot as its half extents
+NEINLINE void neAABBBatch(neV3 * minBound, neV3 * maxBound, const neT3 * c2w, s32 count);
+
 ///////////////////////////////////////////////////////////////////////////
 // INCLUDE INLINE HEADERS
 ///////////////////////////////////////////////////////////////////////////
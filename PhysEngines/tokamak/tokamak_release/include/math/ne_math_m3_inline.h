@@ -88,10 +88,33 @@ NEINLINE neV3 neM3::TransposeMulV3(const neV3 & V)
 	return tmp;
 }
 
+#ifdef NE_USE_SSE2
+
+// c0 * v.x + c1 * v.y + c2 * v.z, in the order the scalar math adds them up
+NEINLINE __m128 neMulColumns(__m128 c0, __m128 c1, __m128 c2, __m128 v)
+{
+	__m128 r = _mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)));
+	r = _mm_add_ps(r, _mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1))));
+	return _mm_add_ps(r, _mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2))));
+}
+
+#endif //NE_USE_SSE2
+
 NEINLINE neM3 operator * ( const neM3& m1, const neM3& m2 )
 {
 	neM3 tmp;
 
+#ifdef NE_USE_SSE2
+	__m128 c0 = m1.M[0].Load();
+	__m128 c1 = m1.M[1].Load();
+	__m128 c2 = m1.M[2].Load();
+
+	tmp.M[0].Store(neMulColumns(c0, c1, c2, m2.M[0].Load()));
+	tmp.M[1].Store(neMulColumns(c0, c1, c2, m2.M[1].Load()));
+	tmp.M[2].Store(neMulColumns(c0, c1, c2, m2.M[2].Load()));
+
+	return tmp;
+#else
 	tmp.M[0].v[0] = m2.M[0].v[0] * m1.M[0].v[0] + m2.M[0].v[1] * m1.M[1].v[0] + m2.M[0].v[2] * m1.M[2].v[0];
 	tmp.M[0].v[1] = m2.M[0].v[0] * m1.M[0].v[1] + m2.M[0].v[1] * m1.M[1].v[1] + m2.M[0].v[2] * m1.M[2].v[1];
 	tmp.M[0].v[2] = m2.M[0].v[0] * m1.M[0].v[2] + m2.M[0].v[1] * m1.M[1].v[2] + m2.M[0].v[2] * m1.M[2].v[2];
@@ -115,17 +138,23 @@ NEINLINE neM3 operator * ( const neM3& m1, const neM3& m2 )
 	tmp.M[2][2] = m1[0][2] * m2[2][0] + m1[1][2] * m2[2][1] + m1[2][2] * m2[2][2];
 */
 	return tmp;
+#endif
 }
 
 NEINLINE neV3 operator * ( const neM3& m1, const neV3& v)
 {
 	neV3 tmp;
+
+#ifdef NE_USE_SSE2
+	return tmp.Store(neMulColumns(m1.M[0].Load(), m1.M[1].Load(), m1.M[2].Load(), v.Load()));
+#else
 	
 	tmp[0] = m1.M[0].v[0] * v.X() + m1.M[1].v[0] * v.Y() + m1.M[2].v[0] * v.Z();
 	tmp[1] = m1.M[0].v[1] * v.X() + m1.M[1].v[1] * v.Y() + m1.M[2].v[1] * v.Z();
 	tmp[2] = m1.M[0].v[2] * v.X() + m1.M[1].v[2] * v.Y() + m1.M[2].v[2] * v.Z();
 	
 	return tmp;
+#endif
 }
 
 NEINLINE neM3& operator *= ( neM3& M1, const f32 f  )
@@ -430,4 +459,4 @@ NEINLINE IceMaths::Point& neV3::AssignIcePoint(IceMaths::Point & pt) const
 	return pt;
 }
 
-#endif //USE_OPCODE
\ No newline at end of file
+#endif //USE_OPCODE
\ No newline at end of file
@@ -21,6 +21,18 @@ NEINLINE neT3 neT3::operator * (const neT3 & t)
 {
 	neT3 ret;
 
+#ifdef NE_USE_SSE2
+	__m128 c0 = rot.M[0].Load();
+	__m128 c1 = rot.M[1].Load();
+	__m128 c2 = rot.M[2].Load();
+
+	ret.rot.M[0].Store(neMulColumns(c0, c1, c2, t.rot.M[0].Load()));
+	ret.rot.M[1].Store(neMulColumns(c0, c1, c2, t.rot.M[1].Load()));
+	ret.rot.M[2].Store(neMulColumns(c0, c1, c2, t.rot.M[2].Load()));
+	ret.pos.Store(_mm_add_ps(neMulColumns(c0, c1, c2, t.pos.Load()), pos.Load()));
+
+	return ret;
+#else
 	ret.rot.M[0][0] = rot.M[0][0] * t.rot.M[0][0] + rot.M[1][0] * t.rot.M[0][1] + rot.M[2][0] * t.rot.M[0][2];
 	ret.rot.M[0][1] = rot.M[0][1] * t.rot.M[0][0] + rot.M[1][1] * t.rot.M[0][1] + rot.M[2][1] * t.rot.M[0][2];
 	ret.rot.M[0][2] = rot.M[0][2] * t.rot.M[0][0] + rot.M[1][2] * t.rot.M[0][1] + rot.M[2][2] * t.rot.M[0][2];
@@ -45,6 +57,7 @@ NEINLINE neT3 neT3::operator * (const neT3 & t)
 	ret.pos = rot[0] * t.pos[0] + rot[1] * t.pos[1] + rot[2] * t.pos[2] + pos;
 */
 	return ret;
+#endif
 }
 
 NEINLINE neV3 neT3::operator * (const neV3 & v)
@@ -52,6 +65,74 @@ NEINLINE neV3 neT3::operator * (const neV3 & v)
 	return rot * v + pos;
 }
 
+NEINLINE void neT3MulBatch(neT3 * out, const neT3 & t, const neT3 * in, s32 count)
+{
+#ifdef NE_USE_SSE2
+	__m128 c0 = t.rot.M[0].Load();
+	__m128 c1 = t.rot.M[1].Load();
+	__m128 c2 = t.rot.M[2].Load();
+	__m128 p = t.pos.Load();
+
+	for (s32 i = 0; i < count; i++)
+	{
+		out[i].rot.M[0].Store(neMulColumns(c0, c1, c2, in[i].rot.M[0].Load()));
+		out[i].rot.M[1].Store(neMulColumns(c0, c1, c2, in[i].rot.M[1].Load()));
+		out[i].rot.M[2].Store(neMulColumns(c0, c1, c2, in[i].rot.M[2].Load()));
+		out[i].pos.Store(_mm_add_ps(neMulColumns(c0, c1, c2, in[i].pos.Load()), p));
+	}
+#else
+	neT3 tt = t;
+
+	for (s32 i = 0; i < count; i++)
+		out[i] = tt * in[i];
+#endif
+}
+
+NEINLINE void neT3TransformBatch(neV3 * out, const neT3 & t, const neV3 * in, s32 count)
+{
+#ifdef NE_USE_SSE2
+	__m128 c0 = t.rot.M[0].Load();
+	__m128 c1 = t.rot.M[1].Load();
+	__m128 c2 = t.rot.M[2].Load();
+	__m128 p = t.pos.Load();
+
+	for (s32 i = 0; i < count; i++)
+		out[i].Store(_mm_add_ps(neMulColumns(c0, c1, c2, in[i].Load()), p));
+#else
+	for (s32 i = 0; i < count; i++)
+		out[i] = t.rot * in[i] + t.pos;
+#endif
+}
+
+NEINLINE void neAABBBatch(neV3 * minBound, neV3 * maxBound, const neT3 * c2w, s32 count)
+{
+#ifdef NE_USE_SSE2
+	__m128 absMask = neMaskAbs();
+
+	for (s32 i = 0; i < count; i++)
+	{
+		__m128 a = _mm_add_ps(_mm_add_ps(_mm_and_ps(c2w[i].rot.M[0].Load(), absMask),
+										_mm_and_ps(c2w[i].rot.M[1].Load(), absMask)),
+										_mm_and_ps(c2w[i].rot.M[2].Load(), absMask));
+		__m128 p = c2w[i].pos.Load();
+
+		minBound[i].Store(_mm_sub_ps(p, a));
+		maxBound[i].Store(_mm_add_ps(p, a));
+	}
+#else
+	for (s32 i = 0; i < count; i++)
+	{
+		for (s32 j = 0; j < 3; j++)
+		{
+			f32 a = neAbs(c2w[i].rot.M[0].v[j]) + neAbs(c2w[i].rot.M[1].v[j]) + neAbs(c2w[i].rot.M[2].v[j]);
+
+			minBound[i].v[j] = c2w[i].pos.v[j] - a;
+			maxBound[i].v[j] = c2w[i].pos.v[j] + a;
+		}
+	}
+#endif
+}
+
 NEINLINE neT3 neT3::FastInverse()
 {
 	neT3 ret;
@@ -119,4 +200,4 @@ neBool neT3::IsFinite()
 	return ((*this).rot.IsFinite() && (*this).pos.IsFinite());
 }
 
-#endif //USE_OPCODE
\ No newline at end of file
+#endif //USE_OPCODE
\ No newline at end of file
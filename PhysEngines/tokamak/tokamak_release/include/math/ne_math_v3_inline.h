@@ -11,6 +11,39 @@
  *                                                                       *
  *************************************************************************/
 
+#ifdef NE_USE_SSE2
+
+// all bits set in x, y and z, clear in w
+NEINLINE __m128 neMaskXYZ()
+{
+	return _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+}
+
+// everything but the sign bits
+NEINLINE __m128 neMaskAbs()
+{
+	return _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+}
+
+//=========================================================================
+
+NEINLINE __m128 neV3::Load() const
+{
+	// w is mostly left uninitialised, and denormals or NaNs in it would send
+	// every SSE2 op down the slow path, so it is cleared on the way in
+	return _mm_and_ps(_mm_load_ps(v), neMaskXYZ());
+}
+
+//=========================================================================
+
+NEINLINE neV3 & neV3::Store(__m128 m)
+{
+	_mm_store_ps(v, m);
+	return (*this);
+}
+
+#endif //NE_USE_SSE2
+
 //=========================================================================
 
 NEINLINE f32& neV3::operator[]( s32 I )
@@ -34,9 +67,12 @@ NEINLINE f32 neV3::operator [] ( s32 I ) const
 
 NEINLINE neV3 & neV3::Set( f32 x, f32 y, f32 z )
 {
+#ifdef NE_USE_SSE2
+	return Store(_mm_set_ps(0.0f, z, y, x));
+#else
     this->v[0] = x; this->v[1] = y; this->v[2] = z;
-	//m = _mm_set_ps(x, y, z, 0);
 	return (*this);
+#endif
 }
 /*
 NEINLINE neV3 & neV3::operator =(const neV3 & V)
@@ -63,9 +99,13 @@ NEINLINE neV3 & neV3::Set(const neQ& Q)
 
 NEINLINE void neV3::SetAbs(const neV3 & a)
 {
+#ifdef NE_USE_SSE2
+	Store(_mm_and_ps(a.Load(), neMaskAbs()));
+#else
 	v[0] = neAbs(a[0]);
 	v[1] = neAbs(a[1]);
 	v[2] = neAbs(a[2]);
+#endif
 }
 
 //=========================================================================
@@ -153,9 +193,13 @@ NEINLINE void neV3::RotateZ( neRadian Rz )
 
 NEINLINE neV3 & neV3::SetZero( void )
 {
+#ifdef NE_USE_SSE2
+	return Store(_mm_setzero_ps());
+#else
     this->v[0] = this->v[1] = this->v[2] = 0.0f;
 
 	return (*this);
+#endif
 }
 
 NEINLINE neV3 & neV3::SetOne(void)
@@ -189,29 +233,48 @@ NEINLINE neV3 neV3::Cross( const neV3& V ) const
 {
 	neV3 tmp;
 
+#ifdef NE_USE_SSE2
+	__m128 a = Load();
+	__m128 b = V.Load();
+	__m128 ayzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	__m128 byzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	// z, x, y of the cross product
+	__m128 c = _mm_sub_ps(_mm_mul_ps(a, byzx), _mm_mul_ps(ayzx, b));
+
+	return tmp.Store(_mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1)));
+#else
 	tmp.v[0] = Y() * V.Z() - Z() * V.Y();
 	tmp.v[1] = Z() * V.X() - X() * V.Z();
 	tmp.v[2] = X() * V.Y() - Y() * V.X();
 
 	return tmp;
+#endif
 }
 
 //=========================================================================
 
 NEINLINE neV3& neV3::operator += ( const neV3& V )
 {
+#ifdef NE_USE_SSE2
+	return Store(_mm_or_ps(_mm_add_ps(Load(), V.Load()), _mm_andnot_ps(neMaskXYZ(), _mm_load_ps(v))));
+#else
     v[0] += V.X(); v[1] += V.Y(); v[2] += V.Z();
     return *this;
+#endif
 }
 
 //=========================================================================
 
 NEINLINE neV3& neV3::operator -= ( const neV3& V )
 {
+#ifdef NE_USE_SSE2
+	return Store(_mm_or_ps(_mm_sub_ps(Load(), V.Load()), _mm_andnot_ps(neMaskXYZ(), _mm_load_ps(v))));
+#else
     v[0] -= V.X(); 
 	v[1] -= V.Y(); 
 	v[2] -= V.Z();
     return *this;
+#endif
 }
 
 //=========================================================================
@@ -253,7 +316,11 @@ NEINLINE neRadian neV3::GetYaw( void ) const
 NEINLINE neV3 operator - ( const neV3& V )
 {
 	neV3 tmp;
+#ifdef NE_USE_SSE2
+	return tmp.Store(_mm_xor_ps(V.Load(), _mm_set1_ps(-0.0f)));
+#else
     return tmp.Set( -V.X(), -V.Y(), -V.Z() );
+#endif
 }
 
 //=========================================================================
@@ -262,11 +329,11 @@ NEINLINE neV3 operator + ( const neV3& V1, const neV3& V2 )
 {
 	neV3 tmp;
 
-	//tmp.m = _mm_add_ps(V1.m, V2.m);
-
-	//return tmp;
-	
+#ifdef NE_USE_SSE2
+	return tmp.Store(_mm_add_ps(V1.Load(), V2.Load()));
+#else
     return tmp.Set( V1.X() + V2.X(), V1.Y() + V2.Y(), V1.Z() + V2.Z() );
+#endif
 }
 
 //=========================================================================
@@ -275,10 +342,11 @@ NEINLINE neV3 operator - ( const neV3& V1, const neV3& V2 )
 {
 	neV3 tmp;
 
-	//tmp.m = _mm_sub_ps(V1.m, V2.m);
-
-	//return tmp;
+#ifdef NE_USE_SSE2
+	return tmp.Store(_mm_sub_ps(V1.Load(), V2.Load()));
+#else
     return tmp.Set( V1.X() - V2.X(), V1.Y() - V2.Y(), V1.Z() - V2.Z() );
+#endif
 }
 
 //=========================================================================
@@ -293,7 +361,11 @@ NEINLINE neV3 operator / ( const neV3& V, f32 S )
 NEINLINE neV3 operator * ( const neV3& V, const f32 S )
 {
 	neV3 tmp;
+#ifdef NE_USE_SSE2
+	return tmp.Store(_mm_mul_ps(V.Load(), _mm_set1_ps(S)));
+#else
     return tmp.Set( V.X() * S, V.Y() * S, V.Z() * S );
+#endif
 }
 
 //=========================================================================
@@ -314,16 +386,24 @@ NEINLINE void neV3::SetBoxTensor(f32 width, f32 height, f32 length, f32 mass)
 //=========================================================================
 NEINLINE void neV3::SetMin(const neV3& V1, const neV3& V2)
 {
+#ifdef NE_USE_SSE2
+	Store(_mm_min_ps(V1.Load(), V2.Load()));
+#else
 	(*this)[0] = (V1.X() < V2.X()) ? V1.X() : V2.X();
 	(*this)[1] = (V1.Y() < V2.Y()) ? V1.Y() : V2.Y();
 	(*this)[2] = (V1.Z() < V2.Z()) ? V1.Z() : V2.Z();
+#endif
 }
 //=========================================================================
 NEINLINE void neV3::SetMax(const neV3& V1, const neV3& V2)
 {
+#ifdef NE_USE_SSE2
+	Store(_mm_max_ps(V1.Load(), V2.Load()));
+#else
 	(*this)[0] = (V1.X() > V2.X()) ? V1.X() : V2.X();
 	(*this)[1] = (V1.Y() > V2.Y()) ? V1.Y() : V2.Y();
 	(*this)[2] = (V1.Z() > V2.Z()) ? V1.Z() : V2.Z();
+#endif
 }
 //=========================================================================
 NEINLINE neV3 operator *      ( const neV3& V,  const neM3&     M  )
@@ -340,15 +420,15 @@ NEINLINE neV3 operator * ( const neV3& V1, const neV3& V2 )
 {
 	neV3 ret;
 
-	//ret.m = _mm_mul_ps(V1.m, V2.m);
-
-	//return ret;
-
+#ifdef NE_USE_SSE2
+	return ret.Store(_mm_mul_ps(V1.Load(), V2.Load()));
+#else
 	ret[0] = V1[0] * V2[0];
 	ret[1] = V1[1] * V2[1];
 	ret[2] = V1[2] * V2[2];
 
 	return ret;
+#endif
 }
 
 NEINLINE bool neV3::IsConsiderZero() const
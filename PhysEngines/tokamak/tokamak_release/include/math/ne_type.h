@@ -61,13 +61,29 @@ typedef s32                 neBool;
 	#define neFinite _finite
 	#define inline   __forceinline       // Make sure that the compiler inlines when we tell him
 	#define NEINLINE __forceinline
+	#define NEALIGN16 __declspec(align(16))
+	#define NETHREADLOCAL __declspec(thread)
 	const char PATH_SEP = '\\';
 #elif defined __GNUC__
 	typedef signed long long    s64;
 	typedef unsigned long long  u64;
 	#define neFinite isfinite
 	#define NEINLINE inline
+	#define NEALIGN16 __attribute__((aligned(16)))
+	#define NETHREADLOCAL __thread
 	const char PATH_SEP = '/';
 #endif
 
+///////////////////////////////////////////////////////////////////////////
+// SIMD
+///////////////////////////////////////////////////////////////////////////
+
+// The vector, matrix and transform math stays scalar unless NE_USE_SSE2 is defined
+// (TOKAMAK_SSE2 in the PAL CMake build). Tokamak and the code using it have to
+// be built the same way, as neV3 is 16 byte aligned with SSE2.
+
+#if defined(NE_USE_SSE2) && !(defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#error NE_USE_SSE2 is defined but the compiler does not target SSE2
+#endif
+
 #endif //NE_TYPE_H
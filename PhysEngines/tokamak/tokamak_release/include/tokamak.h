@@ -79,11 +79,20 @@ public:
 		
 		usedMem += size;
 
+#ifdef NE_USE_SSE2
+		// neV3 is loaded and stored with aligned SSE2 moves
+		return (neByte *)_mm_malloc(size, 16);
+#else
 		return (neByte *)malloc(size);
+#endif
 	}
 	void Free(neByte * ptr) {
 
+#ifdef NE_USE_SSE2
+		_mm_free(ptr);
+#else
 		free(ptr);
+#endif
 	}
 public:
 	s32 usedMem;
@@ -311,6 +320,8 @@ class TOKAMAK_API neRigidBody;
 
 class TOKAMAK_API neAnimatedBody;
 
+class neTerrainTile;
+
 class TOKAMAK_API neSensor
 {
 NE_INTERFACE(neSensor)
@@ -950,6 +961,8 @@ typedef void (neLogOutputCallback)(char * logString);
 
 typedef void (neCollisionCallback)(neCollisionInfo & collisionInfo);
 
+typedef void (neStepCallback)(f32 timeStep);
+
 typedef void (neTerrainTriangleQueryCallback)(const neV3 & minBound, const neV3 & maxBound, 
 											  s32 ** candidateTriangles,
 												neTriangle ** triangles,
@@ -985,6 +998,12 @@ public:
 		LOG_OUTPUT_LEVEL_ONE,
 		LOG_OUTPUT_LEVEL_FULL,
 	} LOG_OUTPUT_LEVEL;
+
+	typedef enum
+	{
+		TERRAIN_TREE_BVH = 0,
+		TERRAIN_TREE_QUADTREE,
+	} TERRAIN_TREE_TYPE;
 	
 public:
 	/* 
@@ -1037,6 +1056,31 @@ public:
 
 	void FreeTerrainMesh();
 
+	// the tree SetTerrainMesh and AddTerrainMesh build over the triangles, a BVH (the default)
+	// or the quadtree of earlier versions; set it before adding the meshes
+	void SetTerrainTreeType(TERRAIN_TREE_TYPE type);
+
+	TERRAIN_TREE_TYPE GetTerrainTreeType();
+
+	// adds a terrain tile: a mesh with its own tree and bounding box, tested
+	// alongside the SetTerrainMesh mesh against the bodies over it; returns
+	// its id for RemoveTerrainMesh, or -1 if the mesh has no triangles
+	s32 AddTerrainMesh(neTriangleMesh * tris);
+
+	void RemoveTerrainMesh(s32 tile);
+
+	// builds a terrain tile without adding it, touching no simulator, so it
+	// may be called from any thread while another one steps; returns NULL if
+	// the mesh has no triangles
+	static neTerrainTile * BuildTerrainTile(neTriangleMesh * tris, TERRAIN_TREE_TYPE type = TERRAIN_TREE_BVH);
+
+	// frees a tile that has not been added
+	static void FreeTerrainTile(neTerrainTile * tile);
+
+	// adds a tile made by BuildTerrainTile, which the simulator then owns;
+	// returns its id for RemoveTerrainMesh
+	s32 AddTerrainTile(neTerrainTile * tile);
+
 	/*
 		Constraint related
 	*/
@@ -1076,6 +1120,17 @@ public:
 
 	neCustomCDRB2ABCallback * GetCustomCDRB2ABCallback();
 
+	// threads the body to body collision tests run on, 1 (the default) tests them
+	// on the calling thread in the order Tokamak always has
+	void SetCollisionThreadCount(s32 count);
+
+	s32 GetCollisionThreadCount();
+
+	// called at the start of every step Advance takes, with the length of the step
+	void SetStepCallback(neStepCallback * cb);
+
+	neStepCallback * GetStepCallback();
+
 	void SetLogOutputCallback(neLogOutputCallback * cb);
 
 	neLogOutputCallback * GetLogOutputCallback();
@@ -1087,6 +1142,18 @@ public:
 	neSimulatorSizeInfo GetStartSizeInfo();
 
 	void GetMemoryAllocated(s32 & memoryAllocated);
+
+	// the number of bytes SaveState needs for the simulator as it is now
+	s32 GetStateSize();
+
+	// copies the motion of the active bodies and the step count, to go back to with
+	// RestoreState while the simulator has the same bodies; the resting contacts,
+	// stacks and broadphase are not copied, and catch up with the bodies after a restore
+	void SaveState(void * buffer);
+
+	// returns false, changing nothing, if the state was not saved with the active bodies
+	// the simulator has now
+	neBool RestoreState(const void * buffer, s32 size);
 };
 
 
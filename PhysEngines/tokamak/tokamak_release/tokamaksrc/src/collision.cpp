@@ -990,8 +990,8 @@ void CollisionTest(neCollisionResult & result, neCollision & colA, neT3 & transA
 	{
 		const s32 totalPotentials = 100;
 
-		static TConvex * potentialsA[totalPotentials];
-		static TConvex * potentialsB[totalPotentials];
+		static NETHREADLOCAL TConvex * potentialsA[totalPotentials];
+		static NETHREADLOCAL TConvex * potentialsB[totalPotentials];
 
 		s32 potentialsACount = 0;
 		s32 potentialsBCount = 0;
@@ -53,23 +53,9 @@ void neCollisionBody_::UpdateAABB()
 */
 	neT3 c2w = b2w * obb;   
 
-	neV3 &pos = c2w.pos;
+	neAABBBatch(&minBound, &maxBound, &c2w, 1);
 
-	int i;
-
-	for (i = 0; i < 3; i++)
-	{
-		f32 a = neAbs(c2w.rot[0][i]) + neAbs(c2w.rot[1][i]) + neAbs(c2w.rot[2][i]);
-
-		minBound[i] = pos[i] - a;
-		maxBound[i] = pos[i] + a;
-
-		if (minCoord[i])
-			minCoord[i]->value = pos[i] - a;// - col.boundingRadius;
-
-		if (maxCoord[i])
-			maxCoord[i]->value = pos[i] + a;// + col.boundingRadius;
-	}
+	SetAABBCoords();
 };
 
 void neCollisionBody_::Free()
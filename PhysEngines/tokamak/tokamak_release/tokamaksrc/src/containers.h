@@ -588,7 +588,12 @@ public:
 
 		neByte * mem = alloc->Alloc(sizeof(listItem) * n + 4);
 
-		data = new (mem) listItem[n];
+		// one at a time, an array new may put a cookie in front and leave the
+		// items off the 16 byte alignment neV3 needs
+		data = (listItem *)mem;
+
+		for (s32 j = 0; j < n; j++)
+			new (&data[j]) listItem;
 
 		mallocNewDiff = (neByte*)data - mem;
 		
@@ -806,7 +811,14 @@ public:
 
 		neByte * mem = alloc->Alloc(sizeof(T) * n + 4);
 
-		buffer = new(mem) T[n];
+		// see neDLinkList::Reserve
+		buffer = (T *)mem;
+
+		if (buffer)
+		{
+			for (s32 j = 0; j < n; j++)
+				new (&buffer[j]) T;
+		}
 	
 		mallocNewDiff = (neByte*)buffer - mem;
 		
@@ -1267,4 +1279,4 @@ public:
 	s32 count;
 };
 
-#endif //CONTAINERS_H
\ No newline at end of file
+#endif //CONTAINERS_H
\ No newline at end of file
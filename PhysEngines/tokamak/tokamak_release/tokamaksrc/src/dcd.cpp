@@ -37,19 +37,21 @@ const s32 TRI_NUM_VERTS = 3;
 const s32 TRI_NUM_EDGES = 3;
 
 
-s32 _num_edge_test;
+// written by the tests, which CheckCollision can run on several threads at once
 
-s32 _num_face_test;
+NETHREADLOCAL s32 _num_edge_test;
+
+NETHREADLOCAL s32 _num_face_test;
 
 static neByte _boxNeighbourFaces[][4] = {{2,3,4,5},{2,3,4,5},{0,1,4,5},{0,1,4,5},{0,1,2,3},{0,1,2,3}};
 static neByte _boxNeighbourVerts[][4] = {{2,3,6,7},{0,1,4,5},{4,5,6,7},{0,1,2,3},{1,3,5,7},{0,2,4,6}};
 static neByte _boxNeighbourEdges[][4] = {{0,1,2,3},{4,5,6,7},{0,4,8,9},{1,5,10,11},{2,8,6,10},{3,7,9,11}};
 static neByte _boxVertNeighbourEdges[][4] = {{5,7,11,0xff},{5,6,10,0xff},{1,3,11,0xff},{1,2,10,0xff},{4,7,9,0xff},{4,6,8,0xff},{0,3,9,0xff},{0,2,8,0xff}};
-static neV3 _boxNormals[BOX_NUM_FACES] = {{0,1,0,0},{0,-1,0,0},{1,0,0,0},{-1,0,0,0},{0,0,1,0},{0,0,-1,0}};
+static NETHREADLOCAL neV3 _boxNormals[BOX_NUM_FACES] = {{0,1,0,0},{0,-1,0,0},{1,0,0,0},{-1,0,0,0},{0,0,1,0},{0,0,-1,0}};
 static neV3 _boxVertexPos0[BOX_NUM_VERTS] = {{-1,-1,-1,0},{-1,-1,1,0},{-1,1,-1,0},{-1,1,1,0},{1,-1,-1,0},{1,-1,1,0},{1,1,-1,0},{1,1,1,0}};
-static neV3 _boxVertexPosP[BOX_NUM_VERTS];
-static neV3 _boxVertexPosQ[BOX_NUM_VERTS];
-static neBool _visited[100];
+static NETHREADLOCAL neV3 _boxVertexPosP[BOX_NUM_VERTS];
+static NETHREADLOCAL neV3 _boxVertexPosQ[BOX_NUM_VERTS];
+static NETHREADLOCAL neBool _visited[100];
 
 DCDFace BoxFaces[BOX_NUM_FACES] =
 {
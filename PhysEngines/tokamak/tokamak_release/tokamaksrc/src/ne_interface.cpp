@@ -2161,6 +2161,96 @@ void neSimulator::FreeTerrainMesh()
 
 }
 
+/****************************************************************************
+*
+*	neSimulator::AddTerrainMesh
+*
+****************************************************************************/ 
+
+s32 neSimulator::AddTerrainMesh(neTriangleMesh * tris)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.AddTerrainMesh(tris);
+}
+
+/****************************************************************************
+*
+*	neSimulator::RemoveTerrainMesh
+*
+****************************************************************************/ 
+
+void neSimulator::RemoveTerrainMesh(s32 tile)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	sim.RemoveTerrainMesh(tile);
+}
+
+/****************************************************************************
+*
+*	neSimulator::BuildTerrainTile
+*
+****************************************************************************/ 
+
+neTerrainTile * neSimulator::BuildTerrainTile(neTriangleMesh * tris, TERRAIN_TREE_TYPE type)
+{
+	return reinterpret_cast<neTerrainTile *>(neRegion::BuildTerrainTile(tris, type, NULL));
+}
+
+/****************************************************************************
+*
+*	neSimulator::FreeTerrainTile
+*
+****************************************************************************/ 
+
+void neSimulator::FreeTerrainTile(neTerrainTile * tile)
+{
+	delete reinterpret_cast<neTriangleTree *>(tile);
+}
+
+/****************************************************************************
+*
+*	neSimulator::AddTerrainTile
+*
+****************************************************************************/ 
+
+s32 neSimulator::AddTerrainTile(neTerrainTile * tile)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	if (!tile)
+		return -1;
+
+	return sim.AddTerrainTile(reinterpret_cast<neTriangleTree *>(tile));
+}
+
+/****************************************************************************
+*
+*	neSimulator::SetTerrainTreeType
+*
+****************************************************************************/ 
+
+void neSimulator::SetTerrainTreeType(TERRAIN_TREE_TYPE type)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	sim.region.terrainTree.treeType = type;
+}
+
+/****************************************************************************
+*
+*	neSimulator::GetTerrainTreeType
+*
+****************************************************************************/ 
+
+neSimulator::TERRAIN_TREE_TYPE neSimulator::GetTerrainTreeType()
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.region.terrainTree.treeType;
+}
+
 /****************************************************************************
 *
 *	 neSimulator::CreateJoint
@@ -2465,6 +2555,58 @@ neCustomCDRB2ABCallback * neSimulator::GetCustomCDRB2ABCallback()
 	return sim.customCDRB2ABCallback;
 }
 
+/****************************************************************************
+*
+*	neSimulator::SetCollisionThreadCount
+*
+****************************************************************************/ 
+
+void neSimulator::SetCollisionThreadCount(s32 count)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	sim.SetCollisionThreadCount(count);
+}
+
+/****************************************************************************
+*
+*	neSimulator::GetCollisionThreadCount
+*
+****************************************************************************/ 
+
+s32 neSimulator::GetCollisionThreadCount()
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.GetCollisionThreadCount();
+}
+
+/****************************************************************************
+*
+*	neSimulator::SetStepCallback
+*
+****************************************************************************/ 
+
+void neSimulator::SetStepCallback(neStepCallback * cb)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	sim.stepCallback = cb;
+}
+
+/****************************************************************************
+*
+*	neSimulator::GetStepCallback
+*
+****************************************************************************/ 
+
+neStepCallback * neSimulator::GetStepCallback()
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.stepCallback;
+}
+
 /****************************************************************************
 *
 *	neSimulator::SetLogOutputCallback
@@ -2567,6 +2709,45 @@ void neSimulator::GetMemoryAllocated(s32 & memoryAllocated)
 	sim.GetMemoryAllocated(memoryAllocated);
 }
 
+/****************************************************************************
+*
+*	neSimulator::GetStateSize
+*
+****************************************************************************/ 
+
+s32 neSimulator::GetStateSize()
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.GetStateSize();
+}
+
+/****************************************************************************
+*
+*	neSimulator::SaveState
+*
+****************************************************************************/ 
+
+void neSimulator::SaveState(void * buffer)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	sim.SaveState(buffer);
+}
+
+/****************************************************************************
+*
+*	neSimulator::RestoreState
+*
+****************************************************************************/ 
+
+neBool neSimulator::RestoreState(const void * buffer, s32 size)
+{
+	CAST_THIS(neFixedTimeStepSimulator, sim);
+
+	return sim.RestoreState(buffer, size);
+}
+
 /****************************************************************************
 *
 *	neJoint::SetType
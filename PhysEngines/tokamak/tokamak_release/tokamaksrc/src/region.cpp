@@ -39,6 +39,10 @@
 
 neRegion::~neRegion()
 {
+	for (size_t i = 0; i < terrainTiles.size(); i++)
+	{
+		delete terrainTiles[i];
+	}
 }
 
 /****************************************************************************
@@ -90,6 +94,8 @@ void neRegion::Initialise(neFixedTimeStepSimulator * s, neByte sortD)
 //	needRebuild = true;
 
 	terrainTree.sim = sim;
+
+	terrainTilesChanged = false;
 	
 #ifdef _DEBUG_REGION
 	debugOn = false;
@@ -473,6 +479,118 @@ void neRegion::FreeTerrain()
 	terrainTree.FreeTree();
 }
 
+/****************************************************************************
+*
+*	neRegion::AddTerrainTile
+*
+*	A tile is a terrain mesh with its own tree, added and removed without
+*	touching the others. The tree over the tile boxes is rebuilt on the next
+*	query after a change.
+*
+****************************************************************************/ 
+
+neTriangleTree * neRegion::BuildTerrainTile(neTriangleMesh * tris, neSimulator::TERRAIN_TREE_TYPE type, neFixedTimeStepSimulator * sim)
+{
+	neTriangleTree * tile = new neTriangleTree;
+
+	tile->sim = sim;
+
+	tile->treeType = type;
+
+	// without a simulator the tile allocates with its own default allocator
+	if (!tile->BuildTree(tris->vertices, tris->vertexCount, tris->triangles, tris->triangleCount, sim ? sim->allocator : NULL))
+	{
+		delete tile;
+
+		return NULL;
+	}
+	return tile;
+}
+
+s32 neRegion::AddTerrainTile(neTriangleMesh * tris)
+{
+	neTriangleTree * tile = BuildTerrainTile(tris, terrainTree.treeType, sim);
+
+	if (!tile)
+		return -1;
+
+	return AddTerrainTile(tile);
+}
+
+s32 neRegion::AddTerrainTile(neTriangleTree * tile)
+{
+	tile->sim = sim;
+
+	s32 i;
+
+	for (i = 0; i < (s32)terrainTiles.size(); i++)
+	{
+		if (terrainTiles[i] == NULL)
+			break;
+	}
+	if (i == (s32)terrainTiles.size())
+		terrainTiles.push_back(tile);
+	else
+		terrainTiles[i] = tile;
+
+	terrainTilesChanged = true;
+
+	return i;
+}
+
+void neRegion::RemoveTerrainTile(s32 tile)
+{
+	if (tile < 0 || tile >= (s32)terrainTiles.size() || terrainTiles[tile] == NULL)
+		return;
+
+	delete terrainTiles[tile];
+
+	terrainTiles[tile] = NULL;
+
+	while (terrainTiles.size() > 0 && terrainTiles.back() == NULL)
+	{
+		terrainTiles.pop_back();
+	}
+	terrainTilesChanged = true;
+}
+
+void neRegion::GetTerrainTiles(neSimpleArray<s32> & tiles, const neV3 & minBound, const neV3 & maxBound)
+{
+	s32 i;
+
+	if (terrainTilesChanged)
+	{
+		std::vector<neV3> minBounds, maxBounds;
+
+		terrainTileTreeTiles.clear();
+
+		for (i = 0; i < (s32)terrainTiles.size(); i++)
+		{
+			if (!terrainTiles[i])
+				continue;
+
+			minBounds.push_back(terrainTiles[i]->minBound);
+
+			maxBounds.push_back(terrainTiles[i]->maxBound);
+
+			terrainTileTreeTiles.push_back(i);
+		}
+		s32 count = (s32)terrainTileTreeTiles.size();
+
+		terrainTileTree.Build(count, count ? &minBounds[0] : NULL, count ? &maxBounds[0] : NULL);
+
+		terrainTilesChanged = false;
+	}
+	s32 first = tiles.GetUsedCount();
+
+	terrainTileTree.GetCandidateTriangles(tiles, minBound, maxBound);
+
+	for (i = first; i < tiles.GetUsedCount(); i++)
+	{
+		tiles[i] = terrainTileTreeTiles[tiles[i]];
+	}
+}
+
 void neRegion::InsertCoordList(neRigidBodyBase * bb, neRigidBodyBase * hint)
 {
 	for (s32 i = 0; i < 3; i++)
@@ -737,37 +737,9 @@ void neRigidBody_::UpdateAABB()
 	c2w.M[2][2] = obb.M[2][0] * rot.M[0][2] + obb.M[2][1] * rot.M[1][2] + obb.M[2][2] * rot.M[2][2];
 */
 
-		neV3 &p = c2w.pos;
+		neAABBBatch(&minBound, &maxBound, &c2w, 1);
 
-		f32 a = neAbs(c2w.rot[0][0]) + neAbs(c2w.rot[1][0]) + neAbs(c2w.rot[2][0]);
-
-		minBound[0] = p[0] - a;
-		maxBound[0] = p[0] + a;
-
-		if (minCoord[0])
-			minCoord[0]->value = p[0] - a ;
-		if (maxCoord[0])
-			maxCoord[0]->value = p[0] + a;
-
-		a = neAbs(c2w.rot[0][1]) + neAbs(c2w.rot[1][1]) + neAbs(c2w.rot[2][1]);
-
-		minBound[1] = p[1] - a;
-		maxBound[1] = p[1] + a;
-
-		if (minCoord[1])
-			minCoord[1]->value = p[1] - a;
-		if (maxCoord[1])
-			maxCoord[1]->value = p[1] + a;
-		
-		a = neAbs(c2w.rot[0][2]) + neAbs(c2w.rot[1][2]) + neAbs(c2w.rot[2][2]);
-
-		minBound[2] = p[2] - a;
-		maxBound[2] = p[2] + a;
-
-		if (minCoord[2])
-			minCoord[2]->value = p[2] - a;
-		if (maxCoord[2])
-			maxCoord[2]->value = p[2] + a;
+		SetAABBCoords();
 #endif
 	}
 }
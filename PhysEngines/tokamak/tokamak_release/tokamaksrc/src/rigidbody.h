@@ -175,6 +175,18 @@ public:
 		return ret;
 	}
 
+	// copies minBound and maxBound to the coordinate lists of the region
+	NEINLINE void SetAABBCoords()
+	{
+		for (s32 i = 0; i < 3; i++)
+		{
+			if (minCoord[i])
+				minCoord[i]->value = minBound[i];
+			if (maxCoord[i])
+				maxCoord[i]->value = maxBound[i];
+		}
+	}
+
 	neBool IsValid();
 
 	neV3 VelocityAtPoint(const neV3 & pt);
@@ -43,6 +43,8 @@
 /********************************************************/
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
+#include <thread>
 
 #define X 0
 #define Y 1
@@ -712,6 +714,443 @@ void neTreeNode::GetCandidateNodes(neSimpleArray<neTreeNode*> & nodes, const neV
 	}
 }
 
+/****************************************************************************
+*
+*	neTerrainBVH
+*
+****************************************************************************/ 
+
+#define NE_BVH_BIN_COUNT 16
+
+#define NE_BVH_MAX_LEAF_SIZE 4
+
+// smaller subtrees are built on the thread that reaches them
+#define NE_BVH_THREAD_MIN_TRIANGLES 4096
+
+// a triangle, or a tile box for the tree over the terrain tiles
+struct neBVHBuildTriangle
+{
+	f32 minBound[3];
+
+	f32 maxBound[3];
+
+	f32 center[3];
+
+	s32 index;
+};
+
+struct neBVHBin
+{
+	f32 minBound[3];
+
+	f32 maxBound[3];
+
+	s32 count;
+};
+
+static void BVHEmptyBounds(f32 * minBound, f32 * maxBound)
+{
+	for (s32 i = 0; i < 3; i++)
+	{
+		minBound[i] = 1.0e30f;
+
+		maxBound[i] = -1.0e30f;
+	}
+}
+
+static void BVHGrowBounds(f32 * minBound, f32 * maxBound, const f32 * otherMin, const f32 * otherMax)
+{
+	for (s32 i = 0; i < 3; i++)
+	{
+		minBound[i] = otherMin[i] < minBound[i] ? otherMin[i] : minBound[i];
+
+		maxBound[i] = otherMax[i] > maxBound[i] ? otherMax[i] : maxBound[i];
+	}
+}
+
+static f32 BVHHalfArea(const f32 * minBound, const f32 * maxBound)
+{
+	f32 dx = maxBound[0] - minBound[0];
+	f32 dy = maxBound[1] - minBound[1];
+	f32 dz = maxBound[2] - minBound[2];
+
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static s32 BVHBin(f32 center, f32 centerMin, f32 scale, s32 binCount)
+{
+	s32 bin = (s32)((center - centerMin) * scale);
+
+	if (bin < 0)
+		return 0;
+
+	if (bin >= binCount)
+		return binCount - 1;
+
+	return bin;
+}
+
+struct neBVHSplitTest
+{
+	s32 axis;
+
+	f32 centerMin;
+
+	f32 scale;
+
+	s32 binCount;
+
+	s32 bin;
+
+	bool operator()(const neBVHBuildTriangle & t) const
+	{
+		return BVHBin(t.center[axis], centerMin, scale, binCount) <= bin;
+	}
+};
+
+class neBVHBuilder
+{
+public:
+	void Build(std::vector<neTerrainBVHNode> & out, s32 first, s32 count, s32 threadDepth);
+
+	static void Append(std::vector<neTerrainBVHNode> & out, const std::vector<neTerrainBVHNode> & subtree);
+
+public:
+	neBVHBuildTriangle * tris; //reordered so the triangles of each leaf are together
+};
+
+void neBVHBuilder::Append(std::vector<neTerrainBVHNode> & out, const std::vector<neTerrainBVHNode> & subtree)
+{
+	s32 offset = (s32)out.size();
+
+	for (size_t i = 0; i < subtree.size(); i++)
+	{
+		neTerrainBVHNode node = subtree[i];
+
+		if (node.triCount == 0)
+			node.next += offset;
+
+		out.push_back(node);
+	}
+}
+
+void neBVHBuilder::Build(std::vector<neTerrainBVHNode> & out, s32 first, s32 count, s32 threadDepth)
+{
+	s32 nodeIndex = (s32)out.size();
+
+	out.push_back(neTerrainBVHNode());
+
+	neTerrainBVHNode node;
+
+	f32 centerMin[3], centerMax[3];
+
+	BVHEmptyBounds(node.minBound, node.maxBound);
+
+	BVHEmptyBounds(centerMin, centerMax);
+
+	neBVHBuildTriangle * begin = tris + first;
+
+	neBVHBuildTriangle * end = begin + count;
+
+	neBVHBuildTriangle * t;
+
+	s32 axis, j;
+
+	for (t = begin; t < end; t++)
+	{
+		BVHGrowBounds(node.minBound, node.maxBound, t->minBound, t->maxBound);
+
+		BVHGrowBounds(centerMin, centerMax, t->center, t->center);
+	}
+
+	if (count <= NE_BVH_MAX_LEAF_SIZE)
+	{
+		node.next = first;
+
+		node.triCount = count;
+
+		out[nodeIndex] = node;
+
+		return;
+	}
+
+	// the cost of testing every triangle against the node's box, relative to testing one child's box
+	f32 nodeArea = BVHHalfArea(node.minBound, node.maxBound);
+
+	f32 bestCost = (f32)count * nodeArea;
+
+	neBVHSplitTest split;
+
+	split.axis = -1;
+
+	// fewer bins for small nodes, there are a lot of them
+	s32 binCount = count < NE_BVH_BIN_COUNT ? count : NE_BVH_BIN_COUNT;
+
+	split.binCount = binCount;
+
+	// bin the centers along the three axes at once
+	neBVHBin bins[3][NE_BVH_BIN_COUNT];
+
+	f32 scale[3];
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		f32 extent = centerMax[axis] - centerMin[axis];
+
+		scale[axis] = extent > 0.0f ? (f32)binCount / extent : 0.0f;
+
+		for (j = 0; j < binCount; j++)
+		{
+			BVHEmptyBounds(bins[axis][j].minBound, bins[axis][j].maxBound);
+
+			bins[axis][j].count = 0;
+		}
+	}
+	for (t = begin; t < end; t++)
+	{
+		for (axis = 0; axis < 3; axis++)
+		{
+			neBVHBin & bin = bins[axis][BVHBin(t->center[axis], centerMin[axis], scale[axis], binCount)];
+
+			BVHGrowBounds(bin.minBound, bin.maxBound, t->minBound, t->maxBound);
+
+			bin.count++;
+		}
+	}
+
+	for (axis = 0; axis < 3; axis++)
+	{
+		if (scale[axis] == 0.0f)
+			continue;
+
+		// the area and count right of each split, the split after bin j leaves j + 1 bins on the left
+		f32 rightArea[NE_BVH_BIN_COUNT];
+
+		s32 rightCount[NE_BVH_BIN_COUNT];
+
+		f32 sideMin[3], sideMax[3];
+
+		s32 sideCount = 0;
+
+		BVHEmptyBounds(sideMin, sideMax);
+
+		for (j = binCount - 1; j > 0; j--)
+		{
+			BVHGrowBounds(sideMin, sideMax, bins[axis][j].minBound, bins[axis][j].maxBound);
+
+			sideCount += bins[axis][j].count;
+
+			rightCount[j] = sideCount;
+
+			rightArea[j] = sideCount ? BVHHalfArea(sideMin, sideMax) : 0.0f;
+		}
+		sideCount = 0;
+
+		BVHEmptyBounds(sideMin, sideMax);
+
+		for (j = 0; j < binCount - 1; j++)
+		{
+			BVHGrowBounds(sideMin, sideMax, bins[axis][j].minBound, bins[axis][j].maxBound);
+
+			sideCount += bins[axis][j].count;
+
+			if (sideCount == 0 || rightCount[j + 1] == 0)
+				continue;
+
+			f32 cost = nodeArea + BVHHalfArea(sideMin, sideMax) * (f32)sideCount + rightArea[j + 1] * (f32)rightCount[j + 1];
+
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+
+				split.axis = axis;
+
+				split.centerMin = centerMin[axis];
+
+				split.scale = scale[axis];
+
+				split.bin = j;
+			}
+		}
+	}
+
+	s32 mid = first + count / 2;
+
+	if (split.axis != -1)
+	{
+		mid = (s32)(std::partition(begin, end, split) - tris);
+
+		if (mid == first || mid == first + count)
+			mid = first + count / 2;
+	}
+	// else all the centers are the same, or no split is cheaper than a leaf, which would be too big
+
+	s32 leftCount = mid - first;
+
+	if (threadDepth > 0 && count >= NE_BVH_THREAD_MIN_TRIANGLES)
+	{
+		std::vector<neTerrainBVHNode> left, right;
+
+		left.reserve(2 * leftCount);
+
+		right.reserve(2 * (count - leftCount));
+
+		std::thread worker(&neBVHBuilder::Build, this, std::ref(left), first, leftCount, threadDepth - 1);
+
+		Build(right, mid, count - leftCount, threadDepth - 1);
+
+		worker.join();
+
+		Append(out, left);
+
+		Append(out, right);
+	}
+	else
+	{
+		Build(out, first, leftCount, threadDepth);
+
+		Build(out, mid, count - leftCount, threadDepth);
+	}
+	node.next = (s32)out.size();
+
+	node.triCount = 0;
+
+	out[nodeIndex] = node;
+}
+
+static void BVHBuild(neTerrainBVH & bvh, std::vector<neBVHBuildTriangle> & buildTris)
+{
+	s32 count = (s32)buildTris.size();
+
+	s32 i;
+
+	for (i = 0; i < count; i++)
+	{
+		neBVHBuildTriangle & b = buildTris[i];
+
+		for (s32 k = 0; k < 3; k++)
+			b.center[k] = (b.minBound[k] + b.maxBound[k]) * 0.5f;
+
+		b.index = i;
+	}
+
+	// a thread for each subtree down to this depth, the splits do not depend on it
+	s32 threadDepth = 0;
+
+	for (u32 n = std::thread::hardware_concurrency(); n > 1; n = (n + 1) / 2)
+		threadDepth++;
+
+	bvh.nodes.reserve(2 * count);
+
+	neBVHBuilder builder;
+
+	builder.tris = &buildTris[0];
+
+	builder.Build(bvh.nodes, 0, count, threadDepth);
+
+	bvh.triIndices.resize(count);
+
+	for (i = 0; i < count; i++)
+		bvh.triIndices[i] = buildTris[i].index;
+}
+
+void neTerrainBVH::Build(neTriangleTree * tree)
+{
+	Free();
+
+	s32 triCount = tree->triangles.GetUsedCount();
+
+	if (triCount <= 0)
+		return;
+
+	std::vector<neBVHBuildTriangle> buildTris(triCount);
+
+	s32 i, j, k;
+
+	for (i = 0; i < triCount; i++)
+	{
+		neTriangle_ & t = tree->triangles[i];
+
+		neBVHBuildTriangle & b = buildTris[i];
+
+		BVHEmptyBounds(b.minBound, b.maxBound);
+
+		for (j = 0; j < 3; j++)
+		{
+			const neV3 & v = tree->vertices[t.indices[j]];
+
+			for (k = 0; k < 3; k++)
+			{
+				if (v[k] < b.minBound[k])
+					b.minBound[k] = v[k];
+
+				if (v[k] > b.maxBound[k])
+					b.maxBound[k] = v[k];
+			}
+		}
+	}
+	BVHBuild(*this, buildTris);
+}
+
+void neTerrainBVH::Build(s32 count, const neV3 * minBounds, const neV3 * maxBounds)
+{
+	Free();
+
+	if (count <= 0)
+		return;
+
+	std::vector<neBVHBuildTriangle> buildBoxes(count);
+
+	for (s32 i = 0; i < count; i++)
+	{
+		for (s32 k = 0; k < 3; k++)
+		{
+			buildBoxes[i].minBound[k] = minBounds[i][k];
+
+			buildBoxes[i].maxBound[k] = maxBounds[i][k];
+		}
+	}
+	BVHBuild(*this, buildBoxes);
+}
+
+void neTerrainBVH::Free()
+{
+	std::vector<neTerrainBVHNode>().swap(nodes);
+
+	std::vector<s32>().swap(triIndices);
+}
+
+void neTerrainBVH::GetCandidateTriangles(neSimpleArray<s32> & tris, const neV3 & minBound, const neV3 & maxBound)
+{
+	s32 nodeCount = (s32)nodes.size();
+
+	s32 i = 0;
+
+	while (i < nodeCount)
+	{
+		const neTerrainBVHNode & node = nodes[i];
+
+		if (minBound[1] > node.maxBound[1] || maxBound[1] < node.minBound[1] ||
+			minBound[0] > node.maxBound[0] || maxBound[0] < node.minBound[0] ||
+			minBound[2] > node.maxBound[2] || maxBound[2] < node.minBound[2])
+		{
+			// skip the subtree
+			i = node.triCount ? i + 1 : node.next;
+
+			continue;
+		}
+		for (s32 j = 0; j < node.triCount; j++)
+		{
+			s32 * n = tris.Alloc();
+
+			ASSERT(n);
+
+			*n = triIndices[node.next + j];
+		}
+		i++;
+	}
+}
+
 /****************************************************************************
 *
 *	neTriangleTree::neTriangleTree()
@@ -726,6 +1165,12 @@ neTriangleTree::neTriangleTree()
 
 	vertices = NULL;
 
+	treeType = neSimulator::TERRAIN_TREE_BVH;
+
+	minBound.SetZero();
+
+	maxBound.SetZero();
+
 	sim = NULL;
 }
 #pragma optimize( "", off )
@@ -813,6 +1258,50 @@ neTreeNode & neTriangleTree::GetNode(s32 nodeIndex)
 	}
 }
 
+/****************************************************************************
+*
+*	neTriangleTree::GetCandidateTriangles
+*
+****************************************************************************/ 
+
+void neTriangleTree::GetCandidateTriangles(neSimpleArray<neTreeNode*> & treeNodes, neSimpleArray<s32> & tris, const neV3 & minBound, const neV3 & maxBound)
+{
+	if (bvh.GetNodeCount() > 0)
+	{
+		bvh.GetCandidateTriangles(tris, minBound, maxBound);
+
+		return;
+	}
+	root.GetCandidateNodes(treeNodes, minBound, maxBound, 0);
+
+	//printf("node count %d\n", treeNodes.GetUsedCount());
+
+	// the quadtree puts a triangle in every sector it crosses
+	for (s32 i = 0; i < treeNodes.GetUsedCount(); i++)
+	{
+		neTreeNode * t = treeNodes[i];
+
+		for (s32 j = 0; j < t->triangleIndices.GetUsedCount(); j++)
+		{
+			s32 k;
+
+			for (k = 0; k < tris.GetUsedCount(); k++)
+			{
+				if (t->triangleIndices[j] == tris[k])
+					break;
+			}
+			if (k == tris.GetUsedCount())
+			{
+				s32 * triIndex = tris.Alloc();
+
+				//ASSERT(triIndex);
+
+				*triIndex = t->triangleIndices[j];
+			}
+		}
+	}
+}
+
 /****************************************************************************
 *
 *	neTriangleTree::BuildTree
@@ -850,6 +1339,10 @@ neBool neTriangleTree::BuildTree(neV3 * _vertices, s32 _vertexCount, neTriangle
 	}
 
 
+	minBound.Set(1.0e30f);
+
+	maxBound.Set(-1.0e30f);
+
 	for (i = 0; i < triCount; i++)
 	{
 		neTriangle * t = triangles.Alloc();
@@ -857,9 +1350,30 @@ neBool neTriangleTree::BuildTree(neV3 * _vertices, s32 _vertexCount, neTriangle
 		ASSERT(t);
 
 		*t = tris[i];
+
+		for (s32 j = 0; j < 3; j++)
+		{
+			const neV3 & v = vertices[t->indices[j]];
+
+			minBound.SetMin(minBound, v);
+
+			maxBound.SetMax(maxBound, v);
+		}
 	}
 
-	nodes.Reserve(sim->sizeInfo.terrainNodesStartCount, alloc, sim->sizeInfo.terrainNodesGrowByCount);
+	if (treeType == neSimulator::TERRAIN_TREE_BVH)
+	{
+		bvh.Build(this);
+
+		return true;
+	}
+
+	// a tile built apart from any simulator takes the default sizes
+	neSimulatorSizeInfo defaultSizeInfo;
+
+	const neSimulatorSizeInfo & sizeInfo = sim ? sim->sizeInfo : defaultSizeInfo;
+
+	nodes.Reserve(sizeInfo.terrainNodesStartCount, alloc, sizeInfo.terrainNodesGrowByCount);
 
 	neSimpleArray<s32> triIndex;
 
@@ -902,11 +1416,17 @@ void neTriangleTree::FreeTree()
 
 	nodes.Free();
 
+	bvh.Free();
+
 	neV3 minBound, maxBound;
 	minBound.SetZero();
 	maxBound.SetZero();
 	root.Initialise(NULL, 0, minBound, maxBound);
 
+	this->minBound.SetZero();
+
+	this->maxBound.SetZero();
+
 	vertexCount = 0;
 }
 
@@ -14,6 +14,8 @@
 #ifndef NE_SCENERY_H
 #define NE_SCENERY_H
 
+#include <vector>
+
 class neTriangleTree;
 
 class neFixedTimeStepSimulator;
@@ -99,6 +101,52 @@ public:
 	neSimpleArray<s32> triangleIndices; //leaf only
 };
 
+/****************************************************************************
+*
+*	NE Physics Engine 
+*
+*	Class: neTerrainBVH
+*
+*	Desc: bounding volume hierarchy over the terrain triangles, or over the
+*		boxes of the terrain tiles, built with a binned surface area heuristic. The nodes are stored depth first in one
+*		array, the first child of an inner node is the node after it and the
+*		other follows the first child's subtree, so a query walks the array
+*		without a stack, jumping over the subtrees it misses.
+*
+****************************************************************************/ 
+
+struct neTerrainBVHNode
+{
+	f32 minBound[3];
+
+	f32 maxBound[3];
+
+	s32 next; //inner: the node after this subtree, leaf: the first entry in triIndices
+
+	s32 triCount; //0 for an inner node
+};
+
+class neTerrainBVH
+{
+public:
+	void Build(neTriangleTree * tree);
+
+	// builds over any boxes, the candidates are then the indices of the boxes
+	void Build(s32 count, const neV3 * minBounds, const neV3 * maxBounds);
+
+	void Free();
+
+	// appends the triangles of the leaves overlapping the box, each triangle is in one leaf only
+	void GetCandidateTriangles(neSimpleArray<s32> & tris, const neV3 & minBound, const neV3 & maxBound);
+
+	s32 GetNodeCount() {return (s32)nodes.size();}
+
+public:
+	std::vector<neTerrainBVHNode> nodes;
+
+	std::vector<s32> triIndices; //the triangles of each leaf in turn
+};
+
 /****************************************************************************
 *
 *	NE Physics Engine 
@@ -122,10 +170,13 @@ public:
 
 	neTreeNode & GetRoot(){ return root;}
 
-	bool HasTerrain() {return nodes.GetUsedCount() > 0;};
+	bool HasTerrain() {return nodes.GetUsedCount() > 0 || bvh.GetNodeCount() > 0;};
 
 	neTreeNode & GetNode(s32 nodeIndex);
 
+	// the triangles to test a box against, treeNodes is scratch space for the quadtree
+	void GetCandidateTriangles(neSimpleArray<neTreeNode*> & treeNodes, neSimpleArray<s32> & tris, const neV3 & minBound, const neV3 & maxBound);
+
 public:
 	neV3 * vertices;
 
@@ -141,6 +192,14 @@ public:
 
 	neTreeNode root;
 
+	neSimulator::TERRAIN_TREE_TYPE treeType; //the tree BuildTree builds
+
+	neV3 minBound; //the box around all the triangles
+
+	neV3 maxBound;
+
+	neTerrainBVH bvh;
+
 	neFixedTimeStepSimulator * sim;
 };
 
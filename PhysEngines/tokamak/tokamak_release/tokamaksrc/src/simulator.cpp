@@ -26,6 +26,12 @@
 
 //#include <assert.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #ifdef _WIN32
 #include <windows.h>
 #endif
@@ -40,6 +46,133 @@ extern s32 currentMicroStep;
 
 void ChooseAxis(neV3 & x, neV3 & y, const neV3 & normal);
 
+/****************************************************************************
+*
+*	neCollisionThreads
+*
+*	The worker threads CheckCollision tests the pairs on. The jobs are handed
+*	out in chunks, each writes only its own result, so the order the threads
+*	get to them in does not matter.
+*
+****************************************************************************/ 
+
+#define NE_COLLISION_JOB_CHUNK 16
+
+class neCollisionThreads
+{
+public:
+	neCollisionThreads(neFixedTimeStepSimulator * s, s32 count) : sim(s), round(0), running(0), quit(false), jobCount(0)
+	{
+		nextJob = 0;
+
+		// the calling thread makes one of them
+		for (s32 i = 1; i < count; i++)
+			workers.push_back(std::thread(&neCollisionThreads::Work, this));
+	}
+	~neCollisionThreads()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			quit = true;
+		}
+		wake.notify_all();
+
+		for (size_t i = 0; i < workers.size(); i++)
+			workers[i].join();
+	}
+	s32 Count()
+	{
+		return (s32)workers.size() + 1;
+	}
+	// tests jobs 0 to count - 1, returns once they are all done
+	void Run(s32 count)
+	{
+		jobCount = count;
+
+		nextJob = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			round++;
+
+			running = (s32)workers.size();
+		}
+		wake.notify_all();
+
+		TestJobs();
+
+		std::unique_lock<std::mutex> lock(mutex);
+
+		while (running > 0)
+			finished.wait(lock);
+	}
+
+protected:
+	void Work()
+	{
+		u32 seen = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+
+				while (!quit && round == seen)
+					wake.wait(lock);
+
+				if (quit)
+					return;
+
+				seen = round;
+			}
+			TestJobs();
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (--running == 0)
+				finished.notify_one();
+		}
+	}
+	void TestJobs()
+	{
+		for (;;)
+		{
+			s32 first = nextJob.fetch_add(NE_COLLISION_JOB_CHUNK);
+
+			if (first >= jobCount)
+				return;
+
+			s32 last = first + NE_COLLISION_JOB_CHUNK;
+
+			if (last > jobCount)
+				last = jobCount;
+
+			sim->TestCollisionJobs(first, last);
+		}
+	}
+
+	neFixedTimeStepSimulator * sim;
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+
+	std::condition_variable wake;
+
+	std::condition_variable finished;
+
+	u32 round;
+
+	s32 running;
+
+	bool quit;
+
+	s32 jobCount;
+
+	std::atomic<s32> nextJob;
+};
+
 /****************************************************************************
 *
 *	neFixedTimeStepSimulator::neFixedTimeStepSimulator(
@@ -79,6 +212,8 @@ neFixedTimeStepSimulator::neFixedTimeStepSimulator(const neSimulatorSizeInfo & _
 
 	triangleIndex.Reserve(200, allocator, 200);
 
+	terrainTileIndex.Reserve(16, allocator, 16);
+
 	constraintHeap.Reserve(sizeInfo.constraintsCount , allocator);
 
 	constraintHeaders.Reserve(sizeInfo.constraintSetsCount , allocator);
@@ -109,6 +244,8 @@ neFixedTimeStepSimulator::neFixedTimeStepSimulator(const neSimulatorSizeInfo & _
 
 	collisionCallback = NULL;
 
+	stepCallback = NULL;
+
 	breakageCallback = NULL;
 
 	terrainQueryCallback = NULL;
@@ -117,6 +254,12 @@ neFixedTimeStepSimulator::neFixedTimeStepSimulator(const neSimulatorSizeInfo & _
 
 	customCDRB2ABCallback = NULL;
 
+	collisionThreadCount = 1;
+
+	collisionThreads = NULL;
+
+	collisionJobs.Reserve(100, allocator, -1);
+
 	logLevel = neSimulator::LOG_OUTPUT_LEVEL_NONE;
 
 //	solver.sim = this;
@@ -592,6 +735,9 @@ neFixedTimeStepSimulator::~neFixedTimeStepSimulator()
 {
 	FreeAllBodies();
 
+	if (collisionThreads)
+		delete collisionThreads;
+
 	if (perf)
 		delete perf;
 }
@@ -608,6 +754,9 @@ neFixedTimeStepSimulator::~neFixedTimeStepSimulator()
 
 void neFixedTimeStepSimulator::Advance(nePerformanceReport * _perfReport)
 {
+	if (stepCallback)
+		stepCallback(_currentTimeStep);
+
 	ClearCollisionBodySensors();
 		
 	UpdateAABB();
@@ -1036,13 +1185,65 @@ void neFixedTimeStepSimulator::ClearCollisionBodySensors()
 	}
 }
 
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::UpdateAABB
+*
+*	Same as calling UpdateAABB on each body, but the bounds are worked out
+*	NE_AABB_BATCH bodies at a time with neAABBBatch.
+*
+****************************************************************************/ 
+
+#define NE_AABB_BATCH 64
+
+class neAABBUpdater
+{
+public:
+	neAABBUpdater()
+	{
+		count = 0;
+	}
+	NEINLINE void Add(neRigidBodyBase * body)
+	{
+		if (body->col.convexCount == 0 && !body->isCustomCD)
+			return;
+
+		bodies[count] = body;
+
+		c2w[count] = body->GetB2W() * body->obb;
+
+		if (++count == NE_AABB_BATCH)
+			Flush();
+	}
+	void Flush()
+	{
+		neAABBBatch(minBound, maxBound, c2w, count);
+
+		for (s32 i = 0; i < count; i++)
+		{
+			bodies[i]->minBound = minBound[i];
+			bodies[i]->maxBound = maxBound[i];
+			bodies[i]->SetAABBCoords();
+		}
+		count = 0;
+	}
+
+	neRigidBodyBase * bodies[NE_AABB_BATCH];
+	neT3 c2w[NE_AABB_BATCH];
+	neV3 minBound[NE_AABB_BATCH];
+	neV3 maxBound[NE_AABB_BATCH];
+	s32 count;
+};
+
 void neFixedTimeStepSimulator::UpdateAABB()
 {
+	neAABBUpdater updater;
+
 	neRigidBody_ * rb = activeRB.GetHead();
 
 	while (rb)
 	{
-		rb->UpdateAABB();
+		updater.Add(rb);
 
 		rb = activeRB.GetNext(rb);
 	}
@@ -1050,7 +1251,7 @@ void neFixedTimeStepSimulator::UpdateAABB()
 
 	while (rp)
 	{
-		rp->UpdateAABB();
+		updater.Add(rp);
 
 		rp = activeRP.GetNext(rp);
 	}
@@ -1059,335 +1260,465 @@ void neFixedTimeStepSimulator::UpdateAABB()
 	while (cb)
 	{
 		if (cb->moved)
-			cb->UpdateAABB();
+			updater.Add(cb);
 
 		cb = activeCB.GetNext(cb);
 	}
+	updater.Flush();
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::SetCollisionThreadCount
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::SetCollisionThreadCount(s32 count)
+{
+	if (count < 1)
+		count = 1;
+
+	collisionThreadCount = count;
+
+	if (collisionThreads && collisionThreads->Count() != count)
+	{
+		delete collisionThreads;
+
+		collisionThreads = NULL;
+	}
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::GetCollisionThreadCount
+*
+****************************************************************************/ 
+
+s32 neFixedTimeStepSimulator::GetCollisionThreadCount()
+{
+	return collisionThreadCount;
 }
 
 /****************************************************************************
 *
 *	neFixedTimeStepSimulator::CheckCollision
 *
+*	With one thread each pair is tested and responded to in turn. With more,
+*	the convex tests of all the pairs run on the collision threads first and
+*	the responses follow in pair order, so every test sees the bodies as they
+*	were before any of this step's penetrations were registered. That is not
+*	quite what one thread gets, but it is the same for any number of threads.
+*
 ****************************************************************************/ 
 
 void neFixedTimeStepSimulator::CheckCollision()
 {
-	//OutputDebugString("region.Update\n");/////////////////////////////////
-
 	neDLinkList<neOverlappedPair>::iterator oiter;
 
-	neCollisionResult result;
+	if (collisionThreadCount <= 1)
+	{
+		neCollisionJob job;
 
-	neV3 backupVector;
-	//OutputDebugString("obj 2 obj test\n");/////////////////////////////////
+		for (oiter = region.overlappedPairs.BeginUsed(); oiter.Valid(); oiter++)
+		{
+			job.bodyA = (*oiter)->bodyA;
+			job.bodyB = (*oiter)->bodyB;
+
+			switch (GetCollisionJob(job))
+			{
+			case neCollisionJob::TEST_CUSTOM:
+				CustomCollisionTest(job);
+				break;
+
+			case neCollisionJob::TEST_CONVEX:
+				PairCollisionTest(job);
+				SensorCollisionTest(job);
+				break;
+
+			default:
+				continue;
+			}
+			RespondToCollision(job);
+		}
+		return;
+	}
+	collisionJobs.Clear();
 
 	for (oiter = region.overlappedPairs.BeginUsed(); oiter.Valid(); oiter++)
 	{
-		//ASSERT((*oiter)->bodyA);
-		//ASSERT((*oiter)->bodyB);
-		
-		neRigidBodyBase * bodyA;
-		neRigidBodyBase * bodyB;
-
-		bodyA = (*oiter)->bodyA;
-		bodyB = (*oiter)->bodyB;
+		neCollisionJob pair;
 
-		neRigidBody_* ra = bodyA->AsRigidBody();
-		neRigidBody_* rb = bodyB->AsRigidBody();
+		pair.bodyA = (*oiter)->bodyA;
+		pair.bodyB = (*oiter)->bodyB;
 
-		neCollisionBody_* ca = bodyA->AsCollisionBody();
-		neCollisionBody_* cb = bodyB->AsCollisionBody();
-		
-		if (ca && cb)
+		if (GetCollisionJob(pair) == neCollisionJob::TEST_NONE)
 			continue;
 
-		neCollisionTable::neReponseBitFlag collisionflag = colTable.Get(bodyA->cid, bodyB->cid);
+		neCollisionJob * job = collisionJobs.Alloc();
 
-		if (collisionflag == neCollisionTable::RESPONSE_IGNORE)
-			continue;
-		
-		neBool isCustomeCD = false;
+		if (!job)
+			break;
 
-		result.penetrate = false;
+		job->bodyA = pair.bodyA;
+		job->bodyB = pair.bodyB;
+		job->collisionflag = pair.collisionflag;
+		job->test = pair.test;
+		job->result.penetrate = false;
+	}
+	s32 jobCount = collisionJobs.GetUsedCount();
 
-		if (ca)
-		{
-			if (rb->status != neRigidBody_::NE_RBSTATUS_IDLE ||
-				rb->isShifted ||
-				ca->moved)
-			{
-				if ((rb->isCustomCD || ca->isCustomCD))
-				{
-					if (customCDRB2ABCallback)
-					{
-						isCustomeCD = true;
-
-						neCustomCDInfo cdInfo;
-
-						memset(&cdInfo, 0, sizeof(cdInfo));
-
-						if (customCDRB2ABCallback((neRigidBody*)rb, (neAnimatedBody*)ca, cdInfo))
-						{
-							result.penetrate = true;
-							result.bodyA = ca;
-							result.bodyB = rb;
-							result.collisionFrame[2] = -cdInfo.collisionNormal;
-							result.materialIdA = cdInfo.materialIdB;
-							result.materialIdB = cdInfo.materialIdA;
-							result.contactA = cdInfo.worldContactPointB - ca->GetB2W().pos;
-							result.contactB = cdInfo.worldContactPointA - rb->GetB2W().pos;
-							result.contactAWorld = cdInfo.worldContactPointB;
-							result.contactBWorld = cdInfo.worldContactPointA;
-							result.contactABody = ca->GetB2W().rot.TransposeMulV3(result.contactA);
-							result.contactBBody = rb->GetB2W().rot.TransposeMulV3(result.contactB);
-							result.depth = cdInfo.penetrationDepth;
-							ChooseAxis(result.collisionFrame[0], result.collisionFrame[1], result.collisionFrame[2]);
-						}
-					}
-				}
-				else
-				{
-					backupVector = rb->backupVector - ca->backupVector;
+	if (jobCount == 0)
+		return;
 
-					CollisionTest(result, ca->col, ca->b2w, 
-											rb->col, rb->State().b2w, backupVector);
+	if (!collisionThreads)
+		collisionThreads = new neCollisionThreads(this, collisionThreadCount);
 
-					if (rb->sensors)
-					{
-						CollisionTestSensor(&rb->col.obb,
-											rb->sensors,
-											rb->State().b2w,
-											ca->col,
-											ca->b2w,
-											ca);
-					}
-				}
-			}
-		}
+	collisionThreads->Run(jobCount);
+
+	for (s32 i = 0; i < jobCount; i++)
+	{
+		neCollisionJob & job = collisionJobs[i];
+
+		if (job.test == neCollisionJob::TEST_CUSTOM)
+			CustomCollisionTest(job);
 		else
+			SensorCollisionTest(job);
+
+		RespondToCollision(job);
+	}
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::TestCollisionJobs
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::TestCollisionJobs(s32 first, s32 last)
+{
+	for (s32 i = first; i < last; i++)
+	{
+		neCollisionJob & job = collisionJobs[i];
+
+		if (job.test == neCollisionJob::TEST_CONVEX)
+			PairCollisionTest(job);
+	}
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::GetCollisionJob
+*
+*	Works out whether the pair needs testing this step, and how
+*
+****************************************************************************/ 
+
+s32 neFixedTimeStepSimulator::GetCollisionJob(neCollisionJob & job)
+{
+	neRigidBody_* ra = job.bodyA->AsRigidBody();
+	neRigidBody_* rb = job.bodyB->AsRigidBody();
+
+	neCollisionBody_* ca = job.bodyA->AsCollisionBody();
+	neCollisionBody_* cb = job.bodyB->AsCollisionBody();
+
+	job.test = neCollisionJob::TEST_NONE;
+
+	if (ca && cb)
+		return job.test;
+
+	job.collisionflag = colTable.Get(job.bodyA->cid, job.bodyB->cid);
+
+	if (job.collisionflag == neCollisionTable::RESPONSE_IGNORE)
+		return job.test;
+
+	if (ca)
+	{
+		if (rb->status != neRigidBody_::NE_RBSTATUS_IDLE ||
+			rb->isShifted ||
+			ca->moved)
 		{
-			if (cb)
+			if ((rb->isCustomCD || ca->isCustomCD))
 			{
-				if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
-					ra->isShifted ||
-					cb->moved)
-				{
-					if ((ra->isCustomCD || cb->isCustomCD))
-					{
-						if (customCDRB2ABCallback)
-						{
-							isCustomeCD = true;
-
-							neCustomCDInfo cdInfo;
-
-							memset(&cdInfo, 0, sizeof(cdInfo));
-
-							if (customCDRB2ABCallback((neRigidBody*)ra, (neAnimatedBody*)cb, cdInfo))
-							{
-								result.penetrate = true;
-								result.bodyA = ra;
-								result.bodyB = cb;
-								result.collisionFrame[2] = cdInfo.collisionNormal;
-								result.materialIdA = cdInfo.materialIdA;
-								result.materialIdB = cdInfo.materialIdB;
-								result.contactA = cdInfo.worldContactPointA - ra->GetB2W().pos;
-								result.contactB = cdInfo.worldContactPointB - cb->GetB2W().pos;
-								result.contactAWorld = cdInfo.worldContactPointA;
-								result.contactBWorld = cdInfo.worldContactPointB;
-								result.contactABody = ra->GetB2W().rot.TransposeMulV3(result.contactA);
-								result.contactBBody = cb->GetB2W().rot.TransposeMulV3(result.contactB);
-								result.depth = cdInfo.penetrationDepth;
-								ChooseAxis(result.collisionFrame[0], result.collisionFrame[1], result.collisionFrame[2]);
-							}
-						}
-					}
-					else
-					{
-						backupVector = cb->backupVector - ra->backupVector;
-
-						CollisionTest(result, ra->col, ra->State().b2w,
-										cb->col, cb->b2w, backupVector);
-						
-						if (ra->sensors)
-						{
-							CollisionTestSensor(&ra->col.obb,
-												ra->sensors,
-												ra->State().b2w,
-												cb->col,
-												cb->b2w,
-												cb);
-						}
-					}
-				}
+				if (customCDRB2ABCallback)
+					job.test = neCollisionJob::TEST_CUSTOM;
 			}
 			else
 			{
-				neBool doCollision = false;
-				
-				if (ra->GetConstraintHeader() && 
-					(ra->GetConstraintHeader() == rb->GetConstraintHeader()))
-				{
-					if (ra->isCollideConnected && rb->isCollideConnected)
-					{
-						if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
-							rb->status != neRigidBody_::NE_RBSTATUS_IDLE)
-	
-							doCollision = true;
-					}
-				}
-				else
-				{
-					if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
-						rb->status != neRigidBody_::NE_RBSTATUS_IDLE || 
-						ra->isShifted ||
-						rb->isShifted)
-					{
-						doCollision = true;
-					}
-				}
-				if (doCollision)
-				{
-					if ((ra->isCustomCD || rb->isCustomCD))
-					{
-						if (customCDRB2RBCallback)
-						{
-							isCustomeCD = true;
-
-							neCustomCDInfo cdInfo;
-
-							memset(&cdInfo, 0, sizeof(cdInfo));
-
-							if (customCDRB2RBCallback((neRigidBody*)ra, (neRigidBody*)rb, cdInfo))
-							{
-								result.penetrate = true;
-								result.bodyA = ra;
-								result.bodyB = rb;
-								result.collisionFrame[2] = cdInfo.collisionNormal;
-								result.materialIdA = cdInfo.materialIdA;
-								result.materialIdB = cdInfo.materialIdB;
-								result.contactA = cdInfo.worldContactPointA - ra->GetB2W().pos;
-								result.contactB = cdInfo.worldContactPointB - rb->GetB2W().pos;
-								result.contactAWorld = cdInfo.worldContactPointA;
-								result.contactBWorld = cdInfo.worldContactPointB;
-								result.contactABody = ra->GetB2W().rot.TransposeMulV3(result.contactA);
-								result.contactBBody = rb->GetB2W().rot.TransposeMulV3(result.contactB);
-								result.depth = cdInfo.penetrationDepth;
-								ChooseAxis(result.collisionFrame[0], result.collisionFrame[1], result.collisionFrame[2]);
-							}
-						}
-					}
-					else
-					{
-						backupVector = rb->backupVector - ra->backupVector;
-
-						CollisionTest(result, ra->col, ra->State().b2w,
-											rb->col, rb->State().b2w, backupVector);
-						if (ra->sensors)
-						{
-							CollisionTestSensor(&ra->col.obb,
-												ra->sensors,
-												ra->State().b2w,
-												rb->col,
-												rb->State().b2w,
-												rb);
-						}
-						if (rb->sensors)
-						{
-							CollisionTestSensor(&rb->col.obb,
-												rb->sensors,
-												rb->State().b2w,
-												ra->col,
-												ra->State().b2w,
-												ra);
-						}
-					}
-				}
+				job.test = neCollisionJob::TEST_CONVEX;
 			}
 		}
-//		if (perfReport)
-//			perf.UpdateCD();
-
-		if (result.penetrate)
+	}
+	else if (cb)
+	{
+		if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
+			ra->isShifted ||
+			cb->moved)
 		{
-			neBool bothAnimated = false;
-
-			if (ra && ra->status == neRigidBody_::NE_RBSTATUS_ANIMATED &&
-				rb && rb->status == neRigidBody_::NE_RBSTATUS_ANIMATED)
+			if ((ra->isCustomCD || cb->isCustomCD))
 			{
-				bothAnimated = true;
+				if (customCDRB2ABCallback)
+					job.test = neCollisionJob::TEST_CUSTOM;
 			}
-			neBool response = true;
-
-			if (!result.collisionFrame[2].IsFinite() || result.collisionFrame[2].IsConsiderZero())
+			else
 			{
-				response = false;
+				job.test = neCollisionJob::TEST_CONVEX;
 			}
+		}
+	}
+	else
+	{
+		neBool doCollision = false;
+		
+		if (ra->GetConstraintHeader() && 
+			(ra->GetConstraintHeader() == rb->GetConstraintHeader()))
+		{
+			if (ra->isCollideConnected && rb->isCollideConnected)
+			{
+				if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
+					rb->status != neRigidBody_::NE_RBSTATUS_IDLE)
 
-			result.impulseType = IMPULSE_NORMAL;
-
-			if ((collisionflag & neCollisionTable::RESPONSE_IMPULSE) && 
-				response &&
-				(!bothAnimated))
+					doCollision = true;
+			}
+		}
+		else
+		{
+			if (ra->status != neRigidBody_::NE_RBSTATUS_IDLE ||
+				rb->status != neRigidBody_::NE_RBSTATUS_IDLE || 
+				ra->isShifted ||
+				rb->isShifted)
+			{
+				doCollision = true;
+			}
+		}
+		if (doCollision)
+		{
+			if ((ra->isCustomCD || rb->isCustomCD))
 			{
-				result.bodyA = bodyA;
-				result.bodyB = bodyB;
-				RegisterPenetration(bodyA, bodyB, result);
+				if (customCDRB2RBCallback)
+					job.test = neCollisionJob::TEST_CUSTOM;
 			}
-			if ((collisionflag & neCollisionTable::RESPONSE_CALLBACK) && collisionCallback && !isCustomeCD)
+			else
 			{
-				static neCollisionInfo cinfo;
-
-				cinfo.bodyA = (neByte *)bodyA;
-				cinfo.bodyB = (neByte *)bodyB;
-				cinfo.typeA = bodyA->btype == NE_OBJECT_COLISION? NE_ANIMATED_BODY : NE_RIGID_BODY;
-				cinfo.typeB = bodyB->btype == NE_OBJECT_COLISION? NE_ANIMATED_BODY : NE_RIGID_BODY;
-				cinfo.materialIdA = result.materialIdA;
-				cinfo.materialIdB = result.materialIdB;
-				cinfo.geometryA = (neGeometry*)result.convexA;
-				cinfo.geometryB = (neGeometry*)result.convexB;
-				cinfo.bodyContactPointA = result.contactABody;
-				cinfo.bodyContactPointB = result.contactBBody;
-				cinfo.worldContactPointA = result.contactAWorld;
-				cinfo.worldContactPointB = result.contactBWorld;
-				cinfo.relativeVelocity = result.initRelVelWorld;
-				cinfo.collisionNormal = result.collisionFrame[2];
-
-				collisionCallback(cinfo);
+				job.test = neCollisionJob::TEST_CONVEX;
 			}
 		}
 	}
+	return job.test;
 }
-	//OutputDebugString("terrain test\n");/////////////////////////////////
 
-void neFixedTimeStepSimulator::CheckTerrainCollision()
-{
-	neCollisionResult result;
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::CustomCollisionTest
+*
+****************************************************************************/ 
 
-	neTreeNode & rootNode = region.GetTriangleTree().GetRoot();
+void neFixedTimeStepSimulator::CustomCollisionTest(neCollisionJob & job)
+{
+	neRigidBodyBase * bodyA = job.bodyA;
+	neRigidBodyBase * bodyB = job.bodyB;
 
-	neT3 identity;
+	neCollisionResult & result = job.result;
 
-	identity.SetIdentity();
+	result.penetrate = false;
 
-	neCollision & triCol = fakeCollisionBody.col;
+	neCustomCDInfo cdInfo;
 
-	triCol.convexCount = 1;
+	memset(&cdInfo, 0, sizeof(cdInfo));
 
-	triCol.obb.SetTransform(identity);
+	// the callbacks take the rigid body first, turn the contact round if it is not body A
+	neBool flip = false;
 
-	neV3 backupVector;
+	neBool hit;
 
-	for (s32 mop = 0; mop < 2; mop++)
+	if (bodyA->AsCollisionBody())
 	{
-		neList<neRigidBody_> * activeList = &activeRB; 
-		
-		if (mop == 1)
-		{
-			activeList = &activeRP;
-
-		}
-		neRigidBody_ * rb = activeList->GetHead();
+		flip = true;
+
+		hit = customCDRB2ABCallback((neRigidBody*)bodyB->AsRigidBody(), (neAnimatedBody*)bodyA->AsCollisionBody(), cdInfo);
+	}
+	else if (bodyB->AsCollisionBody())
+	{
+		hit = customCDRB2ABCallback((neRigidBody*)bodyA->AsRigidBody(), (neAnimatedBody*)bodyB->AsCollisionBody(), cdInfo);
+	}
+	else
+	{
+		hit = customCDRB2RBCallback((neRigidBody*)bodyA->AsRigidBody(), (neRigidBody*)bodyB->AsRigidBody(), cdInfo);
+	}
+	if (!hit)
+		return;
+
+	result.penetrate = true;
+	result.bodyA = bodyA;
+	result.bodyB = bodyB;
+
+	if (flip)
+	{
+		result.collisionFrame[2] = -cdInfo.collisionNormal;
+		result.materialIdA = cdInfo.materialIdB;
+		result.materialIdB = cdInfo.materialIdA;
+		result.contactAWorld = cdInfo.worldContactPointB;
+		result.contactBWorld = cdInfo.worldContactPointA;
+	}
+	else
+	{
+		result.collisionFrame[2] = cdInfo.collisionNormal;
+		result.materialIdA = cdInfo.materialIdA;
+		result.materialIdB = cdInfo.materialIdB;
+		result.contactAWorld = cdInfo.worldContactPointA;
+		result.contactBWorld = cdInfo.worldContactPointB;
+	}
+	result.contactA = result.contactAWorld - bodyA->GetB2W().pos;
+	result.contactB = result.contactBWorld - bodyB->GetB2W().pos;
+	result.contactABody = bodyA->GetB2W().rot.TransposeMulV3(result.contactA);
+	result.contactBBody = bodyB->GetB2W().rot.TransposeMulV3(result.contactB);
+	result.depth = cdInfo.penetrationDepth;
+	ChooseAxis(result.collisionFrame[0], result.collisionFrame[1], result.collisionFrame[2]);
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::PairCollisionTest
+*
+*	Only reads the bodies, so it can run on any of the collision threads
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::PairCollisionTest(neCollisionJob & job)
+{
+	neRigidBodyBase * bodyA = job.bodyA;
+	neRigidBodyBase * bodyB = job.bodyB;
+
+	neV3 backupVector = bodyB->backupVector - bodyA->backupVector;
+
+	CollisionTest(job.result, bodyA->col, bodyA->GetB2W(), 
+							bodyB->col, bodyB->GetB2W(), backupVector);
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::SensorCollisionTest
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::SensorCollisionTest(neCollisionJob & job)
+{
+	neRigidBody_* ra = job.bodyA->AsRigidBody();
+	neRigidBody_* rb = job.bodyB->AsRigidBody();
+
+	if (ra && ra->sensors)
+	{
+		CollisionTestSensor(&ra->col.obb,
+							ra->sensors,
+							ra->State().b2w,
+							job.bodyB->col,
+							job.bodyB->GetB2W(),
+							job.bodyB);
+	}
+	if (rb && rb->sensors)
+	{
+		CollisionTestSensor(&rb->col.obb,
+							rb->sensors,
+							rb->State().b2w,
+							job.bodyA->col,
+							job.bodyA->GetB2W(),
+							job.bodyA);
+	}
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::RespondToCollision
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::RespondToCollision(neCollisionJob & job)
+{
+	neCollisionResult & result = job.result;
+
+	if (!result.penetrate)
+		return;
+
+	neRigidBodyBase * bodyA = job.bodyA;
+	neRigidBodyBase * bodyB = job.bodyB;
+
+	neRigidBody_* ra = bodyA->AsRigidBody();
+	neRigidBody_* rb = bodyB->AsRigidBody();
+
+	neBool bothAnimated = false;
+
+	if (ra && ra->status == neRigidBody_::NE_RBSTATUS_ANIMATED &&
+		rb && rb->status == neRigidBody_::NE_RBSTATUS_ANIMATED)
+	{
+		bothAnimated = true;
+	}
+	neBool response = true;
+
+	if (!result.collisionFrame[2].IsFinite() || result.collisionFrame[2].IsConsiderZero())
+	{
+		response = false;
+	}
+
+	result.impulseType = IMPULSE_NORMAL;
+
+	if ((job.collisionflag & neCollisionTable::RESPONSE_IMPULSE) && 
+		response &&
+		(!bothAnimated))
+	{
+		result.bodyA = bodyA;
+		result.bodyB = bodyB;
+		RegisterPenetration(bodyA, bodyB, result);
+	}
+	if ((job.collisionflag & neCollisionTable::RESPONSE_CALLBACK) && collisionCallback && job.test != neCollisionJob::TEST_CUSTOM)
+	{
+		static neCollisionInfo cinfo;
+
+		cinfo.bodyA = (neByte *)bodyA;
+		cinfo.bodyB = (neByte *)bodyB;
+		cinfo.typeA = bodyA->btype == NE_OBJECT_COLISION? NE_ANIMATED_BODY : NE_RIGID_BODY;
+		cinfo.typeB = bodyB->btype == NE_OBJECT_COLISION? NE_ANIMATED_BODY : NE_RIGID_BODY;
+		cinfo.materialIdA = result.materialIdA;
+		cinfo.materialIdB = result.materialIdB;
+		cinfo.geometryA = (neGeometry*)result.convexA;
+		cinfo.geometryB = (neGeometry*)result.convexB;
+		cinfo.bodyContactPointA = result.contactABody;
+		cinfo.bodyContactPointB = result.contactBBody;
+		cinfo.worldContactPointA = result.contactAWorld;
+		cinfo.worldContactPointB = result.contactBWorld;
+		cinfo.relativeVelocity = result.initRelVelWorld;
+		cinfo.collisionNormal = result.collisionFrame[2];
+
+		collisionCallback(cinfo);
+	}
+}
+
+	//OutputDebugString("terrain test\n");/////////////////////////////////
+
+void neFixedTimeStepSimulator::CheckTerrainCollision()
+{
+	neCollisionResult result;
+
+	neT3 identity;
+
+	identity.SetIdentity();
+
+	neCollision & triCol = fakeCollisionBody.col;
+
+	triCol.convexCount = 1;
+
+	triCol.obb.SetTransform(identity);
+
+	neV3 backupVector;
+
+	for (s32 mop = 0; mop < 2; mop++)
+	{
+		neList<neRigidBody_> * activeList = &activeRB; 
+		
+		if (mop == 1)
+		{
+			activeList = &activeRP;
+
+		}
+		neRigidBody_ * rb = activeList->GetHead();
 
 		//for (riter = rbHeap.BeginUsed(); riter.Valid(); riter++)
 		while (rb)
@@ -1403,68 +1734,23 @@ void neFixedTimeStepSimulator::CheckTerrainCollision()
 			}
 			backupVector = -rb->backupVector;
 			
-			treeNodes.Clear();
-
-			triangleIndex.Clear();
-			
 			if (!terrainQueryCallback)
 			{
-				rootNode.GetCandidateNodes(treeNodes, bodyA->minBound, bodyA->maxBound, 0);
+				result.penetrate = false;
 
-				if (treeNodes.GetUsedCount() == 0)
-				{
-					rb = activeList->GetNext(rb);
-					
-					continue;
-				}
+				TestTerrainTree(result, bodyA, region.terrainTree, backupVector);
 
-				//printf("node count %d\n", treeNodes.GetUsedCount());
-				
-				for (s32 i = 0; i < treeNodes.GetUsedCount(); i++)
+				if (region.terrainTiles.size() > 0)
 				{
-					neTreeNode * t = treeNodes[i];
+					terrainTileIndex.Clear();
+
+					region.GetTerrainTiles(terrainTileIndex, bodyA->minBound, bodyA->maxBound);
 
-					for (s32 j = 0; j < t->triangleIndices.GetUsedCount(); j++)
+					for (s32 i = 0; i < terrainTileIndex.GetUsedCount(); i++)
 					{
-						s32 k;
-
-						for (k = 0; k < triangleIndex.GetUsedCount(); k++)
-						{
-							if (t->triangleIndices[j] == triangleIndex[k])
-								break;
-						}
-						if (k == triangleIndex.GetUsedCount())
-						{
-							s32 * triIndex = triangleIndex.Alloc();
-
-							//ASSERT(triIndex);
-			
-							*triIndex = t->triangleIndices[j];
-						}
+						TestTerrainTree(result, bodyA, *region.terrainTiles[terrainTileIndex[i]], backupVector);
 					}
 				}
-
-#ifdef _WIN32
-if (perfReport)
-	perf->UpdateTerrainCulling();
-#endif
-				triCol.obb.SetTerrain(triangleIndex, region.terrainTree.triangles, region.terrainTree.vertices);
-
-				triCol.convex = &triCol.obb;
-
-				CollisionTest(result, bodyA->col, ((neRigidBody_*)bodyA)->State().b2w,
-								triCol, identity, backupVector);
-
-				if (bodyA->sensors)
-				{
-					CollisionTestSensor(&bodyA->col.obb,
-										bodyA->sensors,
-										bodyA->State().b2w,
-										triCol,
-										identity,
-										NULL);
-				}
-
 			}
 			else
 			{
@@ -1509,39 +1795,7 @@ if (perfReport)
 			}
 			if (result.penetrate)
 			{
-				result.impulseType = IMPULSE_NORMAL;
-
-				neCollisionTable::neReponseBitFlag collisionflag = colTable.Get(bodyA->cid, -1); //-1 is terrain
-
-				if ((collisionflag & neCollisionTable::RESPONSE_IMPULSE) &&
-					bodyA->status != neRigidBody_::NE_RBSTATUS_ANIMATED)
-				{
-					result.bodyA = bodyA;
-					result.bodyB = &fakeCollisionBody;
-
-					RegisterPenetration(bodyA, &fakeCollisionBody, result);
-				}
-				if ((collisionflag & neCollisionTable::RESPONSE_CALLBACK) && collisionCallback)
-				{
-					static neCollisionInfo cinfo;
-
-					cinfo.bodyA = (neByte *)bodyA;
-					cinfo.bodyB = (neByte *)result.convexB;
-					cinfo.typeA = NE_RIGID_BODY;
-					cinfo.typeB = NE_TERRAIN;
-					cinfo.materialIdA = result.materialIdA;
-					cinfo.materialIdB = result.materialIdB;
-					cinfo.geometryA = (neGeometry*)result.convexA;
-					cinfo.geometryB = NULL;
-					cinfo.bodyContactPointA = result.contactABody;
-					cinfo.bodyContactPointB = result.contactBBody;
-					cinfo.worldContactPointA = result.contactAWorld;
-					cinfo.worldContactPointB = result.contactBWorld;
-					cinfo.relativeVelocity = result.initRelVelWorld;
-					cinfo.collisionNormal = result.collisionFrame[2];
-
-					collisionCallback(cinfo);
-				}
+				RespondToTerrainCollision(bodyA, result);
 			}
 
 			rb = activeList->GetNext(rb);
@@ -1575,6 +1829,107 @@ if (perfReport)
 		}
 	}
 }
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::TestTerrainTree
+*
+*	Tests a body against the triangles of one terrain tree (the main terrain
+*	mesh or a tile) and keeps the result if it is deeper than the one in
+*	result, so a body over several tiles gets the same contact as it would
+*	from one mesh holding them all.
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::TestTerrainTree(neCollisionResult & result, neRigidBody_ * bodyA, neTriangleTree & tree, const neV3 & backupVector)
+{
+	treeNodes.Clear();
+
+	triangleIndex.Clear();
+
+	tree.GetCandidateTriangles(treeNodes, triangleIndex, bodyA->minBound, bodyA->maxBound);
+
+	if (triangleIndex.GetUsedCount() == 0)
+		return;
+
+#ifdef _WIN32
+if (perfReport)
+	perf->UpdateTerrainCulling();
+#endif
+
+	neT3 identity;
+
+	identity.SetIdentity();
+
+	neCollision & triCol = fakeCollisionBody.col;
+
+	triCol.obb.SetTerrain(triangleIndex, tree.triangles, tree.vertices);
+
+	triCol.convex = &triCol.obb;
+
+	neCollisionResult treeResult;
+
+	CollisionTest(treeResult, bodyA->col, bodyA->State().b2w,
+					triCol, identity, backupVector);
+
+	if (bodyA->sensors)
+	{
+		CollisionTestSensor(&bodyA->col.obb,
+							bodyA->sensors,
+							bodyA->State().b2w,
+							triCol,
+							identity,
+							NULL);
+	}
+	if (treeResult.penetrate && (!result.penetrate || treeResult.depth > result.depth))
+	{
+		result = treeResult;
+	}
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::RespondToTerrainCollision
+*
+****************************************************************************/ 
+
+void neFixedTimeStepSimulator::RespondToTerrainCollision(neRigidBody_ * bodyA, neCollisionResult & result)
+{
+	result.impulseType = IMPULSE_NORMAL;
+
+	neCollisionTable::neReponseBitFlag collisionflag = colTable.Get(bodyA->cid, -1); //-1 is terrain
+
+	if ((collisionflag & neCollisionTable::RESPONSE_IMPULSE) &&
+		bodyA->status != neRigidBody_::NE_RBSTATUS_ANIMATED)
+	{
+		result.bodyA = bodyA;
+		result.bodyB = &fakeCollisionBody;
+
+		RegisterPenetration(bodyA, &fakeCollisionBody, result);
+	}
+	if ((collisionflag & neCollisionTable::RESPONSE_CALLBACK) && collisionCallback)
+	{
+		static neCollisionInfo cinfo;
+
+		cinfo.bodyA = (neByte *)bodyA;
+		cinfo.bodyB = (neByte *)result.convexB;
+		cinfo.typeA = NE_RIGID_BODY;
+		cinfo.typeB = NE_TERRAIN;
+		cinfo.materialIdA = result.materialIdA;
+		cinfo.materialIdB = result.materialIdB;
+		cinfo.geometryA = (neGeometry*)result.convexA;
+		cinfo.geometryB = NULL;
+		cinfo.bodyContactPointA = result.contactABody;
+		cinfo.bodyContactPointB = result.contactBBody;
+		cinfo.worldContactPointA = result.contactAWorld;
+		cinfo.worldContactPointB = result.contactBWorld;
+		cinfo.relativeVelocity = result.initRelVelWorld;
+		cinfo.collisionNormal = result.collisionFrame[2];
+
+		collisionCallback(cinfo);
+	}
+}
+
 /****************************************************************************
 *
 *	neFixedTimeStepSimulator::SolveConstrain
@@ -2007,6 +2362,27 @@ void neFixedTimeStepSimulator::FreeTerrainMesh()
 	region.FreeTerrain();
 }
 
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::AddTerrainMesh
+*
+****************************************************************************/ 
+
+s32 neFixedTimeStepSimulator::AddTerrainMesh(neTriangleMesh * tris)
+{
+	return region.AddTerrainTile(tris);
+}
+
+s32 neFixedTimeStepSimulator::AddTerrainTile(neTriangleTree * tile)
+{
+	return region.AddTerrainTile(tile);
+}
+
+void neFixedTimeStepSimulator::RemoveTerrainMesh(s32 tile)
+{
+	region.RemoveTerrainTile(tile);
+}
+
 neStackHeader * neFixedTimeStepSimulator::NewStackHeader(neStackInfo * sinfo)
 {
 	neStackHeader * n = stackHeaderHeap.Alloc();
@@ -2266,6 +2642,289 @@ void neFixedTimeStepSimulator::GetMemoryAllocated(s32 & memoryAllocated)
 	memoryAllocated += region.terrainTree.nodes.GetTotalSize() * sizeof(neTreeNode);
 
 	memoryAllocated += region.terrainTree.triangles.GetTotalSize() * sizeof(neTriangle_);
+
+	memoryAllocated += region.terrainTree.bvh.nodes.capacity() * sizeof(neTerrainBVHNode);
+
+	memoryAllocated += region.terrainTree.bvh.triIndices.capacity() * sizeof(s32);
+
+	for (size_t i = 0; i < region.terrainTiles.size(); i++)
+	{
+		neTriangleTree * tile = region.terrainTiles[i];
+
+		if (!tile)
+			continue;
+
+		memoryAllocated += sizeof(neTriangleTree);
+
+		memoryAllocated += tile->nodes.GetTotalSize() * sizeof(neTreeNode);
+
+		memoryAllocated += tile->triangles.GetTotalSize() * sizeof(neTriangle_);
+
+		memoryAllocated += tile->vertexCount * sizeof(neV3);
+
+		memoryAllocated += tile->bvh.nodes.capacity() * sizeof(neTerrainBVHNode);
+
+		memoryAllocated += tile->bvh.triIndices.capacity() * sizeof(s32);
+	}
+	memoryAllocated += region.terrainTileTree.nodes.capacity() * sizeof(neTerrainBVHNode);
+
+	memoryAllocated += region.terrainTileTree.triIndices.capacity() * sizeof(s32);
+
+	memoryAllocated += region.terrainTileTreeTiles.capacity() * sizeof(s32);
+
+	memoryAllocated += terrainTileIndex.GetTotalSize() * sizeof(s32);
+}
+
+/****************************************************************************
+*
+*	neFixedTimeStepSimulator::GetStateSize, SaveState, RestoreState
+*
+*	The state is the motion of every active rigid body and particle, with the
+*	velocity records resting and sleeping are decided from, the pose of the
+*	active animated bodies and the step count the records are indexed by.
+*	The resting contacts, stacks and broadphase are not part of it: like
+*	after SetPos, they catch up with the restored bodies over the next steps.
+*
+****************************************************************************/ 
+
+// the body lists are compared when restoring, so a state only goes back into
+// the simulator that saved it, while it has the same bodies
+struct neSimulatorStateHeader
+{
+	s32 rigidBodyCount;
+	s32 particleCount;
+	s32 animatedBodyCount;
+	s32 stepSoFar;
+	s32 currentRecord;
+	f32 timeFromLastFrame;
+	f32 lastTimeStep;
+	f32 magicNumber;
+};
+
+class neStateSizer
+{
+public:
+	neStateSizer() : size(0) {}
+
+	template <class T> void operator () (T & /*item*/) {size += sizeof(T);}
+
+	s32 size;
+};
+
+class neStateWriter
+{
+public:
+	neStateWriter(neByte * buffer) : p(buffer) {}
+
+	template <class T> void operator () (T & item) {memcpy(p, &item, sizeof(T)); p += sizeof(T);}
+
+	neByte * p;
+};
+
+class neStateReader
+{
+public:
+	neStateReader(const neByte * buffer) : p(buffer) {}
+
+	template <class T> void operator () (T & item) {memcpy(&item, p, sizeof(T)); p += sizeof(T);}
+
+	const neByte * p;
+};
+
+// one function lists the state of a body for the sizer, writer and reader alike
+template <class Op> static void TransferRigidBodyState(neRigidBody_ * rb, Op & op)
+{
+	op(rb->State());
+	op(rb->derive);
+	op(rb->force);
+	op(rb->torque);
+	op(rb->acc);
+	op(rb->status);
+	op(rb->lowEnergyCounter);
+	op(rb->sleepingParam);
+	op(rb->oldPosition);
+	op(rb->oldRotation);
+	op(rb->oldVelocity);
+	op(rb->oldAngularVelocity);
+	op(rb->oldCounter);
+	op(rb->dvRecord);
+	op(rb->davRecord);
+
+	if (rb->rbExtra)
+	{
+		op(rb->rbExtra->velRecords);
+		op(rb->rbExtra->angVelRecords);
+	}
+}
+
+template <class Op> static void TransferBodyLists(neList<neRigidBody_> & rbs, neList<neRigidBody_> & rps, Op & op)
+{
+	neRigidBody_ * rb = rbs.GetHead();
+
+	while (rb)
+	{
+		TransferRigidBodyState(rb, op);
+
+		rb = rbs.GetNext(rb);
+	}
+	rb = rps.GetHead();
+
+	while (rb)
+	{
+		TransferRigidBodyState(rb, op);
+
+		rb = rps.GetNext(rb);
+	}
+}
+
+s32 neFixedTimeStepSimulator::GetStateSize()
+{
+	neStateSizer sizer;
+
+	TransferBodyLists(activeRB, activeRP, sizer);
+
+	s32 bodies = activeRB.count + activeRP.count + activeCB.count;
+
+	return sizeof(neSimulatorStateHeader) + bodies * sizeof(neRigidBodyBase *) + activeCB.count * sizeof(neT3) + sizer.size;
+}
+
+void neFixedTimeStepSimulator::SaveState(void * buffer)
+{
+	neSimulatorStateHeader header;
+
+	header.rigidBodyCount = activeRB.count;
+	header.particleCount = activeRP.count;
+	header.animatedBodyCount = activeCB.count;
+	header.stepSoFar = stepSoFar;
+	header.currentRecord = currentRecord;
+	header.timeFromLastFrame = timeFromLastFrame;
+	header.lastTimeStep = lastTimeStep;
+	header.magicNumber = magicNumber;
+
+	neStateWriter writer((neByte *)buffer);
+
+	writer(header);
+
+	neRigidBody_ * rb = activeRB.GetHead();
+
+	while (rb)
+	{
+		writer(rb);
+
+		rb = activeRB.GetNext(rb);
+	}
+	rb = activeRP.GetHead();
+
+	while (rb)
+	{
+		writer(rb);
+
+		rb = activeRP.GetNext(rb);
+	}
+	neCollisionBody_ * cb = activeCB.GetHead();
+
+	while (cb)
+	{
+		writer(cb);
+
+		writer(cb->b2w);
+
+		cb = activeCB.GetNext(cb);
+	}
+	TransferBodyLists(activeRB, activeRP, writer);
+}
+
+neBool neFixedTimeStepSimulator::RestoreState(const void * buffer, s32 size)
+{
+	if (size < (s32)sizeof(neSimulatorStateHeader) || size != GetStateSize())
+		return false;
+
+	neStateReader reader((const neByte *)buffer);
+
+	neSimulatorStateHeader header;
+
+	reader(header);
+
+	if (header.rigidBodyCount != activeRB.count || header.particleCount != activeRP.count || 
+		header.animatedBodyCount != activeCB.count)
+		return false;
+
+	// the bodies have to be the same ones, in the same order, before anything is changed
+	neStateReader check = reader;
+
+	neRigidBodyBase * saved;
+
+	neT3 b2w;
+
+	neRigidBody_ * rb = activeRB.GetHead();
+
+	while (rb)
+	{
+		check(saved);
+
+		if (saved != rb)
+			return false;
+
+		rb = activeRB.GetNext(rb);
+	}
+	rb = activeRP.GetHead();
+
+	while (rb)
+	{
+		check(saved);
+
+		if (saved != rb)
+			return false;
+
+		rb = activeRP.GetNext(rb);
+	}
+	const neByte * animated = check.p;
+
+	neCollisionBody_ * cb = activeCB.GetHead();
+
+	while (cb)
+	{
+		check(saved);
+
+		check(b2w);
+
+		if (saved != cb)
+			return false;
+
+		cb = activeCB.GetNext(cb);
+	}
+
+	// the bodies are checked, the rigid bodies and particles follow the list of bodies
+	reader.p = check.p;
+
+	check.p = animated;
+
+	cb = activeCB.GetHead();
+
+	while (cb)
+	{
+		check(saved);
+
+		check(b2w);
+
+		// moved, so its bounding box is updated, only if it was moved since
+		if (memcmp(&b2w, &cb->b2w, sizeof(neT3)) != 0)
+		{
+			cb->b2w = b2w;
+
+			cb->moved = true;
+		}
+		cb = activeCB.GetNext(cb);
+	}
+	TransferBodyLists(activeRB, activeRP, reader);
+
+	stepSoFar = header.stepSoFar;
+	currentRecord = header.currentRecord;
+	timeFromLastFrame = header.timeFromLastFrame;
+	lastTimeStep = header.lastTimeStep;
+	magicNumber = header.magicNumber;
+
+	return true;
 }
 
 /****************************************************************************
@@ -172,6 +172,18 @@ public:
 
 	neTriangleTree & GetTriangleTree() {return terrainTree;}
 
+	s32 AddTerrainTile(neTriangleMesh * tris);
+
+	s32 AddTerrainTile(neTriangleTree * tile);
+
+	void RemoveTerrainTile(s32 tile);
+
+	// builds a tile without adding it, sim may be NULL
+	static neTriangleTree * BuildTerrainTile(neTriangleMesh * tris, neSimulator::TERRAIN_TREE_TYPE type, neFixedTimeStepSimulator * sim);
+
+	// appends the tiles whose box overlaps the given one
+	void GetTerrainTiles(neSimpleArray<s32> & tiles, const neV3 & minBound, const neV3 & maxBound);
+
 	~neRegion();
 
 public:
@@ -205,6 +217,14 @@ public:
 
 	neTriangleTree terrainTree;
 
+	std::vector<neTriangleTree *> terrainTiles; //each with its own tree, NULL where one has been removed
+
+	neTerrainBVH terrainTileTree; //over the boxes of terrainTiles, rebuilt when a tile is added or removed
+
+	std::vector<s32> terrainTileTreeTiles; //the tile of each box in terrainTileTree
+
+	bool terrainTilesChanged;
+
 #ifdef _DEBUG_REGION
 	bool debugOn;
 #endif
@@ -317,6 +337,36 @@ public:
 	s32 overheadTicks;   // overhead  in calling timer
 };
 
+/****************************************************************************
+*
+*	neCollisionJob
+*
+*	One overlapped pair of CheckCollision, the test it needs and its result
+*
+****************************************************************************/ 
+
+class neCollisionJob
+{
+public:
+	enum
+	{
+		TEST_NONE,
+		TEST_CUSTOM,
+		TEST_CONVEX,
+	};
+	neRigidBodyBase * bodyA;
+
+	neRigidBodyBase * bodyB;
+
+	neCollisionTable::neReponseBitFlag collisionflag;
+
+	s32 test;
+
+	neCollisionResult result;
+};
+
+class neCollisionThreads;
+
 class neFixedTimeStepSimulator
 {
 public:
@@ -325,6 +375,13 @@ public:
 	enum {MAX_MATERIAL = 256,};
 
 	neFixedTimeStepSimulator(const neSimulatorSizeInfo & _sizeInfo, neAllocatorAbstract * alloc = NULL, const neV3 * grav = NULL);
+
+#ifdef NE_USE_SSE2
+	// the neV3 members have to be 16 byte aligned, which plain new does not promise
+	void * operator new(size_t size) {return _mm_malloc(size, 16);}
+
+	void operator delete(void * ptr) {_mm_free(ptr);}
+#endif
 	
 	~neFixedTimeStepSimulator();
 
@@ -360,12 +417,24 @@ public:
 
 	void FreeTerrainMesh();
 
+	s32 AddTerrainMesh(neTriangleMesh * tris);
+
+	s32 AddTerrainTile(neTriangleTree * tile);
+
+	void RemoveTerrainMesh(s32 tile);
+
 	void CreatePoint2PointConstraint(neRigidBodyBase * bodyA, const neV3 & pointA, neRigidBodyBase * bodyB, const neV3 & pointB);
 
 	neStackHeader * NewStackHeader(neStackInfo *);
 
 	neConstraintHeader * NewConstraintHeader();
 
+	void SetCollisionThreadCount(s32 count);
+
+	s32 GetCollisionThreadCount();
+
+	void TestCollisionJobs(s32 first, s32 last);
+
 	void CheckStackHeader();
 
 	neLogOutputCallback * SetLogOutputCallback(neLogOutputCallback * fn);
@@ -382,6 +451,12 @@ public:
 
 	void GetMemoryAllocated(s32 & memoryAllocated);
 
+	s32 GetStateSize();
+
+	void SaveState(void * buffer);
+
+	neBool RestoreState(const void * buffer, s32 size);
+
 	neBool CheckBreakage(neRigidBodyBase * originalBody, TConvex * convex, const neV3 & contactPoint, neV3 & impulse);
 
 	void ResetTotalForce();
@@ -491,8 +566,22 @@ public:
 protected:
 	void CheckCollision();
 
+	s32 GetCollisionJob(neCollisionJob & job);
+
+	void CustomCollisionTest(neCollisionJob & job);
+
+	void PairCollisionTest(neCollisionJob & job);
+
+	void SensorCollisionTest(neCollisionJob & job);
+
+	void RespondToCollision(neCollisionJob & job);
+
 	void CheckTerrainCollision();
 
+	void TestTerrainTree(neCollisionResult & result, neRigidBody_ * bodyA, neTriangleTree & tree, const neV3 & backupVector);
+
+	void RespondToTerrainCollision(neRigidBody_ * bodyA, neCollisionResult & result);
+
 	void SolveAllConstrain();
 
 	void SolveOneConstrainChain(f32 epsilon, s32 iteration);
@@ -547,6 +636,8 @@ public:
 
 	neSimpleArray<s32> triangleIndex;
 
+	neSimpleArray<s32> terrainTileIndex;
+
 	neCollisionBody_ fakeCollisionBody;
 
 //state
@@ -554,6 +645,8 @@ public:
 
 //others
 	neCollisionCallback * collisionCallback;
+
+	neStepCallback * stepCallback;
 	
 	neLogOutputCallback * logCallback;	
 
@@ -566,6 +659,13 @@ public:
 	neCustomCDRB2ABCallback * customCDRB2ABCallback;
 
 	s32 idleBodyCount;
+
+//collision threads
+	s32 collisionThreadCount;
+
+	neCollisionThreads * collisionThreads;
+
+	neSimpleArray<neCollisionJob> collisionJobs;
 };
 
 #endif
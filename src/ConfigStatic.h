@@ -12,4 +12,9 @@
 
 #endif
 
+// Concrete engine types, when linking statically with a single engine (PAL_STATIC_ENGINE).
+#ifdef PAL_STATIC_ENGINE
+	#include <pal/palStaticEngine.h>
+#endif
+
 #endif	// PAL_CONFIG_STATIC_H
@@ -157,6 +157,9 @@ public:
 		mActiveGroup = GroupName;
 		RebuildRegistry();
 	}
+	const PAL_STRING& GetActiveGroup() const {
+		return mActiveGroup;
+	}
 	PAL_MAP <PAL_STRING, FactoryObject<FactoryBase>*> mRegistry; //the selected registry for this selected pluggable factory.
 private:
 	PAL_STRING mActiveGroup; //this needs to be private, to stop it being accssesed from non-group supporting factories
@@ -7,6 +7,7 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 1.3  :19/10/26 Single library loading and unloading
 		Version 1.2  :06/12/07 MGF merge
 		Version 1.1	 :28/06/07 Group DLL reimplementation
 		Version 1.0.4:18/08/04 PAL modifications
@@ -33,88 +34,89 @@ typedef UINT32 (*pt2PropertiesFunction) (void);
 #include <dlfcn.h>
 #endif
 
-static PAL_VECTOR<OS_DynlibHandle> svDlls;
+//a loaded library, and the registration objects it created
+struct DllRecord {
+	OS_DynlibHandle hInst;
+	PAL_VECTOR<myFactoryObject *> objects;
+};
+static PAL_VECTOR<DllRecord> svDlls;
 //class myAbstractFOS : public myFactoryObject, public Serializable  {};
-static PAL_VECTOR<myFactoryObject *> svDllObjects;
 template <> PAL_VECTOR<RegistrationInfo<myFactoryBase> > * PluggableFactory< ManagedMemoryObject<StatusObject> >::sInfoInstance = 0;
 
 void myFactory::FreeObjects() {
-	unsigned int i;
-	for (i=0;i<svDllObjects.size();i++) {
-		delete svDllObjects[i];
+	unsigned int i,j;
+	for (i=0;i<svDlls.size();i++) {
+		for (j=0;j<svDlls[i].objects.size();j++)
+			delete svDlls[i].objects[j];
 	}
 #if defined (_WIN32)
 #pragma warning( disable : 4552) //disable warning from os portable DYNLIB macro
 #endif
 	for (i=0;i<svDlls.size();i++) {
-		OS_DYNLIB_UNLOAD(svDlls[i]);
+		OS_DYNLIB_UNLOAD(svDlls[i].hInst);
 	}
 #if defined (_WIN32)
 #pragma warning( default : 4552)
 #endif
+	svDlls.clear();
 }
 
-void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *factoryInfoPointer) throw(palException) {
-#ifdef INTERNAL_DEBUG
-  printf("myFactory::LoadObjects: szPath = '%s', factory = %p, sinfo = %p\n", 
-	  szPath, factoryPointer, factoryInfoPointer);
-#endif
+static bool IsDllObject(const DllRecord& dll, const myFactoryObject *object) {
+	for (unsigned int i=0;i<dll.objects.size();i++)
+		if (dll.objects[i] == object)
+			return true;
+	return false;
+}
 
-	char current_directory[4096];
-	if (szPath != NULL) {
-		GetCurrentDir(4096,current_directory);
-		try
-		{
-			SetCurrentDir(szPath);
+void myFactory::UnloadObjects(const PAL_STRING& keepGroup) {
+	PAL_VECTOR<DllRecord>::iterator it = svDlls.begin();
+	while (it != svDlls.end()) {
+		//keep the library if anything it registered is used by the kept group
+		PAL_VECTOR<myFactoryInfo>::iterator itv;
+		bool used = false;
+		for (itv = sInfo().begin(); itv != sInfo().end(); itv++) {
+			if ((itv->mGroupName == keepGroup || itv->mGroupName == "*") && IsDllObject(*it,itv->mConstructor)) {
+				used = true;
+				break;
+			}
 		}
-		catch (const palException& ex)
-		{
-			fprintf(stderr, "%s:%d: Unable to change directory to \"%s\" to load plugins because of \"%s\" \n",__FILE__,__LINE__,szPath, ex.what());
-			throw;
+		if (used) {
+			it++;
+			continue;
 		}
-	}
-	PAL_VECTOR<PAL_STRING> filesfound;
-
+		itv = sInfo().begin();
+		while (itv != sInfo().end()) {
+			if (IsDllObject(*it,itv->mConstructor))
+				itv = sInfo().erase(itv);
+			else
+				itv++;
+		}
+		for (unsigned int i=0;i<it->objects.size();i++)
+			delete it->objects[i];
 #if defined (_WIN32)
-	PAL_STRING pattern("*.dll");
-#ifdef INTERNAL_DEBUG
-	printf("myFactory::LoadObjects: About to call FindFiles with pattern '%s'\n",
-		pattern.c_str());
+#pragma warning( disable : 4552)
 #endif
-	FindFiles(pattern,filesfound);
-#ifdef INTERNAL_DEBUG
-	printf("myFactory::LoadObjects: Back from FindFiles\n");
-#endif
-#elif defined (OS_OSX)
-   FindFiles("*.dylib",filesfound);
-#else
-	FindFiles("*.so",filesfound);
+		OS_DYNLIB_UNLOAD(it->hInst);
+#if defined (_WIN32)
+#pragma warning( default : 4552)
 #endif
+		it = svDlls.erase(it);
+	}
+}
 
-	PAL_VECTOR<PAL_STRING>::size_type i;
-	for (i=0;i<filesfound.size();i++) {
-
-			const char *filename = filesfound[i].c_str();
-				//printf("found : '%s'\n",filename);
-
-				//build full location for *nix systems
-				char full_location[4096];
-				GetCurrentDir(4096,full_location);
-				strcat(full_location,"/");
-				strcat(full_location,filename);
-
+bool myFactory::LoadObject(const char *szFile, void *factoryPointer, void *factoryInfoPointer) {
 				//load the dll
 #ifdef INTERNAL_DEBUG
-                                printf("%s:%d: about to load dynamic library %s\n",__FILE__,__LINE__,filename);
+                                printf("%s:%d: about to load dynamic library %s\n",__FILE__,__LINE__,szFile);
 #endif
-			OS_DynlibHandle hInst=OS_DYNLIB_LOAD(full_location);
+			OS_DynlibHandle hInst=OS_DYNLIB_LOAD(szFile);
 			if (hInst==NULL) {
 #ifdef INTERNAL_DEBUG
 				#if defined (OS_LINUX)
-				printf("%s:%d: Could not load DLL library %s\n",__FILE__,__LINE__,filename);
+				printf("%s:%d: Could not load DLL library %s\n",__FILE__,__LINE__,szFile);
 				#endif
 #endif
-				STATIC_SET_ERROR("Could not load DLL library %s",filename);
+				STATIC_SET_ERROR("Could not load DLL library %s",szFile);
 				#if defined (OS_LINUX)
 				{
 				  char *err = dlerror();
@@ -124,15 +126,17 @@ void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *fa
 #endif
 				}
 				#endif
-				continue;
+				return false;
 			}
 			#ifndef NDEBUG
 #ifdef INTERNAL_DEBUG
 			printf("%s:%d:",__FILE__,__LINE__);
-			printf("Found dll '%s'\n",filename);
+			printf("Found dll '%s'\n",szFile);
 #endif
 			#endif
-			svDlls.push_back(hInst);
+			svDlls.push_back(DllRecord());
+			svDlls.back().hInst = hInst;
+			PAL_VECTOR<myFactoryObject *>& dllObjects = svDlls.back().objects;
 /*			pt2StatusTrackerFunction sfp = (pt2StatusTrackerFunction) GetProcAddress((HMODULE)hInst,"SetStatusTrackerInstance");
 			if (sfp==NULL) {
 //				LOG(SWARNING,"%s does not contain a valid status tracking component\n",filename);
@@ -161,7 +165,7 @@ void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *fa
 					void *vo=fpg(i); //void object pointer, construct a copy of the object for registration purposes
 					myFactoryObject *fo= (myFactoryObject *) vo;
 					fo->RegisterWithFactory(myFactory::sInfo());
-					svDllObjects.push_back(fo);
+					dllObjects.push_back(fo);
 				}
 			}
 
@@ -174,7 +178,7 @@ void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *fa
 				void *vo=fp(); //void object pointer, construct a copy of the object for registration purposes
 				myFactoryObject *fo= (myFactoryObject *) vo;
 				fo->RegisterWithFactory(myFactory::sInfo());
-				svDllObjects.push_back(fo);
+				dllObjects.push_back(fo);
 #ifndef NDEBUG
 				printf("constructor connected and registered\n");
 #endif
@@ -196,8 +200,59 @@ void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *fa
 				}
 
 			}
+	return true;
+}
+
+void myFactory::LoadObjects(const char *szPath , void * factoryPointer, void *factoryInfoPointer) throw(palException) {
+#ifdef INTERNAL_DEBUG
+  printf("myFactory::LoadObjects: szPath = '%s', factory = %p, sinfo = %p\n", 
+	  szPath, factoryPointer, factoryInfoPointer);
+#endif
 
+	char current_directory[4096];
+	if (szPath != NULL) {
+		GetCurrentDir(4096,current_directory);
+		try
+		{
+			SetCurrentDir(szPath);
+		}
+		catch (const palException& ex)
+		{
+			fprintf(stderr, "%s:%d: Unable to change directory to \"%s\" to load plugins because of \"%s\" \n",__FILE__,__LINE__,szPath, ex.what());
+			throw;
+		}
+	}
+	PAL_VECTOR<PAL_STRING> filesfound;
+
+#if defined (_WIN32)
+	PAL_STRING pattern("*.dll");
+#ifdef INTERNAL_DEBUG
+	printf("myFactory::LoadObjects: About to call FindFiles with pattern '%s'\n",
+		pattern.c_str());
+#endif
+	FindFiles(pattern,filesfound);
+#ifdef INTERNAL_DEBUG
+	printf("myFactory::LoadObjects: Back from FindFiles\n");
+#endif
+#elif defined (OS_OSX)
+   FindFiles("*.dylib",filesfound);
+#else
+	FindFiles("*.so",filesfound);
+#endif
+
+	PAL_VECTOR<PAL_STRING>::size_type i;
+	for (i=0;i<filesfound.size();i++) {
+
+			const char *filename = filesfound[i].c_str();
+				//printf("found : '%s'\n",filename);
+
+				//build full location for *nix systems
+				char full_location[4096];
+				GetCurrentDir(4096,full_location);
+				strcat(full_location,"/");
+				strcat(full_location,filename);
 
+			LoadObject(full_location,factoryPointer,factoryInfoPointer);
 	}
 	if (szPath != NULL) {
 	SetCurrentDir(current_directory);
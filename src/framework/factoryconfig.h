@@ -7,6 +7,9 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 1.4  :19/10/26 GetFactoryName, for creating engine classes directly
+		Version 1.3  :19/10/26 Factory objects are created in the arena of their class
+		Version 1.2  :19/10/26 LoadObject and UnloadObjects for loading single libraries
 		Version 1.1  :06/12/07 Update merge with MGF, myFactory singleton and DLL factory set instance
 		Version 1.0.4:18/08/04 PAL modifications
 		Version 1.0.3:04/08/04 Virtual freeobjects
@@ -40,6 +43,10 @@ typedef PluggableFactory<myFactoryBase> myPluggableFactory;
 class myFactory : public myPluggableFactory, public MemoryObjectManager<StatusObject> {
 public:
 	static void LoadObjects(const char *szPath = NULL, void *factoryPointer = 0, void *factoryInfoPointer=0) throw(palException);
+	//loads and registers the objects of a single library, returns false if it could not be loaded
+	static bool LoadObject(const char *szFile, void *factoryPointer = 0, void *factoryInfoPointer=0);
+	//unloads every library that registered nothing for keepGroup. Objects created from them must already be deleted.
+	static void UnloadObjects(const PAL_STRING& keepGroup);
 	virtual void FreeObjects(void);
 	myFactoryObject *Construct(const PAL_STRING& ClassName);
 #ifdef INTERNAL_DEBUG
@@ -75,7 +82,10 @@ void RegisterWithFactory(PAL_VECTOR<myFactoryInfo> &lsInfo) { \
 		printf("%s:%d: Registering %s (%p) with sInfo:%p (size:%ld)\n",__FILE__,__LINE__,#name,this,&lsInfo,lsInfo.size()); \
 		Register(ri,lsInfo); \
 } \
-myFactoryObject* Create() {return new name;} \
+myFactoryObject* Create() { \
+		static ObjectArena *arena = ObjectArena::Get(#name, sizeof(name)); \
+		return new (arena) name;} \
+static const char *GetFactoryName() { return #name; } \
 	private:
 #else
 #define FACTORY_CLASS(name,ClassName,GroupName,Version) public: \
@@ -90,7 +100,10 @@ void RegisterWithFactory(PAL_VECTOR<myFactoryInfo> &lsInfo) { \
 		ri.mConstructor=(myFactoryObject *) this; \
 		Register(ri,lsInfo); \
 } \
-virtual myFactoryObject* Create() {return new name;} \
+virtual myFactoryObject* Create() { \
+		static ObjectArena *arena = ObjectArena::Get(#name, sizeof(name)); \
+		return new (arena) name;} \
+static const char *GetFactoryName() { return #name; } \
 	private:
 #endif //INTERNAL_DEBUG
 
@@ -7,12 +7,12 @@
 	Author: 
 		Adrian Boeing
 	Revision History:	
+		Version 1.04: 19/10/26 Objects allocated from per-type arenas, handle table instead of a set
 		Version 1.03: 04/08/04 Virtual free all
 		Version 1.02: 12/06/04 Protected list for MOM to allow custom free.
 		Version 1.01: 22/01/04 Restored to working state
 		Version 1.0 : 28/12/03
 	TODO:
-		- Improve iterator performance, incase it need not delete
 		- Support FreeStoreDetect class or force private MMO's
 		- Proper virtual free all
 */
@@ -20,11 +20,19 @@
 //header:
 
 #include "empty.h"
+#include "objectarena.h"
 #include "pal/palStringable.h"
 #include <cstdio>
-#include <unordered_set>
 #include <typeinfo>
 
+//a handle holds the slot of an object in the index bits and the generation of the slot above them,
+//the generation changes every time the slot is freed so old handles do not resolve to a new object.
+//0 is never a valid handle.
+#define MMO_HANDLE_INDEX_BITS 20
+#define MMO_HANDLE_INDEX_MASK ((1u << MMO_HANDLE_INDEX_BITS) - 1)
+#define MMO_HANDLE_GENERATIONS (1u << (32 - MMO_HANDLE_INDEX_BITS))
+#define MMO_NO_SLOT 0xFFFFFFFFu
+
 template <typename MemoryBase> class MemoryObjectManager;
 
 template <typename MemoryBase>
@@ -34,7 +42,7 @@ protected:
 //private:
 	ManagedMemoryObject();
 	ManagedMemoryObject(const ManagedMemoryObject<MemoryBase>& mmo)
-		: MemoryBase(mmo) {
+		: MemoryBase(mmo), mSlot(MMO_NO_SLOT) {
 		pMOM = mmo.pMOM;
 	}
 	ManagedMemoryObject& operator=(const ManagedMemoryObject<StatusObject>& mmo) { pMOM = mmo.pMOM; return *this; }
@@ -42,26 +50,52 @@ protected:
 public:
 	MemoryObjectManager<MemoryBase> *pMOM; //wheres my mommy?
 	virtual std::string toString() const;
+
+	//objects are allocated from the arena of their size, or of their class when created by a factory
+	static void *operator new(size_t size) { return ObjectArena::GetForSize(size)->Allocate(size); }
+	static void *operator new(size_t size, ObjectArena *arena) { return arena->Allocate(size); }
+	static void *operator new(size_t, void *place) { return place; }
+	static void operator delete(void *ptr) { ObjectArena::Free(ptr); }
+	static void operator delete(void *ptr, ObjectArena *) { ObjectArena::Free(ptr); }
+	static void operator delete(void *, void *) {}
+private:
+	unsigned int mSlot; //in the MOM's table
 };
 
 template <typename MemoryBase>
 class MemoryObjectManager {
 public:
-	MemoryObjectManager() : pMMO() {}
+	MemoryObjectManager() : mFreeHead(MMO_NO_SLOT), mFreeTail(MMO_NO_SLOT), mCount(0) {}
 	virtual ~MemoryObjectManager() {}
 	void Add(ManagedMemoryObject<MemoryBase> *item);
 	void Remove(ManagedMemoryObject<MemoryBase> *item);
 	virtual void FreeAll();
+	//returns 0 if the item is not managed here
+	unsigned int GetHandle(const ManagedMemoryObject<MemoryBase> *item) const;
+	//returns NULL if the handle's object has been freed
+	ManagedMemoryObject<MemoryBase> *Resolve(unsigned int handle) const;
+	size_t GetObjectCount() const { return mCount; }
 protected:
 //private:
-	typedef std::unordered_set<ManagedMemoryObject<MemoryBase>*> MMOType;
-	MMOType pMMO;
+	//the objects are walked by slot, a slot is NULL if it is free. Freeing objects during the walk is fine.
+	size_t GetSlotCount() const { return mSlots.size(); }
+	ManagedMemoryObject<MemoryBase> *GetSlotObject(size_t slot) const { return mSlots[slot].item; }
+private:
+	struct Slot {
+		ManagedMemoryObject<MemoryBase> *item;
+		unsigned int generation; //from 1, so no handle is 0
+		unsigned int nextFree;
+	};
+	PAL_VECTOR<Slot> mSlots;
+	//free slots are reused oldest first, spreading out the generations
+	unsigned int mFreeHead, mFreeTail;
+	size_t mCount;
 };
 
 //code:
 //mmo
 template <typename MemoryBase> ManagedMemoryObject<MemoryBase>::ManagedMemoryObject()
-: pMOM(0) {
+: pMOM(0), mSlot(MMO_NO_SLOT) {
 }
 
 template <typename MemoryBase> ManagedMemoryObject<MemoryBase>::~ManagedMemoryObject() {
@@ -83,21 +117,68 @@ template <typename MemoryBase> std::string ManagedMemoryObject<MemoryBase>::toSt
 //mom
 template <typename MemoryBase>
 void MemoryObjectManager<MemoryBase>::Add(ManagedMemoryObject<MemoryBase> *item) {
-	pMMO.insert(item);
+	if (item->pMOM == this && item->mSlot != MMO_NO_SLOT)
+		return; //already here
+	unsigned int slot = mFreeHead;
+	if (slot != MMO_NO_SLOT) {
+		mFreeHead = mSlots[slot].nextFree;
+		if (mFreeHead == MMO_NO_SLOT)
+			mFreeTail = MMO_NO_SLOT;
+	} else {
+		slot = (unsigned int)mSlots.size();
+		Slot s;
+		s.generation = 1;
+		mSlots.push_back(s);
+	}
+	mSlots[slot].item = item;
+	mSlots[slot].nextFree = MMO_NO_SLOT;
+	item->mSlot = slot;
 	item->pMOM=this;
+	mCount++;
 }
 
 template <typename MemoryBase>
 void MemoryObjectManager<MemoryBase>::Remove(ManagedMemoryObject<MemoryBase> *item) {
-	pMMO.erase(item);
+	unsigned int slot = item->mSlot;
+	if (slot >= mSlots.size() || mSlots[slot].item != item)
+		return; //not managed here, eg a copy
+	Slot &s = mSlots[slot];
+	s.item = NULL;
+	s.generation++;
+	if (s.generation >= MMO_HANDLE_GENERATIONS)
+		s.generation = 1;
+	s.nextFree = MMO_NO_SLOT;
+	if (mFreeTail != MMO_NO_SLOT)
+		mSlots[mFreeTail].nextFree = slot;
+	else
+		mFreeHead = slot;
+	mFreeTail = slot;
+	item->mSlot = MMO_NO_SLOT;
+	mCount--;
 }
 
 template <typename MemoryBase>
 void MemoryObjectManager<MemoryBase>::FreeAll() {
-	while (!pMMO.empty() ) {
-		delete *pMMO.begin();
-		//no need to erase() because the MMO takes care of it.
+	for (size_t i = 0; i < mSlots.size(); i++) {
+		delete mSlots[i].item;
+		//no need to Remove() because the MMO takes care of it.
 	}
 }
 
+template <typename MemoryBase>
+unsigned int MemoryObjectManager<MemoryBase>::GetHandle(const ManagedMemoryObject<MemoryBase> *item) const {
+	unsigned int slot = item ? item->mSlot : MMO_NO_SLOT;
+	if (slot > MMO_HANDLE_INDEX_MASK || slot >= mSlots.size() || mSlots[slot].item != item)
+		return 0;
+	return (mSlots[slot].generation << MMO_HANDLE_INDEX_BITS) | slot;
+}
+
+template <typename MemoryBase>
+ManagedMemoryObject<MemoryBase> *MemoryObjectManager<MemoryBase>::Resolve(unsigned int handle) const {
+	unsigned int slot = handle & MMO_HANDLE_INDEX_MASK;
+	if (slot >= mSlots.size() || mSlots[slot].generation != (handle >> MMO_HANDLE_INDEX_BITS))
+		return NULL;
+	return mSlots[slot].item;
+}
+
 #endif
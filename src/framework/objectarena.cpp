@@ -0,0 +1,157 @@
+#include "objectarena.h"
+/*
+	Abstract:
+		Slab allocation for managed memory objects
+	Revision History:
+		Version 1.0 : 19/10/26
+	TODO:
+*/
+
+#include <stdio.h>
+#include <map>
+#include <new>
+#include <atomic>
+
+//aim for slabs of about this many bytes, and at least MIN_BLOCKS_PER_SLAB objects
+#define SLAB_BYTES 65536
+#define MIN_BLOCKS_PER_SLAB 16
+
+//the arenas are never deleted, objects may be freed while statics are being destroyed
+struct ArenaRegistry {
+	std::mutex mutex;
+	std::map<std::string, ObjectArena *> named;
+	std::map<size_t, ObjectArena *> sized;
+	PAL_VECTOR<ObjectArena *> all;
+	std::atomic<bool> enabled;
+	ArenaRegistry() : enabled(true) {}
+};
+
+static ArenaRegistry& Registry() {
+	static ArenaRegistry *registry = new ArenaRegistry;
+	return *registry;
+}
+
+ObjectArena::ObjectArena(const char *name, size_t size)
+: m_Name(name), m_nSize(size), m_pFree(NULL), m_nLive(0) {
+	size_t align = sizeof(Header);
+	m_nBlockSize = sizeof(Header) + (size + align - 1) / align * align;
+	m_nBlocksPerSlab = SLAB_BYTES / m_nBlockSize;
+	if (m_nBlocksPerSlab < MIN_BLOCKS_PER_SLAB)
+		m_nBlocksPerSlab = MIN_BLOCKS_PER_SLAB;
+}
+
+ObjectArena *ObjectArena::Get(const char *name, size_t size) {
+	ArenaRegistry& reg = Registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	std::map<std::string, ObjectArena *>::iterator it = reg.named.find(name);
+	if (it != reg.named.end())
+		return it->second;
+	ObjectArena *arena = new ObjectArena(name, size);
+	reg.named[name] = arena;
+	reg.all.push_back(arena);
+	return arena;
+}
+
+ObjectArena *ObjectArena::GetForSize(size_t size) {
+	size_t align = sizeof(Header);
+	size = (size + align - 1) / align * align;
+	ArenaRegistry& reg = Registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	std::map<size_t, ObjectArena *>::iterator it = reg.sized.find(size);
+	if (it != reg.sized.end())
+		return it->second;
+	char name[32];
+	sprintf(name, "%lu bytes", (unsigned long)size);
+	ObjectArena *arena = new ObjectArena(name, size);
+	reg.sized[size] = arena;
+	reg.all.push_back(arena);
+	return arena;
+}
+
+void *ObjectArena::Allocate(size_t size) {
+	if (!Registry().enabled) {
+		Header *h = static_cast<Header *>(::operator new(sizeof(Header) + size));
+		h->owner = NULL;
+		return h + 1;
+	}
+	if (size > m_nSize) //a derived class without an arena of its own
+		return GetForSize(size)->Allocate(size);
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_pFree == NULL) {
+		char *slab = static_cast<char *>(::operator new(m_nBlockSize * m_nBlocksPerSlab));
+		m_Slabs.push_back(slab);
+		//link the blocks so they are handed out in address order
+		for (size_t i = m_nBlocksPerSlab; i > 0; i--) {
+			Header *h = reinterpret_cast<Header *>(slab + (i - 1) * m_nBlockSize);
+			h->next = m_pFree;
+			m_pFree = h;
+		}
+	}
+	Header *h = m_pFree;
+	m_pFree = h->next;
+	h->owner = this;
+	m_nLive++;
+	return h + 1;
+}
+
+void ObjectArena::Free(void *ptr) {
+	if (ptr == NULL)
+		return;
+	Header *h = static_cast<Header *>(ptr) - 1;
+	ObjectArena *arena = h->owner;
+	if (arena == NULL) {
+		::operator delete(h);
+		return;
+	}
+	std::lock_guard<std::mutex> lock(arena->m_Mutex);
+	h->next = arena->m_pFree;
+	arena->m_pFree = h;
+	arena->m_nLive--;
+}
+
+void ObjectArena::Trim() {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	if (m_nLive > 0)
+		return;
+	for (size_t i = 0; i < m_Slabs.size(); i++)
+		::operator delete(m_Slabs[i]);
+	m_Slabs.clear();
+	m_pFree = NULL;
+}
+
+void ObjectArena::TrimAll() {
+	PAL_VECTOR<ObjectArena *> arenas;
+	GetArenas(&arenas);
+	for (size_t i = 0; i < arenas.size(); i++)
+		arenas[i]->Trim();
+}
+
+void ObjectArena::SetEnabled(bool enabled) {
+	Registry().enabled = enabled;
+}
+
+const char *ObjectArena::GetName() const {
+	return m_Name.c_str();
+}
+
+size_t ObjectArena::GetObjectSize() const {
+	return m_nSize;
+}
+
+size_t ObjectArena::GetLiveCount() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_nLive;
+}
+
+size_t ObjectArena::GetSlabCount() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Slabs.size();
+}
+
+size_t ObjectArena::GetArenas(PAL_VECTOR<ObjectArena *> *arenas) {
+	ArenaRegistry& reg = Registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	if (arenas)
+		*arenas = reg.all;
+	return reg.all.size();
+}
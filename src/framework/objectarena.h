@@ -0,0 +1,71 @@
+#ifndef OBJECTARENA_H
+#define OBJECTARENA_H
+/**
+	Abstract:
+		Slab allocation for managed memory objects.
+		Each arena hands out blocks of one size from large slabs, so the objects of a type lie
+		next to each other in memory, and a whole slab is released at once when it is empty.
+	Revision History:
+		Version 1.0 : 19/10/26
+	TODO:
+		- Release single empty slabs while other slabs are in use
+*/
+
+#include "common.h"
+#include <stddef.h>
+#include <string>
+#include <mutex>
+
+class ObjectArena {
+public:
+	/** The arena for the objects of one class, made on first use and kept until the program ends.
+	Objects of other sizes given to it are passed on to the arena for their size.
+	*/
+	static ObjectArena *Get(const char *name, size_t size);
+	/// The arena shared by the objects of a size that have no arena of their own
+	static ObjectArena *GetForSize(size_t size);
+
+	void *Allocate(size_t size);
+	/// Frees a block from any arena
+	static void Free(void *ptr);
+
+	/// Releases all the slabs of the arena, if none of its objects are in use
+	void Trim();
+	/// Trims every arena, after a world has been torn down
+	static void TrimAll();
+
+	/** Turns the arenas off (or back on), new objects are then allocated from the heap one by one.
+	Only for comparison; objects allocated either way may be freed at any time.
+	*/
+	static void SetEnabled(bool enabled);
+
+	const char *GetName() const;
+	size_t GetObjectSize() const;
+	size_t GetLiveCount() const;
+	size_t GetSlabCount() const;
+	/// \return The number of arenas, all the arenas if arenas is not NULL
+	static size_t GetArenas(PAL_VECTOR<ObjectArena *> *arenas = NULL);
+private:
+	ObjectArena(const char *name, size_t size);
+	ObjectArena(const ObjectArena&);
+	ObjectArena& operator=(const ObjectArena&);
+
+	//in front of every block, the owner while allocated and the next free block otherwise
+	union Header {
+		ObjectArena *owner;
+		Header *next;
+		long double align;
+		long long alignLong;
+	};
+
+	std::string m_Name;
+	size_t m_nSize; //of the objects
+	size_t m_nBlockSize; //of the objects and their header
+	size_t m_nBlocksPerSlab;
+	Header *m_pFree;
+	size_t m_nLive;
+	PAL_VECTOR<char *> m_Slabs;
+	mutable std::mutex m_Mutex;
+};
+
+#endif
@@ -1,7 +1,12 @@
 //#include "pal.h"
 #include "palFactory.h"
+#include "palCommandBuffer.h"
+#include "palStateBuffer.h"
+#include "palTransformSnapshots.h"
+#include "pal.inl"
 #include <algorithm>
 #include <iostream>
+#include <string.h>
 /*
 	Abstract:
 		PAL - Physics Abstraction Layer.
@@ -31,18 +36,11 @@ void palPhysics::SetFactoryInstance(palFactory *pf) {
 }
 
 void palPhysics::AddAction(palAction *action) {
-	if (action != NULL)
-		m_Actions.push_back(action);
+	m_Actions.Add(action);
 }
 
 void palPhysics::RemoveAction(palAction *action) {
-	if (action != NULL)
-	{
-		PAL_LIST<palAction*>::iterator found = std::find(m_Actions.begin(),m_Actions.end(),action);
-		if (found != m_Actions.end()) {
-			m_Actions.erase(found);
-		}
-	}
+	m_Actions.Remove(action);
 }
 
 void palPhysics::SetDebugDraw(palDebugDraw* debugDraw) {
@@ -53,18 +51,8 @@ palDebugDraw* palPhysics::GetDebugDraw() {
 	return m_pDebugDraw;
 }
 
-struct ActionCaller {
-	void operator()(palAction *action)
-	{
-		(*action)(m_fTimeStep);
-	}
-	float m_fTimeStep;
-};
-
 void palPhysics::CallActions(Float timestep) {
-	ActionCaller ac;
-	ac.m_fTimeStep = timestep;
-	std::for_each(m_Actions.begin(), m_Actions.end(), ac);
+	m_Actions.Run(timestep);
 }
 
 #if 0
@@ -193,13 +181,17 @@ void palPhysics::Init(const palPhysicsDesc& desc) {
 	}
 
 	m_Properties=desc.m_Properties;
+	m_Actions.SetNumThreads(GetInitProperty<unsigned int>("ActionThreads", 1, 1, 64));
 
 	m_pMaterials = palFactory::GetInstance()->CreateObject<palMaterials>("palMaterials");
+
+	static unsigned int s_nStateIds = 0;
+	m_nStateId = ++s_nStateIds;
 }
 
 palPhysics::palPhysics()
   : m_bListen(false), m_fGravityX(0), m_fGravityY(0), m_fGravityZ(0), m_fLastTimestep(0),
-    m_fTime(0), m_nUpAxis(PAL_Y_AXIS), m_pMaterials(0), m_pDebugDraw(0) {
+    m_fTime(0), m_nUpAxis(PAL_Y_AXIS), m_bSubstepActions(false), m_pMaterials(0), m_pDebugDraw(0), m_pCommandBuffer(0), m_pTransformSnapshots(0), m_nStateId(0) {
 }
 
 palPhysics::~palPhysics() {
@@ -209,19 +201,82 @@ palPhysics::~palPhysics() {
 
 void palPhysics::GetPropertyDocumentation(PAL_MAP<PAL_STRING, PAL_STRING>& docOut) const
 {
+	docOut["ActionThreads"] = "Defaults to 1, from 1 to 64.  The number of threads the independent actions (see palAction::IsIndependent) are split over.";
 }
 
 void palPhysics::Update(Float timestep) {
 #ifdef INTERNAL_DEBUG
 	std::cout << "palPhysics::Update: timestep = " << timestep << " (==0.02? " << (timestep == 0.02f) << ")" << std::endl;
 #endif
+	if (m_pCommandBuffer != NULL) {
+		m_pCommandBuffer->Apply(this);
+	}
 	if (GetDebugDraw() != NULL) {
 		GetDebugDraw()->Clear();
 	}
-	CallActions(timestep);
+	if (!m_bSubstepActions)
+		CallActions(timestep);
 	Iterate(timestep);
 	m_fTime+=timestep;
 	m_fLastTimestep=timestep;
+	if (m_pTransformSnapshots != NULL) {
+		m_pTransformSnapshots->Publish(m_fTime);
+	}
+}
+
+void palPhysics::BeginBatch() {
+}
+
+void palPhysics::EndBatch() {
+}
+
+// the start of a saved state, the engine state follows it
+#define PAL_STATE_VERSION 1
+struct palStateHeader {
+	char m_Magic[4];
+	unsigned int m_nVersion;
+	unsigned int m_nStateId;
+	Float m_fTime;
+	Float m_fLastTimestep;
+};
+
+bool palPhysics::SaveState(palStateBuffer& state) const {
+	state.Clear();
+	palStateHeader header;
+	memcpy(header.m_Magic, "PALS", 4);
+	header.m_nVersion = PAL_STATE_VERSION;
+	header.m_nStateId = m_nStateId;
+	header.m_fTime = m_fTime;
+	header.m_fLastTimestep = m_fLastTimestep;
+	state.Write(header);
+	if (!SaveEngineState(state)) {
+		state.Clear();
+		return false;
+	}
+	return true;
+}
+
+bool palPhysics::RestoreState(const palStateBuffer& state) {
+	palStateHeader header;
+	state.Rewind();
+	if (!state.Read(header))
+		return false;
+	if (memcmp(header.m_Magic, "PALS", 4) != 0 || header.m_nVersion != PAL_STATE_VERSION
+			|| header.m_nStateId != m_nStateId || m_nStateId == 0)
+		return false;
+	if (!RestoreEngineState(state))
+		return false;
+	m_fTime = header.m_fTime;
+	m_fLastTimestep = header.m_fLastTimestep;
+	return true;
+}
+
+bool palPhysics::SaveEngineState(palStateBuffer& /*state*/) const {
+	return false;
+}
+
+bool palPhysics::RestoreEngineState(const palStateBuffer& /*state*/) {
+	return false;
 }
 
 palTerrainType palTerrain::GetType() const {
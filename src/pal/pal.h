@@ -16,6 +16,10 @@
 	\version
 	<pre>
 	Revision History:
+		Version 0.4.05: 19/10/26 - Transform snapshots
+		Version 0.4.04: 19/10/26 - Save and restore state
+		Version 0.4.03: 19/10/26 - Action scheduler, actions called every substep
+		Version 0.4.02: 19/10/26 - Command buffer
 		Version 0.4.01: 28/02/08 - Physics get gravity, additional init for palOrientatedPlane.
 		Version 0.4   : 30/09/08 - PAL Versioning
 		Version 0.3.16: 26/05/08 - Collision groups
@@ -45,6 +49,7 @@
 #include "palBase.h"
 #include "palDebugDraw.h"
 #include "palMaterials.h"
+#include "palActionScheduler.h"
 
 //forward decl
 class palGeometry;
@@ -52,6 +57,9 @@ class palBodyBase;
 class palCollisionDetection;
 class palSolver;
 class palAction;
+class palCommandBuffer;
+class palStateBuffer;
+class palTransformSnapshots;
 
 typedef enum {
 	PAL_X_AXIS = 0,
@@ -79,6 +87,7 @@ struct palPhysicsDesc {
 */
 class palPhysics : public palFactoryObject {
 	friend class palFactory;
+	friend class palCommandBuffer;
 public:
 
 	/**
@@ -139,11 +148,48 @@ public:
 	/**
 	 * Adds a new action to the physics system
 	 * @see palAction
+	 * @see palActionScheduler
 	 */
 	virtual void AddAction(palAction *action);
 	/// Removes an action from the physics system
 	virtual void RemoveAction(palAction *action);
 
+	/**
+	 * Sets the command buffer that is applied at the start of every Update, before the actions are called.
+	 * The buffer is not owned by the physics, set it to NULL before deleting it.
+	 * @see palCommandBuffer
+	 */
+	void SetCommandBuffer(palCommandBuffer* commands) { m_pCommandBuffer = commands; }
+	/// @return the command buffer applied by Update, or NULL
+	palCommandBuffer* GetCommandBuffer() { return m_pCommandBuffer; }
+
+	/**
+	 * Sets the snapshots Update publishes the bodies to at the end of every step, for other threads to read.
+	 * The snapshots are not owned by the physics, set them to NULL before deleting them.
+	 * @see palTransformSnapshots
+	 */
+	void SetTransformSnapshots(palTransformSnapshots* snapshots) { m_pTransformSnapshots = snapshots; }
+	/// @return the snapshots published by Update, or NULL
+	palTransformSnapshots* GetTransformSnapshots() { return m_pTransformSnapshots; }
+
+	/**
+	Saves the state of the simulation: the location, velocity and sleep state of every body, the state the engine keeps
+	for its links and motors, and, where the engine supports it, its contact caches (eg: for warm starting).
+	Stepping after RestoreState then gives the results stepping after SaveState did, which allows rolling back and
+	resimulating, or simulating ahead and going back.
+	The state can only be restored into this physics, while it holds the same bodies, geometries and links.
+	Their properties (eg: mass, materials, link limits) are not part of the state.
+	\param state The buffer to save to, its contents are replaced
+	\return false, leaving the buffer empty, if the engine cannot save its state
+	*/
+	virtual bool SaveState(palStateBuffer& state) const;
+	/**
+	Restores a state saved by SaveState, along with the simulation time.
+	\return false, changing nothing, if the state was saved by another physics (or an earlier Init of this one),
+	or the bodies, geometries or links have changed since
+	*/
+	virtual bool RestoreState(const palStateBuffer& state);
+
 	/// Assigns the debug draw instance.
 	virtual void SetDebugDraw(palDebugDraw* debugDraw);
 	/// @return the debug draw instance.
@@ -171,14 +217,35 @@ protected:
 	bool m_bListen; //!< If set to true, notify functions are called.
 	virtual void Iterate(Float timestep) = 0;
 
-	///Call all actions.
+	/**
+	 * Call all actions.
+	 * Update calls this once before Iterate, unless m_bSubstepActions is set, in which case the engine
+	 * has to call it itself before every substep it takes.
+	 */
 	virtual void CallActions(Float timestep);
+	/**
+	 * Called before and after a palCommandBuffer creates, moves and deletes a set of objects.
+	 * Engines can use this to insert all the new bodies into the broadphase at once.
+	 */
+	virtual void BeginBatch();
+	virtual void EndBatch();
+	/**
+	 * Called by SaveState to append the engine state to the buffer, after the state PAL keeps itself.
+	 * The default saves nothing and returns false, for engines that cannot save their state.
+	 */
+	virtual bool SaveEngineState(palStateBuffer& state) const;
+	/**
+	 * Called by RestoreState to read back what SaveEngineState appended, from the read position of the buffer.
+	 * It has to check the state matches the world before changing anything, and return false if it does not.
+	 */
+	virtual bool RestoreEngineState(const palStateBuffer& state);
 	Float m_fGravityX; //!< The gravity vector (x)
 	Float m_fGravityY; //!< The gravity vector (y)
 	Float m_fGravityZ; //!< The gravity vector (z)
 	Float m_fLastTimestep;
 	Float m_fTime; //dodgy?
 	palAxis m_nUpAxis;
+	bool m_bSubstepActions; //!< If set to true, the engine calls CallActions for each substep
 
 	/** Construction, destruction, and Cleanup should only be done by
 	 * the palFactory. */
@@ -204,13 +271,16 @@ private:
 	PropertyMap m_Properties;
 	palMaterials *m_pMaterials;
 	palDebugDraw *m_pDebugDraw;
-	PAL_LIST<palAction*> m_Actions;
+	palCommandBuffer *m_pCommandBuffer;
+	palTransformSnapshots *m_pTransformSnapshots;
+	palActionScheduler m_Actions;
+	unsigned int m_nStateId; //!< set by each Init, so a state is only restored into the world that saved it
 };
 
 /*!
  * Actions are custom objects that can be added to the physics system and they will be called during each physics step.
- * The default behavior is to call these once each time palPhysics::Update is called, but some engines support calling this every
- * substep.  In either case, the correct time step will be passed in.
+ * Engines that take substeps (Bullet and Tokamak) call them before every substep, the others once each time palPhysics::Update is called.
+ * In either case, the correct time step will be passed in.
  *
  * @note Unless you are certain the engine you are using will only call this once per call to Update(), you should
  *       not call AddForce because the force could continue to be applied for multiple time steps, giving undesired
@@ -218,8 +288,19 @@ private:
  */
 class palAction {
 public:
+	palAction() : m_nScheduleIndex(-1), m_bScheduleIndependent(false) {}
 	virtual ~palAction() {}
 	virtual void operator()(Float timeStep) = 0;
+	/**
+	 * Independent actions are called after the others, on several threads at once (see palActionScheduler).
+	 * Only return true if the action changes no body that another independent action changes,
+	 * and reads nothing another one changes. The default is false.
+	 */
+	virtual bool IsIndependent() const { return false; }
+private:
+	friend class palActionScheduler;
+	int m_nScheduleIndex; //!< where the scheduler keeps the action, -1 if it has not been added
+	bool m_bScheduleIndependent;
 };
 
 #include "palBodyBase.h"
@@ -0,0 +1,77 @@
+#ifndef PALACTIONSCHEDULER_H
+#define PALACTIONSCHEDULER_H
+/*! \file palActionScheduler.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Action scheduling
+	\version
+	<pre>
+	Revision History:
+		Version 0.1.1 : 19/10/26 - Worker threads kept between steps
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palBase.h"
+
+class palAction;
+class palActionWorkers;
+
+/** Holds the actions of a palPhysics and calls them for each step.
+	Engines that take several substeps per palPhysics::Update run the actions before every substep,
+	with the substep length, the others once per Update.
+
+	Actions are kept in arrays, adding and removing one takes constant time.
+	The actions are called in the order they were added, except that the independent ones
+	(see palAction::IsIndependent) are called after all the others, split over the threads
+	set with SetNumThreads (the ActionThreads init property of palPhysics).
+	The worker threads are started the first time they are needed and sleep between steps.
+
+	An action may remove itself or any other action, or add new ones, from its call, unless it is an independent one.
+	Actions added during a step are first called on the next step.
+*/
+class palActionScheduler {
+public:
+	palActionScheduler();
+	~palActionScheduler();
+
+	/** Adds an action, does nothing if it has already been added.
+	Whether the action is independent is asked here, once.
+	*/
+	void Add(palAction *action);
+	/** Removes an action, does nothing if it has not been added.
+	*/
+	void Remove(palAction *action);
+	/** Removes all the actions.
+	*/
+	void Clear();
+
+	/** Calls all the actions.
+	\param timestep The length of the step they act for
+	*/
+	void Run(Float timestep);
+
+	/** Sets the number of threads the independent actions are split over.
+	\param threads The number of threads, 1 (the default) calls them all on the calling thread.
+	Changing it stops the worker threads, they are restarted by the next Run that needs them.
+	*/
+	void SetNumThreads(unsigned threads);
+	unsigned GetNumThreads() const;
+
+	/// \return The number of actions
+	unsigned GetNumActions() const;
+private:
+	palActionScheduler(const palActionScheduler&);
+	palActionScheduler& operator=(const palActionScheduler&);
+
+	/// Drops the removed actions from the arrays, keeping the order of the others
+	void Compact(PAL_VECTOR<palAction *>& actions);
+
+	PAL_VECTOR<palAction *> m_Actions; //!< called in turn, NULL where one has been removed
+	PAL_VECTOR<palAction *> m_Independent; //!< called in parallel, NULL where one has been removed
+	unsigned m_nRemoved; //!< the number of NULL entries in both arrays
+	unsigned m_nThreads;
+	palActionWorkers *m_pWorkers; //!< NULL until the independent actions are first split
+};
+
+#endif
@@ -9,6 +9,8 @@
 		Adrian Boeing
 	\version
 	<pre>
+		Version 0.1.2 : 19/10/26 - PAL_FINAL for the static single engine build
+		Version 0.1.1 : 19/10/26 - Object handles
 		Version 0.1   : 11/12/07 - Original
 	</pre>
 	\todo
@@ -39,6 +41,9 @@ protected:
 
 typedef int palGroup;
 
+/// A generation checked reference to an object created by the factory, see palFactory::GetHandle. 0 is never valid.
+typedef unsigned int palHandle;
+
 /* 
  * A mask used for requesting a list of groups. Note: some physics
  * engines may use fewer bits than an unsigned long has. If you 
@@ -46,4 +51,16 @@ typedef int palGroup;
  */
 typedef unsigned long palGroupFlags;
 
+/* 
+ * Marks engine classes, and the engine overrides of the hot body methods, final in the
+ * static single engine build (PAL_STATIC_ENGINE, see palStaticEngine.h). Calls through the
+ * concrete engine types are then direct and can be inlined. Empty in the plugin build,
+ * where engine classes may still be derived from.
+ */
+#ifdef PAL_STATIC_ENGINE
+#define PAL_FINAL final
+#else
+#define PAL_FINAL
+#endif
+
 #endif
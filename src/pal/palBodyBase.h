@@ -9,6 +9,7 @@
 		Adrian Boeing
 	\version
 	<pre>
+		Version 0.2.13: 19/10/26 - Static instance set type
 		Version 0.2.12: 01/10/08 - Optional indices for convex
 		Version 0.2.11: 26/09/08 - Merged body type enum
 		Version 0.2.1 : 26/05/08 - Collision groups
@@ -51,6 +52,7 @@ typedef enum {
 	PAL_STATIC_CAPSULE = 103, //!< Capsule body type
 	PAL_STATIC_CONVEX = 104, //!< Convex body type
 	PAL_STATIC_COMPOUND = 105, //!< Compound body type
+	PAL_STATIC_INSTANCE_SET = 106, //!< Static instance set type
 	PAL_TERRAIN_NONE = 0, //!< Undefined terrain type
 	PAL_TERRAIN_PLANE = 201, //!< Planar (flat) terrain type
 	PAL_TERRAIN_HEIGHTMAP = 202, //!< Heightmap terrain type
@@ -0,0 +1,127 @@
+#ifndef PALCOMMANDBUFFER_H
+#define PALCOMMANDBUFFER_H
+/*! \file palCommandBuffer.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Deferred, thread safe object creation and destruction
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "pal.h"
+#include "palBodyBase.h"
+#include <functional>
+#include <mutex>
+
+/** Records object creation, destruction and pose changes from any thread.
+	PAL objects may only be created, initialised and deleted on the thread that steps the physics.
+	A command buffer lets other threads (eg: game logic, or streaming) queue those changes instead.
+	The queued commands are applied in the order they were recorded, either by an explicit call to Apply,
+	or by palPhysics::Update (before the actions are called and the world is stepped) when the buffer has been set with palPhysics::SetCommandBuffer.
+
+	The whole set of commands is applied as one batch, so engines that support it can insert all the new bodies into the broadphase at once.
+
+	Every create returns a handle straight away. The object it refers to exists once the commands have been applied,
+	until then (and after it is destroyed) Get returns NULL.
+	Example:
+	<pre>
+		//on the physics thread
+		pp->SetCommandBuffer(&commands);
+		//on any thread
+		palCommandBuffer::Handle h = commands.CreateBox(x, y, z, 1, 1, 1, 1);
+		...
+		//after the next pp->Update(dt)
+		palBox *box = commands.Get<palBox>(h);
+	</pre>
+*/
+class palCommandBuffer {
+public:
+	typedef unsigned int Handle;
+	/// A handle that never refers to an object
+	static const Handle INVALID_HANDLE = ~0u;
+	/// Initialises a newly created object, called on the physics thread.
+	typedef std::function<void (palFactoryObject *)> InitFunction;
+
+	palCommandBuffer();
+	~palCommandBuffer();
+
+	/** Queues the creation of an object.
+	\param className The factory class name of the object (eg: "palBox")
+	\param init Called to initialise the object after it is created
+	\return The handle of the new object
+	*/
+	Handle Create(const PAL_STRING& className, const InitFunction& init);
+	/// Queues the creation of a palBox, see palBox::Init
+	Handle CreateBox(Float x, Float y, Float z, Float width, Float height, Float depth, Float mass);
+	/// Queues the creation of a palSphere, see palSphere::Init
+	Handle CreateSphere(Float x, Float y, Float z, Float radius, Float mass);
+	/// Queues the creation of a palCapsule, see palCapsule::Init
+	Handle CreateCapsule(Float x, Float y, Float z, Float radius, Float length, Float mass);
+	/// Queues the creation of a palStaticBox, see palStaticBox::Init
+	Handle CreateStaticBox(const palMatrix4x4& pos, Float width, Float height, Float depth);
+	/// Queues the creation of a palStaticSphere, see palStaticSphere::Init
+	Handle CreateStaticSphere(const palMatrix4x4& pos, Float radius);
+
+	/// Queues the destruction of an object created by this buffer
+	void Destroy(Handle handle);
+	/// Queues the destruction of any object, the handle of an object created by this buffer no longer refers to it once it is applied
+	void Destroy(palFactoryObject *object);
+
+	/// Queues a change of location for a body created by this buffer
+	void SetPosition(Handle handle, const palMatrix4x4& location);
+	/// Queues a change of location for any body
+	void SetPosition(palBodyBase *body, const palMatrix4x4& location);
+
+	/** Applies all the commands queued so far.
+	This must be called on the thread that steps the physics, palPhysics::Update does this for the buffer it was given.
+	Commands recorded while this runs are left for the next call.
+	\param physics The physics the objects are created in
+	*/
+	void Apply(palPhysics *physics);
+
+	/// \return The object, or NULL if it has not been created yet, could not be created, or was destroyed
+	palFactoryObject *Get(Handle handle) const;
+	template <typename T> T *Get(Handle handle) const {
+		return dynamic_cast<T *>(Get(handle));
+	}
+
+	/// \return The number of commands waiting to be applied
+	unsigned int GetNumPending() const;
+private:
+	palCommandBuffer(const palCommandBuffer&);
+	palCommandBuffer& operator=(const palCommandBuffer&);
+
+	enum CommandType {
+		CMD_CREATE,
+		CMD_DESTROY,
+		CMD_SET_POSITION
+	};
+	struct Command {
+		CommandType m_Type;
+		Handle m_Handle; //!< INVALID_HANDLE if the command is for m_pObject
+		palFactoryObject *m_pObject;
+		PAL_STRING m_ClassName;
+		InitFunction m_Init;
+		palMatrix4x4 m_mLocation;
+	};
+	struct Slot {
+		palFactoryObject *m_pObject;
+		unsigned int m_nGeneration;
+	};
+
+	Handle AllocateHandle();
+	void FreeHandle(Handle handle);
+	palFactoryObject *Lookup(Handle handle) const; //!< mutex must be held
+
+	mutable std::mutex m_Mutex;
+	PAL_VECTOR<Command> m_Commands;
+	PAL_VECTOR<Command> m_Applying; //!< swapped with m_Commands by Apply, so recording is never blocked for long
+	PAL_VECTOR<Slot> m_Slots;
+	PAL_VECTOR<unsigned int> m_FreeSlots;
+	PAL_MAP<palFactoryObject *, unsigned int> m_SlotIndex; //!< the slot of each object created by this buffer
+};
+
+#endif
@@ -15,6 +15,9 @@
 	\version
 	<pre>
 	Revision History:
+		Version 0.2.17: 19/10/26 - Engine classes created directly (static single engine build)
+		Version 0.2.16: 19/10/26 - Object handles, objects are kept in per-type arenas
+		Version 0.2.15: 19/10/26 - Plugin manifest, engines are loaded on demand
 		Version 0.2.14: 29/10/08 - Cleanup bugfix
 		Version 0.2.13: 10/10/08 - Cleanup update to remove constraints first
 		Version 0.2.12: 30/09/08 - PAL API Versioning
@@ -62,6 +65,7 @@ class palFactory : private myFactory {
 	This function must be called before any objects are created.
 
 	If the call was succesfull then subsequent create calls should succeed, else, they will return null.
+	If the engine was found in a plugin manifest (see LoadPALfromDLL) its library is loaded now.
 
 	\param name The name of the physics engine to be used
 	\return whether the requested engine was able to be selected
@@ -70,9 +74,30 @@ class palFactory : private myFactory {
 
 		/**
 	Removes all the objects created - regardless of which engine they were constructed with.
+	The objects are deleted one by one, each freeing its engine side, walking them in memory order.
+	Only the arena slabs they were allocated from are handed back a whole slab at a time afterwards.
 		 */
 		void Cleanup();
 
+		/** Gets a handle to an object created by the factory, to keep in place of a pointer to it.
+	A handle is 32 bits, and never resolves to another object: once the object is deleted (or Cleanup is called)
+	Resolve returns NULL for it, even if a new object takes the same memory.
+	\return The handle, 0 if the object was not created by the factory
+		 */
+		palHandle GetHandle(const palFactoryObject *obj) const;
+		/** Gets the object a handle refers to.
+	\return The object, NULL if it has been deleted
+		 */
+		palFactoryObject *Resolve(palHandle handle) const;
+		/// Resolves a handle and casts the object, NULL if it has been deleted or is not a T
+		template<typename T>
+		T* Resolve(palHandle handle) const
+		{
+			return dynamic_cast<T*>(Resolve(handle));
+		}
+		/// \return The number of objects created by the factory that are not deleted yet
+		size_t GetObjectCount() const;
+
 		/** Creates the physics class.
 	This should be created and initialized before any other objects are created for the current physics engine
 	\return A newly constructed physics class, specified by the select method
@@ -123,6 +148,10 @@ class palFactory : private myFactory {
 		palGenericBody *CreateGenericBody(palMatrix4x4& pos);
 
 		palStaticConvex *CreateStaticConvex();
+		/** Creates a static instance set.
+	\return A newly constructed static instance set, specified by the select method
+		 */
+		palStaticInstanceSet *CreateStaticInstanceSet();
 
 		/** Creates a box geometry.  This can be added to a compound or generic body
 	 \return A new constructed box geometry
@@ -336,10 +365,44 @@ class palFactory : private myFactory {
 			return result;
 		}
 
+		/** Creates an object of an engine class directly, without the name lookup and casts of CreateObject.
+	The engine class must be linked in, so this is meant for the static single engine build (see palStaticEngine.h).
+	The object is managed like any other object created by the factory.
+	\return A newly constructed T (eg: palODEGenericBody)
+		 */
+		template<typename T>
+		T* CreateEngineObject()
+		{
+			static ObjectArena *arena = ObjectArena::Get(T::GetFactoryName(), sizeof(T));
+			T* result = new (arena) T;
+			Add(result);
+			Adopt(result);
+			return result;
+		}
+		/** Creates the physics class of an engine directly, see CreatePhysics and CreateEngineObject.
+	\return A newly constructed T (eg: palODEPhysics)
+		 */
+		template<typename T>
+		T* CreateEnginePhysics()
+		{
+			m_active = 0;
+			T* result = CreateEngineObject<T>();
+			result->SetFactoryInstance(this);
+			m_active = result;
+			return result;
+		}
+
 		palPhysics *GetActivePhysics();
 		void SetActivePhysics(palPhysics *physics);
+		/** Makes the physics engine libraries in a directory available.
+	If the directory contains a plugin manifest (PAL_PLUGIN_MANIFEST, written by the build, one "EngineName libraryfile" per line)
+	the libraries are only recorded and each one is loaded by the first SelectEngine call for its engine.
+	Otherwise every library in the directory is loaded immediately.
+		 */
 		void LoadPALfromDLL(const char *szPath = NULL) throw(palException);
 
+		static const char* PAL_PLUGIN_MANIFEST;
+
 		static const char* PAL_PLUGIN_PATH;
 		/**
 		 * Loads available physics engine libraries from specified directory. If no directory is given, the environment variable PAL_PLUGIN_PATH is used.
@@ -347,12 +410,18 @@ class palFactory : private myFactory {
 		 */
 		void LoadPhysicsEngines(const char* dirName = NULL);
 
+		/**
+		 * Unloads the libraries of all the physics engines except the selected one.
+		 * Call Cleanup first if objects were created with any other engine. Unloaded engines that are listed in a manifest are loaded again if selected.
+		 */
+		void UnloadUnusedEngines();
+
 		void DumpObjects(const PAL_STRING& separator = "\n");
 		void DumpObjects(std::ostream& out, const PAL_STRING& separator = "\n");
-	protected:
-		typedef MemoryObjectManager<StatusObject>::MMOType MMOType;
 	private:
+		void Adopt(palFactoryObject *p); //parents a new object and notifies the active physics
 		palPhysics *m_active;
+		PAL_MAP<PAL_STRING, PAL_STRING> m_PluginFiles; //engine name -> library file, from the plugin manifests
 	public:
 		static palFactory *GetInstance();
 		static void SetInstance(palFactory *pf);
@@ -10,6 +10,7 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 0.22: 19/10/26 SSE2/AVX2 backend, batched transform kernels, quaternion to matrix
 		Version 0.21: 10/07/08 vec_q_mul
 		Version 0.2 : 23/10/07 palQuaternion
 		Version 0.19: 22/06/07 Transpose
@@ -45,6 +46,25 @@
 	typedef float Float;
 #endif
 
+/*
+	SIMD backend selection.
+	The vectorised kernels are chosen at compile time from the instruction sets the
+	compiler targets (-msse2 is implied on x86-64, -mavx2 -mfma enables the AVX2 path).
+	Define PAL_MATH_NO_SIMD to force the scalar reference implementation everywhere.
+*/
+#if !defined(PAL_MATH_NO_SIMD)
+#if defined(__AVX2__)
+#define PAL_MATH_AVX2
+#define PAL_MATH_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PAL_MATH_SSE2
+#endif
+#endif
+
+#if defined(PAL_MATH_SSE2)
+#define PAL_MATH_SIMD
+#endif
+
 #define PAL_MAX_FLOAT std::numeric_limits<Float>::max()
 #define PAL_FLOAT_EPSILON std::numeric_limits<Float>::epsilon()
 
@@ -72,7 +92,7 @@ Real Max(Real a, Real b)
  */
 inline bool Equivalent(Float float1, Float float2, Float baseEpsilon = PAL_FLOAT_EPSILON)
 {
-   return (std::abs(float1 - float2) <= baseEpsilon * Max(1.0f, Max(float1, float2)));
+   return (std::abs(float1 - float2) <= baseEpsilon * Max(Float(1.0), Max(float1, float2)));
 }
 
 struct palVector3 {
@@ -310,6 +330,37 @@ extern void mat_multiply( palMatrix4x4 *m, const palMatrix4x4 *a, const palMatri
 extern void mat_rotate( palMatrix4x4 *m, Float angle, Float x, Float y, Float z);
 extern void mat_translate( palMatrix4x4 *m, Float x, Float y, Float z);
 extern bool mat_invert( palMatrix4x4 *dest, const palMatrix4x4 *src );
+
+/**
+ * Sets the upper-left 3x3 rotation of m from the unit quaternion q.
+ * The translation column and the last row are left untouched, as with mat_set_rotation.
+ */
+extern void mat_set_quaternion(palMatrix4x4 *m, const palQuaternion *q);
+
+/**
+ * Batched kernels. These operate on n contiguous elements and use the SIMD backend when it is
+ * compiled in. Output arrays must not overlap the input arrays.
+ */
+/// m[i] = a[i] * b[i]
+extern void mat_multiply_n(palMatrix4x4 *m, const palMatrix4x4 *a, const palMatrix4x4 *b, unsigned int n);
+/// v[i] = a(1:3,1:3) * b[i], see vec_mat_mul
+extern void vec_mat_mul_n(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b, unsigned int n);
+/// v[i] = basis(a) * b[i] + origin(a), see vec_mat_transform
+extern void vec_mat_transform_n(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b, unsigned int n);
+/// mat_set_quaternion(&m[i], &q[i]) for n poses. Always scalar, a SIMD version did not pay for its transposes.
+extern void mat_set_quaternion_n(palMatrix4x4 *m, const palQuaternion *q, unsigned int n);
+
+/**
+ * Scalar reference implementations. These are always compiled, whatever the SIMD backend,
+ * and are what the vectorised versions are checked against.
+ */
+extern void mat_multiply_scalar( palMatrix4x4 *m, const palMatrix4x4 *a, const palMatrix4x4 *b );
+extern void vec_mat_mul_scalar(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b);
+extern void vec_mat_transform_scalar(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b);
+extern void mat_set_quaternion_scalar(palMatrix4x4 *m, const palQuaternion *q);
+
+/// @return the name of the compiled math backend, i.e. "scalar", "SSE2" or "AVX2"
+extern const char* pal_math_backend();
 //based from bullet:
 extern void q_set(palQuaternion *q, Float x, Float y, Float z, Float w);
 extern void vec_q_mul(palQuaternion *q, const palVector3 *a, const palQuaternion *b);
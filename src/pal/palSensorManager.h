@@ -0,0 +1,112 @@
+#ifndef PALSENSORMANAGER_H
+#define PALSENSORMANAGER_H
+/*! \file palSensorManager.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Batched sensor updates
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palSensors.h"
+
+/** Updates many sensors at once.
+	Normally every sensor query is answered on demand, so each PSD reading is a separate raycast and each
+	inclinometer or compass reading fetches the body location again.
+	Sensors added to a manager are instead all updated by one call to Update() after the physics step:
+	the location of every body is read once, the rays of all PSD sensors are cast as one batch per physics engine
+	(see palCollisionDetection::RayCastBatch), and the readings are stored in the sensors.
+	While a sensor is managed its Get* function simply returns the stored reading.
+
+	Supports palPSDSensor, palCompassSensor, palInclinometerSensor, palGyroscopeSensor and palVelocimeterSensor.
+	Example:
+	<pre>
+		palSensorManager sensors;
+		sensors.Add(psd);
+		sensors.Add(inclinometer);
+		...
+		pp->Update(dt);
+		sensors.Update();
+		Float d = psd->GetDistance(); // reading from this step
+	</pre>
+	A sensor must be removed before it, or the body it is attached to, is deleted.
+*/
+class palSensorManager {
+public:
+	palSensorManager();
+	~palSensorManager();
+
+	/** Adds a sensor to be updated by this manager.
+	\return false if the sensor type is not supported or the sensor already has a manager
+	*/
+	bool Add(palSensor *sensor);
+	/** Removes a sensor, it goes back to answering queries on demand.
+	*/
+	void Remove(palSensor *sensor);
+	/** Removes all the sensors.
+	*/
+	void Clear();
+
+	/** Updates the reading of every sensor. Call this once after each palPhysics::Update.
+	*/
+	void Update();
+
+	/** Sets the number of threads used to calculate the readings.
+	Body locations are read and rays are cast on the calling thread, only the per sensor maths is split up.
+	\param threads The number of threads, 1 (the default) does everything on the calling thread.
+	*/
+	void SetNumThreads(unsigned threads);
+
+	/// \return The number of sensors updated by this manager
+	unsigned GetNumSensors() const;
+private:
+	palSensorManager(const palSensorManager&);
+	palSensorManager& operator=(const palSensorManager&);
+
+	struct BodyState {
+		palBody *m_pBody;
+		palMatrix4x4 m_mLocation;
+		palVector3 m_vLinearVelocity;
+		palVector3 m_vAngularVelocity;
+		unsigned m_nSensors; //!< number of sensors attached to this body
+		unsigned m_nVelocitySensors; //!< number of those that need the velocities
+	};
+
+	template <typename T>
+	struct Entry {
+		T *m_pSensor;
+		unsigned m_nBody;
+		unsigned m_nRayBatch; //!< PSD sensors only, UINT_MAX if the engine has no collision detection
+	};
+
+	/// The PSD rays of one physics engine
+	struct RayBatch {
+		const palCollisionDetection *m_pCollision;
+		PAL_VECTOR<palRay> m_Rays;
+		PAL_VECTOR<palRayHit> m_Hits;
+		PAL_VECTOR<palPSDSensor *> m_Sensors;
+	};
+
+	unsigned AddBody(palBody *body, bool velocity);
+	void RemoveBody(unsigned index, bool velocity);
+	template <typename T> bool RemoveEntry(PAL_VECTOR<Entry<T> >& entries, palSensor *sensor, bool velocity);
+	template <typename Functor> void ParallelFor(unsigned count, Functor f);
+
+	PAL_VECTOR<BodyState> m_Bodies;
+	PAL_VECTOR<unsigned> m_FreeBodies;
+	PAL_MAP<palBody *, unsigned> m_BodyIndex;
+
+	PAL_VECTOR<Entry<palPSDSensor> > m_PSDSensors;
+	PAL_VECTOR<Entry<palCompassSensor> > m_CompassSensors;
+	PAL_VECTOR<Entry<palInclinometerSensor> > m_InclinometerSensors;
+	PAL_VECTOR<Entry<palGyroscopeSensor> > m_GyroscopeSensors;
+	PAL_VECTOR<Entry<palVelocimeterSensor> > m_VelocimeterSensors;
+
+	PAL_VECTOR<RayBatch> m_RayBatches;
+	unsigned m_nThreads;
+};
+
+#endif
@@ -11,6 +11,7 @@
 	\version
 	<pre>
 	Revision History:
+		Version 0.5   : 19/10/26 - Sensor manager support, cached readings
 		Version 0.4.2 : 10/10/06 - Added transponder
 		Version 0.4.1 : 08/10/06 - Fixed compass bug, redefined compass inputs
 		Version 0.4	  : 19/09/06 - Revisision from lost verion, added GPS and Compass
@@ -25,6 +26,7 @@
 */
 
 #include "pal.h"
+#include "palCollision.h"
 
 /** The type of sensor
 */
@@ -47,12 +49,20 @@ typedef enum {
 	Every sensor is attached to a body.
 	All coordinates are specified in world space, unless otherwise indicated.
 */
+class palSensorManager;
+
 class palSensor : public palFactoryObject {
+	friend class palSensorManager;
 public:
 	palSensor()
-	: m_pBody(0), m_Type(PAL_SENSOR_NONE) {}
+	: m_pBody(0), m_Type(PAL_SENSOR_NONE), m_pManager(0), m_fReading(0) {}
+	/// \return the palSensorManager updating this sensor, or NULL if it is queried on demand
+	palSensorManager* GetManager() const { return m_pManager; }
 	palBody *m_pBody;
 	palSensorType m_Type;
+protected:
+	palSensorManager* m_pManager;
+	Float m_fReading; //!< the reading from the last palSensorManager::Update
 };
 
 //this doesnt need to be virtual, but you never know right?
@@ -85,6 +95,13 @@ public:
 	\return The distance to the closest object
 	*/
 	virtual Float GetDistance() const = 0;
+	/** Calculates the ray the sensor casts for a given body location.
+	Used by palSensorManager to cast the rays of many sensors in one batch.
+	\param bodyLocation The location matrix of the body the sensor is attached to
+	\param ray The world space ray
+	\return false if the engine updates the sensor itself, in which case GetDistance is used
+	*/
+	virtual bool GetWorldRay(const palMatrix4x4& /*bodyLocation*/, palRay& /*ray*/) const { return false; }
 	Float m_fPosX;
 	Float m_fPosY;
 	Float m_fPosZ;
@@ -114,6 +131,8 @@ public:
 	\return The angle (radians)
 	*/
 	virtual Float GetAngle() const;
+	/// Calculates the angle for the given body location
+	Float CalculateAngle(const palMatrix4x4& bodyLocation) const;
 
 	palVector3 m_fNorth;
 	FACTORY_CLASS(palCompassSensor,palCompassSensor,*,1);
@@ -154,6 +173,8 @@ public:
 		return 0;
 	}*/
 	virtual Float GetAngle() const;
+	/// Calculates the angle for the given body location
+	Float CalculateAngle(const palMatrix4x4& bodyLocation) const;
 
 	palVector3 m_fAxis;
 	palVector3 m_fUp;
@@ -179,6 +200,8 @@ public:
 	\return The angular velcoity (radians)
 	*/
 	virtual Float GetAngle() const;
+	/// Calculates the angular velocity about the sensor axis for the given body angular velocity
+	Float CalculateAngle(const palVector3& angularVelocity) const;
 	Float m_fAxisX;
 	Float m_fAxisY;
 	Float m_fAxisZ;
@@ -203,6 +226,8 @@ public:
 	\return The linear velocity
 	*/
 	virtual Float GetVelocity() const;
+	/// Calculates the velocity for the given body location and linear velocity
+	Float CalculateVelocity(const palMatrix4x4& bodyLocation, const palVector3& linearVelocity) const;
 	Float m_fAxisX;
 	Float m_fAxisY;
 	Float m_fAxisZ;
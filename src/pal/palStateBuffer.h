@@ -0,0 +1,79 @@
+#ifndef PALSTATEBUFFER_H
+#define PALSTATEBUFFER_H
+/*! \file palStateBuffer.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		World state snapshots
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palBase.h"
+#include <string.h>
+
+/** Holds a snapshot of a physics world, written by palPhysics::SaveState and read by palPhysics::RestoreState.
+	The contents are raw engine data in the byte order of the machine: a snapshot can only be restored into
+	the world that saved it, and only while that world still holds the same bodies, geometries and links.
+	It is not a file format, nor a way to send a world over the network.
+
+	Keep a buffer around and reuse it: Clear keeps the memory, so saving every frame does not allocate.
+	Example:
+	<pre>
+		palStateBuffer state;
+		pp->SaveState(state);
+		//simulate ahead
+		for (int i = 0; i < 10; i++)
+			pp->Update(dt);
+		//and go back
+		pp->RestoreState(state);
+	</pre>
+*/
+class palStateBuffer {
+public:
+	palStateBuffer();
+
+	/// Empties the buffer, keeping its memory
+	void Clear();
+	/// Reserves memory for a snapshot of the given size
+	void Reserve(size_t bytes);
+	size_t GetSize() const;
+	/// \return The contents, NULL if the buffer is empty
+	const void *GetData() const;
+	/// Replaces the contents with a copy of the data, eg: a snapshot kept elsewhere
+	void SetData(const void *data, size_t bytes);
+
+	/// Appends bytes to the buffer
+	void Write(const void *data, size_t bytes);
+	/** Appends room for the given number of bytes, for engines to write their state into directly.
+	\return The start of the room, valid until the next write
+	*/
+	void *Append(size_t bytes);
+	template <typename T> void Write(const T& value) {
+		Write(&value, sizeof(T));
+	}
+
+	/// Moves the read position back to the start
+	void Rewind() const;
+	/** Reads bytes from the read position.
+	\return false, reading nothing, if there are not enough bytes left
+	*/
+	bool Read(void *data, size_t bytes) const;
+	/** Reads bytes in place.
+	\return The bytes at the read position, NULL if there are not enough left
+	*/
+	const void *Take(size_t bytes) const;
+	template <typename T> bool Read(T& value) const {
+		return Read(&value, sizeof(T));
+	}
+	/// \return The number of bytes left to read
+	size_t GetRemaining() const;
+private:
+	PAL_VECTOR<unsigned char> m_Data;
+	size_t m_nSize;
+	mutable size_t m_nRead;
+};
+
+#endif
@@ -9,6 +9,7 @@
 		Adrian Boeing
 	\version
 	<pre>
+		Version 0.1.3 : 19/10/26 - Static instance set
 		Version 0.1.22: 26/09/08 - Merged body type enum
 		Version 0.1.21: 17/01/08 - Documentation
 		Version 0.1.2 : 12/01/08 - Static compound
@@ -165,6 +166,107 @@ protected:
 	FACTORY_CLASS(palStaticCompoundBody,palStaticCompoundBody,*,1);
 };
 
+/** A single instance of a palStaticInstanceSet.
+*/
+struct palStaticInstance {
+	palGeometryType m_Type; //!< PAL_GEOM_BOX, PAL_GEOM_SPHERE, PAL_GEOM_CAPSULE or PAL_GEOM_CONVEX
+	palMatrix4x4 m_mLoc; //!< The position and orientation of the instance
+	Float m_fDimensions[3]; //!< box: width, height, depth. sphere: radius. capsule: radius, length
+	int m_nShape; //!< convex: the convex shape, see palStaticInstanceSet::AddConvexShape
+	palMaterial *m_pMaterial; //!< The material of the instance, or NULL to use the material of the set
+	void *m_pUserData; //!< The user data of the instance
+};
+
+/** A set of static objects that never move.
+	Level props (eg: fences, rocks, crates) are usually far too many to create as individual static bodies,
+	each of which would be a separate object in the engines broadphase.
+	A static instance set holds many (shape, transform) pairs as a single body, which the engine builds into one
+	collision structure when the set is finalized.
+
+	Each instance keeps its own material and user data. Contact points involving the set report the instance in
+	palContactPoint::m_nInstance1 / m_nInstance2, which can be passed to GetInstanceMaterial and GetInstanceUserData.
+
+	Instances are specified in world coordinates. Convex shapes are added once and may then be shared by many instances.
+	Example:
+	<pre>
+		palStaticInstanceSet *props = PF->CreateStaticInstanceSet();
+		int rock = props->AddConvexShape(pVertices, nVertices);
+		for (...) {
+			props->AddBox(crateLocation, 1, 1, 1, pWood);
+			props->AddConvex(rockLocation, rock, pStone, pRockData);
+		}
+		props->Finalize();
+	</pre>
+*/
+class palStaticInstanceSet : virtual public palStatic {
+public:
+	palStaticInstanceSet();
+
+	/** Adds a box instance.
+	\param pos The transformation matrix representing the position and orientation of the box
+	\param width The width of the box
+	\param height The height of the box
+	\param depth The depth of the box
+	\param material The material of the instance, or NULL to use the material of the set
+	\param userData The user data of the instance
+	\return The index of the instance, or -1 if the set has already been finalized
+	*/
+	int AddBox(const palMatrix4x4& pos, Float width, Float height, Float depth, palMaterial *material = NULL, void *userData = NULL);
+	/** Adds a sphere instance.
+	\return The index of the instance, or -1 if the set has already been finalized
+	*/
+	int AddSphere(const palMatrix4x4& pos, Float radius, palMaterial *material = NULL, void *userData = NULL);
+	/** Adds a capped cylinder instance. As for palCapsuleGeometry, the length is specified along the up axis of the physics.
+	\return The index of the instance, or -1 if the set has already been finalized
+	*/
+	int AddCapsule(const palMatrix4x4& pos, Float radius, Float length, palMaterial *material = NULL, void *userData = NULL);
+	/** Adds a convex shape that can be used by any number of convex instances.
+	\param pVertices The vertices describing the shape
+	\param nVertices The number of vertices (ie: the total number of Floats / 3)
+	\param pIndices The triangles of the convex hull, optional
+	\param nIndices The number of indices
+	\return The index of the shape, or -1 if the set has already been finalized
+	*/
+	int AddConvexShape(const Float *pVertices, int nVertices, const int *pIndices = NULL, int nIndices = 0);
+	/** Adds a convex instance.
+	\param pos The transformation matrix representing the position and orientation of the instance
+	\param shape The convex shape, returned by AddConvexShape
+	\return The index of the instance, or -1 if the set has already been finalized or the shape is not valid
+	*/
+	int AddConvex(const palMatrix4x4& pos, int shape, palMaterial *material = NULL, void *userData = NULL);
+
+	/**
+	Finalizes the construction of the set.
+	This function must be called after all the instances have been added, no instances can be added afterwards.
+	*/
+	virtual void Finalize();
+
+	/** \return The number of instances in the set */
+	unsigned int GetNumInstances() const;
+	const palStaticInstance& GetInstance(unsigned int instance) const;
+	/** \return The dimensions of a box instance along the x, y and z axes, taking the up axis into account as palBoxGeometry::GetXYZDimensions does */
+	palVector3 GetBoxXYZDimensions(unsigned int instance) const;
+	/** \return The number of convex shapes in the set */
+	unsigned int GetNumConvexShapes() const;
+	/** Retrieves a convex shape added with AddConvexShape. The index vector is empty if no indices were given. */
+	void GetConvexShape(int shape, const PAL_VECTOR<Float> *&vertices, const PAL_VECTOR<int> *&indices) const;
+
+	/** \return The material of the instance, or the material of the set if the instance has none, or if instance is -1 */
+	palMaterial *GetInstanceMaterial(int instance);
+	/** \return The user data of the instance, or the user data of the set if instance is -1 */
+	void *GetInstanceUserData(int instance) const;
+
+	virtual const palMatrix4x4& GetLocationMatrix() const;
+protected:
+	int GetUpAxis() const; //!< the up axis of the physics the set belongs to
+	int AddInstance(palGeometryType type, const palMatrix4x4& pos, palMaterial *material, void *userData);
+
+	bool m_bFinalized;
+	PAL_VECTOR<palStaticInstance> m_Instances;
+	PAL_VECTOR<PAL_VECTOR<Float> > m_ConvexVertices;
+	PAL_VECTOR<PAL_VECTOR<int> > m_ConvexIndices;
+};
+
 #endif
 
 
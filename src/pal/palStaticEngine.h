@@ -0,0 +1,73 @@
+#ifndef PALSTATICENGINE_H
+#define PALSTATICENGINE_H
+/*! \file palStaticEngine.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Concrete engine types for the static single engine build
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palFactory.h"
+
+/*
+	When PAL is linked statically with one engine (CMake: PAL_STATIC and PAL_STATIC_ENGINE=ODE or Bullet, which define
+	PAL_STATIC_ENGINE and PAL_STATIC_ENGINE_ODE or PAL_STATIC_ENGINE_BULLET) the engine classes are known at compile time.
+	This header names them as palEngine* types, and the engine leaf classes and the engine overrides of the hot body
+	methods are declared final (PAL_FINAL), so calls made through these types (GetLocationMatrix, ApplyForce,
+	GetLinearVelocity...) are direct calls instead of virtual calls through the virtual bases, and can be inlined.
+	The palEngine* types are still PAL objects: they can be passed to anything taking the PAL interfaces.
+
+	Objects are created as the concrete types with palFactory::CreateEngineObject, which skips the name lookup and the
+	dynamic_cast of the Create* methods.
+	Example:
+	<pre>
+		PF->SelectEngine(PAL_STATIC_ENGINE_NAME);
+		palEnginePhysics *pp = PF->CreateEnginePhysics<palEnginePhysics>();
+		pp->Init(desc);
+		palEngineGenericBody *pb = PF->CreateEngineObject<palEngineGenericBody>();
+		palEngineBoxGeometry *pg = PF->CreateEngineObject<palEngineBoxGeometry>();
+		...
+		pb->ApplyForce(0, 10, 0); //direct call
+	</pre>
+	Code that has to build with any engine keeps using the PAL interfaces and PF->Create*.
+*/
+
+#if defined(PAL_STATIC_ENGINE_ODE)
+#include "pal_i/ode/ode_pal.h"
+
+/// The name of the engine to select
+#define PAL_STATIC_ENGINE_NAME "ODE"
+typedef palODEPhysics palEnginePhysics;
+typedef palODEBody palEngineBody;
+typedef palODEGenericBody palEngineGenericBody;
+typedef palODEGeometry palEngineGeometry;
+typedef palODEBoxGeometry palEngineBoxGeometry;
+typedef palODESphereGeometry palEngineSphereGeometry;
+typedef palODECapsuleGeometry palEngineCapsuleGeometry;
+typedef palODEConvexGeometry palEngineConvexGeometry;
+typedef palODETerrainPlane palEngineTerrainPlane;
+
+#elif defined(PAL_STATIC_ENGINE_BULLET)
+#include "pal_i/bullet/bullet_pal.h"
+
+/// The name of the engine to select
+#define PAL_STATIC_ENGINE_NAME "Bullet"
+typedef palBulletPhysics palEnginePhysics;
+typedef palBulletBody palEngineBody;
+typedef palBulletGenericBody palEngineGenericBody;
+typedef palBulletGeometry palEngineGeometry;
+typedef palBulletBoxGeometry palEngineBoxGeometry;
+typedef palBulletSphereGeometry palEngineSphereGeometry;
+typedef palBulletCapsuleGeometry palEngineCapsuleGeometry;
+typedef palBulletConvexGeometry palEngineConvexGeometry;
+typedef palBulletTerrainPlane palEngineTerrainPlane;
+
+#elif defined(PAL_STATIC_ENGINE)
+#error PAL_STATIC_ENGINE is defined without the engine (PAL_STATIC_ENGINE_ODE or PAL_STATIC_ENGINE_BULLET)
+#endif
+
+#endif
@@ -9,6 +9,7 @@
 		Adrian Boeing
 	\version
 	<pre>
+		Version 0.3.5 : 19/10/26 - Heightmap Prepare, to build the collision data on another thread
 		Version 0.3.4 : 28/02/09 - Added plane init in (a,b,c,d) form
 		Version 0.3.31: 26/09/08 - Merged body type enum
 		Version 0.3.3 : 25/07/07 - Orientated terrain plane
@@ -104,6 +105,14 @@ public:
 	\param pHeightmap A pointer to an array of Float values of size (terrain_data_width*terrain_data_depth) which contains all the heights of the terrain.
 	*/
 	virtual void Init(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
+	/** Builds the collision data of the heightmap ahead of Init, without adding anything to the world,
+	so that it can be done on another thread while the physics steps (see palTerrainStreamer).
+	Init must follow, from the physics thread, with the same parameters; it then only adds the prepared data.
+	Prepare must not be called while anything else uses this object.
+	The parameters are those of Init.
+	\return false if the implementation has nothing to prepare, and does all the work in Init
+	*/
+	virtual bool Prepare(Float x, Float y, Float z, Float width, Float depth, int terrain_data_width, int terrain_data_depth, const Float *pHeightmap);
 	const Float *GetHeightMap() const;
 	Float GetWidth() const;
 	Float GetDepth() const;
@@ -0,0 +1,168 @@
+#ifndef PALTERRAINSTREAMER_H
+#define PALTERRAINSTREAMER_H
+/*! \file palTerrainStreamer.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Heightmap terrain streaming
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palTerrain.h"
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+/** Pages a large heightmap terrain in and out as fixed size square tiles around a set of focus points.
+	Each tile is a palTerrainHeightmap of its own. The heights of a tile are asked from a height source,
+	and its collision data built (palTerrainHeightmap::Prepare), on a background thread;
+	Update, called between steps on the physics thread, then adds the built tiles to the world and removes
+	the ones no longer wanted, so the physics never waits for a tile to be built.
+
+	Tiles are loaded nearest first within the load radius of any focus point, and unloaded once they are
+	beyond the unload radius of all of them. The number of resident tiles, and their memory, may be capped,
+	in which case the farthest tiles give way to nearer ones.
+
+	Engines whose heightmaps have nothing to prepare build the whole tile in Init, on the physics thread.
+	The streamer must be deleted before the physics it adds the tiles to.
+*/
+class palTerrainStreamer {
+public:
+	/** Gives the heights of a tile, called on the background thread.
+	\param tileX, tileZ The tile, (0,0) being the one whose min corner is the origin
+	\param samples The number of heights along each side of the tile
+	\param heights The samples*samples heights to fill in, heights[i + j*samples] being at
+		x = originX + (tileX + i/(samples-1.0))*tileSize, z = originZ + (tileZ + j/(samples-1.0))*tileSize.
+		Neighbouring tiles share the heights along their common edge.
+	\return false if there is no terrain on this tile
+	*/
+	typedef std::function<bool (int tileX, int tileZ, int samples, Float *heights)> HeightSource;
+
+	struct Metrics {
+		unsigned int m_nResidentTiles; //!< tiles in the world
+		unsigned int m_nPendingTiles; //!< tiles waiting for or being built
+		unsigned int m_nReadyTiles; //!< tiles built and waiting to be added
+		size_t m_nResidentBytes; //!< an estimate, see EstimateTileBytes
+		unsigned int m_nLoaded; //!< tiles added so far
+		unsigned int m_nUnloaded; //!< tiles removed so far
+		unsigned int m_nCancelled; //!< tiles no longer wanted before they were added
+		Float m_fLastBuildMs; //!< background time to get the heights of the last tile and prepare it
+		Float m_fMeanBuildMs;
+		Float m_fMaxBuildMs;
+		Float m_fMeanAddMs; //!< physics thread time to add a built tile (Init)
+		Float m_fMaxAddMs;
+		Float m_fMeanLatencyMs; //!< from a tile being wanted to it being added
+		Float m_fMaxLatencyMs;
+	};
+
+	palTerrainStreamer();
+	~palTerrainStreamer();
+
+	/** Sets up the tiles and starts the background thread, unloading any tiles from an earlier Init.
+	The load and unload radii default to 1.5 and 2 tiles.
+	\param tileSize The width and depth of a tile
+	\param samples The number of heights along each side of a tile, at least 2
+	\param source Gives the heights of the tiles
+	\param originX, originZ The min corner of tile (0,0). The heights are the y of the terrain.
+	*/
+	void Init(Float tileSize, int samples, const HeightSource& source, Float originX = 0, Float originZ = 0);
+
+	/** Adds a point to load the terrain around.
+	\return The index of the focus point for SetFocus and RemoveFocus
+	*/
+	int AddFocus(Float x, Float z);
+	void SetFocus(int focus, Float x, Float z);
+	void RemoveFocus(int focus);
+
+	/** Sets the distances from a focus point to the nearest point of a tile within which the tile is loaded,
+	and beyond which it is unloaded. The unload radius should be the larger, so that a focus moving along the
+	edge of a tile does not load and unload it over and over.
+	*/
+	void SetRadius(Float load, Float unload);
+
+	/// Caps the number of tiles resident or being built, 0 (the default) for no cap
+	void SetMaxResidentTiles(unsigned int tiles);
+	/// Caps the estimated memory of the tiles resident or being built, 0 (the default) for no cap
+	void SetMaxResidentBytes(size_t bytes);
+	/// Sets the number of built tiles Update adds at most, to bound the time it takes, 4 by default
+	void SetMaxTilesPerUpdate(unsigned int tiles);
+
+	/** Adds the built tiles, removes the ones no longer wanted and asks for the missing ones.
+	Call it from the physics thread, between steps.
+	*/
+	void Update();
+	/** Calls Update until every wanted tile within the caps is resident, waiting for them to be built.
+	Useful before the first step, so bodies do not start over missing terrain.
+	*/
+	void Flush();
+	/// Unloads all the tiles
+	void Clear();
+
+	/// \return The resident terrain of a tile, NULL if it is not resident (or has no terrain)
+	palTerrainHeightmap *GetTile(int tileX, int tileZ) const;
+	Metrics GetMetrics() const;
+	/// \return An estimate of the memory a tile takes: its heights, and the vertices and indices of its mesh
+	static size_t EstimateTileBytes(int samples);
+private:
+	palTerrainStreamer(const palTerrainStreamer&);
+	palTerrainStreamer& operator=(const palTerrainStreamer&);
+
+	enum TileState {TILE_QUEUED, TILE_BUILDING, TILE_READY, TILE_RESIDENT};
+	struct Tile {
+		int m_nX, m_nZ;
+		TileState m_State; //!< guarded by m_Mutex until ready
+		bool m_bCancelled; //!< no longer wanted, unloaded once it is not being built
+		bool m_bHasTerrain; //!< false if the source had none
+		Float m_fDistance; //!< to the nearest focus point
+		palTerrainHeightmap *m_pTerrain;
+		PAL_VECTOR<Float> m_Heights; //!< kept from the build until Init
+		std::chrono::steady_clock::time_point m_Requested;
+	};
+	typedef std::pair<int, int> TileKey;
+
+	void Worker();
+	void Stop();
+	void ClearTiles();
+	Float Distance(int tileX, int tileZ) const;
+	void AddTile(Tile *tile);
+	void RemoveTile(Tile *tile);
+	bool OverCap(unsigned int extraTiles) const;
+
+	Float m_fTileSize;
+	int m_nSamples;
+	Float m_fOriginX, m_fOriginZ;
+	Float m_fLoadRadius, m_fUnloadRadius;
+	HeightSource m_Source;
+	struct Focus {
+		Float m_fX, m_fZ;
+		bool m_bUsed; //!< false once removed, the slot is reused
+	};
+	PAL_VECTOR<Focus> m_Focus;
+	unsigned int m_nMaxTiles;
+	size_t m_nMaxBytes;
+	unsigned int m_nMaxPerUpdate;
+
+	PAL_MAP<TileKey, Tile *> m_Tiles; //!< every tile wanted, whatever its state
+	PAL_VECTOR<Tile *> m_Queue; //!< waiting for the worker, guarded by m_Mutex
+	PAL_VECTOR<Tile *> m_Built; //!< built by the worker, guarded by m_Mutex
+	PAL_VECTOR<Tile *> m_Ready; //!< taken from m_Built by Update, waiting to be added
+	unsigned int m_nInFlight; //!< tiles asked for and not yet added or cancelled
+	unsigned int m_nBuilding; //!< guarded by m_Mutex
+	unsigned int m_nResident;
+	Metrics m_Metrics;
+	double m_fBuildMsTotal, m_fAddMsTotal, m_fLatencyMsTotal;
+	unsigned int m_nBuilds;
+
+	std::thread m_Thread;
+	mutable std::mutex m_Mutex;
+	std::condition_variable m_Wake; //!< the worker waits on it for work
+	std::condition_variable m_Done; //!< Flush waits on it for a tile to be built
+	bool m_bStop;
+};
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef PALTRANSFORMSNAPSHOTS_H
+#define PALTRANSFORMSNAPSHOTS_H
+/*! \file palTransformSnapshots.h
+	\brief
+		PAL - Physics Abstraction Layer.
+		Body transforms for other threads
+	\version
+	<pre>
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	</pre>
+*/
+
+#include "palBodies.h"
+#include <atomic>
+
+/// The pose and velocity of one body, as published in a palTransformSnapshot
+struct palBodySnapshot {
+	palMatrix4x4 m_mLocation;
+	palVector3 m_vLinearVelocity;
+	palVector3 m_vAngularVelocity;
+	bool m_bUsed; //!< false if no body is in this slot
+};
+
+/** The state of the bodies at the end of one step, indexed by the slot palTransformSnapshots::Add returned for each body.
+	It does not change while it is acquired.
+*/
+class palTransformSnapshot {
+public:
+	/// \return The number of slots, some of which may be unused
+	unsigned GetNumSlots() const { return (unsigned)m_Bodies.size(); }
+	/// \return The state of the body in a slot, check m_bUsed
+	const palBodySnapshot& operator[](unsigned slot) const { return m_Bodies[slot]; }
+	/// \return All the slots, NULL if there are none
+	const palBodySnapshot *GetBodies() const { return m_Bodies.empty() ? NULL : &m_Bodies[0]; }
+	/// \return The simulation time of the step
+	Float GetTime() const { return m_fTime; }
+	/// \return The number of the snapshot, counting from 1, incremented by every publish
+	unsigned GetFrame() const { return m_nFrame; }
+private:
+	friend class palTransformSnapshots;
+	palTransformSnapshot();
+
+	PAL_VECTOR<palBodySnapshot> m_Bodies;
+	Float m_fTime;
+	unsigned m_nFrame;
+	mutable std::atomic<unsigned> m_nReaders;
+};
+
+/** Publishes the pose and velocity of a set of bodies for other threads (eg: a renderer) to read without locks, while the next step runs.
+	Calling palBody::GetLocationMatrix from another thread races with the engine step. Instead, palPhysics::Update publishes
+	a snapshot of every body added to this at the end of each step, when it has been set with palPhysics::SetTransformSnapshots.
+	A reader acquires the latest complete snapshot, which stays unchanged until it is released.
+
+	The snapshots are triple buffered: one is the latest, one is being written by the step, and one is left for a reader still holding an older snapshot.
+	Neither side ever waits. If readers hold all the buffers the step could write to, that step is not published (see GetNumSkipped),
+	so hold a snapshot only as long as it takes to copy out or draw the bodies.
+
+	Add, Remove and Clear have to be called on the thread that steps the physics, Acquire and Release on any thread.
+	Example:
+	<pre>
+		//on the physics thread
+		unsigned slot = snapshots.Add(body);
+		pp->SetTransformSnapshots(&snapshots);
+		pp->Update(dt);
+		//on the render thread
+		const palTransformSnapshot *s = snapshots.Acquire();
+		if (s) {
+			draw((*s)[slot].m_mLocation);
+			snapshots.Release(s);
+		}
+	</pre>
+	A body must be removed before it is deleted.
+*/
+class palTransformSnapshots {
+public:
+	palTransformSnapshots();
+
+	/** Adds a body, which is published from the next step on.
+	\return The slot of the body, which does not change until it is removed. Slots of removed bodies are reused.
+	*/
+	unsigned Add(palBody *body);
+	/// Removes a body, its slot is marked unused from the next step on
+	void Remove(palBody *body);
+	/// Removes all the bodies
+	void Clear();
+	/// \return The slot of a body, UINT_MAX if it has not been added
+	unsigned GetSlot(palBody *body) const;
+
+	/** Writes the state of every body into a free buffer and makes it the latest snapshot.
+	Called by palPhysics::Update after each step.
+	\return false if every other buffer is held by a reader, and nothing was published
+	*/
+	bool Publish(Float time);
+
+	/** Acquires the latest snapshot. Never waits, and may be called by any number of threads at once.
+	\return The snapshot, NULL if nothing has been published yet
+	*/
+	const palTransformSnapshot *Acquire() const;
+	/// Releases a snapshot returned by Acquire
+	void Release(const palTransformSnapshot *snapshot) const;
+
+	/// \return The number of steps that were not published because readers held the buffers
+	unsigned GetNumSkipped() const { return m_nSkipped; }
+private:
+	palTransformSnapshots(const palTransformSnapshots&);
+	palTransformSnapshots& operator=(const palTransformSnapshots&);
+
+	static const int NUM_BUFFERS = 3;
+	palTransformSnapshot m_Buffers[NUM_BUFFERS];
+	std::atomic<int> m_nLatest; //!< the buffer readers acquire, -1 before the first publish
+	unsigned m_nFrame;
+	unsigned m_nSkipped;
+
+	PAL_VECTOR<palBody *> m_Slots;
+	PAL_VECTOR<unsigned> m_FreeSlots;
+	PAL_MAP<palBody *, unsigned> m_SlotIndex;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "pal.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (action scheduler)
+
+	Revision History:
+		Version 0.1.1 : 19/10/26 - Worker threads kept between steps
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+static void CallActionRange(palAction **actions, size_t begin, size_t end, Float timestep) {
+	for (size_t i = begin; i < end; i++) {
+		if (actions[i] != NULL)
+			(*actions[i])(timestep);
+	}
+}
+
+/** The threads the independent actions are split over, the calling thread being the first.
+	They are started once and woken for each batch, spinning for a while before going to sleep
+	so the batches of consecutive substeps do not pay for waking them.
+*/
+class palActionWorkers {
+public:
+	palActionWorkers(unsigned threads)
+	: m_nGeneration(0), m_nActive(0), m_bQuit(false), m_pActions(NULL), m_nCount(0), m_nChunk(0), m_fTimestep(0) {
+		for (unsigned t = 1; t < threads; t++)
+			m_Workers.push_back(std::thread(&palActionWorkers::WorkerMain, this, t));
+	}
+	~palActionWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_bQuit = true;
+			m_nGeneration++;
+		}
+		m_Wake.notify_all();
+		for (size_t t = 0; t < m_Workers.size(); t++)
+			m_Workers[t].join();
+	}
+
+	/// \return The number of threads, including the calling one
+	unsigned GetNumThreads() const {
+		return (unsigned)m_Workers.size() + 1;
+	}
+
+	/// Calls the actions in ranges of chunk, thread t taking range t, and returns when all are done
+	void Run(palAction **actions, size_t count, size_t chunk, Float timestep) {
+		m_pActions = actions;
+		m_nCount = count;
+		m_nChunk = chunk;
+		m_fTimestep = timestep;
+		m_nActive = (unsigned)m_Workers.size();
+		{
+			std::lock_guard<std::mutex> lock(m_WakeMutex);
+			m_nGeneration++;
+		}
+		m_Wake.notify_all();
+		CallRange(0);
+		while (m_nActive > 0)
+			std::this_thread::yield();
+	}
+private:
+	void CallRange(unsigned part) {
+		size_t begin = part * m_nChunk;
+		size_t end = (begin + m_nChunk < m_nCount) ? begin + m_nChunk : m_nCount;
+		CallActionRange(m_pActions, begin, end, m_fTimestep);
+	}
+
+	void WorkerMain(unsigned part) {
+		unsigned seen = 0;
+		for (;;) {
+			// spin first, the next substep usually follows at once
+			for (int spin = 0; spin < 2000 && m_nGeneration == seen; spin++)
+				std::this_thread::yield();
+			if (m_nGeneration == seen) {
+				std::unique_lock<std::mutex> lock(m_WakeMutex);
+				while (m_nGeneration == seen)
+					m_Wake.wait(lock);
+			}
+			seen = m_nGeneration;
+			if (m_bQuit)
+				return;
+			CallRange(part);
+			m_nActive--;
+		}
+	}
+
+	PAL_VECTOR<std::thread> m_Workers;
+	std::mutex m_WakeMutex;
+	std::condition_variable m_Wake;
+	std::atomic<unsigned> m_nGeneration; //!< bumped for each batch, and to quit
+	std::atomic<unsigned> m_nActive; //!< the workers still busy with the batch
+	std::atomic<bool> m_bQuit;
+	// the batch, set before m_nGeneration is bumped
+	palAction **m_pActions;
+	size_t m_nCount;
+	size_t m_nChunk;
+	Float m_fTimestep;
+};
+
+palActionScheduler::palActionScheduler()
+: m_nRemoved(0), m_nThreads(1), m_pWorkers(NULL) {
+}
+
+palActionScheduler::~palActionScheduler() {
+	delete m_pWorkers;
+	Clear();
+}
+
+void palActionScheduler::SetNumThreads(unsigned threads) {
+	threads = (threads > 0) ? threads : 1;
+	if (threads == m_nThreads)
+		return;
+	m_nThreads = threads;
+	delete m_pWorkers;
+	m_pWorkers = NULL;
+}
+
+unsigned palActionScheduler::GetNumThreads() const {
+	return m_nThreads;
+}
+
+unsigned palActionScheduler::GetNumActions() const {
+	return (unsigned)(m_Actions.size() + m_Independent.size()) - m_nRemoved;
+}
+
+void palActionScheduler::Add(palAction *action) {
+	if (action == NULL || action->m_nScheduleIndex >= 0)
+		return;
+	action->m_bScheduleIndependent = action->IsIndependent();
+	PAL_VECTOR<palAction *>& actions = action->m_bScheduleIndependent ? m_Independent : m_Actions;
+	action->m_nScheduleIndex = (int)actions.size();
+	actions.push_back(action);
+}
+
+void palActionScheduler::Remove(palAction *action) {
+	if (action == NULL || action->m_nScheduleIndex < 0)
+		return;
+	PAL_VECTOR<palAction *>& actions = action->m_bScheduleIndependent ? m_Independent : m_Actions;
+	size_t index = (size_t)action->m_nScheduleIndex;
+	if (index < actions.size() && actions[index] == action) {
+		// the slot is dropped by the next Run, so the actions after it keep their order
+		actions[index] = NULL;
+		m_nRemoved++;
+	}
+	action->m_nScheduleIndex = -1;
+}
+
+void palActionScheduler::Clear() {
+	for (size_t i = 0; i < m_Actions.size(); i++) {
+		if (m_Actions[i] != NULL)
+			m_Actions[i]->m_nScheduleIndex = -1;
+	}
+	for (size_t i = 0; i < m_Independent.size(); i++) {
+		if (m_Independent[i] != NULL)
+			m_Independent[i]->m_nScheduleIndex = -1;
+	}
+	m_Actions.clear();
+	m_Independent.clear();
+	m_nRemoved = 0;
+}
+
+void palActionScheduler::Compact(PAL_VECTOR<palAction *>& actions) {
+	size_t count = 0;
+	for (size_t i = 0; i < actions.size(); i++) {
+		if (actions[i] != NULL) {
+			actions[i]->m_nScheduleIndex = (int)count;
+			actions[count++] = actions[i];
+		}
+	}
+	actions.resize(count);
+}
+
+void palActionScheduler::Run(Float timestep) {
+	if (m_nRemoved > 0) {
+		Compact(m_Actions);
+		Compact(m_Independent);
+		m_nRemoved = 0;
+	}
+	// the actions added by these calls wait for the next step
+	size_t count = m_Actions.size();
+	size_t independent = m_Independent.size();
+	for (size_t i = 0; i < count; i++) {
+		palAction *action = m_Actions[i];
+		if (action != NULL)
+			(*action)(timestep);
+	}
+	if (independent == 0)
+		return;
+
+	// not worth waking a thread for less than this many actions
+	const size_t minPerThread = 256;
+	palAction **actions = &m_Independent[0];
+	if (m_nThreads <= 1 || independent < 2 * minPerThread) {
+		CallActionRange(actions, 0, independent, timestep);
+		return;
+	}
+	if (m_pWorkers == NULL)
+		m_pWorkers = new palActionWorkers(m_nThreads);
+	size_t threads = m_pWorkers->GetNumThreads();
+	size_t chunk = (independent + threads - 1) / threads;
+	if (chunk < minPerThread)
+		chunk = minPerThread;
+	m_pWorkers->Run(actions, independent, chunk, timestep);
+}
@@ -11,6 +11,7 @@
 	\version
 	<pre>
 	Revision History:
+		Version 0.27  : 19/10/26 - Actuator action, to apply actuators in every substep
 		Version 0.261 : 28/09/06 - Cleanup
 		Version 0.26  : 04/12/04 - New propeller model, new hydrofoil model, liquid drag class, documentation
 		Version 0.25  : 14/09/04 - Impulse actuator
@@ -57,6 +58,27 @@ protected:
 		: m_Type(actuatorType) {}
 };
 
+/** Applies an actuator as an action, so it acts in every substep the engine takes
+	rather than once per palPhysics::Update.
+	Mark it independent if no other independent action acts on the actuator's body,
+	the independent actions are applied in parallel.
+	\code
+	palActuatorAction *action = new palActuatorAction(spring);
+	physics->AddAction(action);
+	\endcode
+*/
+class palActuatorAction : public palAction {
+public:
+	palActuatorAction(palActuator *actuator, bool independent = false)
+		: m_pActuator(actuator), m_bIndependent(independent) {}
+	virtual void operator()(Float timeStep) { m_pActuator->Apply(timeStep); }
+	virtual bool IsIndependent() const { return m_bIndependent; }
+	palActuator *GetActuator() const { return m_pActuator; }
+protected:
+	palActuator *m_pActuator;
+	bool m_bIndependent;
+};
+
 /** A generic angular or linear actuator.
 	Uses the engine-specific capabilities to achieve a target linear or rotational velocity.
 */
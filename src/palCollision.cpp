@@ -14,6 +14,15 @@
 palCollisionDetection::palCollisionDetection(){
 }
 
+void palCollisionDetection::RayCastBatch(const palRay* rays, palRayHit* hits, unsigned count) const {
+	for (unsigned i = 0; i < count; i++) {
+		const palRay& ray = rays[i];
+		hits[i].Clear();
+		RayCast(ray.m_vOrigin.x, ray.m_vOrigin.y, ray.m_vOrigin.z,
+				ray.m_vDirection.x, ray.m_vDirection.y, ray.m_vDirection.z, ray.m_fRange, hits[i]);
+	}
+}
+
 void palCollisionDetection::GetContacts(palBodyBase *pBody, palContact& contact) const {
 	for (auto i = m_vContacts.begin(), iend = m_vContacts.end(); i != iend; ++i) {
 		const palContactPoint& curContact = *i;
@@ -56,6 +65,8 @@ void palCollisionDetection::ClearContacts()
 palContactPoint::palContactPoint()
 : m_pBody1(NULL)
 , m_pBody2(NULL)
+, m_nInstance1(-1)
+, m_nInstance2(-1)
 , m_fDistance(0.0f) //!< The distance between closest points. Negative distance indicates interpenetrations
 , m_fImpulse(0.0f) //!< The impulse magnitude used to resolve the constraints on the bodies along the normal.
 {
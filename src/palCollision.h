@@ -10,6 +10,8 @@
 	\version
 	<pre>
 	Revision History:
+		Version 0.0.31: 19/10/26 - Static instance in contact points
+		Version 0.0.3: 19/10/26 - Batched raycasts
 		Version 0.0.21:05/09/08 - Doxygen support
 		Version 0.0.2: 05/07/08 - Collision design implementation pass
 		Version 0.0.1: 26/05/08 - Collision planning
@@ -30,6 +32,8 @@ public:
 	palContactPoint();
 	palBodyBase *m_pBody1; //!< A body involved in the collision
 	palBodyBase *m_pBody2; //!< Another body involved in the collision
+	int m_nInstance1; //!< The instance of m_pBody1 involved in the collision, if it is a palStaticInstanceSet, otherwise -1
+	int m_nInstance2; //!< The instance of m_pBody2 involved in the collision, if it is a palStaticInstanceSet, otherwise -1
 	palVector3 m_vContactPosition; //!< The contact position.
 	palVector3 m_vContactNormal; //!< The contact normal
 	Float m_fDistance; //!< The distance between closest points. Negative distance indicates interpenetrations
@@ -81,6 +85,14 @@ public:
 };
 
 
+/** A ray for a batched raycast, see palCollisionDetection::RayCastBatch().
+*/
+struct palRay {
+	palVector3 m_vOrigin; //!< The position of the ray
+	palVector3 m_vDirection; //!< The normalized direction vector of the ray
+	Float m_fRange; //!< The maximum range to test
+};
+
 /** Raycasting callback.
  * This will be called for each ray hit.
  */
@@ -140,6 +152,14 @@ public:
 	*/
 	virtual void RayCast(Float x, Float y, Float z, Float dx, Float dy, Float dz, Float range, palRayHit& hit) const = 0;
 
+	/** Queries the collision system for the closest intersection of many rays at once.
+	Engines that can share the broadphase traversal between rays override this, the default casts each ray in turn.
+	\param rays The rays to cast
+	\param hits The ray hit information, one per ray
+	\param count The number of rays
+	*/
+	virtual void RayCastBatch(const palRay* rays, palRayHit* hits, unsigned count) const;
+
 	/** Enables listening for a collision between two bodies.
 	\param a The first body
 	\param b The second body
@@ -0,0 +1,231 @@
+#include "palCommandBuffer.h"
+#include "palFactory.h"
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (command buffer)
+
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+// a handle is a slot index, with the slot generation in the top bits so a stale handle never finds a newer object
+#define HANDLE_INDEX_BITS 24
+#define HANDLE_INDEX_MASK ((1u << HANDLE_INDEX_BITS) - 1)
+#define HANDLE_GENERATION_MASK ((1u << (32 - HANDLE_INDEX_BITS)) - 1)
+
+palCommandBuffer::palCommandBuffer() {
+}
+
+palCommandBuffer::~palCommandBuffer() {
+}
+
+palCommandBuffer::Handle palCommandBuffer::AllocateHandle() {
+	unsigned int index;
+	if (!m_FreeSlots.empty()) {
+		index = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+	} else {
+		index = (unsigned int)m_Slots.size();
+		if (index >= HANDLE_INDEX_MASK)
+			return INVALID_HANDLE;
+		Slot slot = { NULL, 0 };
+		m_Slots.push_back(slot);
+	}
+	return index | (m_Slots[index].m_nGeneration << HANDLE_INDEX_BITS);
+}
+
+void palCommandBuffer::FreeHandle(Handle handle) {
+	unsigned int index = handle & HANDLE_INDEX_MASK;
+	Slot& slot = m_Slots[index];
+	if (slot.m_pObject != NULL)
+		m_SlotIndex.erase(slot.m_pObject);
+	slot.m_pObject = NULL;
+	slot.m_nGeneration = (slot.m_nGeneration + 1) & HANDLE_GENERATION_MASK;
+	// skip the generation that would make the last slot's handle INVALID_HANDLE
+	if (index == HANDLE_INDEX_MASK - 1 && slot.m_nGeneration == HANDLE_GENERATION_MASK)
+		slot.m_nGeneration = 0;
+	m_FreeSlots.push_back(index);
+}
+
+palFactoryObject *palCommandBuffer::Lookup(Handle handle) const {
+	if (handle == INVALID_HANDLE)
+		return NULL;
+	unsigned int index = handle & HANDLE_INDEX_MASK;
+	if (index >= m_Slots.size() || m_Slots[index].m_nGeneration != (handle >> HANDLE_INDEX_BITS))
+		return NULL;
+	return m_Slots[index].m_pObject;
+}
+
+palFactoryObject *palCommandBuffer::Get(Handle handle) const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return Lookup(handle);
+}
+
+unsigned int palCommandBuffer::GetNumPending() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return (unsigned int)m_Commands.size();
+}
+
+palCommandBuffer::Handle palCommandBuffer::Create(const PAL_STRING& className, const InitFunction& init) {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Handle handle = AllocateHandle();
+	if (handle == INVALID_HANDLE)
+		return handle;
+	Command cmd;
+	cmd.m_Type = CMD_CREATE;
+	cmd.m_Handle = handle;
+	cmd.m_pObject = NULL;
+	cmd.m_ClassName = className;
+	cmd.m_Init = init;
+	m_Commands.push_back(cmd);
+	return handle;
+}
+
+palCommandBuffer::Handle palCommandBuffer::CreateBox(Float x, Float y, Float z, Float width, Float height, Float depth, Float mass) {
+	return Create("palBox", [=](palFactoryObject *obj) {
+		palBox *box = dynamic_cast<palBox *>(obj);
+		if (box)
+			box->Init(x, y, z, width, height, depth, mass);
+	});
+}
+
+palCommandBuffer::Handle palCommandBuffer::CreateSphere(Float x, Float y, Float z, Float radius, Float mass) {
+	return Create("palSphere", [=](palFactoryObject *obj) {
+		palSphere *sphere = dynamic_cast<palSphere *>(obj);
+		if (sphere)
+			sphere->Init(x, y, z, radius, mass);
+	});
+}
+
+palCommandBuffer::Handle palCommandBuffer::CreateCapsule(Float x, Float y, Float z, Float radius, Float length, Float mass) {
+	return Create("palCapsule", [=](palFactoryObject *obj) {
+		palCapsule *capsule = dynamic_cast<palCapsule *>(obj);
+		if (capsule)
+			capsule->Init(x, y, z, radius, length, mass);
+	});
+}
+
+palCommandBuffer::Handle palCommandBuffer::CreateStaticBox(const palMatrix4x4& pos, Float width, Float height, Float depth) {
+	return Create("palStaticBox", [=](palFactoryObject *obj) {
+		palStaticBox *box = dynamic_cast<palStaticBox *>(obj);
+		if (box)
+			box->Init(pos, width, height, depth);
+	});
+}
+
+palCommandBuffer::Handle palCommandBuffer::CreateStaticSphere(const palMatrix4x4& pos, Float radius) {
+	return Create("palStaticSphere", [=](palFactoryObject *obj) {
+		palStaticSphere *sphere = dynamic_cast<palStaticSphere *>(obj);
+		if (sphere)
+			sphere->Init(pos, radius);
+	});
+}
+
+void palCommandBuffer::Destroy(Handle handle) {
+	if (handle == INVALID_HANDLE)
+		return;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Command cmd;
+	cmd.m_Type = CMD_DESTROY;
+	cmd.m_Handle = handle;
+	cmd.m_pObject = NULL;
+	m_Commands.push_back(cmd);
+}
+
+void palCommandBuffer::Destroy(palFactoryObject *object) {
+	if (object == NULL)
+		return;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Command cmd;
+	cmd.m_Type = CMD_DESTROY;
+	cmd.m_Handle = INVALID_HANDLE;
+	cmd.m_pObject = object;
+	m_Commands.push_back(cmd);
+}
+
+void palCommandBuffer::SetPosition(Handle handle, const palMatrix4x4& location) {
+	if (handle == INVALID_HANDLE)
+		return;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Command cmd;
+	cmd.m_Type = CMD_SET_POSITION;
+	cmd.m_Handle = handle;
+	cmd.m_pObject = NULL;
+	cmd.m_mLocation = location;
+	m_Commands.push_back(cmd);
+}
+
+void palCommandBuffer::SetPosition(palBodyBase *body, const palMatrix4x4& location) {
+	if (body == NULL)
+		return;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Command cmd;
+	cmd.m_Type = CMD_SET_POSITION;
+	cmd.m_Handle = INVALID_HANDLE;
+	cmd.m_pObject = body;
+	cmd.m_mLocation = location;
+	m_Commands.push_back(cmd);
+}
+
+void palCommandBuffer::Apply(palPhysics *physics) {
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Applying.swap(m_Commands);
+	}
+	if (m_Applying.empty())
+		return;
+
+	// objects are parented to the factory's active physics
+	palFactory *factory = palFactory::GetInstance();
+	palPhysics *active = factory->GetActivePhysics();
+	factory->SetActivePhysics(physics);
+	physics->BeginBatch();
+
+	for (unsigned int i = 0; i < m_Applying.size(); i++) {
+		Command& cmd = m_Applying[i];
+		palFactoryObject *object = cmd.m_pObject;
+		if (cmd.m_Handle != INVALID_HANDLE && cmd.m_Type != CMD_CREATE) {
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			object = Lookup(cmd.m_Handle);
+			if (object != NULL && cmd.m_Type == CMD_DESTROY)
+				FreeHandle(cmd.m_Handle);
+		} else if (cmd.m_Type == CMD_DESTROY && object != NULL) {
+			// an object created by this buffer, destroyed by pointer: its handle must not find it any more
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			PAL_MAP<palFactoryObject *, unsigned int>::iterator it = m_SlotIndex.find(object);
+			if (it != m_SlotIndex.end())
+				FreeHandle(it->second);
+		}
+		switch (cmd.m_Type) {
+		case CMD_CREATE:
+			object = factory->CreateObject(cmd.m_ClassName);
+			if (object != NULL && cmd.m_Init)
+				cmd.m_Init(object);
+			{
+				std::lock_guard<std::mutex> lock(m_Mutex);
+				if (object != NULL) {
+					m_Slots[cmd.m_Handle & HANDLE_INDEX_MASK].m_pObject = object;
+					m_SlotIndex[object] = cmd.m_Handle & HANDLE_INDEX_MASK;
+				} else
+					FreeHandle(cmd.m_Handle);
+			}
+			break;
+		case CMD_DESTROY:
+			delete object;
+			break;
+		case CMD_SET_POSITION:
+			{
+				palBodyBase *body = dynamic_cast<palBodyBase *>(object);
+				if (body != NULL)
+					body->SetPosition(cmd.m_mLocation);
+			}
+			break;
+		}
+	}
+
+	physics->EndBatch();
+	factory->SetActivePhysics(active);
+	m_Applying.clear();
+}
@@ -8,6 +8,8 @@
 	Author:
 		Adrian Boeing
 	Revision History:
+		Version 0.83: 19/10/26 - Object handles, arenas released after Cleanup
+		Version 0.82: 19/10/26 - Plugin manifest, engines are loaded on demand
 		Version 0.81: 05/07/08 - Notifications
 		Version 0.8 : 06/06/04
 	TODO:
@@ -18,6 +20,7 @@
 #define new new(_NORMAL_BLOCK,__FILE__, __LINE__)
 #endif
 #include "framework/osfs.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <iostream>
@@ -55,52 +58,44 @@ bool palFactory::SelectEngine(const PAL_STRING& name) {
 	printf("palFactory::SelectEngine: this = %p\n", this);
 #endif
 	SetActiveGroup(name); // also calls RebuildRegistry
+	if (!isClassRegistered("palPhysics")) {
+		// not loaded yet, or unloaded since
+		PAL_MAP<PAL_STRING, PAL_STRING>::iterator it = m_PluginFiles.find(name);
+		if (it != m_PluginFiles.end() && LoadObject(it->second.c_str(),PF,&sInfo()))
+			RebuildRegistry();
+	}
 	return isClassRegistered("palPhysics");
 }
 
-void palFactory::Cleanup() {
-	MMOType::iterator it;
+void palFactory::UnloadUnusedEngines() {
+	UnloadObjects(GetActiveGroup());
+	RebuildRegistry();
+}
 
-	//delete all items, except the physics class
-	it=pMMO.begin();
+void palFactory::Cleanup() {
+	size_t i;
 
-	//delete all constraints and geometries first
-	while (it != pMMO.end() ) {
-		myFactoryBase* objPtr = *it;
-		palFactoryObject* factoryObj = dynamic_cast<palLink *>(objPtr);
-		if (factoryObj) {
-			it = pMMO.erase(it);
-			delete factoryObj;
-		} else {
-			it++;
-		}
+	//delete all constraints first
+	for (i = 0; i < GetSlotCount(); i++) {
+		palLink *link = dynamic_cast<palLink *>(GetSlotObject(i));
+		if (link)
+			delete link;
 	}
 
-	it=pMMO.begin();
 	//now delete everything the palFactory made except the main physics class
-	while (it != pMMO.end() ) {
-		palPhysics * pPhysics = dynamic_cast<palPhysics *>(*it);
-		//		printf("\ntesting:%d\n",*it);
-		if (pPhysics) {
-			//			printf("\n%d is a physics object\n",pPhysics);
-			it++;
-		} else {
-			palFactoryObject* factoryObj = dynamic_cast<palFactoryObject*>(*it);
-			if (factoryObj) {
-				it = pMMO.erase(it);
-				delete factoryObj;
-			} else {
-				it++;
-			}
-		}
+	for (i = 0; i < GetSlotCount(); i++) {
+		myFactoryBase* objPtr = GetSlotObject(i);
+		if (objPtr == NULL || dynamic_cast<palPhysics *>(objPtr))
+			continue;
+		palFactoryObject* factoryObj = dynamic_cast<palFactoryObject*>(objPtr);
+		if (factoryObj)
+			delete factoryObj;
 	}
 
 	//now cleanup physics class, and delete it
-	it=pMMO.begin();
-	while (it != pMMO.end() ) {
-		palPhysics * pPhysics = dynamic_cast<palPhysics *>(*it);
+	for (i = 0; i < GetSlotCount(); i++) {
+		palPhysics * pPhysics = dynamic_cast<palPhysics *>(GetSlotObject(i));
 		if (pPhysics) {
-			it = pMMO.erase(it);
 			pPhysics->Cleanup();
 			delete pPhysics;
 		}
@@ -109,10 +104,25 @@ void palFactory::Cleanup() {
 	// clean up whatever is left (if anything)
 	FreeAll();
 
+	// the objects are all deleted, the now empty arenas hand their slabs back
+	ObjectArena::TrimAll();
+
 	//	MessageBox(NULL,"hi","hi",MB_OK);
 	m_active=NULL;
 }
 
+palHandle palFactory::GetHandle(const palFactoryObject *obj) const {
+	return MemoryObjectManager<StatusObject>::GetHandle(obj);
+}
+
+palFactoryObject *palFactory::Resolve(palHandle handle) const {
+	return static_cast<palFactoryObject *>(MemoryObjectManager<StatusObject>::Resolve(handle));
+}
+
+size_t palFactory::GetObjectCount() const {
+	return MemoryObjectManager<StatusObject>::GetObjectCount();
+}
+
 template <typename iType, typename fType> fType Cast(palFactoryObject *obj) {
 #ifdef INTERNAL_DEBUG
 	iType i = dynamic_cast<iType> (obj);
@@ -216,6 +226,11 @@ palStaticConvex *palFactory::CreateStaticConvex() {
 	return Cast<palBody *,palStaticConvex *>(pmFO);
 }
 
+palStaticInstanceSet *palFactory::CreateStaticInstanceSet() {
+	palFactoryObject *pmFO = CreateObject("palStaticInstanceSet");
+	return Cast<palBodyBase *,palStaticInstanceSet *>(pmFO);
+}
+
 palBoxGeometry *palFactory::CreateBoxGeometry() {
 	palFactoryObject *pmFO = CreateObject("palBoxGeometry");
 	return Cast<palGeometry *,palBoxGeometry *>(pmFO);
@@ -513,26 +528,27 @@ palFactoryObject *palFactory::CreateObject(const PAL_STRING& name) {
 	printf("%s:%d:palFactoryObject:%p\n",__FILE__,__LINE__,p);
 #endif
 	//printf("m_active is: %d\n",m_active);
-	if (p) {
-		if (m_active) {
-			p->SetParent(dynamic_cast<StatusObject *>(m_active));
-			if (m_active->m_bListen) {
-				palGeometry *pg = dynamic_cast<palGeometry *>(p);
-				if (pg) {
-					m_active->NotifyGeometryAdded(pg);
-					return p;
-				}
-				palBodyBase *pb = dynamic_cast<palBodyBase *>(p);
-				if (pb) {
-					m_active->NotifyBodyAdded(pb);
-					return p;
-				}
+	if (p)
+		Adopt(p);
+	return p;
+}
+
+void palFactory::Adopt(palFactoryObject *p) {
+	if (m_active) {
+		p->SetParent(dynamic_cast<StatusObject *>(m_active));
+		if (m_active->m_bListen) {
+			palGeometry *pg = dynamic_cast<palGeometry *>(p);
+			if (pg) {
+				m_active->NotifyGeometryAdded(pg);
+				return;
 			}
+			palBodyBase *pb = dynamic_cast<palBodyBase *>(p);
+			if (pb)
+				m_active->NotifyBodyAdded(pb);
 		}
-		else
-			p->SetParent(dynamic_cast<StatusObject *>(this));
 	}
-	return p;
+	else
+		p->SetParent(dynamic_cast<StatusObject *>(this));
 }
 
 palPhysics * palFactory::GetActivePhysics() {
@@ -542,7 +558,12 @@ palPhysics * palFactory::GetActivePhysics() {
 	return m_active;
 }
 
+void palFactory::SetActivePhysics(palPhysics *physics) {
+	m_active = physics;
+}
+
 const char* palFactory::PAL_PLUGIN_PATH = "PAL_PLUGIN_PATH";
+const char* palFactory::PAL_PLUGIN_MANIFEST = "pal_plugins.txt";
 
 void palFactory::LoadPhysicsEngines(const char* dirName) {
 	try
@@ -607,6 +628,31 @@ void palFactory::LoadPALfromDLL(const char *szPath) throw(palException) {
 	printf("palFactory::LoadPALfromDLL: path = '%s'. about to get palFactory\n",
 			szPath);
 #endif
+	if (szPath != NULL) {
+		PAL_STRING dir(szPath);
+		bool absolute = (dir[0] == '/') || (dir[0] == '\\') || (dir.size() > 1 && dir[1] == ':');
+		if (!absolute) {
+			// the libraries are loaded later, possibly from another working directory
+			char current_directory[4096];
+			GetCurrentDir(4096,current_directory);
+			dir = PAL_STRING(current_directory) + "/" + dir;
+		}
+		FILE *manifest = fopen((dir + "/" + PAL_PLUGIN_MANIFEST).c_str(),"r");
+		if (manifest) {
+			char line[4096];
+			char engine[256];
+			char file[2048];
+			while (fgets(line,sizeof(line),manifest)) {
+				if (line[0] == '#' || sscanf(line,"%255s %2047s",engine,file) != 2)
+					continue;
+				// the first directory to list an engine wins
+				if (m_PluginFiles.find(engine) == m_PluginFiles.end())
+					m_PluginFiles[engine] = dir + "/" + file;
+			}
+			fclose(manifest);
+			return;
+		}
+	}
 	palFactory* factory = PF;
 #ifdef INTERNAL_DEBUG
 	printf("palFactory::LoadPALfromDLL: factory = %p. about to get sInfo from method %p\n",
@@ -629,11 +675,10 @@ void palFactory::DumpObjects(const PAL_STRING& separator) {
 }
 
 void palFactory::DumpObjects(std::ostream& out, const PAL_STRING& separator) {
-	for (MMOType::iterator iter = pMMO.begin();
-			iter != pMMO.end();
-			iter++) {
-		myFactoryBase* objPtr = *iter;
-		out << objPtr->toString() << separator;
+	for (size_t i = 0; i < GetSlotCount(); i++) {
+		myFactoryBase* objPtr = GetSlotObject(i);
+		if (objPtr)
+			out << objPtr->toString() << separator;
 	}
 }
 
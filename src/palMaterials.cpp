@@ -6,6 +6,8 @@
  */
 #include "palFactory.h"
 #include "palMaterials.h"
+#include <stdlib.h>
+#include <algorithm>
 
 FACTORY_CLASS_IMPLEMENTATION(palMaterials);
 FACTORY_CLASS_IMPLEMENTATION(palMaterial);
@@ -42,10 +44,11 @@ void palMaterialDesc::SetParameters(const palMaterialDesc& matDesc) {
 palMaterial::palMaterial()
 : m_Name()
 , m_Id(0)
+, m_pMaterials(NULL)
 , m_bHasCustomMaterialInteractions(false)
 {}
 
-palMaterial::palMaterial(const palMaterial& m):m_Id(0),m_bHasCustomMaterialInteractions(false) {}
+palMaterial::palMaterial(const palMaterial& m):m_Id(0),m_pMaterials(NULL),m_bHasCustomMaterialInteractions(false) {}
 
 palMaterial::~palMaterial() {}
 
@@ -57,16 +60,22 @@ void palMaterial::Init(const PAL_STRING& name, const palMaterialDesc& matDesc) {
 	m_Name=name;
 }
 
+void palMaterial::SetParameters(const palMaterialDesc& matDesc) {
+	palMaterialDesc::SetParameters(matDesc);
+	if (m_pMaterials != NULL)
+		m_pMaterials->UpdateMaterialPairs(m_Id);
+}
+
 const PAL_STRING& palMaterial::GetName() const
 {
 	return m_Name;
 }
 
 palMaterialInteraction::palMaterialInteraction()
-: m_pMaterial1(), m_pMaterial2(), m_pCollsionCallback() {
+: m_pMaterials(NULL), m_pMaterial1(), m_pMaterial2(), m_pCollsionCallback() {
 }
 palMaterialInteraction::palMaterialInteraction(const palMaterialInteraction& pmi)
-: m_pMaterial1(pmi.m_pMaterial1), m_pMaterial2(pmi.m_pMaterial2), m_pCollsionCallback(pmi.m_pCollsionCallback) {}
+: m_pMaterials(NULL), m_pMaterial1(pmi.m_pMaterial1), m_pMaterial2(pmi.m_pMaterial2), m_pCollsionCallback(pmi.m_pCollsionCallback) {}
 
 palMaterialInteraction& palMaterialInteraction::operator=(const palMaterialInteraction& pmi) {
 	m_pMaterial1 = pmi.m_pMaterial1;
@@ -82,23 +91,94 @@ void palMaterialInteraction::Init(palMaterial* pM1, palMaterial* pM2, const palM
 	pM2->SetHasCustomInteractions(true);
 }
 
-palMaterials::palMaterials() {
+void palMaterialInteraction::SetParameters(const palMaterialDesc& matDesc) {
+	palMaterialDesc::SetParameters(matDesc);
+	if (m_pMaterials != NULL) {
+		m_pMaterials->UpdatePair(m_pMaterial1->GetId(), m_pMaterial2->GetId());
+		m_pMaterials->UpdatePair(m_pMaterial2->GetId(), m_pMaterial1->GetId());
+	}
+}
+
+palMaterials::palMaterials()
+: m_pPairs(NULL)
+, m_pPairMemory(NULL)
+, m_nPairStride(0) {
 };
 
 palMaterials::~palMaterials() {
+	free(m_pPairMemory);
 	// Ugly memory cleanup workaround.
 	palPhysics* physics = dynamic_cast<palPhysics*>(GetParent());
 	if (physics != 0) physics->SetMaterialsNull();
 }
 
 unsigned palMaterials::GetIndex(const PAL_STRING& name) const {
-//	PAL_VECTOR<PAL_STRING>::iterator obj;
-//	obj = std::find(m_MaterialNames.begin(), m_MaterialNames.end(), name);
-	unsigned size = m_Materials.size();
-	for (unsigned int i=0; i < size ;i++)
-		if (m_Materials[i]->GetName() == name)
-			return i;
-	return UINT_MAX;
+	PAL_MAP<PAL_STRING, unsigned>::const_iterator it = m_MaterialIds.find(name);
+	if (it == m_MaterialIds.end())
+		return UINT_MAX;
+	return it->second;
+}
+
+void palMaterials::RebuildInteractionTable() {
+	const unsigned n = GetNumMaterials();
+	if (n > m_nPairStride) {
+		// materials are only ever added, so grow with some room to add the next ones without a rebuild.
+		const unsigned stride = std::max(n, m_nPairStride + m_nPairStride / 2 + 8);
+		free(m_pPairMemory);
+		const size_t align = 64;
+		m_pPairMemory = malloc(sizeof(palMaterialPair) * stride * stride + align);
+		if (m_pPairMemory == NULL) {
+			SET_ERROR("Could not allocate the material interaction table");
+			m_pPairs = NULL;
+			m_nPairStride = 0;
+			return;
+		}
+		m_pPairs = reinterpret_cast<palMaterialPair*>((reinterpret_cast<size_t>(m_pPairMemory) + align - 1) & ~(align - 1));
+		m_nPairStride = stride;
+	}
+
+	for (unsigned i = 0; i < n; i++) {
+		for (unsigned j = 0; j < n; j++) {
+			UpdatePair(i, j);
+		}
+	}
+}
+
+void palMaterials::UpdateMaterialPairs(unsigned id) {
+	if (id >= m_nPairStride)
+		return;
+	const unsigned n = GetNumMaterials();
+	for (unsigned k = 0; k < n; k++) {
+		UpdatePair(id, k);
+		UpdatePair(k, id);
+	}
+}
+
+void palMaterials::UpdatePair(unsigned i, unsigned j) {
+	if (i >= m_nPairStride || j >= m_nPairStride)
+		return;
+	palMaterialPair& pair = m_pPairs[i * m_nPairStride + j];
+	// matches HandleCustomInteraction: a material against itself is always combined.
+	palMaterialInteraction* pMI = (i != j) ? m_MaterialInteractions.Get(i, j).m_pMatInteration : NULL;
+	palMaterialDesc desc;
+	if (pMI != NULL)
+		desc.SetParameters(*pMI);
+	else
+		CombineMaterials(*m_Materials[i], *m_Materials[j], desc);
+
+	pair.m_fStatic = desc.m_fStatic;
+	pair.m_fKinetic = desc.m_fKinetic;
+	pair.m_fRestitution = desc.m_fRestitution;
+	pair.m_fStaticAnisotropic[0] = desc.m_fStatic * desc.m_vStaticAnisotropic[0];
+	pair.m_fStaticAnisotropic[1] = desc.m_fStatic * desc.m_vStaticAnisotropic[1];
+	pair.m_nFlags = 0;
+	if (desc.m_bEnableAnisotropicFriction)
+		pair.m_nFlags |= PAL_MATERIAL_PAIR_ANISOTROPIC;
+	if (desc.m_bDisableStrongFriction)
+		pair.m_nFlags |= PAL_MATERIAL_PAIR_DISABLE_STRONG_FRICTION;
+	if (pMI != NULL)
+		pair.m_nFlags |= PAL_MATERIAL_PAIR_INTERACTION;
+	pair.m_pInteraction = pMI;
 }
 
 palMaterial* palMaterials::GetMaterial(const PAL_STRING& name) {
@@ -189,8 +269,14 @@ palMaterial* palMaterials::NewMaterial(const PAL_STRING& name, const palMaterial
 	unsigned pos = m_Materials.size();
 	m_Materials.push_back(pM);
 	pM->SetId(pos);
+	m_MaterialIds[name] = pos;
 
 	m_MaterialInteractions.Resize(pos+1, pos+1);
+	pM->m_pMaterials = this;
+	if (pos < m_nPairStride)
+		UpdateMaterialPairs(pos);
+	else
+		RebuildInteractionTable();
 
 	return pM;
 }
@@ -201,7 +287,7 @@ void palMaterials::SetMaterialInteraction(palMaterial* pm1, palMaterial* pm2, co
 	m_MaterialInteractions.GetDimensions(x,y);
 	id1 = (pm1 != NULL) ? pm1->GetId(): UINT_MAX;
 	id2 = (pm2 != NULL) ? pm2->GetId(): UINT_MAX;
-	if (id1 > x || id2 > y)
+	if (id1 >= x || id2 >= y)
 	{
 		return;
 	}
@@ -216,11 +302,15 @@ void palMaterials::SetMaterialInteraction(palMaterial* pm1, palMaterial* pm2, co
 			return;
 		}
 		pMI->Init(m_Materials[id1], m_Materials[id2], matDesc);
+		pMI->m_pMaterials = this;
 		m_MaterialInteractions.Get(id1,id2).m_pMatInteration = pMI;
 		m_MaterialInteractions.Get(id2,id1).m_pMatInteration = pMI;
+		UpdatePair(id1, id2);
+		UpdatePair(id2, id1);
 	}
 	else
 	{
+		// updates the pair
 		pMI->SetParameters(matDesc);
 	}
 }
@@ -54,12 +54,16 @@ struct palMaterialDesc {
 	\version
 	<pre>
 		Version 0.1   : 11/12/07 - Original
+		Version 0.2   : 19/10/26 - Interned material names, precomputed pair table
+		Version 0.2.2 : 19/10/26 - GetInteraction returns NULL before the pair table exists
+		Version 0.2.1 : 19/10/26 - Pair table updated when materials change, read only lookups
 	</pre>
 	\todo
 */
 
 class palMaterial;
 class palMaterialInteraction;
+class palMaterials;
 
 /** This is the base material class.
 	This class is only neccessary when constructing a new PAL physics implementation.
@@ -73,6 +77,9 @@ public:
 
 	virtual void Init(const PAL_STRING& name, const palMaterialDesc& desc); //api version 3
 
+	/// Sets the member variables, and updates the interactions of this material in palMaterials
+	virtual void SetParameters(const palMaterialDesc& matDesc);
+
 	/// The id is used internally in the material system.
 	unsigned GetId() const { return m_Id; }
 	void SetId(unsigned newId) { m_Id = newId; }
@@ -86,9 +93,11 @@ public:
 protected:
 	FACTORY_CLASS(palMaterial,palMaterial,*,1);
 private:
+	friend class palMaterials;
 	virtual palMaterial& operator=(const palMaterial& m) { return *this; };
 	PAL_STRING m_Name;//!< The name for this material. (eg:"wood")
 	unsigned m_Id;
+	palMaterials* m_pMaterials; //!< the library the material is in, NULL until it is added
 	bool m_bHasCustomMaterialInteractions; //!< material interactions are ignored by default.  This value
 };
 
@@ -122,6 +131,8 @@ public:
    \param desc the material description
 	*/
 	virtual void Init(palMaterial *pM1, palMaterial *pM2, const palMaterialDesc& matDesc); //api version 2
+	/// Sets the member variables, and updates the pair in palMaterials
+	virtual void SetParameters(const palMaterialDesc& matDesc);
 	virtual palMaterialInteraction& operator=(const palMaterialInteraction& pmi);
 
 	palMaterial* getMaterial1() { return m_pMaterial1; }
@@ -137,13 +148,38 @@ public:
 protected:
 	FACTORY_CLASS(palMaterialInteraction,palMaterialInteraction,*,1);
 private:
+	friend class palMaterials;
 	palMaterialInteraction(const palMaterialInteraction& pmi);
 
+	palMaterials* m_pMaterials; //!< the library the interaction is in, NULL until it is added
 	palMaterial* m_pMaterial1;	//!< Pointers to the unique materials which interact
 	palMaterial* m_pMaterial2;	//!< Pointers to the unique materials which interact
 	palMaterialInteractionCollisionCallback* m_pCollsionCallback;
 };
 
+/** Flags for a palMaterialPair. */
+enum palMaterialPairFlag {
+	PAL_MATERIAL_PAIR_ANISOTROPIC = 1, //!< m_fStaticAnisotropic is valid
+	PAL_MATERIAL_PAIR_DISABLE_STRONG_FRICTION = 2,
+	PAL_MATERIAL_PAIR_INTERACTION = 4 //!< values come from an explicit palMaterialInteraction rather than combining the materials
+};
+
+/** The precomputed result of two materials coming into contact.
+	palMaterials keeps one of these for every ordered pair of material ids so an engine can resolve
+	a contact with a single table lookup, see palMaterials::GetInteraction().
+	If the pair has a collision callback the engine must still go through palMaterials::HandleCustomInteraction for each contact.
+*/
+struct palMaterialPair {
+	Float m_fStatic;
+	Float m_fKinetic;
+	Float m_fRestitution;
+	Float m_fStaticAnisotropic[2]; //!< static friction along and across the direction of anisotropy (already scaled by m_fStatic)
+	unsigned m_nFlags;
+	palMaterialInteraction* m_pInteraction; //!< the explicit interaction, or NULL
+
+	bool HasCallback() const { return m_pInteraction != NULL && m_pInteraction->GetCollisionCallback() != NULL; }
+};
+
 
 /** The materials management class.
 	This class allows you to add materials into the physics engine. The class maintains a library of all materials created and generates the appropriate underlying data structures. 
@@ -222,6 +258,30 @@ public:
 	 */
 	bool HandleCustomInteraction(palMaterial* pm1, palMaterial* pm2, palMaterialDesc& matToAdjust, palContactPoint& contactToAdjust, bool combine);
 
+	/**
+	Returns the precomputed interaction of two materials, equivalent to HandleCustomInteraction with combine set.
+	This is an O(1) read only lookup, so engines may call it from several collision threads at once.
+	The table is updated when a material or interaction is added or its SetParameters is called,
+	which must not happen while the physics is stepping.
+	\param id1 The id of the first material (palMaterial::GetId())
+	\param id2 The id of the second material
+	\return The pair, or NULL if no material has been added yet
+	*/
+	const palMaterialPair* GetInteraction(unsigned id1, unsigned id2) const {
+		if (m_pPairs == NULL)
+			return NULL;
+		return &m_pPairs[id1 * m_nPairStride + id2];
+	}
+
+	/**
+	Recomputes the interaction table.
+	Only needed after assigning the members of an existing palMaterial or palMaterialInteraction directly, SetParameters updates it.
+	*/
+	void Invalidate() { RebuildInteractionTable(); }
+
+	/// \return the number of materials, ids range from 0 to GetNumMaterials()-1
+	unsigned GetNumMaterials() const { return (unsigned)m_Materials.size(); }
+
 	/**
 	Retrievies an interaction for the two named materials, if it exists.
 	This function is not particularly fast.  The other version that takes two materials is O(1)
@@ -251,10 +311,26 @@ protected:
 		palMaterialInteraction* m_pMatInteration;
 	};
 	std_matrix<InteractionData> m_MaterialInteractions;
+	PAL_MAP<PAL_STRING, unsigned> m_MaterialIds; //!< name to index in m_Materials
 
 	virtual unsigned GetIndex(const PAL_STRING& name) const;
 
+	virtual void RebuildInteractionTable();
+	/// Recomputes the row and the column of one material
+	void UpdateMaterialPairs(unsigned id);
+	/// Recomputes one entry of the table
+	void UpdatePair(unsigned id1, unsigned id2);
+
+	palMaterialPair* m_pPairs; //!< m_nPairStride*m_nPairStride entries, cache line aligned
+	void* m_pPairMemory;
+	unsigned m_nPairStride; //!< the row length, at least the number of materials
+
 	FACTORY_CLASS(palMaterials,palMaterials,*,1);
+private:
+	friend class palMaterial;
+	friend class palMaterialInteraction;
+	palMaterials(const palMaterials&);
+	palMaterials& operator=(const palMaterials&);
 };
 
 
@@ -5,6 +5,113 @@
 #include <ostream>
 #include <limits>
 
+#if defined(PAL_MATH_AVX2)
+#include <immintrin.h>
+#elif defined(PAL_MATH_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(PAL_MATH_SIMD)
+namespace {
+
+/*
+	Backend primitives.
+	A palSimdCol holds one four element matrix column (x,y,z,w).
+*/
+#if !defined(DOUBLE_PRECISION)
+
+struct palSimdCol { __m128 v; };
+
+inline palSimdCol col_load(const Float *p) { palSimdCol c; c.v = _mm_loadu_ps(p); return c; }
+inline void col_store(Float *p, const palSimdCol& c) { _mm_storeu_ps(p, c.v); }
+inline void col_store3(Float *p, const palSimdCol& c) {
+	_mm_storel_pi((__m64 *)p, c.v);
+	_mm_store_ss(p + 2, _mm_movehl_ps(c.v, c.v));
+}
+inline palSimdCol col_splat(Float f) { palSimdCol c; c.v = _mm_set1_ps(f); return c; }
+inline palSimdCol col_add(const palSimdCol& a, const palSimdCol& b) { palSimdCol c; c.v = _mm_add_ps(a.v, b.v); return c; }
+inline palSimdCol col_mul(const palSimdCol& a, const palSimdCol& b) { palSimdCol c; c.v = _mm_mul_ps(a.v, b.v); return c; }
+//! a*b+c
+inline palSimdCol col_madd(const palSimdCol& a, const palSimdCol& b, const palSimdCol& c) {
+	palSimdCol r;
+#if defined(__FMA__)
+	r.v = _mm_fmadd_ps(a.v, b.v, c.v);
+#else
+	r.v = _mm_add_ps(_mm_mul_ps(a.v, b.v), c.v);
+#endif
+	return r;
+}
+
+#elif defined(PAL_MATH_AVX2) // double precision, 4 doubles per register
+
+struct palSimdCol { __m256d v; };
+
+inline palSimdCol col_load(const Float *p) { palSimdCol c; c.v = _mm256_loadu_pd(p); return c; }
+inline void col_store(Float *p, const palSimdCol& c) { _mm256_storeu_pd(p, c.v); }
+inline void col_store3(Float *p, const palSimdCol& c) {
+	_mm_storeu_pd(p, _mm256_castpd256_pd128(c.v));
+	_mm_store_sd(p + 2, _mm256_extractf128_pd(c.v, 1));
+}
+inline palSimdCol col_splat(Float f) { palSimdCol c; c.v = _mm256_set1_pd(f); return c; }
+inline palSimdCol col_add(const palSimdCol& a, const palSimdCol& b) { palSimdCol c; c.v = _mm256_add_pd(a.v, b.v); return c; }
+inline palSimdCol col_mul(const palSimdCol& a, const palSimdCol& b) { palSimdCol c; c.v = _mm256_mul_pd(a.v, b.v); return c; }
+inline palSimdCol col_madd(const palSimdCol& a, const palSimdCol& b, const palSimdCol& c) {
+	palSimdCol r;
+#if defined(__FMA__)
+	r.v = _mm256_fmadd_pd(a.v, b.v, c.v);
+#else
+	r.v = _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v);
+#endif
+	return r;
+}
+
+#else // double precision SSE2, a column is split over two registers
+
+struct palSimdCol { __m128d lo, hi; };
+
+inline palSimdCol col_load(const Float *p) { palSimdCol c; c.lo = _mm_loadu_pd(p); c.hi = _mm_loadu_pd(p + 2); return c; }
+inline void col_store(Float *p, const palSimdCol& c) { _mm_storeu_pd(p, c.lo); _mm_storeu_pd(p + 2, c.hi); }
+inline void col_store3(Float *p, const palSimdCol& c) { _mm_storeu_pd(p, c.lo); _mm_store_sd(p + 2, c.hi); }
+inline palSimdCol col_splat(Float f) { palSimdCol c; c.lo = c.hi = _mm_set1_pd(f); return c; }
+inline palSimdCol col_add(const palSimdCol& a, const palSimdCol& b) {
+	palSimdCol c; c.lo = _mm_add_pd(a.lo, b.lo); c.hi = _mm_add_pd(a.hi, b.hi); return c;
+}
+inline palSimdCol col_mul(const palSimdCol& a, const palSimdCol& b) {
+	palSimdCol c; c.lo = _mm_mul_pd(a.lo, b.lo); c.hi = _mm_mul_pd(a.hi, b.hi); return c;
+}
+inline palSimdCol col_madd(const palSimdCol& a, const palSimdCol& b, const palSimdCol& c) {
+	return col_add(col_mul(a, b), c);
+}
+
+#endif
+
+// All of a and b are held in registers before anything is written, so p may alias either input.
+inline void mat_multiply_simd(Float *p, const Float *a, const Float *b) {
+	const palSimdCol a0 = col_load(a);
+	const palSimdCol a1 = col_load(a + 4);
+	const palSimdCol a2 = col_load(a + 8);
+	const palSimdCol a3 = col_load(a + 12);
+	palSimdCol r[4];
+	for (int j = 0; j < 4; j++) {
+		const Float *bj = b + (j << 2);
+		palSimdCol c = col_mul(a0, col_splat(bj[0]));
+		c = col_madd(a1, col_splat(bj[1]), c);
+		c = col_madd(a2, col_splat(bj[2]), c);
+		r[j] = col_madd(a3, col_splat(bj[3]), c);
+	}
+	for (int j = 0; j < 4; j++)
+		col_store(p + (j << 2), r[j]);
+}
+
+inline palSimdCol vec_mat_mul_simd(const palSimdCol& c0, const palSimdCol& c1, const palSimdCol& c2, const palVector3 *b) {
+	palSimdCol r = col_mul(c0, col_splat(b->x));
+	r = col_madd(c1, col_splat(b->y), r);
+	return col_madd(c2, col_splat(b->z), r);
+}
+
+} // namespace
+#endif
+
 
 palBoundingBox::palBoundingBox()
 : min(PAL_MAX_FLOAT, PAL_MAX_FLOAT, PAL_MAX_FLOAT)
@@ -114,13 +221,34 @@ void vec_vec_mul(palVector3 *v, const palVector3 *a, const palVector3 *b) {
 	v->z=a->z * b->z;
 }
 
-void vec_mat_mul(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
+void vec_mat_mul_scalar(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
 	Float *m = (Float *) a->_mat;
 	v->x = m[0] * b->x + m[4] * b->y + m[8] * b->z;
 	v->y = m[1] * b->x + m[5] * b->y + m[9] * b->z;
 	v->z = m[2] * b->x + m[6] * b->y + m[10] * b->z;
 }
 
+void vec_mat_mul(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
+#if defined(PAL_MATH_SIMD)
+	const Float *m = a->_mat;
+	col_store3(v->_vec, vec_mat_mul_simd(col_load(m), col_load(m + 4), col_load(m + 8), b));
+#else
+	vec_mat_mul_scalar(v, a, b);
+#endif
+}
+
+void vec_mat_mul_n(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b, unsigned int n) {
+#if defined(PAL_MATH_SIMD)
+	const Float *m = a->_mat;
+	const palSimdCol c0 = col_load(m), c1 = col_load(m + 4), c2 = col_load(m + 8);
+	for (unsigned int i = 0; i < n; i++)
+		col_store3(v[i]._vec, vec_mat_mul_simd(c0, c1, c2, &b[i]));
+#else
+	for (unsigned int i = 0; i < n; i++)
+		vec_mat_mul_scalar(&v[i], a, &b[i]);
+#endif
+}
+
 palVector3 palVector3::operator+(const palVector3& b) const {
 	palVector3 c;
 	c.x = x + b.x;
@@ -161,13 +289,35 @@ void mat_scale3x3(palMatrix4x4 *m, const palVector3 *s) {
 	}
 }
 
-void vec_mat_transform(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
+void vec_mat_transform_scalar(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
 	palVector3 x;
-	vec_mat_mul(v,a,b);
+	vec_mat_mul_scalar(v,a,b);
 	mat_get_translation(a,&x);
 	vec_add(v,&x,v);
 }
 
+void vec_mat_transform(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b) {
+#if defined(PAL_MATH_SIMD)
+	const Float *m = a->_mat;
+	palSimdCol r = vec_mat_mul_simd(col_load(m), col_load(m + 4), col_load(m + 8), b);
+	col_store3(v->_vec, col_add(col_load(m + 12), r));
+#else
+	vec_mat_transform_scalar(v, a, b);
+#endif
+}
+
+void vec_mat_transform_n(palVector3 *v, const palMatrix4x4 *a, const palVector3 *b, unsigned int n) {
+#if defined(PAL_MATH_SIMD)
+	const Float *m = a->_mat;
+	const palSimdCol c0 = col_load(m), c1 = col_load(m + 4), c2 = col_load(m + 8), c3 = col_load(m + 12);
+	for (unsigned int i = 0; i < n; i++)
+		col_store3(v[i]._vec, col_add(c3, vec_mat_mul_simd(c0, c1, c2, &b[i])));
+#else
+	for (unsigned int i = 0; i < n; i++)
+		vec_mat_transform_scalar(&v[i], a, &b[i]);
+#endif
+}
+
 void vec_cross(palVector3 *v, const palVector3 *a, const palVector3 *b) {
 	v->x=a->y*b->z - a->z*b->y;
 	v->y=a->z*b->x - a->x*b->z;
@@ -221,7 +371,7 @@ void mat_sub(palMatrix4x4 *m, const palMatrix4x4 *a, const palMatrix4x4 *b) {
 	}
 }
 
-void mat_multiply( palMatrix4x4 *pal_product, const palMatrix4x4 *pal_a, const palMatrix4x4 *pal_b )
+void mat_multiply_scalar( palMatrix4x4 *pal_product, const palMatrix4x4 *pal_a, const palMatrix4x4 *pal_b )
 {
 	Float *product = pal_product->_mat;
 	Float *a = (Float *) pal_a->_mat;
@@ -236,6 +386,21 @@ void mat_multiply( palMatrix4x4 *pal_product, const palMatrix4x4 *pal_a, const p
    }
 }
 
+void mat_multiply( palMatrix4x4 *pal_product, const palMatrix4x4 *pal_a, const palMatrix4x4 *pal_b )
+{
+#if defined(PAL_MATH_SIMD)
+	mat_multiply_simd(pal_product->_mat, pal_a->_mat, pal_b->_mat);
+#else
+	mat_multiply_scalar(pal_product, pal_a, pal_b);
+#endif
+}
+
+void mat_multiply_n( palMatrix4x4 *m, const palMatrix4x4 *a, const palMatrix4x4 *b, unsigned int n )
+{
+	for (unsigned int i = 0; i < n; i++)
+		mat_multiply(&m[i], &a[i], &b[i]);
+}
+
 #define M(row,col)  m[(col<<2)+row]
 
 void mat_rotate(palMatrix4x4 *pal_m, Float angle, Float x, Float y, Float z) {
@@ -628,6 +793,37 @@ void q_q_mul(palQuaternion *q, const palQuaternion *a, const palQuaternion *b) {
 	q->w = a->w * b->w - a->x * b->x - a->y * b->y - a->z * b->z;
 }
 
+void mat_set_quaternion_scalar(palMatrix4x4 *pal_m, const palQuaternion *q) {
+	Float *m = pal_m->_mat;
+	const Float x2 = q->x + q->x, y2 = q->y + q->y, z2 = q->z + q->z;
+	const Float xx = q->x * x2, yy = q->y * y2, zz = q->z * z2;
+	const Float xy = q->x * y2, xz = q->x * z2, yz = q->y * z2;
+	const Float wx = q->w * x2, wy = q->w * y2, wz = q->w * z2;
+
+	MAT(m,0,0) = Float(1.0) - (yy + zz);
+	MAT(m,1,0) = xy + wz;
+	MAT(m,2,0) = xz - wy;
+
+	MAT(m,0,1) = xy - wz;
+	MAT(m,1,1) = Float(1.0) - (xx + zz);
+	MAT(m,2,1) = yz + wx;
+
+	MAT(m,0,2) = xz + wy;
+	MAT(m,1,2) = yz - wx;
+	MAT(m,2,2) = Float(1.0) - (xx + yy);
+}
+
+void mat_set_quaternion(palMatrix4x4 *m, const palQuaternion *q) {
+	mat_set_quaternion_scalar(m, q);
+}
+
+void mat_set_quaternion_n(palMatrix4x4 *pal_m, const palQuaternion *q, unsigned int n) {
+	// Stays scalar: transposing the quaternions in and the columns back out of SIMD lanes
+	// cost as much as the nine products it vectorised, at every batch size.
+	for (unsigned int i = 0; i < n; i++)
+		mat_set_quaternion_scalar(&pal_m[i], &q[i]);
+}
+
 void q_set_axis_angle(palQuaternion *q, const palVector3 *axis, Float angle)
 {
 	Float d = vec_mag(axis);
@@ -675,6 +871,16 @@ Float plane_distance(const palPlane *plane, const palVector3 *point) {
 	return top/mag;
 }
 
+const char* pal_math_backend() {
+#if defined(PAL_MATH_AVX2)
+	return "AVX2";
+#elif defined(PAL_MATH_SSE2)
+	return "SSE2";
+#else
+	return "scalar";
+#endif
+}
+
 //////////////////////////////////////////////////////////////////////
 // output helpers
 //
@@ -0,0 +1,240 @@
+#include "palSensorManager.h"
+#include <thread>
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (sensor manager)
+
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+palSensorManager::palSensorManager()
+: m_nThreads(1) {
+}
+
+palSensorManager::~palSensorManager() {
+	Clear();
+}
+
+void palSensorManager::SetNumThreads(unsigned threads) {
+	m_nThreads = (threads > 0) ? threads : 1;
+}
+
+unsigned palSensorManager::GetNumSensors() const {
+	return (unsigned)(m_PSDSensors.size() + m_CompassSensors.size() + m_InclinometerSensors.size()
+			+ m_GyroscopeSensors.size() + m_VelocimeterSensors.size());
+}
+
+unsigned palSensorManager::AddBody(palBody *body, bool velocity) {
+	unsigned index;
+	PAL_MAP<palBody *, unsigned>::iterator it = m_BodyIndex.find(body);
+	if (it != m_BodyIndex.end()) {
+		index = it->second;
+	} else {
+		if (!m_FreeBodies.empty()) {
+			index = m_FreeBodies.back();
+			m_FreeBodies.pop_back();
+		} else {
+			index = (unsigned)m_Bodies.size();
+			m_Bodies.push_back(BodyState());
+		}
+		BodyState& state = m_Bodies[index];
+		state.m_pBody = body;
+		state.m_nSensors = 0;
+		state.m_nVelocitySensors = 0;
+		m_BodyIndex[body] = index;
+	}
+	m_Bodies[index].m_nSensors++;
+	if (velocity)
+		m_Bodies[index].m_nVelocitySensors++;
+	return index;
+}
+
+void palSensorManager::RemoveBody(unsigned index, bool velocity) {
+	BodyState& state = m_Bodies[index];
+	if (velocity)
+		state.m_nVelocitySensors--;
+	if (--state.m_nSensors == 0) {
+		m_BodyIndex.erase(state.m_pBody);
+		state.m_pBody = NULL;
+		m_FreeBodies.push_back(index);
+	}
+}
+
+bool palSensorManager::Add(palSensor *sensor) {
+	if (sensor == NULL || sensor->m_pBody == NULL || sensor->m_pManager != NULL)
+		return false;
+
+	if (palPSDSensor *psd = dynamic_cast<palPSDSensor *>(sensor)) {
+		Entry<palPSDSensor> e = { psd, AddBody(sensor->m_pBody, false), UINT_MAX };
+		palPhysics *physics = dynamic_cast<palPhysics *>(sensor->GetParent());
+		const palCollisionDetection *pcd = (physics != NULL) ? physics->asCollisionDetection() : NULL;
+		if (pcd != NULL) {
+			for (unsigned i = 0; i < m_RayBatches.size(); i++)
+				if (m_RayBatches[i].m_pCollision == pcd)
+					e.m_nRayBatch = i;
+			if (e.m_nRayBatch == UINT_MAX) {
+				e.m_nRayBatch = (unsigned)m_RayBatches.size();
+				m_RayBatches.push_back(RayBatch());
+				m_RayBatches.back().m_pCollision = pcd;
+			}
+		}
+		m_PSDSensors.push_back(e);
+	} else if (palCompassSensor *compass = dynamic_cast<palCompassSensor *>(sensor)) {
+		Entry<palCompassSensor> e = { compass, AddBody(sensor->m_pBody, false), UINT_MAX };
+		m_CompassSensors.push_back(e);
+	} else if (palInclinometerSensor *inclinometer = dynamic_cast<palInclinometerSensor *>(sensor)) {
+		Entry<palInclinometerSensor> e = { inclinometer, AddBody(sensor->m_pBody, false), UINT_MAX };
+		m_InclinometerSensors.push_back(e);
+	} else if (palGyroscopeSensor *gyroscope = dynamic_cast<palGyroscopeSensor *>(sensor)) {
+		Entry<palGyroscopeSensor> e = { gyroscope, AddBody(sensor->m_pBody, true), UINT_MAX };
+		m_GyroscopeSensors.push_back(e);
+	} else if (palVelocimeterSensor *velocimeter = dynamic_cast<palVelocimeterSensor *>(sensor)) {
+		Entry<palVelocimeterSensor> e = { velocimeter, AddBody(sensor->m_pBody, true), UINT_MAX };
+		m_VelocimeterSensors.push_back(e);
+	} else {
+		return false;
+	}
+	sensor->m_pManager = this;
+	return true;
+}
+
+template <typename T>
+bool palSensorManager::RemoveEntry(PAL_VECTOR<Entry<T> >& entries, palSensor *sensor, bool velocity) {
+	for (unsigned i = 0; i < entries.size(); i++) {
+		if (static_cast<palSensor *>(entries[i].m_pSensor) == sensor) {
+			RemoveBody(entries[i].m_nBody, velocity);
+			entries[i] = entries.back();
+			entries.pop_back();
+			return true;
+		}
+	}
+	return false;
+}
+
+void palSensorManager::Remove(palSensor *sensor) {
+	if (sensor == NULL || sensor->m_pManager != this)
+		return;
+	if (!RemoveEntry(m_PSDSensors, sensor, false)
+		&& !RemoveEntry(m_CompassSensors, sensor, false)
+		&& !RemoveEntry(m_InclinometerSensors, sensor, false)
+		&& !RemoveEntry(m_GyroscopeSensors, sensor, true))
+		RemoveEntry(m_VelocimeterSensors, sensor, true);
+	sensor->m_pManager = NULL;
+}
+
+void palSensorManager::Clear() {
+	for (unsigned i = 0; i < m_PSDSensors.size(); i++)
+		m_PSDSensors[i].m_pSensor->m_pManager = NULL;
+	for (unsigned i = 0; i < m_CompassSensors.size(); i++)
+		m_CompassSensors[i].m_pSensor->m_pManager = NULL;
+	for (unsigned i = 0; i < m_InclinometerSensors.size(); i++)
+		m_InclinometerSensors[i].m_pSensor->m_pManager = NULL;
+	for (unsigned i = 0; i < m_GyroscopeSensors.size(); i++)
+		m_GyroscopeSensors[i].m_pSensor->m_pManager = NULL;
+	for (unsigned i = 0; i < m_VelocimeterSensors.size(); i++)
+		m_VelocimeterSensors[i].m_pSensor->m_pManager = NULL;
+	m_PSDSensors.clear();
+	m_CompassSensors.clear();
+	m_InclinometerSensors.clear();
+	m_GyroscopeSensors.clear();
+	m_VelocimeterSensors.clear();
+	m_Bodies.clear();
+	m_FreeBodies.clear();
+	m_BodyIndex.clear();
+	m_RayBatches.clear();
+}
+
+template <typename Functor>
+void palSensorManager::ParallelFor(unsigned count, Functor f) {
+	// not worth starting a thread for less than this many sensors
+	const unsigned minPerThread = 1024;
+	unsigned threads = m_nThreads;
+	if (threads > count / minPerThread)
+		threads = count / minPerThread;
+	if (threads <= 1) {
+		f(0, count);
+		return;
+	}
+	PAL_VECTOR<std::thread> workers;
+	unsigned chunk = (count + threads - 1) / threads;
+	for (unsigned t = 1; t < threads; t++) {
+		unsigned begin = t * chunk;
+		unsigned end = (begin + chunk < count) ? begin + chunk : count;
+		if (begin < end)
+			workers.push_back(std::thread(f, begin, end));
+	}
+	f(0, chunk);
+	for (unsigned t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
+
+void palSensorManager::Update() {
+	// Read each body once, no matter how many sensors are attached to it.
+	for (unsigned i = 0; i < m_Bodies.size(); i++) {
+		BodyState& state = m_Bodies[i];
+		if (state.m_pBody == NULL)
+			continue;
+		state.m_mLocation = state.m_pBody->GetLocationMatrix();
+		if (state.m_nVelocitySensors > 0) {
+			state.m_pBody->GetLinearVelocity(state.m_vLinearVelocity);
+			state.m_pBody->GetAngularVelocity(state.m_vAngularVelocity);
+		}
+	}
+
+	for (unsigned b = 0; b < m_RayBatches.size(); b++) {
+		m_RayBatches[b].m_Rays.clear();
+		m_RayBatches[b].m_Sensors.clear();
+	}
+	for (unsigned i = 0; i < m_PSDSensors.size(); i++) {
+		const Entry<palPSDSensor>& e = m_PSDSensors[i];
+		palRay ray;
+		if (e.m_nRayBatch != UINT_MAX && e.m_pSensor->GetWorldRay(m_Bodies[e.m_nBody].m_mLocation, ray)) {
+			RayBatch& batch = m_RayBatches[e.m_nRayBatch];
+			batch.m_Rays.push_back(ray);
+			batch.m_Sensors.push_back(e.m_pSensor);
+		} else {
+			// the engine keeps this sensor up to date itself (or can not cast rays), so just ask it.
+			e.m_pSensor->m_pManager = NULL;
+			e.m_pSensor->m_fReading = e.m_pSensor->GetDistance();
+			e.m_pSensor->m_pManager = this;
+		}
+	}
+	for (unsigned b = 0; b < m_RayBatches.size(); b++) {
+		RayBatch& batch = m_RayBatches[b];
+		if (batch.m_Rays.empty())
+			continue;
+		batch.m_Hits.resize(batch.m_Rays.size());
+		batch.m_pCollision->RayCastBatch(&batch.m_Rays[0], &batch.m_Hits[0], (unsigned)batch.m_Rays.size());
+		for (unsigned i = 0; i < batch.m_Hits.size(); i++) {
+			const palRayHit& hit = batch.m_Hits[i];
+			batch.m_Sensors[i]->m_fReading = (hit.m_bHitPosition && hit.m_pBody) ? hit.m_fDistance : batch.m_Rays[i].m_fRange;
+		}
+	}
+
+	const BodyState *bodies = m_Bodies.empty() ? NULL : &m_Bodies[0];
+	Entry<palCompassSensor> *compass = m_CompassSensors.empty() ? NULL : &m_CompassSensors[0];
+	ParallelFor((unsigned)m_CompassSensors.size(), [compass, bodies](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; i++)
+			compass[i].m_pSensor->m_fReading = compass[i].m_pSensor->CalculateAngle(bodies[compass[i].m_nBody].m_mLocation);
+	});
+	Entry<palInclinometerSensor> *inclinometer = m_InclinometerSensors.empty() ? NULL : &m_InclinometerSensors[0];
+	ParallelFor((unsigned)m_InclinometerSensors.size(), [inclinometer, bodies](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; i++)
+			inclinometer[i].m_pSensor->m_fReading = inclinometer[i].m_pSensor->CalculateAngle(bodies[inclinometer[i].m_nBody].m_mLocation);
+	});
+	Entry<palGyroscopeSensor> *gyroscope = m_GyroscopeSensors.empty() ? NULL : &m_GyroscopeSensors[0];
+	ParallelFor((unsigned)m_GyroscopeSensors.size(), [gyroscope, bodies](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; i++)
+			gyroscope[i].m_pSensor->m_fReading = gyroscope[i].m_pSensor->CalculateAngle(bodies[gyroscope[i].m_nBody].m_vAngularVelocity);
+	});
+	Entry<palVelocimeterSensor> *velocimeter = m_VelocimeterSensors.empty() ? NULL : &m_VelocimeterSensors[0];
+	ParallelFor((unsigned)m_VelocimeterSensors.size(), [velocimeter, bodies](unsigned begin, unsigned end) {
+		for (unsigned i = begin; i < end; i++) {
+			const BodyState& state = bodies[velocimeter[i].m_nBody];
+			velocimeter[i].m_pSensor->m_fReading = velocimeter[i].m_pSensor->CalculateVelocity(state.m_mLocation, state.m_vLinearVelocity);
+		}
+	});
+}
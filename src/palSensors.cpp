@@ -75,7 +75,13 @@ Float iGetAngle(palVector3 fwd, const palMatrix4x4 &M) {
 
 Float palCompassSensor::GetAngle() const
 {
-	palMatrix4x4 M = m_pBody->GetLocationMatrix();
+	if (m_pManager != NULL)
+		return m_fReading;
+	return CalculateAngle(m_pBody->GetLocationMatrix());
+}
+
+Float palCompassSensor::CalculateAngle(const palMatrix4x4& M) const
+{
 //#error todo: use getangle here and inclino, and make lowlevel example of submarine diving with a sin() on the props or something
 	palVector3 fwd = m_fNorth;
 	vec_norm(&fwd);
@@ -113,14 +119,19 @@ void palInclinometerSensor::Init(palBody *body,
 
 Float palInclinometerSensor::GetAngle() const
 {
-	palMatrix4x4 M = m_pBody->GetLocationMatrix();
+	if (m_pManager != NULL)
+		return m_fReading;
+	return CalculateAngle(m_pBody->GetLocationMatrix());
+}
 
+Float palInclinometerSensor::CalculateAngle(const palMatrix4x4& M) const
+{
 	return iGetAngle(m_fAxis,M);
 }
 
 palGyroscopeSensor::palGyroscopeSensor() {
 	m_pBody = NULL;
-	m_Type = PAL_SENSOR_INCLINOMETER;
+	m_Type = PAL_SENSOR_GYROSCOPE;
 }
 
 void palGyroscopeSensor::Init(palBody *body, Float axis_x, Float axis_y, Float axis_z) {
@@ -136,8 +147,14 @@ void palGyroscopeSensor::Init(palBody *body, Float axis_x, Float axis_y, Float a
 }
 
 Float palGyroscopeSensor::GetAngle() const {
+	if (m_pManager != NULL)
+		return m_fReading;
 	palVector3 angular_vel; 
 	m_pBody->GetAngularVelocity(angular_vel);
+	return CalculateAngle(angular_vel);
+}
+
+Float palGyroscopeSensor::CalculateAngle(const palVector3& angular_vel) const {
 	palVector3 pos;
 	pos.x=m_fAxisX;
 	pos.y=m_fAxisY;
@@ -164,9 +181,14 @@ void palVelocimeterSensor::Init(palBody *body, Float axis_x, Float axis_y, Float
 }
 
 Float palVelocimeterSensor::GetVelocity() const {
+	if (m_pManager != NULL)
+		return m_fReading;
 	palVector3 linear_vel; 
 	m_pBody->GetLinearVelocity(linear_vel);
-	palMatrix4x4 m = m_pBody->GetLocationMatrix();
+	return CalculateVelocity(m_pBody->GetLocationMatrix(), linear_vel);
+}
+
+Float palVelocimeterSensor::CalculateVelocity(const palMatrix4x4& m, const palVector3& linear_vel) const {
 	palVector3 old_pos;
 	palVector3 new_pos;
 	old_pos.x=m_fAxisX;
@@ -0,0 +1,87 @@
+#include "palStateBuffer.h"
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (state buffer)
+
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+//the vector only grows, m_nSize is the part in use, so that Clear and Append never touch the bytes
+
+palStateBuffer::palStateBuffer()
+: m_nSize(0), m_nRead(0) {
+}
+
+void palStateBuffer::Clear() {
+	m_nSize = 0;
+	m_nRead = 0;
+}
+
+void palStateBuffer::Reserve(size_t bytes) {
+	if (m_Data.size() < bytes)
+		m_Data.resize(bytes);
+}
+
+size_t palStateBuffer::GetSize() const {
+	return m_nSize;
+}
+
+const void *palStateBuffer::GetData() const {
+	if (m_nSize == 0)
+		return NULL;
+	return &m_Data[0];
+}
+
+void palStateBuffer::SetData(const void *data, size_t bytes) {
+	Clear();
+	Write(data, bytes);
+}
+
+void *palStateBuffer::Append(size_t bytes) {
+	if (m_Data.size() < m_nSize + bytes || m_Data.empty()) {
+		size_t size = m_Data.size() * 2;
+		if (size < m_nSize + bytes)
+			size = m_nSize + bytes;
+		if (size == 0)
+			size = 256;
+		m_Data.resize(size);
+	}
+	void *p = &m_Data[0] + m_nSize;
+	m_nSize += bytes;
+	return p;
+}
+
+void palStateBuffer::Write(const void *data, size_t bytes) {
+	if (bytes == 0)
+		return;
+	memcpy(Append(bytes), data, bytes);
+}
+
+void palStateBuffer::Rewind() const {
+	m_nRead = 0;
+}
+
+const void *palStateBuffer::Take(size_t bytes) const {
+	if (bytes > m_nSize - m_nRead || m_nSize == 0)
+		return NULL;
+	const void *p = &m_Data[0] + m_nRead;
+	m_nRead += bytes;
+	return p;
+}
+
+bool palStateBuffer::Read(void *data, size_t bytes) const {
+	if (bytes == 0)
+		return true;
+	const void *p = Take(bytes);
+	if (p == NULL)
+		return false;
+	memcpy(data, p, bytes);
+	return true;
+}
+
+size_t palStateBuffer::GetRemaining() const {
+	return m_nSize - m_nRead;
+}
@@ -1,5 +1,6 @@
 #include "palStatic.h"
 #include "palFactory.h"
+#include <string.h>
 
 FACTORY_CLASS_IMPLEMENTATION(palStaticCompoundBody);
 
@@ -124,3 +125,137 @@ void palStaticCompoundBody::Finalize() {
 //		}
 //	}
 }
+
+//////////////
+
+palStaticInstanceSet::palStaticInstanceSet()
+: m_bFinalized(false)
+{
+	m_Type = PAL_STATIC_INSTANCE_SET;
+}
+
+int palStaticInstanceSet::AddInstance(palGeometryType type, const palMatrix4x4& pos, palMaterial *material, void *userData) {
+	if (m_bFinalized)
+		return -1;
+	palStaticInstance inst;
+	memset(&inst, 0, sizeof(inst));
+	inst.m_Type = type;
+	inst.m_mLoc = pos;
+	inst.m_nShape = -1;
+	inst.m_pMaterial = material;
+	inst.m_pUserData = userData;
+	m_Instances.push_back(inst);
+	return (int)m_Instances.size() - 1;
+}
+
+int palStaticInstanceSet::AddBox(const palMatrix4x4& pos, Float width, Float height, Float depth, palMaterial *material, void *userData) {
+	int i = AddInstance(PAL_GEOM_BOX, pos, material, userData);
+	if (i >= 0) {
+		m_Instances[i].m_fDimensions[0] = width;
+		m_Instances[i].m_fDimensions[1] = height;
+		m_Instances[i].m_fDimensions[2] = depth;
+	}
+	return i;
+}
+
+int palStaticInstanceSet::AddSphere(const palMatrix4x4& pos, Float radius, palMaterial *material, void *userData) {
+	int i = AddInstance(PAL_GEOM_SPHERE, pos, material, userData);
+	if (i >= 0)
+		m_Instances[i].m_fDimensions[0] = radius;
+	return i;
+}
+
+int palStaticInstanceSet::AddCapsule(const palMatrix4x4& pos, Float radius, Float length, palMaterial *material, void *userData) {
+	int i = AddInstance(PAL_GEOM_CAPSULE, pos, material, userData);
+	if (i >= 0) {
+		m_Instances[i].m_fDimensions[0] = radius;
+		m_Instances[i].m_fDimensions[1] = length;
+	}
+	return i;
+}
+
+int palStaticInstanceSet::AddConvexShape(const Float *pVertices, int nVertices, const int *pIndices, int nIndices) {
+	if (m_bFinalized || pVertices == NULL || nVertices <= 0)
+		return -1;
+	m_ConvexVertices.push_back(PAL_VECTOR<Float>(pVertices, pVertices + nVertices * 3));
+	if (pIndices != NULL && nIndices > 0)
+		m_ConvexIndices.push_back(PAL_VECTOR<int>(pIndices, pIndices + nIndices));
+	else
+		m_ConvexIndices.push_back(PAL_VECTOR<int>());
+	return (int)m_ConvexVertices.size() - 1;
+}
+
+int palStaticInstanceSet::AddConvex(const palMatrix4x4& pos, int shape, palMaterial *material, void *userData) {
+	if (shape < 0 || shape >= (int)m_ConvexVertices.size())
+		return -1;
+	int i = AddInstance(PAL_GEOM_CONVEX, pos, material, userData);
+	if (i >= 0)
+		m_Instances[i].m_nShape = shape;
+	return i;
+}
+
+void palStaticInstanceSet::Finalize() {
+	m_bFinalized = true;
+}
+
+unsigned int palStaticInstanceSet::GetNumInstances() const {
+	return (unsigned int)m_Instances.size();
+}
+
+const palStaticInstance& palStaticInstanceSet::GetInstance(unsigned int instance) const {
+	return m_Instances[instance];
+}
+
+int palStaticInstanceSet::GetUpAxis() const {
+	const palPhysics *physics = dynamic_cast<const palPhysics *>(GetParent());
+	if (physics != NULL)
+		return physics->GetUpAxis();
+	return PAL_Y_AXIS;
+}
+
+palVector3 palStaticInstanceSet::GetBoxXYZDimensions(unsigned int instance) const {
+	const palStaticInstance& inst = m_Instances[instance];
+	int upAxis = GetUpAxis();
+	palVector3 result;
+	result[upAxis] = inst.m_fDimensions[1];
+	switch (upAxis) {
+	case PAL_X_AXIS:
+		result.y = inst.m_fDimensions[2];
+		result.z = inst.m_fDimensions[0];
+		break;
+	case PAL_Z_AXIS:
+		result.x = inst.m_fDimensions[0];
+		result.y = inst.m_fDimensions[2];
+		break;
+	default:
+		result.x = inst.m_fDimensions[0];
+		result.z = inst.m_fDimensions[2];
+		break;
+	}
+	return result;
+}
+
+unsigned int palStaticInstanceSet::GetNumConvexShapes() const {
+	return (unsigned int)m_ConvexVertices.size();
+}
+
+void palStaticInstanceSet::GetConvexShape(int shape, const PAL_VECTOR<Float> *&vertices, const PAL_VECTOR<int> *&indices) const {
+	vertices = &m_ConvexVertices[shape];
+	indices = &m_ConvexIndices[shape];
+}
+
+palMaterial *palStaticInstanceSet::GetInstanceMaterial(int instance) {
+	if (instance >= 0 && instance < (int)m_Instances.size() && m_Instances[instance].m_pMaterial != NULL)
+		return m_Instances[instance].m_pMaterial;
+	return GetMaterial();
+}
+
+void *palStaticInstanceSet::GetInstanceUserData(int instance) const {
+	if (instance >= 0 && instance < (int)m_Instances.size())
+		return m_Instances[instance].m_pUserData;
+	return GetUserData();
+}
+
+const palMatrix4x4& palStaticInstanceSet::GetLocationMatrix() const {
+	return m_mLoc;
+}
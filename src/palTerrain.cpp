@@ -147,13 +147,17 @@ void palTerrainHeightmap::Init(Float x, Float y, Float z, Float width, Float dep
 	m_Type = PAL_TERRAIN_HEIGHTMAP;
 }
 
+bool palTerrainHeightmap::Prepare(Float /*x*/, Float /*y*/, Float /*z*/, Float /*width*/, Float /*depth*/, int /*terrain_data_width*/, int /*terrain_data_depth*/, const Float * /*pHeightmap*/) {
+	return false;
+}
+
 palTerrainHeightmap::palTerrainHeightmap() {
 	m_pHeightmap  = NULL;
 	m_Type = PAL_TERRAIN_HEIGHTMAP;
 }
 
 palTerrainHeightmap::~palTerrainHeightmap() {
-	delete m_pHeightmap;
+	delete [] m_pHeightmap;
 	m_pHeightmap = NULL;
 }
 
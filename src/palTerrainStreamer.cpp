@@ -0,0 +1,379 @@
+#include "palTerrainStreamer.h"
+#include "palFactory.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (terrain streamer)
+
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+typedef std::chrono::steady_clock StreamerClock;
+
+static double MsSince(StreamerClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(StreamerClock::now() - start).count();
+}
+
+palTerrainStreamer::palTerrainStreamer()
+: m_fTileSize(1), m_nSamples(2), m_fOriginX(0), m_fOriginZ(0),
+  m_fLoadRadius(1.5f), m_fUnloadRadius(2),
+  m_nMaxTiles(0), m_nMaxBytes(0), m_nMaxPerUpdate(4),
+  m_nInFlight(0), m_nBuilding(0), m_nResident(0),
+  m_fBuildMsTotal(0), m_fAddMsTotal(0), m_fLatencyMsTotal(0), m_nBuilds(0),
+  m_bStop(false) {
+	memset(&m_Metrics, 0, sizeof(m_Metrics));
+}
+
+palTerrainStreamer::~palTerrainStreamer() {
+	Stop();
+	ClearTiles();
+}
+
+void palTerrainStreamer::Init(Float tileSize, int samples, const HeightSource& source, Float originX, Float originZ) {
+	Stop();
+	ClearTiles();
+	m_fTileSize = tileSize;
+	m_nSamples = (samples < 2) ? 2 : samples;
+	m_fOriginX = originX;
+	m_fOriginZ = originZ;
+	m_fLoadRadius = tileSize * 1.5f;
+	m_fUnloadRadius = tileSize * 2;
+	m_Source = source;
+	m_Thread = std::thread(&palTerrainStreamer::Worker, this);
+}
+
+void palTerrainStreamer::Stop() {
+	if (!m_Thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_bStop = true;
+	}
+	m_Wake.notify_all();
+	m_Thread.join();
+	m_bStop = false;
+}
+
+int palTerrainStreamer::AddFocus(Float x, Float z) {
+	Focus focus;
+	focus.m_fX = x;
+	focus.m_fZ = z;
+	focus.m_bUsed = true;
+	for (size_t i = 0; i < m_Focus.size(); i++) {
+		if (!m_Focus[i].m_bUsed) {
+			m_Focus[i] = focus;
+			return (int)i;
+		}
+	}
+	m_Focus.push_back(focus);
+	return (int)m_Focus.size() - 1;
+}
+
+void palTerrainStreamer::SetFocus(int focus, Float x, Float z) {
+	if (focus < 0 || focus >= (int)m_Focus.size())
+		return;
+	m_Focus[focus].m_fX = x;
+	m_Focus[focus].m_fZ = z;
+}
+
+void palTerrainStreamer::RemoveFocus(int focus) {
+	if (focus >= 0 && focus < (int)m_Focus.size())
+		m_Focus[focus].m_bUsed = false;
+}
+
+void palTerrainStreamer::SetRadius(Float load, Float unload) {
+	m_fLoadRadius = load;
+	m_fUnloadRadius = (unload > load) ? unload : load;
+}
+
+void palTerrainStreamer::SetMaxResidentTiles(unsigned int tiles) {
+	m_nMaxTiles = tiles;
+}
+
+void palTerrainStreamer::SetMaxResidentBytes(size_t bytes) {
+	m_nMaxBytes = bytes;
+}
+
+void palTerrainStreamer::SetMaxTilesPerUpdate(unsigned int tiles) {
+	m_nMaxPerUpdate = (tiles > 0) ? tiles : 1;
+}
+
+size_t palTerrainStreamer::EstimateTileBytes(int samples) {
+	size_t points = (size_t)samples * samples;
+	size_t triangles = (size_t)(samples - 1) * (samples - 1) * 2;
+	// the heights PAL keeps, the vertices, and three indices per triangle
+	return points * sizeof(Float) * 4 + triangles * 3 * sizeof(int);
+}
+
+Float palTerrainStreamer::Distance(int tileX, int tileZ) const {
+	Float minX = m_fOriginX + tileX * m_fTileSize;
+	Float minZ = m_fOriginZ + tileZ * m_fTileSize;
+	Float best = PAL_MAX_FLOAT;
+	for (size_t i = 0; i < m_Focus.size(); i++) {
+		const Focus& focus = m_Focus[i];
+		if (!focus.m_bUsed)
+			continue;
+		Float dx = std::max(std::max(minX - focus.m_fX, focus.m_fX - (minX + m_fTileSize)), (Float)0);
+		Float dz = std::max(std::max(minZ - focus.m_fZ, focus.m_fZ - (minZ + m_fTileSize)), (Float)0);
+		best = std::min(best, (Float)sqrt(dx * dx + dz * dz));
+	}
+	return best;
+}
+
+bool palTerrainStreamer::OverCap(unsigned int extraTiles) const {
+	size_t tiles = m_nResident + m_nInFlight + extraTiles;
+	if (m_nMaxTiles > 0 && tiles > m_nMaxTiles)
+		return true;
+	return m_nMaxBytes > 0 && tiles * EstimateTileBytes(m_nSamples) > m_nMaxBytes;
+}
+
+void palTerrainStreamer::Worker() {
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	for (;;) {
+		m_Wake.wait(lock, [this] {return m_bStop || !m_Queue.empty();});
+		if (m_bStop)
+			return;
+		// the nearest tile first
+		size_t next = 0;
+		for (size_t i = 1; i < m_Queue.size(); i++) {
+			if (m_Queue[i]->m_fDistance < m_Queue[next]->m_fDistance)
+				next = i;
+		}
+		Tile *tile = m_Queue[next];
+		m_Queue[next] = m_Queue.back();
+		m_Queue.pop_back();
+		tile->m_State = TILE_BUILDING;
+		m_nBuilding++;
+		lock.unlock();
+
+		StreamerClock::time_point start = StreamerClock::now();
+		tile->m_Heights.resize(m_nSamples * m_nSamples);
+		tile->m_bHasTerrain = m_Source(tile->m_nX, tile->m_nZ, m_nSamples, &tile->m_Heights[0]);
+		if (tile->m_bHasTerrain) {
+			Float half = m_fTileSize * 0.5f;
+			tile->m_pTerrain->Prepare(m_fOriginX + tile->m_nX * m_fTileSize + half, 0,
+				m_fOriginZ + tile->m_nZ * m_fTileSize + half,
+				m_fTileSize, m_fTileSize, m_nSamples, m_nSamples, &tile->m_Heights[0]);
+		}
+		double ms = MsSince(start);
+
+		lock.lock();
+		tile->m_State = TILE_READY;
+		m_nBuilding--;
+		m_Built.push_back(tile);
+		m_Metrics.m_fLastBuildMs = (Float)ms;
+		m_Metrics.m_fMaxBuildMs = std::max(m_Metrics.m_fMaxBuildMs, (Float)ms);
+		m_fBuildMsTotal += ms;
+		m_nBuilds++;
+		m_Metrics.m_fMeanBuildMs = (Float)(m_fBuildMsTotal / m_nBuilds);
+		m_Done.notify_all();
+	}
+}
+
+void palTerrainStreamer::AddTile(Tile *tile) {
+	if (tile->m_bHasTerrain) {
+		StreamerClock::time_point start = StreamerClock::now();
+		Float half = m_fTileSize * 0.5f;
+		tile->m_pTerrain->Init(m_fOriginX + tile->m_nX * m_fTileSize + half, 0,
+			m_fOriginZ + tile->m_nZ * m_fTileSize + half,
+			m_fTileSize, m_fTileSize, m_nSamples, m_nSamples, &tile->m_Heights[0]);
+		double ms = MsSince(start);
+		m_fAddMsTotal += ms;
+		m_Metrics.m_fMaxAddMs = std::max(m_Metrics.m_fMaxAddMs, (Float)ms);
+		m_nResident++;
+		m_Metrics.m_nLoaded++;
+		m_Metrics.m_fMeanAddMs = (Float)(m_fAddMsTotal / m_Metrics.m_nLoaded);
+		double latency = MsSince(tile->m_Requested);
+		m_fLatencyMsTotal += latency;
+		m_Metrics.m_fMaxLatencyMs = std::max(m_Metrics.m_fMaxLatencyMs, (Float)latency);
+		m_Metrics.m_fMeanLatencyMs = (Float)(m_fLatencyMsTotal / m_Metrics.m_nLoaded);
+	} else {
+		// kept as an empty tile, so it is not asked for again
+		delete tile->m_pTerrain;
+		tile->m_pTerrain = NULL;
+	}
+	PAL_VECTOR<Float>().swap(tile->m_Heights);
+	tile->m_State = TILE_RESIDENT;
+	m_nInFlight--;
+}
+
+void palTerrainStreamer::RemoveTile(Tile *tile) {
+	if (tile->m_State == TILE_RESIDENT) {
+		if (tile->m_pTerrain) {
+			m_nResident--;
+			m_Metrics.m_nUnloaded++;
+		}
+	} else {
+		m_nInFlight--;
+		m_Metrics.m_nCancelled++;
+	}
+	m_Tiles.erase(TileKey(tile->m_nX, tile->m_nZ));
+	delete tile->m_pTerrain;
+	delete tile;
+}
+
+void palTerrainStreamer::Update() {
+	if (!m_Thread.joinable())
+		return;
+	// unload the tiles beyond reach, those being built once they are
+	PAL_VECTOR<Tile *> unload;
+	{
+		// the worker reads the distances of the queued tiles, and sets the state of the others
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Ready.insert(m_Ready.end(), m_Built.begin(), m_Built.end());
+		m_Built.clear();
+		for (PAL_MAP<TileKey, Tile *>::iterator it = m_Tiles.begin(); it != m_Tiles.end(); ++it) {
+			Tile *tile = it->second;
+			tile->m_fDistance = Distance(tile->m_nX, tile->m_nZ);
+			tile->m_bCancelled = tile->m_fDistance > m_fUnloadRadius;
+			if (tile->m_bCancelled && tile->m_State == TILE_RESIDENT)
+				unload.push_back(tile);
+		}
+		for (size_t i = 0; i < m_Queue.size();) {
+			if (m_Queue[i]->m_bCancelled) {
+				unload.push_back(m_Queue[i]);
+				m_Queue[i] = m_Queue.back();
+				m_Queue.pop_back();
+			} else {
+				i++;
+			}
+		}
+	}
+	for (size_t i = 0; i < m_Ready.size();) {
+		if (m_Ready[i]->m_bCancelled) {
+			unload.push_back(m_Ready[i]);
+			m_Ready.erase(m_Ready.begin() + i);
+		} else {
+			i++;
+		}
+	}
+	for (size_t i = 0; i < unload.size(); i++)
+		RemoveTile(unload[i]);
+
+	// add the nearest built tiles
+	std::sort(m_Ready.begin(), m_Ready.end(), [](const Tile *a, const Tile *b) {return a->m_fDistance < b->m_fDistance;});
+	size_t add = std::min(m_Ready.size(), (size_t)m_nMaxPerUpdate);
+	for (size_t i = 0; i < add; i++)
+		AddTile(m_Ready[i]);
+	m_Ready.erase(m_Ready.begin(), m_Ready.begin() + add);
+
+	// the missing tiles within the load radius, nearest first
+	PAL_VECTOR<std::pair<Float, TileKey> > wanted;
+	for (size_t f = 0; f < m_Focus.size(); f++) {
+		if (!m_Focus[f].m_bUsed)
+			continue;
+		int x0 = (int)floor((m_Focus[f].m_fX - m_fLoadRadius - m_fOriginX) / m_fTileSize);
+		int x1 = (int)floor((m_Focus[f].m_fX + m_fLoadRadius - m_fOriginX) / m_fTileSize);
+		int z0 = (int)floor((m_Focus[f].m_fZ - m_fLoadRadius - m_fOriginZ) / m_fTileSize);
+		int z1 = (int)floor((m_Focus[f].m_fZ + m_fLoadRadius - m_fOriginZ) / m_fTileSize);
+		for (int z = z0; z <= z1; z++) {
+			for (int x = x0; x <= x1; x++) {
+				TileKey key(x, z);
+				if (m_Tiles.find(key) != m_Tiles.end())
+					continue;
+				Float distance = Distance(x, z);
+				if (distance <= m_fLoadRadius)
+					wanted.push_back(std::make_pair(distance, key));
+			}
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+	wanted.erase(std::unique(wanted.begin(), wanted.end()), wanted.end());
+
+	// the farthest resident tiles make room for nearer ones
+	PAL_VECTOR<Tile *> resident;
+	if (m_nMaxTiles > 0 || m_nMaxBytes > 0) {
+		for (PAL_MAP<TileKey, Tile *>::iterator it = m_Tiles.begin(); it != m_Tiles.end(); ++it) {
+			if (it->second->m_State == TILE_RESIDENT && it->second->m_pTerrain)
+				resident.push_back(it->second);
+		}
+		std::sort(resident.begin(), resident.end(), [](const Tile *a, const Tile *b) {return a->m_fDistance < b->m_fDistance;});
+		while (OverCap(0) && !resident.empty()) {
+			RemoveTile(resident.back());
+			resident.pop_back();
+		}
+	}
+
+	size_t requested = 0;
+	for (size_t i = 0; i < wanted.size(); i++) {
+		while (OverCap(1) && !resident.empty() && resident.back()->m_fDistance > wanted[i].first) {
+			RemoveTile(resident.back());
+			resident.pop_back();
+		}
+		if (OverCap(1))
+			break;
+		palTerrainHeightmap *terrain = PF->CreateTerrainHeightmap();
+		if (terrain == NULL)
+			break;
+		Tile *tile = new Tile;
+		tile->m_nX = wanted[i].second.first;
+		tile->m_nZ = wanted[i].second.second;
+		tile->m_State = TILE_QUEUED;
+		tile->m_bCancelled = false;
+		tile->m_bHasTerrain = false;
+		tile->m_fDistance = wanted[i].first;
+		tile->m_pTerrain = terrain;
+		tile->m_Requested = StreamerClock::now();
+		m_Tiles[wanted[i].second] = tile;
+		m_nInFlight++;
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Queue.push_back(tile);
+		requested++;
+	}
+	if (requested > 0)
+		m_Wake.notify_one();
+}
+
+void palTerrainStreamer::Flush() {
+	for (;;) {
+		Update();
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		if (m_Queue.empty() && m_nBuilding == 0 && m_Built.empty()) {
+			if (m_Ready.empty())
+				return;
+			continue;
+		}
+		m_Done.wait(lock, [this] {return !m_Built.empty() || (m_Queue.empty() && m_nBuilding == 0);});
+	}
+}
+
+void palTerrainStreamer::Clear() {
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Queue.clear();
+		m_Done.wait(lock, [this] {return m_nBuilding == 0;});
+		m_Built.clear();
+	}
+	ClearTiles();
+}
+
+void palTerrainStreamer::ClearTiles() {
+	// the worker is stopped or idle, every tile is in m_Tiles
+	while (!m_Tiles.empty())
+		RemoveTile(m_Tiles.begin()->second);
+	m_Queue.clear();
+	m_Built.clear();
+	m_Ready.clear();
+}
+
+palTerrainHeightmap *palTerrainStreamer::GetTile(int tileX, int tileZ) const {
+	PAL_MAP<TileKey, Tile *>::const_iterator it = m_Tiles.find(TileKey(tileX, tileZ));
+	if (it == m_Tiles.end() || it->second->m_State != TILE_RESIDENT)
+		return NULL;
+	return it->second->m_pTerrain;
+}
+
+palTerrainStreamer::Metrics palTerrainStreamer::GetMetrics() const {
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Metrics metrics = m_Metrics;
+	metrics.m_nResidentTiles = m_nResident;
+	metrics.m_nPendingTiles = (unsigned int)m_Queue.size() + m_nBuilding;
+	metrics.m_nReadyTiles = (unsigned int)(m_Built.size() + m_Ready.size());
+	metrics.m_nResidentBytes = m_nResident * EstimateTileBytes(m_nSamples);
+	return metrics;
+}
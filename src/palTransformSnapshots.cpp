@@ -0,0 +1,114 @@
+#include "palTransformSnapshots.h"
+#include <limits.h>
+/*
+	Abstract:
+		PAL - Physics Abstraction Layer.
+		Implementation File (transform snapshots)
+
+	Revision History:
+		Version 0.1   : 19/10/26 - Original
+	TODO:
+*/
+
+//A reader counts itself into the buffer it read as the latest, then checks it is still the latest.
+//If it is, the buffer was complete when it was published and Publish will not pick it until the count drops back to 0:
+//Publish only writes buffers that are not the latest and have no readers.
+//All the atomics are sequentially consistent, the check relies on it.
+
+palTransformSnapshot::palTransformSnapshot()
+: m_fTime(0), m_nFrame(0), m_nReaders(0) {
+}
+
+palTransformSnapshots::palTransformSnapshots()
+: m_nLatest(-1), m_nFrame(0), m_nSkipped(0) {
+}
+
+unsigned palTransformSnapshots::Add(palBody *body) {
+	PAL_MAP<palBody *, unsigned>::iterator it = m_SlotIndex.find(body);
+	if (it != m_SlotIndex.end())
+		return it->second;
+	unsigned slot;
+	if (!m_FreeSlots.empty()) {
+		slot = m_FreeSlots.back();
+		m_FreeSlots.pop_back();
+		m_Slots[slot] = body;
+	} else {
+		slot = (unsigned)m_Slots.size();
+		m_Slots.push_back(body);
+	}
+	m_SlotIndex[body] = slot;
+	return slot;
+}
+
+void palTransformSnapshots::Remove(palBody *body) {
+	PAL_MAP<palBody *, unsigned>::iterator it = m_SlotIndex.find(body);
+	if (it == m_SlotIndex.end())
+		return;
+	m_Slots[it->second] = NULL;
+	m_FreeSlots.push_back(it->second);
+	m_SlotIndex.erase(it);
+}
+
+void palTransformSnapshots::Clear() {
+	m_Slots.clear();
+	m_FreeSlots.clear();
+	m_SlotIndex.clear();
+}
+
+unsigned palTransformSnapshots::GetSlot(palBody *body) const {
+	PAL_MAP<palBody *, unsigned>::const_iterator it = m_SlotIndex.find(body);
+	if (it == m_SlotIndex.end())
+		return UINT_MAX;
+	return it->second;
+}
+
+bool palTransformSnapshots::Publish(Float time) {
+	int latest = m_nLatest;
+	int target = -1;
+	for (int i = 0; i < NUM_BUFFERS; i++) {
+		if (i != latest && m_Buffers[i].m_nReaders == 0) {
+			target = i;
+			break;
+		}
+	}
+	if (target < 0) {
+		m_nSkipped++;
+		return false;
+	}
+
+	palTransformSnapshot& snapshot = m_Buffers[target];
+	snapshot.m_Bodies.resize(m_Slots.size());
+	for (size_t i = 0; i < m_Slots.size(); i++) {
+		palBodySnapshot& s = snapshot.m_Bodies[i];
+		palBody *body = m_Slots[i];
+		s.m_bUsed = (body != NULL);
+		if (body == NULL)
+			continue;
+		s.m_mLocation = body->GetLocationMatrix();
+		body->GetLinearVelocity(s.m_vLinearVelocity);
+		body->GetAngularVelocity(s.m_vAngularVelocity);
+	}
+	snapshot.m_fTime = time;
+	snapshot.m_nFrame = ++m_nFrame;
+	m_nLatest = target;
+	return true;
+}
+
+const palTransformSnapshot *palTransformSnapshots::Acquire() const {
+	for (;;) {
+		int latest = m_nLatest;
+		if (latest < 0)
+			return NULL;
+		const palTransformSnapshot& snapshot = m_Buffers[latest];
+		snapshot.m_nReaders++;
+		if (m_nLatest == latest)
+			return &snapshot;
+		//a newer one was published in between, this one may be being written
+		snapshot.m_nReaders--;
+	}
+}
+
+void palTransformSnapshots::Release(const palTransformSnapshot *snapshot) const {
+	if (snapshot != NULL)
+		snapshot->m_nReaders--;
+}